@@ -93,6 +93,33 @@ int register_async_fd(int fd, async_resume_fd *f, void *resume_param)
 }
 
 
+int unregister_async_fd(int fd)
+{
+	struct fd_map *e;
+	async_ctx *ctx;
+
+	if (fd<0 || fd>=_worker_io.max_fd_no) {
+		LM_ERR("invalid fd %d\n", fd);
+		return -1;
+	}
+
+	e = get_fd_map(&_worker_io, fd);
+	if (e->type!=F_FD_ASYNC) {
+		LM_ERR("fd %d is not registered as async fd\n", fd);
+		return -1;
+	}
+	ctx = (async_ctx *)e->data;
+
+	if (reactor_del_reader(fd, -1, 0)<0) {
+		LM_ERR("failed to remove async fd %d from reactor\n", fd);
+		return -1;
+	}
+
+	shm_free(ctx);
+	return 0;
+}
+
+
 int async_fd_resume(int fd, void *param)
 {
 	async_ctx *ctx = (async_ctx *)param;
@@ -145,6 +172,7 @@ done:
 	if (async_status == ASYNC_DONE_CLOSE_FD)
 		close(fd);
 
+	shm_free(ctx);
 	return 0;
 }
 
@@ -125,6 +125,13 @@ typedef int (async_resume_fd)
  */
 int register_async_fd(int fd, async_resume_fd *f, void *param);
 
+/* Removes from the reactor (and releases) an fd registered via
+ * register_async_fd(), before its resume function is done with it.
+ * Returns : 0 - on success
+ *          -1 - the FD is not registered as async FD
+ */
+int unregister_async_fd(int fd);
+
 /* Resume function for the registered async fd. This is internally called
  * by the reactor via the handle_io() routine.  Function only for internal
  * usage.  @fd is always valid.
@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "mem/mem.h"
+#include "mem/shm_mem.h"
+#include "dprint.h"
+#include "bin_persist.h"
+
+#define BIN_PERSIST_BUF_SIZE (1024 * 1024)
+
+/* the header of a packet, with its length field set to its buffer length */
+#define BIN_HDR_LEN (BIN_PACKET_MARKER_SIZE + PKG_LEN_FIELD_SIZE)
+
+static inline void bin_persist_hdr(char *hdr, bin_packet_t *packet)
+{
+	unsigned int len = packet->buffer.len;
+
+	memcpy(hdr, BIN_PACKET_MARKER, BIN_PACKET_MARKER_SIZE);
+	memcpy(hdr + BIN_PACKET_MARKER_SIZE, &len, PKG_LEN_FIELD_SIZE);
+}
+
+bin_persist_t *bin_persist_init(const char *path)
+{
+	bin_persist_t *bp;
+	int len;
+	char *p;
+
+	len = strlen(path);
+	if (len == 0) {
+		LM_ERR("empty persistence file path\n");
+		return NULL;
+	}
+
+	bp = pkg_malloc(sizeof *bp + 4 * len + sizeof ".journal.old" +
+		sizeof ".journal" + sizeof ".tmp" + 1);
+	if (!bp) {
+		LM_ERR("no more pkg memory\n");
+		return NULL;
+	}
+	memset(bp, 0, sizeof *bp);
+
+	p = (char *)(bp + 1);
+	bp->snapshot = p;
+	p += sprintf(p, "%s", path) + 1;
+	bp->journal = p;
+	p += sprintf(p, "%s.journal", path) + 1;
+	bp->journal_old = p;
+	p += sprintf(p, "%s.journal.old", path) + 1;
+	bp->tmp = p;
+	sprintf(p, "%s.tmp", path);
+
+	bp->sh = shm_malloc(sizeof *bp->sh);
+	if (!bp->sh) {
+		LM_ERR("no more shm memory\n");
+		pkg_free(bp);
+		return NULL;
+	}
+	memset(bp->sh, 0, sizeof *bp->sh);
+
+	if (!lock_init(&bp->sh->lock)) {
+		LM_ERR("failed to init lock\n");
+		shm_free(bp->sh);
+		pkg_free(bp);
+		return NULL;
+	}
+
+	bp->journal_fd = -1;
+
+	return bp;
+}
+
+void bin_persist_destroy(bin_persist_t *bp)
+{
+	if (!bp)
+		return;
+
+	if (bp->journal_fd >= 0)
+		close(bp->journal_fd);
+
+	lock_destroy(&bp->sh->lock);
+	shm_free(bp->sh);
+	pkg_free(bp);
+}
+
+int bin_load_file(const char *path, bin_persist_load_f cb, void *param)
+{
+	bin_packet_t packet;
+	struct stat st;
+	char *map, *p, *end;
+	unsigned int len;
+	unsigned short cap_len;
+	int fd, n = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return 0;
+
+		LM_ERR("failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		LM_ERR("failed to stat %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	/* private, so the callbacks may alter the packets */
+	map = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		LM_ERR("failed to map %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	for (p = map, end = map + st.st_size; p < end; p += len) {
+		if (end - p < MIN_BIN_PACKET_SIZE) {
+			LM_WARN("truncated packet at offset %ld in %s\n",
+				(long)(p - map), path);
+			break;
+		}
+
+		if (!is_valid_bin_packet(p)) {
+			LM_ERR("bad packet at offset %ld in %s, ignoring the rest\n",
+				(long)(p - map), path);
+			break;
+		}
+
+		memcpy(&len, p + BIN_PACKET_MARKER_SIZE, PKG_LEN_FIELD_SIZE);
+		memcpy(&cap_len, p + HEADER_SIZE, LEN_FIELD_SIZE);
+		if (len > end - p) {
+			LM_WARN("truncated packet at offset %ld in %s\n",
+				(long)(p - map), path);
+			break;
+		}
+
+		if (len < MIN_BIN_PACKET_SIZE + cap_len - 1) {
+			LM_ERR("bad packet at offset %ld in %s, ignoring the rest\n",
+				(long)(p - map), path);
+			break;
+		}
+
+		bin_init_buffer(&packet, p, len);
+		cb(&packet, param);
+		n++;
+	}
+
+	munmap(map, st.st_size);
+	return n;
+}
+
+int bin_persist_load(bin_persist_t *bp, bin_persist_load_f cb, void *param)
+{
+	int n, total;
+
+	total = bin_load_file(bp->snapshot, cb, param);
+	if (total < 0)
+		goto out;
+
+	/* a snapshot was interrupted: its changes were not dumped for sure */
+	n = bin_load_file(bp->journal_old, cb, param);
+	if (n < 0) {
+		total = -1;
+		goto out;
+	}
+	total += n;
+
+	n = bin_load_file(bp->journal, cb, param);
+	if (n < 0) {
+		total = -1;
+		goto out;
+	}
+	total += n;
+
+out:
+	/* even if partially loaded, the data is now the one to be persisted */
+	bp->sh->loaded = 1;
+	return total;
+}
+
+static int bin_persist_open_journal(bin_persist_t *bp)
+{
+	if (bp->journal_fd >= 0) {
+		if (bp->journal_gen == bp->sh->journal_gen)
+			return 0;
+
+		close(bp->journal_fd);
+	}
+
+	bp->journal_fd = open(bp->journal, O_WRONLY|O_APPEND|O_CREAT, 0600);
+	if (bp->journal_fd < 0) {
+		LM_ERR("failed to open %s: %s\n", bp->journal, strerror(errno));
+		return -1;
+	}
+
+	bp->journal_gen = bp->sh->journal_gen;
+	return 0;
+}
+
+int bin_persist_journal(bin_persist_t *bp, bin_packet_t *packet)
+{
+	char hdr[BIN_HDR_LEN];
+	struct iovec iov[2];
+	ssize_t ret;
+	off_t off;
+	int rc = -1;
+
+	bin_persist_hdr(hdr, packet);
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = BIN_HDR_LEN;
+	iov[1].iov_base = packet->buffer.s + BIN_HDR_LEN;
+	iov[1].iov_len = packet->buffer.len - BIN_HDR_LEN;
+
+	/* the journal must not be moved aside in between */
+	lock_get(&bp->sh->lock);
+
+	if (bin_persist_open_journal(bp) < 0)
+		goto out;
+
+	do {
+		ret = writev(bp->journal_fd, iov, 2);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret != packet->buffer.len) {
+		LM_ERR("failed to append to %s: %s\n", bp->journal,
+			ret < 0 ? strerror(errno) : "short write");
+
+		/* drop the partial packet, or the next ones will not be loaded */
+		if (ret > 0) {
+			off = lseek(bp->journal_fd, 0, SEEK_CUR);
+			if (off < 0 || ftruncate(bp->journal_fd, off - ret) < 0)
+				LM_ERR("failed to truncate %s\n", bp->journal);
+		}
+		goto out;
+	}
+
+	rc = 0;
+out:
+	lock_release(&bp->sh->lock);
+	return rc;
+}
+
+int bin_persist_write(bin_persist_t *bp, bin_packet_t *packet)
+{
+	char hdr[BIN_HDR_LEN];
+
+	bin_persist_hdr(hdr, packet);
+
+	if (fwrite(hdr, BIN_HDR_LEN, 1, bp->snapshot_f) != 1 ||
+	    fwrite(packet->buffer.s + BIN_HDR_LEN,
+	           packet->buffer.len - BIN_HDR_LEN, 1, bp->snapshot_f) != 1) {
+		LM_ERR("failed to write to %s: %s\n", bp->tmp, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int bin_persist_copy_cb(bin_packet_t *packet, void *param)
+{
+	int *fd = (int *)param;
+	ssize_t ret;
+
+	if (*fd < 0)
+		return -1;
+
+	do {
+		ret = write(*fd, packet->buffer.s, packet->buffer.len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret != packet->buffer.len) {
+		LM_ERR("failed to copy a packet: %s\n",
+			ret < 0 ? strerror(errno) : "short write");
+		*fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* appends the whole packets of @from to @to (a torn one at the end of
+ * @from is left out, so it does not hide the ones appended later) */
+static int bin_persist_append_file(const char *from, const char *to)
+{
+	int fd, out;
+
+	out = open(to, O_WRONLY|O_APPEND|O_CREAT, 0600);
+	if (out < 0) {
+		LM_ERR("failed to open %s: %s\n", to, strerror(errno));
+		return -1;
+	}
+
+	fd = out;
+	if (bin_load_file(from, bin_persist_copy_cb, &fd) < 0 || fd < 0 ||
+	    fsync(out) < 0) {
+		LM_ERR("failed to append %s to %s\n", from, to);
+		close(out);
+		return -1;
+	}
+
+	close(out);
+	return 0;
+}
+
+/* puts the moved journal back, followed by the changes done meanwhile */
+static void bin_persist_restore_journal(bin_persist_t *bp)
+{
+	lock_get(&bp->sh->lock);
+
+	if (bin_persist_append_file(bp->journal, bp->journal_old) < 0)
+		goto out;
+
+	if (rename(bp->journal_old, bp->journal) < 0 && errno != ENOENT)
+		LM_ERR("failed to rename %s: %s\n", bp->journal_old, strerror(errno));
+	else
+		bp->sh->journal_gen++;
+
+out:
+	lock_release(&bp->sh->lock);
+}
+
+int bin_persist_snapshot(bin_persist_t *bp, bin_persist_dump_f dump,
+		void *param)
+{
+	int fd;
+
+	if (!bp->sh->loaded) {
+		LM_DBG("data not loaded yet, skipping the snapshot\n");
+		return 0;
+	}
+
+	fd = open(bp->tmp, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if (fd < 0) {
+		LM_ERR("failed to open %s: %s\n", bp->tmp, strerror(errno));
+		return -1;
+	}
+
+	bp->snapshot_f = fdopen(fd, "w");
+	if (!bp->snapshot_f) {
+		LM_ERR("failed to open %s: %s\n", bp->tmp, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	setvbuf(bp->snapshot_f, NULL, _IOFBF, BIN_PERSIST_BUF_SIZE);
+
+	/* from now on, the changes go to a new journal; if a previous snapshot
+	 * was interrupted, the old journal still holds changes no snapshot has,
+	 * so the journal goes after them instead of over them */
+	lock_get(&bp->sh->lock);
+	if (access(bp->journal_old, F_OK) == 0) {
+		if (bin_persist_append_file(bp->journal, bp->journal_old) < 0 ||
+		    (unlink(bp->journal) < 0 && errno != ENOENT)) {
+			LM_ERR("failed to move %s aside\n", bp->journal);
+			lock_release(&bp->sh->lock);
+			fclose(bp->snapshot_f);
+			bp->snapshot_f = NULL;
+			return -1;
+		}
+	} else if (rename(bp->journal, bp->journal_old) < 0 && errno != ENOENT) {
+		LM_ERR("failed to rename %s: %s\n", bp->journal, strerror(errno));
+		lock_release(&bp->sh->lock);
+		fclose(bp->snapshot_f);
+		bp->snapshot_f = NULL;
+		return -1;
+	}
+	bp->sh->journal_gen++;
+	lock_release(&bp->sh->lock);
+
+	if (dump(bp, param) < 0) {
+		LM_ERR("failed to dump the data\n");
+		goto error;
+	}
+
+	if (fflush(bp->snapshot_f) != 0 || fsync(fd) < 0) {
+		LM_ERR("failed to sync %s: %s\n", bp->tmp, strerror(errno));
+		goto error;
+	}
+
+	fclose(bp->snapshot_f);
+	bp->snapshot_f = NULL;
+
+	if (rename(bp->tmp, bp->snapshot) < 0) {
+		LM_ERR("failed to rename %s: %s\n", bp->tmp, strerror(errno));
+		unlink(bp->tmp);
+		bin_persist_restore_journal(bp);
+		return -1;
+	}
+
+	unlink(bp->journal_old);
+	return 0;
+
+error:
+	fclose(bp->snapshot_f);
+	bp->snapshot_f = NULL;
+	unlink(bp->tmp);
+	bin_persist_restore_journal(bp);
+	return -1;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Local file persistence of in-memory data, as binary packets
+ *
+ * The data is kept in two files, both plain sequences of bin packets, as
+ * they would be sent on the wire:
+ *   - "<path>", a snapshot of the whole data, written periodically;
+ *   - "<path>.journal", the changes done since the snapshot was started,
+ *     appended by any process, in the format they are replicated in.
+ * At startup, the snapshot and then the journal are memory-mapped and
+ * replayed through a callback.
+ *
+ * A new snapshot first moves the journal aside ("<path>.journal.old"), so
+ * the changes done while the data is dumped go into a new journal. The
+ * dump is written to "<path>.tmp", synced and renamed over the previous
+ * snapshot; only then the old journal is removed. A crash at any point
+ * leaves a loadable set of files behind. If the old journal is still there
+ * when a snapshot starts (the previous one crashed), the journal is
+ * appended to it rather than moved over it, so a second crash loses
+ * nothing either.
+ *
+ * For the data to be consistent, a change must be applied in memory
+ * before it is journaled, and the dump must read the data under the same
+ * locks it is changed under.
+ */
+
+#ifndef _BIN_PERSIST_H_
+#define _BIN_PERSIST_H_
+
+#include <stdio.h>
+
+#include "bin_interface.h"
+#include "locking.h"
+
+struct bin_persist_shared {
+	gen_lock_t lock;
+	/* increased each time the journal is moved aside */
+	unsigned int journal_gen;
+	/* no snapshot is written until the previous data was loaded */
+	int loaded;
+};
+
+typedef struct bin_persist {
+	char *snapshot;
+	char *journal;
+	char *journal_old;
+	char *tmp;
+	struct bin_persist_shared *sh;
+
+	/* per process */
+	int journal_fd;
+	unsigned int journal_gen;
+	FILE *snapshot_f;
+} bin_persist_t;
+
+typedef int (*bin_persist_load_f)(bin_packet_t *packet, void *param);
+typedef int (*bin_persist_dump_f)(bin_persist_t *bp, void *param);
+
+/*
+ * sets up the persistence into the @path snapshot (and its journal);
+ * to be called from mod_init, before forking
+ */
+bin_persist_t *bin_persist_init(const char *path);
+void bin_persist_destroy(bin_persist_t *bp);
+
+/*
+ * replays the snapshot, then the journal(s), packet by packet
+ *
+ * @return: number of loaded packets, -1 on error
+ */
+int bin_persist_load(bin_persist_t *bp, bin_persist_load_f cb, void *param);
+
+/*
+ * appends a change to the journal; any process may call it
+ *
+ * @return: 0 on success, -1 on error
+ */
+int bin_persist_journal(bin_persist_t *bp, bin_packet_t *packet);
+
+/*
+ * writes a new snapshot, calling @dump to push the whole data into it
+ * with bin_persist_write(); skipped until the data was loaded
+ *
+ * @return: 0 on success (or skipped), -1 on error
+ */
+int bin_persist_snapshot(bin_persist_t *bp, bin_persist_dump_f dump,
+		void *param);
+
+/* adds a packet to the snapshot being written */
+int bin_persist_write(bin_persist_t *bp, bin_packet_t *packet);
+
+/*
+ * maps a file of bin packets and calls @cb for each one of them;
+ * a missing file is empty, a truncated packet at its end (an interrupted
+ * append) ends it
+ *
+ * @return: number of packets, -1 on error
+ */
+int bin_load_file(const char *path, bin_persist_load_f cb, void *param);
+
+#endif /* _BIN_PERSIST_H_ */
@@ -607,6 +607,14 @@ static inline int check_against_rule_list(struct ip_addr *ip, str *text,
 
 
 
+int blacklists_in_use(void)
+{
+	unsigned int bl_marker;
+
+	return get_bl_marker(&bl_marker)==0 && bl_marker!=0;
+}
+
+
 int check_against_blacklist(struct ip_addr *ip, str *text,
 			unsigned short port, unsigned short proto)
 {
@@ -87,6 +87,9 @@ void reset_bl_markers();
 int check_against_blacklist(struct ip_addr *ip, str *text, unsigned short port,
 			unsigned short proto);
 
+/* returns true if any blacklist is to be checked in the current context */
+int blacklists_in_use(void);
+
 static inline int check_blacklists( unsigned short proto,
 	union sockaddr_union *to, char *body_s, int body_len)
 {
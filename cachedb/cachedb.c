@@ -144,6 +144,46 @@ int cachedb_bind_mod(str *url,cachedb_funcs *funcs)
 	return 0;
 }
 
+int cachedb_get_multi(cachedb_funcs *funcs, cachedb_con *con, str *attrs,
+		str *vals, int n)
+{
+	int i, ret, found = 0;
+
+	if (funcs == NULL || con == NULL || attrs == NULL || vals == NULL) {
+		LM_ERR("NULL parameter provided\n");
+		return -1;
+	}
+
+	if (CACHEDB_CAPABILITY(funcs, CACHEDB_CAP_GET_MULTI))
+		return funcs->get_multi(con, attrs, vals, n);
+
+	if (!CACHEDB_CAPABILITY(funcs, CACHEDB_CAP_GET)) {
+		LM_ERR("cachedb engine does not support get\n");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		vals[i].s = NULL;
+		vals[i].len = 0;
+
+		ret = funcs->get(con, &attrs[i], &vals[i]);
+		if (ret == -2 || (ret >= 0 && vals[i].s == NULL)) {
+			vals[i].s = NULL;
+			vals[i].len = 0;
+		} else if (ret < 0) {
+			LM_ERR("failed to fetch key %.*s\n", attrs[i].len, attrs[i].s);
+			while (i-- > 0)
+				if (vals[i].s)
+					pkg_free(vals[i].s);
+			return -1;
+		} else {
+			found++;
+		}
+	}
+
+	return found;
+}
+
 int register_cachedb(cachedb_engine* cde_entry)
 {
 	struct cachedb_engine_t* cde_node;
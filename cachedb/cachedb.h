@@ -62,6 +62,19 @@ typedef struct cachedb_funcs_t {
 	 * and MUST be freed by the calling layer! */
 	int (*get) (cachedb_con *con, str *attr, str *val);
 
+	/**
+	 * get_multi() - fetches several keys, in as few round trips as the
+	 * backend allows.
+	 * @attrs: the @n keys to fetch.
+	 * @vals: their @n values, set to a NULL string for the missing keys.
+	 *
+	 * NOTE: the found values shall be allocated in PKG memory, and MUST
+	 * be freed by the calling layer!
+	 *
+	 * Return: the number of keys found, -1 on error (no values returned).
+	 */
+	int (*get_multi) (cachedb_con *con, str *attrs, str *vals, int n);
+
 	/**
 	 * Gets the value of a counter.
 	 * Return values:
@@ -171,6 +184,11 @@ int cachedb_raw_query(str* cachedb_engine, str* attr, cdb_raw_entry ***reply,
 			int expected_key_no,int *val_no);
 
 int cachedb_bind_mod(str *url,cachedb_funcs *funcs);
+
+/* runs get_multi(), or falls back to one get() per key for the engines
+ * not supporting it */
+int cachedb_get_multi(cachedb_funcs *funcs, cachedb_con *con, str *attrs,
+		str *vals, int n);
 int cachedb_put_connection(str *cachedb_name,cachedb_con *con);
 
 void cachedb_end_connections(str *cachedb_name);
@@ -44,6 +44,8 @@ typedef enum {
 	CACHEDB_CAP_QUERY = 1<<8,
 	CACHEDB_CAP_UPDATE = 1<<9,
 	CACHEDB_CAP_COL_ORIENTED = (CACHEDB_CAP_QUERY|CACHEDB_CAP_UPDATE),
+
+	CACHEDB_CAP_GET_MULTI = 1<<10,
 } cachedb_cap;
 
 #define CACHEDB_CAPABILITY(cdbf,cpv) (((cdbf)->capability & (cpv)) == (cpv))
@@ -69,6 +71,8 @@ static inline int check_cachedb_api(cachedb_engine *cde)
 		cde->cdb_func.capability |= CACHEDB_CAP_GET;
 	if (cde->cdb_func.set)
 		cde->cdb_func.capability |= CACHEDB_CAP_SET;
+	if (cde->cdb_func.get_multi)
+		cde->cdb_func.capability |= CACHEDB_CAP_GET_MULTI;
 	if (cde->cdb_func.remove)
 		cde->cdb_func.capability |= CACHEDB_CAP_REMOVE;
 	if (cde->cdb_func.add)
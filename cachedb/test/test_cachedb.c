@@ -33,6 +33,7 @@ extern cachedb_engine* lookup_cachedb(str *name);
 static void test_cachedb_backends(void);
 static void load_cachedb_modules(void);
 static void test_cachedb_url(void);
+static void test_cachedb_get_multi(void);
 
 
 void init_cachedb_tests(void)
@@ -44,6 +45,7 @@ void init_cachedb_tests(void)
 void test_cachedb(void)
 {
 	test_cachedb_url();
+	test_cachedb_get_multi();
 	test_cachedb_backends();
 }
 
@@ -430,6 +432,69 @@ static void test_cachedb_backends(void)
 }
 
 
+/* a backend only able to fetch one key at a time: "k<N>" keys are found
+ * (with a "v<N>" value), "miss" keys are not and "fail" keys are errors */
+static int mock_get_calls;
+
+static int mock_get(cachedb_con *con, str *attr, str *val)
+{
+	mock_get_calls++;
+
+	if (attr->len == 4 && !memcmp(attr->s, "fail", 4))
+		return -1;
+	if (attr->len == 4 && !memcmp(attr->s, "miss", 4))
+		return -2;
+
+	val->s = pkg_malloc(attr->len);
+	if (!val->s)
+		return -1;
+	memcpy(val->s, attr->s, attr->len);
+	val->s[0] = 'v';
+	val->len = attr->len;
+	return 0;
+}
+
+
+static void test_cachedb_get_multi(void)
+{
+	cachedb_funcs funcs;
+	cachedb_con con;
+	str keys[] = {str_init("k1"), str_init("miss"), str_init("k3")};
+	str bad_keys[] = {str_init("k1"), str_init("fail"), str_init("k3")};
+	str vals[3];
+
+	memset(&funcs, 0, sizeof funcs);
+	memset(&con, 0, sizeof con);
+	funcs.get = mock_get;
+	funcs.capability = CACHEDB_CAP_GET;
+
+	/* no get_multi() support - one get() per key */
+	mock_get_calls = 0;
+	ok(cachedb_get_multi(&funcs, &con, keys, vals, 3) == 2,
+		"get_multi fallback: found keys");
+	ok(mock_get_calls == 3, "get_multi fallback: one get per key");
+	ok(vals[0].len == 2 && !memcmp(vals[0].s, "v1", 2),
+		"get_multi fallback: first value");
+	ok(vals[1].s == NULL && vals[1].len == 0,
+		"get_multi fallback: missing key");
+	ok(vals[2].len == 2 && !memcmp(vals[2].s, "v3", 2),
+		"get_multi fallback: last value");
+	pkg_free(vals[0].s);
+	pkg_free(vals[2].s);
+
+	/* an error on any key fails the whole fetch */
+	mock_get_calls = 0;
+	ok(cachedb_get_multi(&funcs, &con, bad_keys, vals, 3) == -1,
+		"get_multi fallback: failed key");
+	ok(mock_get_calls == 2, "get_multi fallback: stops on error");
+
+	/* no get() either */
+	funcs.capability = 0;
+	ok(cachedb_get_multi(&funcs, &con, keys, vals, 3) == -1,
+		"get_multi fallback: no get support");
+}
+
+
 static void test_cachedb_url(void)
 {
 	struct cachedb_id *db;
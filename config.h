@@ -137,6 +137,8 @@
 #else
 #define PKG_MEM_SIZE 2				/*!< Used only if PKG_MALLOC is defined*/
 #endif
+#define MSG_ARENA_CHUNK_SIZE (8*1024)	/*!< pkg arena chunk of the processed msg */
+#define MSG_ARENA_MAX_SIZE (64*1024)	/*!< all the chunks of the msg arena */
 #define SHM_MEM_SIZE 32				/*!< Used if SH_MEM is defined*/
 #define SHM_MAX_SECONDARY_HASH_SIZE 32
 #define DEFAULT_SHM_HASH_SPLIT_PERCENTAGE 1	/*!< Used if SH_MEM is defined*/
@@ -40,6 +40,7 @@
 #include "data_lump.h"
 #include "dprint.h"
 #include "mem/mem.h"
+#include "mem/msg_arena.h"
 #include "globals.h"
 #include "error.h"
 
@@ -127,7 +128,7 @@ struct lump* insert_new_lump_after( struct lump* after, char* new_hdr,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(after, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -153,7 +154,7 @@ struct lump* insert_new_lump_before( struct lump* before, char* new_hdr,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(before, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -179,7 +180,7 @@ struct lump* insert_subst_lump_after( struct lump* after,enum lump_subst subst,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(after, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -206,7 +207,7 @@ struct lump* insert_subst_lump_before(	struct lump* before,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(before, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -232,7 +233,7 @@ struct lump* insert_cond_lump_after( struct lump* after,enum lump_conditions c,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(after, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -259,7 +260,7 @@ struct lump* insert_cond_lump_before(	struct lump* before,
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(before, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -284,7 +285,7 @@ struct lump* insert_skip_lump_after( struct lump* after)
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(after, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -306,7 +307,7 @@ struct lump* insert_skip_lump_before( struct lump* before )
 {
 	struct lump* tmp;
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc_near(before, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -349,7 +350,7 @@ struct lump* del_lump(struct sip_msg* msg, unsigned int offset,
 		LM_WARN("called with 0 len (offset =%d)\n",	offset);
 	}
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc(msg, sizeof(struct lump));
 	if (tmp==0){
 		LM_ERR("out of pkg memory\n");
 		return 0;
@@ -399,7 +400,7 @@ struct lump* anchor_lump(struct sip_msg* msg, unsigned int offset,
 		abort();
 	}
 
-	tmp=pkg_malloc(sizeof(struct lump));
+	tmp=msg_malloc(msg, sizeof(struct lump));
 	if (tmp==0){
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("out of pkg memory\n");
@@ -462,18 +463,18 @@ void free_lump_list(struct lump* l)
 		while(r){
 			foo=r; r=r->before;
 			free_lump(foo);
-			pkg_free(foo);
+			msg_free(foo);
 		}
 		r=crt->after;
 		while(r){
 			foo=r; r=r->after;
 			free_lump(foo);
-			pkg_free(foo);
+			msg_free(foo);
 		}
 
 		/*clean current elem*/
 		free_lump(crt);
-		pkg_free(crt);
+		msg_free(crt);
 	}
 }
 
@@ -581,7 +582,7 @@ void del_flaged_lumps( struct lump** lump_list, enum lump_flag flags )
 				if ( foo->flags&flags ) {
 					prev_r->after = r;
 					free_lump(foo);
-					pkg_free(foo);
+					msg_free(foo);
 				} else {
 					prev_r = foo;
 				}
@@ -594,7 +595,7 @@ void del_flaged_lumps( struct lump** lump_list, enum lump_flag flags )
 				if ( foo->flags&flags ) {
 					prev_r->before = r;
 					free_lump(foo);
-					pkg_free(foo);
+					msg_free(foo);
 				} else {
 					prev_r = foo;
 				}
@@ -635,7 +636,7 @@ void del_notflaged_lumps( struct lump** lump_list, enum lump_flag not_flags )
 				if ( (~foo->flags)&not_flags ) {
 					prev_r->after = r;
 					free_lump(foo);
-					pkg_free(foo);
+					msg_free(foo);
 				} else {
 					prev_r = foo;
 				}
@@ -648,7 +649,7 @@ void del_notflaged_lumps( struct lump** lump_list, enum lump_flag not_flags )
 				if ( (~foo->flags)&not_flags ) {
 					prev_r->before = r;
 					free_lump(foo);
-					pkg_free(foo);
+					msg_free(foo);
 				} else {
 					prev_r = foo;
 				}
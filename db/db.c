@@ -144,6 +144,10 @@ int db_check_api(db_func_t* dbf, char *mname)
 		dbf->cap |= DB_CAP_INSERT_UPDATE;
 	}
 
+	if (dbf->insert_update_rows) {
+		dbf->cap |= DB_CAP_MULTIPLE_INSERT_UPDATE;
+	}
+
 	if (dbf->async_raw_query || dbf->async_resume || dbf->async_free_result) {
 		if (!dbf->async_raw_query || !dbf->async_resume || !dbf->async_free_result) {
 			LM_BUG("NULL async raw_query | resume | free_result in %s", mname);
@@ -243,6 +247,8 @@ int db_bind_mod(const str* mod, db_func_t* mydbf)
 			"db_last_inserted_id", 1, 0);
 		dbf.insert_update = (db_insert_update_f)find_mod_export(tmp,
 			"db_insert_update", 2, 0);
+		dbf.insert_update_rows = (db_insert_update_rows_f)find_mod_export(
+			tmp, "db_insert_update_rows", 2, 0);
 	}
 	/* check if the module pre-populated the capabilities, or we need to
 	 * compute them ourselves - we check for the INSERT capability, because
@@ -271,6 +271,21 @@ typedef int (*db_last_inserted_id_f) (const db_con_t* _h);
 typedef int (*db_insert_update_f) (const db_con_t* _h, const db_key_t* _k,
 				const db_val_t* _v, const int _n);
 
+/**
+ * \brief Insert several rows into specified table, update on duplicate key.
+ *
+ * Same as db_insert_update_f, for "_r" rows with the same keys. The rows are
+ * sent in as few statements as the driver allows.
+ * \param _h structure representing database connection
+ * \param _k key names
+ * \param _v values of the keys, one array for each row
+ * \param _n number of key=value pairs of a row
+ * \param _r number of rows
+ * \return returns the number of submitted statements, a value < 0 on error
+ */
+typedef int (*db_insert_update_rows_f) (const db_con_t* _h,
+				const db_key_t* _k, db_val_t** _v, const int _n, const int _r);
+
 /**
  * \brief Asynchronous raw SQL query on a separate DB connection.
  *		  Returns immediately.
@@ -353,6 +368,7 @@ typedef struct db_func {
 	db_async_raw_query_f   async_raw_query;   /* Starts an asynchronous raw query */
 	db_async_resume_f      async_resume;      /* Called on progress or completed query */
 	db_async_free_result_f async_free_result; /* Clean up after an async query */
+	db_insert_update_rows_f insert_update_rows; /* Multi-row insert_update */
 } db_func_t;
 
 
@@ -304,10 +304,13 @@ int forward_request( struct sip_msg* msg, struct proxy_l * p)
 {
 	union sockaddr_union to;
 	str buf;
+	struct msg_iov mi;
 	struct socket_info* send_sock;
 	struct socket_info* last_sock;
+	int gather;
 
 	buf.s=NULL;
+	mi.buf=NULL;
 
 	/* calculate branch for outbound request - if the branch buffer is already
 	 * set (maybe by an upper level as TM), used it; otherwise computes
@@ -329,6 +332,11 @@ int forward_request( struct sip_msg* msg, struct proxy_l * p)
 	if (getb0flags(msg) & tcp_no_new_conn_bflag)
 		tcp_no_new_conn = 1;
 
+	/* unless something needs to see the whole outgoing request, it is sent
+	 * as gathered from the received buffer and the lumps (no copying) */
+	gather = !has_post_raw_processing_cb() &&
+		!slcb_registered(SLCB_REQUEST_OUT) && !blacklists_in_use();
+
 	do {
 		send_sock=get_send_socket( msg, &to, p->proto);
 		if (send_sock==0){
@@ -342,35 +350,58 @@ int forward_request( struct sip_msg* msg, struct proxy_l * p)
 
 			if (buf.s)
 				pkg_free(buf.s);
-
-			buf.s = build_req_buf_from_sip_req( msg, (unsigned int*)&buf.len,
-				send_sock, p->proto, NULL, 0 /*flags*/);
-			if (!buf.s){
-				LM_ERR("building req buf failed\n");
-				tcp_no_new_conn = 0;
-				goto error;
+			if (mi.buf)
+				pkg_free(mi.buf);
+			buf.s = mi.buf = NULL;
+
+			if (gather) {
+				if (build_req_iov_from_sip_req( msg, &mi, send_sock,
+				p->proto)<0) {
+					LM_ERR("building req iov failed\n");
+					tcp_no_new_conn = 0;
+					goto error;
+				}
+			} else {
+				buf.s = build_req_buf_from_sip_req( msg,
+					(unsigned int*)&buf.len, send_sock, p->proto,
+					NULL, 0 /*flags*/);
+				if (!buf.s){
+					LM_ERR("building req buf failed\n");
+					tcp_no_new_conn = 0;
+					goto error;
+				}
 			}
 
 			last_sock = send_sock;
 		}
 
-		if (check_blacklists( p->proto, &to, buf.s, buf.len)) {
-			LM_DBG("blocked by blacklists\n");
-			ser_error=E_IP_BLOCKED;
-			continue;
-		}
+		if (gather) {
+			LM_DBG("sending %d pieces, orig. len=%d, new_len=%d, proto=%d\n",
+				mi.cnt, msg->len, mi.len, p->proto );
 
-		/* send it! */
-		LM_DBG("sending:\n%.*s.\n", buf.len, buf.s);
-		LM_DBG("orig. len=%d, new_len=%d, proto=%d\n",
-			msg->len, buf.len, p->proto );
+			if (msg_sendv(send_sock, p->proto, &to, 0, &mi, msg)<0){
+				ser_error=E_SEND;
+				continue;
+			}
+		} else {
+			if (check_blacklists( p->proto, &to, buf.s, buf.len)) {
+				LM_DBG("blocked by blacklists\n");
+				ser_error=E_IP_BLOCKED;
+				continue;
+			}
 
-		if (msg_send(send_sock, p->proto, &to, 0, buf.s, buf.len, msg)<0){
-			ser_error=E_SEND;
-			continue;
-		}
+			/* send it! */
+			LM_DBG("sending:\n%.*s.\n", buf.len, buf.s);
+			LM_DBG("orig. len=%d, new_len=%d, proto=%d\n",
+				msg->len, buf.len, p->proto );
 
-		slcb_run_req_out( msg, &buf, &to, send_sock, p->proto);
+			if (msg_send(send_sock, p->proto, &to, 0, buf.s, buf.len, msg)<0){
+				ser_error=E_SEND;
+				continue;
+			}
+
+			slcb_run_req_out( msg, &buf, &to, send_sock, p->proto);
+		}
 
 		ser_error = 0;
 		break;
@@ -387,12 +418,14 @@ int forward_request( struct sip_msg* msg, struct proxy_l * p)
 	/* sent requests stats */
 	update_stat( fwd_reqs, 1);
 
-	pkg_free(buf.s);
+	if (buf.s) pkg_free(buf.s);
+	if (mi.buf) pkg_free(mi.buf);
 	/* received_buf & line_buf will be freed in receive_msg by free_lump_list*/
 	return 0;
 
 error:
 	if (buf.s) pkg_free(buf.s);
+	if (mi.buf) pkg_free(mi.buf);
 	return -1;
 }
 
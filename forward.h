@@ -46,6 +46,7 @@
 #include "sl_cb.h"
 #include "net/trans.h"
 #include "socket_info.h"
+#include "msg_translator.h"
 
 struct socket_info* get_send_socket(struct sip_msg* msg,
 									union sockaddr_union* su, int proto);
@@ -139,4 +140,52 @@ error:
 }
 
 
+
+/*! \brief
+ * Same as msg_send(), but for a message gathered from several pieces (see
+ * build_req_iov_from_sip_req()). The message is put together in a single
+ * buffer only if the transport cannot send it as it is or if there are
+ * raw processing callbacks to run over it.
+ * \param mi - the pieces of the message to be sent
+ * \return 0 if ok, -1 on error
+ */
+static inline int msg_sendv( struct socket_info* send_sock, int proto,
+							union sockaddr_union* to, int id,
+							struct msg_iov *mi, struct sip_msg* msg)
+{
+	unsigned short port;
+	char *ip, *buf, *p;
+	int i, ret;
+
+	if (mi->cnt==1)
+		return msg_send(send_sock, proto, to, id, mi->v[0].iov_base,
+			mi->len, msg);
+
+	if (proto<=PROTO_NONE || proto>=PROTO_OTHER ||
+	protos[proto].id==PROTO_NONE || protos[proto].tran.sendv==NULL ||
+	send_sock==0 || (is_sip_proto(proto) && has_post_raw_processing_cb())) {
+		buf = pkg_malloc(mi->len);
+		if (buf==NULL) {
+			LM_ERR("no more pkg mem\n");
+			return -1;
+		}
+		for (i=0,p=buf ; i<mi->cnt ; p+=mi->v[i].iov_len,i++)
+			memcpy(p, mi->v[i].iov_base, mi->v[i].iov_len);
+
+		ret = msg_send(send_sock, proto, to, id, buf, mi->len, msg);
+		pkg_free(buf);
+		return ret;
+	}
+
+	if (protos[proto].tran.sendv(send_sock, mi->v, mi->cnt, mi->len,
+	to, id)<0) {
+		get_su_info(to, ip, port);
+		LM_ERR("sendv() to %s:%hu for proto %s/%d failed\n",
+				ip, port, proto2a(proto),proto);
+		return -1;
+	}
+
+	return 0;
+}
+
 #endif
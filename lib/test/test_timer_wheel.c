@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <tap.h>
+
+#include "../timer_wheel.h"
+
+/* runs the wheel unit by unit, up to "until" (or until it gets empty),
+ * recording the order in which the timers fire */
+static int run_wheel(struct timer_wheel *tw, struct tw_link *tl,
+		utime_t from, utime_t until, int *order, int *early)
+{
+	struct list_head expired;
+	struct tw_link *l;
+	int fired = 0;
+	utime_t now;
+
+	*early = 0;
+	for (now = from; now <= until && tw->count; now++) {
+		INIT_LIST_HEAD(&expired);
+		tw_expire(tw, now, &expired);
+		while (!list_empty(&expired)) {
+			l = list_entry(expired.next, struct tw_link, list);
+			if (l->expires != now)
+				(*early)++;
+			order[fired++] = l - tl;
+			list_del(expired.next);
+		}
+	}
+
+	return fired;
+}
+
+static void test_timer_wheel_expiry(void)
+{
+	struct timer_wheel tw;
+	struct tw_link tl[5];
+	struct list_head expired;
+	utime_t expires[] = { 100, 100, 163, 4200, 300000 };
+	int order[5];
+	int i, early;
+
+	tw_init(&tw, 1, 100);
+	for (i = 0; i < 5; i++)
+		tw_add(&tw, &tl[i], expires[i], 100);
+	ok(tw.count == 5, "5 timers added");
+
+	ok(run_wheel(&tw, tl, 100, 300000, order, &early) == 5 && early == 0,
+	    "all timers fired on time, by cascading");
+
+	/* a coarse wheel never fires early, it checks the current unit */
+	tw_init(&tw, 100, 0);
+	tw_add(&tw, &tl[0], 150, 0);
+	INIT_LIST_HEAD(&expired);
+	tw_expire(&tw, 149, &expired);
+	ok(list_empty(&expired), "timer not fired inside its unit");
+	tw_expire(&tw, 150, &expired);
+	ok(!list_empty(&expired) && tw.count == 0, "timer fired inside its unit");
+
+	/* a jump over many units fires everything in between, at once */
+	tw_init(&tw, 1, 0);
+	for (i = 0; i < 5; i++)
+		tw_add(&tw, &tl[i], expires[i], 0);
+	INIT_LIST_HEAD(&expired);
+	tw_expire(&tw, 4200, &expired);
+	ok(tw.count == 1 && expired.prev == &tl[3].list,
+	    "timers fired by a jump");
+
+	/* beyond the span of the wheel, a timer is re-hashed until due */
+	tw_init(&tw, 1, 0);
+	tw_add(&tw, &tl[0], TW_MAX_SPAN + 1000, 0);
+	INIT_LIST_HEAD(&expired);
+	tw_expire(&tw, TW_MAX_SPAN + 999, &expired);
+	ok(list_empty(&expired) && tw.count == 1, "far timer not fired early");
+	tw_expire(&tw, TW_MAX_SPAN + 1000, &expired);
+	ok(expired.next == &tl[0].list && tw.count == 0, "far timer fired");
+}
+
+static void test_timer_wheel_order(void)
+{
+	struct timer_wheel tw;
+	struct tw_link tl[6];
+	/* added out of order, some of them at the same time */
+	utime_t expires[] = { 5000, 70, 70, 4096, 64, 70 };
+	int expected[] = { 4, 1, 2, 5, 3, 0 };
+	int order[6];
+	int i, early, fired;
+
+	tw_init(&tw, 1, 0);
+	for (i = 0; i < 6; i++)
+		tw_add(&tw, &tl[i], expires[i], 0);
+
+	fired = run_wheel(&tw, tl, 0, 5000, order, &early);
+	ok(fired == 6 && early == 0, "all timers fired on time");
+	for (i = 0; i < fired && order[i] == expected[i]; i++) ;
+	ok(i == 6, "timers fired by expiry, then by insertion order");
+}
+
+static void test_timer_wheel_cancel(void)
+{
+	struct timer_wheel tw;
+	struct tw_link tl[4];
+	struct list_head expired;
+	int order[4];
+	int early;
+
+	tw_init(&tw, 200, 0);
+	tw_add(&tw, &tl[0], 1000, 200);
+	tw_add(&tw, &tl[1], 2000, 200);
+	tw_del(&tw, &tl[0]);
+	INIT_LIST_HEAD(&expired);
+	tw_expire(&tw, 5000, &expired);
+	ok(expired.next == &tl[1].list && expired.prev == &tl[1].list,
+	    "deleted timer not fired");
+
+	/* deleted from a higher level, before and after cascading */
+	tw_init(&tw, 1, 0);
+	tw_add(&tw, &tl[0], 100, 0);
+	tw_add(&tw, &tl[1], 300000, 0);
+	tw_add(&tw, &tl[2], 5000, 0);
+	tw_add(&tw, &tl[3], 5001, 0);
+	tw_del(&tw, &tl[1]);
+	ok(tw.count == 3, "timer deleted before cascading");
+
+	ok(run_wheel(&tw, tl, 0, 4990, order, &early) == 1 && order[0] == 0,
+	    "first timer fired");
+	tw_del(&tw, &tl[2]);
+	ok(run_wheel(&tw, tl, 4991, 300000, order, &early) == 1 &&
+	    order[0] == 3 && early == 0 && tw.count == 0,
+	    "timer deleted after cascading not fired");
+
+	/* re-armed after being cancelled */
+	tw_add(&tw, &tl[2], 310000, 300000);
+	tw_del(&tw, &tl[2]);
+	tw_add(&tw, &tl[2], 320000, 300000);
+	ok(run_wheel(&tw, tl, 300001, 400000, order, &early) == 1 &&
+	    order[0] == 2 && early == 0, "re-armed timer fired once, on time");
+
+	/* flushing hands over all the pending timers */
+	tw_add(&tw, &tl[0], 500000, 400000);
+	tw_add(&tw, &tl[1], 600000, 400000);
+	INIT_LIST_HEAD(&expired);
+	tw_flush(&tw, &expired);
+	ok(tw.count == 0 && expired.next->next == expired.prev &&
+	    expired.prev->next == &expired, "pending timers flushed");
+}
+
+void test_lib_timer_wheel(void)
+{
+	test_timer_wheel_expiry();
+	test_timer_wheel_order();
+	test_timer_wheel_cancel();
+}
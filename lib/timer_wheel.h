@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Hashed hierarchical timing wheel
+ *
+ * Timers are hashed, by their expiry time, into TW_LEVELS wheels of
+ * TW_SLOTS slots each; the slots of level "l" are TW_SLOTS^l units wide.
+ * Adding and removing a timer is O(1), expiring is O(1) per expired
+ * timer, plus the occasional cascading of a higher level slot into the
+ * lower levels - so the cost does not depend on the number of running
+ * timers.
+ *
+ * The wheel is not protected in any way - the caller must do the locking.
+ * Time is measured in the caller's time base (ticks, uticks, etc.), with
+ * a resolution of "unit"; still, the expiry is exact: a timer never fires
+ * before its "expires" time.
+ */
+
+#ifndef __LIB_TIMER_WHEEL_H__
+#define __LIB_TIMER_WHEEL_H__
+
+#include "../timer.h"
+#include "list.h"
+
+#define TW_BITS    6
+#define TW_SLOTS   (1<<TW_BITS)
+#define TW_MASK    (TW_SLOTS-1)
+#define TW_LEVELS  4
+/* the furthest a timer can be hashed, in units; anything beyond gets
+ * clamped and it will be re-hashed by the cascading */
+#define TW_MAX_SPAN  ((1ULL<<(TW_BITS*TW_LEVELS))-1)
+
+struct tw_link {
+	struct list_head list;
+	utime_t expires;
+};
+
+struct timer_wheel {
+	struct list_head slots[TW_LEVELS][TW_SLOTS];
+	/* the unit currently being expired; all the previous ones are done */
+	utime_t cur;
+	/* resolution of the wheel, in the caller's time base */
+	utime_t unit;
+	/* number of timers in the wheel */
+	unsigned int count;
+};
+
+
+static inline void tw_init(struct timer_wheel *tw, utime_t unit, utime_t now)
+{
+	int l, s;
+
+	for (l = 0; l < TW_LEVELS; l++)
+		for (s = 0; s < TW_SLOTS; s++)
+			INIT_LIST_HEAD(&tw->slots[l][s]);
+
+	tw->unit = unit ? unit : 1;
+	tw->cur = now / tw->unit;
+	tw->count = 0;
+}
+
+
+static inline void __tw_hash(struct timer_wheel *tw, struct tw_link *tl)
+{
+	utime_t e, delta;
+	int l;
+
+	e = tl->expires / tw->unit;
+	if (e < tw->cur)
+		e = tw->cur;
+
+	delta = e - tw->cur;
+	if (delta > TW_MAX_SPAN)
+		e = tw->cur + (delta = TW_MAX_SPAN);
+
+	for (l = 0; l < TW_LEVELS - 1; l++)
+		if (delta < (1ULL << (TW_BITS * (l + 1))))
+			break;
+
+	list_add_tail(&tl->list, &tw->slots[l][(e >> (TW_BITS * l)) & TW_MASK]);
+}
+
+
+/* adds a timer; "now" is only used to fast forward an idle wheel */
+static inline void tw_add(struct timer_wheel *tw, struct tw_link *tl,
+                          utime_t expires, utime_t now)
+{
+	if (tw->count == 0 && now / tw->unit > tw->cur)
+		tw->cur = now / tw->unit;
+
+	tl->expires = expires;
+	__tw_hash(tw, tl);
+	tw->count++;
+}
+
+
+static inline void tw_del(struct timer_wheel *tw, struct tw_link *tl)
+{
+	list_del(&tl->list);
+	tw->count--;
+}
+
+
+/* moves all the entries of a slot at the end of the "to" list */
+static inline void __tw_splice_tail(struct list_head *slot,
+                                    struct list_head *to)
+{
+	if (list_empty(slot))
+		return;
+
+	slot->next->prev = to->prev;
+	to->prev->next = slot->next;
+	slot->prev->next = to;
+	to->prev = slot->prev;
+
+	INIT_LIST_HEAD(slot);
+}
+
+
+/* re-hashes the higher level slots which start with the current unit */
+static inline void __tw_cascade(struct timer_wheel *tw)
+{
+	struct list_head tmp, *it, *next;
+	int l, idx;
+
+	for (l = 1; l < TW_LEVELS; l++) {
+		idx = (tw->cur >> (TW_BITS * l)) & TW_MASK;
+
+		INIT_LIST_HEAD(&tmp);
+		__tw_splice_tail(&tw->slots[l][idx], &tmp);
+		list_for_each_safe(it, next, &tmp)
+			__tw_hash(tw, list_entry(it, struct tw_link, list));
+
+		if (idx != 0)
+			break;
+	}
+}
+
+
+/* moves all the timers, expired or not, at the end of the "to" list */
+static inline void tw_flush(struct timer_wheel *tw, struct list_head *to)
+{
+	int l, s;
+
+	for (l = 0; l < TW_LEVELS; l++)
+		for (s = 0; s < TW_SLOTS; s++)
+			__tw_splice_tail(&tw->slots[l][s], to);
+
+	tw->count = 0;
+}
+
+
+/* moves all the timers expired by "now" at the end of the "expired" list */
+static inline void tw_expire(struct timer_wheel *tw, utime_t now,
+                             struct list_head *expired)
+{
+	struct list_head *slot, *it, *next;
+	utime_t nu = now / tw->unit;
+
+	if (tw->count == 0) {
+		if (nu > tw->cur)
+			tw->cur = nu;
+		return;
+	}
+
+	/* the fully elapsed units */
+	while (tw->cur < nu) {
+		slot = &tw->slots[0][tw->cur & TW_MASK];
+		list_for_each(it, slot)
+			tw->count--;
+		__tw_splice_tail(slot, expired);
+
+		tw->cur++;
+		if (tw->count == 0) {
+			tw->cur = nu;
+			return;
+		}
+		if ((tw->cur & TW_MASK) == 0)
+			__tw_cascade(tw);
+	}
+
+	/* the current unit is only partially elapsed */
+	slot = &tw->slots[0][tw->cur & TW_MASK];
+	list_for_each_safe(it, next, slot) {
+		if (list_entry(it, struct tw_link, list)->expires <= now) {
+			list_del(it);
+			list_add_tail(it, expired);
+			tw->count--;
+		}
+	}
+}
+
+#endif /* __LIB_TIMER_WHEEL_H__ */
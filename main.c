@@ -107,6 +107,7 @@
 #include "globals.h"
 #include "mem/mem.h"
 #include "mem/shm_mem.h"
+#include "mem/msg_arena.h"
 #include "sr_module.h"
 #include "timer.h"
 #include "ipc.h"
@@ -659,6 +660,8 @@ static void sig_usr(int signo)
 					LM_GEN1(memdump, "Memory status (pkg):\n");
 					pkg_status();
 					#endif
+					/* give back the shm fragments cached by the process */
+					shm_cache_destroy();
 					exit(0);
 					break;
 			case SIGUSR1:
@@ -1405,6 +1408,19 @@ try_again:
 		LM_ERR("failed to init stats for pkg\n");
 		goto error;
 	}
+	/* the high-water marks of the per-message arena, next to them */
+	if (init_msg_arena_stats(counted_processes)!=0) {
+		LM_ERR("failed to init stats for the msg arena\n");
+		goto error;
+	}
+	#endif
+
+	#if defined(HP_MALLOC) && defined(HP_MALLOC_FRONT_CACHE)
+	/* init stats support for the per-process shm front cache */
+	if (hp_init_cache_statistics(counted_processes)!=0) {
+		LM_ERR("failed to init stats for the shm cache\n");
+		goto error;
+	}
 	#endif
 
 	/* init avps */
@@ -41,6 +41,10 @@
 #include "hp_malloc.h"
 #include "common.h"
 
+#ifdef HP_MALLOC_FRONT_CACHE
+extern int process_no;
+#endif
+
 #ifdef DBG_MALLOC
 #include "mem_dbg_hash.h"
 #endif
@@ -1384,6 +1388,233 @@ void *hp_shm_realloc(struct hp_block *hpb, void *p, unsigned long size)
 	return p;
 }
 
+#ifdef HP_MALLOC_FRONT_CACHE
+struct hp_cache_class {
+	struct hp_frag *first;
+	unsigned int no;
+};
+
+/* private (pkg) part of the front cache - the fragments are linked through
+ * their "nxt_free" field, while "prev" stays NULL, so they are still seen
+ * as busy by the shared pool (no coalescing with them) */
+static struct hp_cache_class hp_cache[HPC_CLASSES];
+static int hp_cache_on;
+/* set while working on the cache, so a flush triggered from a signal
+ * handler does not find it in an inconsistent state */
+static volatile int hp_cache_busy;
+
+struct hp_cache_stats *hp_cache_stats;
+
+#define hpc_stats() \
+	(hp_cache_stats ? &hp_cache_stats[process_no] : NULL)
+
+void hp_cache_enable(void)
+{
+	hp_cache_on = 1;
+}
+
+static inline void hpc_push(struct hp_cache_class *cls, struct hp_frag *f)
+{
+	f->nxt_free = cls->first;
+	cls->first = f;
+	cls->no++;
+}
+
+static inline struct hp_frag *hpc_pop(struct hp_cache_class *cls)
+{
+	struct hp_frag *f;
+
+	f = cls->first;
+	cls->first = f->nxt_free;
+	f->nxt_free = NULL;
+	cls->no--;
+
+	return f;
+}
+
+/* gives back to the shared pool the @keep first fragments of a class */
+static void hpc_drain(struct hp_block *hpb, struct hp_cache_class *cls,
+																int keep)
+{
+	struct hp_cache_stats *st = hpc_stats();
+	struct hp_frag *f;
+
+	while (cls->no > keep) {
+		f = hpc_pop(cls);
+		if (st)
+			st->cached -= f->size;
+		hp_shm_free(hpb, f + 1);
+	}
+
+	if (st)
+		st->flushes++;
+}
+
+/*
+ * carves a batch of @size fragments out of a single shm allocation, keeps
+ * one for the caller and pushes the rest into the cache class
+ */
+static void *hpc_refill(struct hp_block *hpb, struct hp_cache_class *cls,
+														unsigned long size)
+{
+	struct hp_cache_stats *st = hpc_stats();
+	struct hp_frag *big, *f, *next;
+	unsigned long total;
+	void *p;
+	int i;
+
+	total = HPC_REFILL * (size + FRAG_OVERHEAD) - FRAG_OVERHEAD;
+
+	p = hp_shm_malloc(hpb, total);
+	if (!p)
+		return hp_shm_malloc(hpb, size);
+
+	big = FRAG_OF(p);
+
+#ifdef HP_MALLOC_FAST_STATS
+	hpb->free_hash[PEEK_HASH_RR(hpb, big->size)].total_no--;
+#endif
+
+	/* the last fragment inherits any leftover of the big one */
+	for (f = big, i = 0; i < HPC_REFILL - 1; i++, f = next) {
+		total = f->size;
+		f->size = size;
+		next = FRAG_NEXT(f);
+		next->size = total - size - FRAG_OVERHEAD;
+		next->prev = NULL;
+		next->nxt_free = NULL;
+#if (defined DBG_MALLOC) || (defined SHM_EXTRA_STATS)
+		next->is_free = 0;
+#endif
+#ifdef HP_MALLOC_FAST_STATS
+		hpb->free_hash[PEEK_HASH_RR(hpb, size)].total_no++;
+#endif
+
+		if (f != big) {
+			hpc_push(cls, f);
+			if (st)
+				st->cached += f->size;
+		}
+	}
+
+#ifdef HP_MALLOC_FAST_STATS
+	hpb->free_hash[PEEK_HASH_RR(hpb, f->size)].total_no++;
+#endif
+
+	/* the leftover may not fit this class */
+	if (f->size == size) {
+		hpc_push(cls, f);
+		if (st)
+			st->cached += f->size;
+	} else {
+		hp_shm_free(hpb, f + 1);
+	}
+
+	update_stat(shm_frags, HPC_REFILL - 1);
+	update_stat(shm_used, -(long)((HPC_REFILL - 1) * FRAG_OVERHEAD));
+
+	if (st)
+		st->refills++;
+
+	return big + 1;
+}
+
+void *hp_shm_cache_malloc(struct hp_block *hpb, unsigned long size)
+{
+	struct hp_cache_stats *st;
+	struct hp_cache_class *cls;
+	struct hp_frag *f;
+	void *p;
+
+	size = ROUNDUP(size);
+	if (!hp_cache_on || size > HPC_MAX_SIZE)
+		return hp_shm_malloc(hpb, size);
+
+	st = hpc_stats();
+	cls = &hp_cache[size / ROUNDTO];
+
+	hp_cache_busy = 1;
+
+	if (!cls->first) {
+		if (st)
+			st->misses++;
+		p = hpc_refill(hpb, cls, size);
+		hp_cache_busy = 0;
+		return p;
+	}
+
+	f = hpc_pop(cls);
+	if (st) {
+		st->hits++;
+		st->cached -= f->size;
+	}
+
+	hp_cache_busy = 0;
+	return f + 1;
+}
+
+void hp_shm_cache_free(struct hp_block *hpb, void *p)
+{
+	struct hp_cache_stats *st;
+	struct hp_cache_class *cls;
+	struct hp_frag *f;
+
+	if (!p) {
+		LM_GEN1(memlog, "free(0) called\n");
+		return;
+	}
+
+	f = FRAG_OF(p);
+	if (!hp_cache_on || f->size > HPC_MAX_SIZE) {
+		hp_shm_free(hpb, p);
+		return;
+	}
+
+	/* frees of fragments allocated by other processes land here as well,
+	 * they are given back to the shared pool lazily, in batches */
+	cls = &hp_cache[f->size / ROUNDTO];
+
+	hp_cache_busy = 1;
+
+	hpc_push(cls, f);
+
+	st = hpc_stats();
+	if (st)
+		st->cached += f->size;
+
+	if (cls->no > HPC_MAG_SIZE)
+		hpc_drain(hpb, cls, HPC_MAG_SIZE / 2);
+
+	hp_cache_busy = 0;
+}
+
+void hp_cache_flush(struct hp_block *hpb)
+{
+	int i;
+
+	for (i = 0; i < HPC_CLASSES; i++)
+		if (hp_cache[i].no)
+			hpc_drain(hpb, &hp_cache[i], 0);
+}
+
+void hp_cache_destroy(struct hp_block *hpb)
+{
+	if (!hp_cache_on)
+		return;
+
+	hp_cache_on = 0;
+
+	/* interrupted in the middle of a cache operation, the fragments are
+	 * left to the shared memory teardown */
+	if (hp_cache_busy) {
+		LM_DBG("shm cache busy, not flushed\n");
+		return;
+	}
+
+	hp_cache_flush(hpb);
+}
+#endif /* HP_MALLOC_FRONT_CACHE */
+
 #ifdef SHM_EXTRA_STATS
 void set_indexes(int core_index) {
 
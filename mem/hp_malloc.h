@@ -166,6 +166,48 @@ struct hp_frag {
 
 #define FRAG_OVERHEAD     sizeof(struct hp_frag)
 
+#if defined(HP_MALLOC_FRONT_CACHE) && defined(DBG_MALLOC)
+#warning "HP_MALLOC_FRONT_CACHE is not supported with DBG_MALLOC, disabling it"
+#undef HP_MALLOC_FRONT_CACHE
+#endif
+
+#ifdef HP_MALLOC_FRONT_CACHE
+/*
+ * per-process cache of free shm fragments, in front of hp_shm_malloc() /
+ * hp_shm_free(); fragments are grouped in size classes (exact fragment
+ * size, up to HPC_MAX_SIZE), a class being refilled by carving a batch
+ * of HPC_REFILL fragments out of a single hp_shm_malloc() and drained back
+ * to the shared pool, in batch, once it grows over HPC_MAG_SIZE fragments
+ */
+#define HPC_MAX_SIZE     2048
+#define HPC_CLASSES      (HPC_MAX_SIZE / ROUNDTO + 1)
+#define HPC_MAG_SIZE     64
+#define HPC_REFILL       16
+
+struct hp_cache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long refills;
+	unsigned long flushes;
+	unsigned long cached;
+};
+
+/* shm array, one slot per process */
+extern struct hp_cache_stats *hp_cache_stats;
+
+/* starts using the front cache in the current process (must be empty!) */
+void hp_cache_enable(void);
+
+/* returns all the cached fragments of the process to the shared pool */
+void hp_cache_flush(struct hp_block *);
+
+/* stops using the front cache and flushes it, at process shutdown */
+void hp_cache_destroy(struct hp_block *);
+
+void *hp_shm_cache_malloc(struct hp_block *, unsigned long size);
+void hp_shm_cache_free(struct hp_block *, void *p);
+#endif
+
 struct hp_frag_lnk {
 	/*
 	 * optimized buckets are further split into
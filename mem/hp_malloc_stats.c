@@ -34,8 +34,10 @@
 #include "sys/time.h"
 
 #include "../lock_ops.h"
+#include "../ut.h"
 #include "hp_malloc.h"
 #include "hp_malloc_stats.h"
+#include "shm_mem.h"
 
 gen_lock_t *hp_stats_lock;
 
@@ -205,6 +207,75 @@ unsigned long hp_shm_get_frags(struct hp_block *hpb)
 #endif /* HP_MALLOC_FAST_STATS */
 
 
+#ifdef HP_MALLOC_FRONT_CACHE
+static unsigned long hp_cache_get_hits(void *proc)
+{
+	return hp_cache_stats[(long)proc].hits;
+}
+
+static unsigned long hp_cache_get_misses(void *proc)
+{
+	return hp_cache_stats[(long)proc].misses;
+}
+
+static unsigned long hp_cache_get_refills(void *proc)
+{
+	return hp_cache_stats[(long)proc].refills;
+}
+
+static unsigned long hp_cache_get_flushes(void *proc)
+{
+	return hp_cache_stats[(long)proc].flushes;
+}
+
+static unsigned long hp_cache_get_cached(void *proc)
+{
+	return hp_cache_stats[(long)proc].cached;
+}
+
+int hp_init_cache_statistics(int no_procs)
+{
+	static struct {
+		char *name;
+		stat_function f;
+	} cache_stats[] = {
+		{"cache_hits",    hp_cache_get_hits},
+		{"cache_misses",  hp_cache_get_misses},
+		{"cache_refills", hp_cache_get_refills},
+		{"cache_flushes", hp_cache_get_flushes},
+		{"cache_size",    hp_cache_get_cached},
+	};
+	unsigned short n;
+	unsigned int i;
+	str n_str;
+	char *name;
+
+	hp_cache_stats = shm_malloc(no_procs * sizeof *hp_cache_stats);
+	if (!hp_cache_stats) {
+		LM_ERR("no more shm mem for cache stats\n");
+		return -1;
+	}
+	memset(hp_cache_stats, 0, no_procs * sizeof *hp_cache_stats);
+
+	for (n = 0; n < no_procs; n++) {
+		n_str.s = int2str(n, &n_str.len);
+
+		for (i = 0; i < sizeof cache_stats / sizeof *cache_stats; i++) {
+			if ((name = build_stat_name(&n_str, cache_stats[i].name)) == 0 ||
+			    register_stat2("shmem", name, (stat_var **)cache_stats[i].f,
+			        STAT_NO_RESET|STAT_SHM_NAME|STAT_IS_FUNC,
+			        (void *)(long)n, 0) != 0) {
+				LM_ERR("failed to add stat variable\n");
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+#endif /* HP_MALLOC_FRONT_CACHE */
+
+
 unsigned long hp_pkg_get_size(struct hp_block *hpb)
 {
 	return hpb->size;
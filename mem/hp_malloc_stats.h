@@ -46,6 +46,11 @@ unsigned long hp_shm_get_real_used(struct hp_block *hpb);
 unsigned long hp_shm_get_max_real_used(struct hp_block *hpb);
 unsigned long hp_shm_get_frags(struct hp_block *hpb);
 
+#ifdef HP_MALLOC_FRONT_CACHE
+/* allocates the per-process front cache stats and registers them */
+int hp_init_cache_statistics(int no_procs);
+#endif
+
 unsigned long hp_pkg_get_size(struct hp_block *hpb);
 unsigned long hp_pkg_get_used(struct hp_block *hpb);
 unsigned long hp_pkg_get_free(struct hp_block *hpb);
@@ -114,6 +119,7 @@ unsigned long hp_pkg_get_frags(struct hp_block *hpb);
 	#define update_shm_stats(...)
 
 	#define hp_init_shm_statistics(...)
+	#define hp_init_cache_statistics(...) 0
 	#define update_stats_pkg_frag_attach(blk, frag)
 	#define update_stats_pkg_frag_detach(blk, frag)
 	#define update_stats_pkg_frag_split(blk, ...)
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <string.h>
+
+#include "../dprint.h"
+#include "../pt.h"
+#include "../ut.h"
+#include "../statistics.h"
+#include "shm_mem.h"
+#include "msg_arena.h"
+
+#if defined(PKG_MALLOC) && !defined(DBG_MALLOC)
+
+#define MSG_ARENA_DATA_SIZE \
+	(MSG_ARENA_CHUNK_SIZE - sizeof(struct msg_arena_chunk))
+
+struct msg_arena msg_arena;
+
+struct msg_arena_stats {
+	unsigned long hwm[MSG_ARENA_ROUTES];
+	unsigned long fallbacks;
+};
+
+static struct msg_arena_stats *arena_stats;
+
+
+static inline void arena_set_chunk(struct msg_arena_chunk *c)
+{
+	msg_arena.cur = c;
+	msg_arena.pos = (char *)(c + 1);
+	msg_arena.end = c->end;
+}
+
+
+void *__msg_arena_alloc(unsigned long size)
+{
+	struct msg_arena_chunk *c;
+
+	/* outside of a message, or too large to share a chunk */
+	if (!msg_arena.msg || size > MSG_ARENA_DATA_SIZE / 4)
+		goto fallback;
+
+	if (msg_arena.cur && msg_arena.cur->next) {
+		/* a chunk kept from a previous message */
+		msg_arena.used += msg_arena.pos - (char *)(msg_arena.cur + 1);
+		arena_set_chunk(msg_arena.cur->next);
+	} else if (msg_arena.size + MSG_ARENA_CHUNK_SIZE <= MSG_ARENA_MAX_SIZE) {
+		c = pkg_malloc(MSG_ARENA_CHUNK_SIZE);
+		if (!c)
+			goto fallback;
+
+		c->next = NULL;
+		c->end = (char *)c + MSG_ARENA_CHUNK_SIZE;
+		msg_arena.size += MSG_ARENA_CHUNK_SIZE;
+
+		if (msg_arena.cur) {
+			msg_arena.used += msg_arena.pos - (char *)(msg_arena.cur + 1);
+			msg_arena.cur->next = c;
+		} else {
+			msg_arena.first = c;
+		}
+		arena_set_chunk(c);
+	} else {
+		goto fallback;
+	}
+
+	msg_arena.pos += size;
+	return msg_arena.pos - size;
+
+fallback:
+	if (msg_arena.msg && arena_stats)
+		arena_stats[process_no].fallbacks++;
+	return pkg_malloc(size);
+}
+
+
+int msg_arena_open(struct sip_msg *msg)
+{
+	if (msg_arena.msg)
+		return 0;
+
+	msg_arena.msg = msg;
+	return 1;
+}
+
+
+void msg_arena_close(int route)
+{
+	unsigned long used;
+
+	if (!msg_arena.cur) {
+		msg_arena.msg = NULL;
+		return;
+	}
+
+	used = msg_arena.used + (msg_arena.pos - (char *)(msg_arena.cur + 1));
+	if (arena_stats && used > arena_stats[process_no].hwm[route])
+		arena_stats[process_no].hwm[route] = used;
+
+	/* nothing in the arena is referred anymore */
+	msg_arena.msg = NULL;
+	msg_arena.used = 0;
+	arena_set_chunk(msg_arena.first);
+}
+
+
+#ifdef STATISTICS
+static unsigned long get_arena_request_hwm(void *proc)
+{
+	return arena_stats[(long)proc].hwm[MSG_ARENA_REQUEST];
+}
+
+static unsigned long get_arena_reply_hwm(void *proc)
+{
+	return arena_stats[(long)proc].hwm[MSG_ARENA_REPLY];
+}
+
+static unsigned long get_arena_error_hwm(void *proc)
+{
+	return arena_stats[(long)proc].hwm[MSG_ARENA_ERROR];
+}
+
+static unsigned long get_arena_fallbacks(void *proc)
+{
+	return arena_stats[(long)proc].fallbacks;
+}
+
+int init_msg_arena_stats(int no_procs)
+{
+	static struct {
+		char *name;
+		stat_function f;
+	} arena_stats_exp[] = {
+		{"arena_request_hwm", get_arena_request_hwm},
+		{"arena_reply_hwm",   get_arena_reply_hwm},
+		{"arena_error_hwm",   get_arena_error_hwm},
+		{"arena_fallbacks",   get_arena_fallbacks},
+	};
+	unsigned short n;
+	unsigned int i;
+	str n_str;
+	char *name;
+
+	arena_stats = shm_malloc(no_procs * sizeof *arena_stats);
+	if (!arena_stats) {
+		LM_ERR("no more shm mem for arena stats\n");
+		return -1;
+	}
+	memset(arena_stats, 0, no_procs * sizeof *arena_stats);
+
+	for (n = 0; n < no_procs; n++) {
+		n_str.s = int2str(n, &n_str.len);
+
+		for (i = 0; i < sizeof arena_stats_exp / sizeof *arena_stats_exp;
+		i++) {
+			if ((name = build_stat_name(&n_str, arena_stats_exp[i].name))==0
+			|| register_stat2("pkmem", name,
+			        (stat_var **)arena_stats_exp[i].f,
+			        STAT_NO_RESET|STAT_SHM_NAME|STAT_IS_FUNC,
+			        (void *)(long)n, 0) != 0) {
+				LM_ERR("failed to add stat variable\n");
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+#endif /* STATISTICS */
+
+#endif /* PKG_MALLOC && !DBG_MALLOC */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Per-message pkg arena
+ *
+ * While receive_msg() processes a message, the small objects living as
+ * long as the message (header fields, parsed Via/To/From/CSeq bodies,
+ * lumps) are bump-allocated from a per-process arena bound to it. Freeing
+ * them is a no-op; the whole arena is reset once the message is released.
+ * The arena chunks are pkg chunks, kept from one message to the next.
+ *
+ * An object goes to the arena only if it is allocated for the bound
+ * message (msg_malloc) or as part of an object already in the arena
+ * (msg_malloc_near); anything else, as well as everything not fitting
+ * into MSG_ARENA_MAX_SIZE, is a regular pkg chunk. msg_free() releases
+ * both kinds, so the objects may be freed the usual way, from any place.
+ */
+
+#ifndef _MEM_MSG_ARENA_H
+#define _MEM_MSG_ARENA_H
+
+#include "mem.h"
+
+struct sip_msg;
+
+/* the routes the high-water marks are kept for */
+#define MSG_ARENA_REQUEST  0
+#define MSG_ARENA_REPLY    1
+#define MSG_ARENA_ERROR    2
+#define MSG_ARENA_ROUTES   3
+
+#if defined(PKG_MALLOC) && !defined(DBG_MALLOC)
+
+#define MSG_ARENA_ALIGN     16
+#define MSG_ARENA_ROUND(_s) \
+	(((_s) + MSG_ARENA_ALIGN - 1) & ~(unsigned long)(MSG_ARENA_ALIGN - 1))
+
+struct msg_arena_chunk {
+	struct msg_arena_chunk *next;
+	char *end;
+	/* the data follows, aligned */
+} __attribute__((aligned(MSG_ARENA_ALIGN)));
+
+struct msg_arena {
+	/* the message the arena is bound to, NULL if none */
+	struct sip_msg *msg;
+	struct msg_arena_chunk *first;
+	struct msg_arena_chunk *cur;
+	char *pos;
+	char *end;
+	/* bytes given by the chunks before "cur" */
+	unsigned long used;
+	unsigned long size;
+};
+
+extern struct msg_arena msg_arena;
+
+void *__msg_arena_alloc(unsigned long size);
+
+static inline void *msg_arena_alloc(unsigned long size)
+{
+	char *p = msg_arena.pos;
+
+	size = MSG_ARENA_ROUND(size);
+	if (size <= (unsigned long)(msg_arena.end - p)) {
+		msg_arena.pos = p + size;
+		return p;
+	}
+
+	return __msg_arena_alloc(size);
+}
+
+static inline int in_msg_arena(void *p)
+{
+	struct msg_arena_chunk *c;
+
+	for (c = msg_arena.first; c; c = c->next)
+		if ((char *)p >= (char *)(c + 1) && (char *)p < c->end)
+			return 1;
+
+	return 0;
+}
+
+/* binds the arena to the message; returns 0 if already bound elsewhere */
+int msg_arena_open(struct sip_msg *msg);
+
+/* resets the arena, once the bound message was freed */
+void msg_arena_close(int route);
+
+static inline void *msg_malloc(struct sip_msg *msg, unsigned long size)
+{
+	if (msg_arena.msg && msg_arena.msg == msg)
+		return msg_arena_alloc(size);
+
+	return pkg_malloc(size);
+}
+
+static inline void *msg_malloc_near(void *p, unsigned long size)
+{
+	if (msg_arena.msg && in_msg_arena(p))
+		return msg_arena_alloc(size);
+
+	return pkg_malloc(size);
+}
+
+static inline void msg_free(void *p)
+{
+	if (!in_msg_arena(p))
+		pkg_free(p);
+}
+
+#else
+
+#define msg_arena_open(_msg) 0
+#define msg_arena_close(_route) do {} while (0)
+
+#define msg_malloc(_msg, _size)    pkg_malloc(_size)
+#define msg_malloc_near(_p, _size) pkg_malloc(_size)
+#define msg_free(_p)               pkg_free(_p)
+
+#endif
+
+#if defined(PKG_MALLOC) && !defined(DBG_MALLOC) && defined(STATISTICS)
+/* allocates the per-process arena stats and registers them */
+int init_msg_arena_stats(int no_procs);
+#else
+#define init_msg_arena_stats(_no_procs) 0
+#endif
+
+#endif /* _MEM_MSG_ARENA_H */
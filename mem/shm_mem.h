@@ -88,9 +88,14 @@
 #	define MY_REALLOC_UNSAFE MY_REALLOC
 #elif defined HP_MALLOC
 #	include "hp_malloc.h"
-#	define MY_MALLOC hp_shm_malloc
+#	ifdef HP_MALLOC_FRONT_CACHE
+#		define MY_MALLOC hp_shm_cache_malloc
+#		define MY_FREE hp_shm_cache_free
+#	else
+#		define MY_MALLOC hp_shm_malloc
+#		define MY_FREE hp_shm_free
+#	endif
 #	define MY_MALLOC_UNSAFE hp_shm_malloc_unsafe
-#	define MY_FREE hp_shm_free
 #	define MY_FREE_UNSAFE hp_shm_free_unsafe
 #	define MY_REALLOC hp_shm_realloc
 #	define MY_REALLOC_UNSAFE hp_shm_realloc_unsafe
@@ -197,6 +202,16 @@ inline static void shm_threshold_check(void)
 #endif
 
 
+#if defined(HP_MALLOC) && defined(HP_MALLOC_FRONT_CACHE)
+#define shm_cache_enable() hp_cache_enable()
+#define shm_cache_flush()  hp_cache_flush(shm_block)
+#define shm_cache_destroy() hp_cache_destroy(shm_block)
+#else
+#define shm_cache_enable()
+#define shm_cache_flush()
+#define shm_cache_destroy()
+#endif
+
 #ifndef HP_MALLOC
 #define shm_lock()    lock_get(mem_lock)
 #define shm_unlock()  lock_release(mem_lock)
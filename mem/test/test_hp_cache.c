@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#if defined(HP_MALLOC) && defined(HP_MALLOC_FRONT_CACHE)
+
+#include <tap.h>
+#include <sys/time.h>
+
+#include "../../str.h"
+#include "../../ut.h"
+#include "../../pt.h"
+#include "../shm_mem.h"
+#include "../hp_malloc.h"
+
+#include "test_hp_cache.h"
+
+/* operations performed by each worker, per round */
+#define HPC_OPS             2000000
+/* chunks kept alive by each worker (a few in-flight transactions) */
+#define HPC_WORKING_SET     256
+
+typedef void *(*hpc_malloc_f)(struct hp_block *, unsigned long);
+typedef void (*hpc_free_f)(struct hp_block *, void *);
+
+/* typical sizes of the TM cell / cloned request related chunks */
+static unsigned long hpc_sizes[] = { 48, 96, 136, 256, 520, 1024, 1800 };
+
+static stat_var *forked_workers;
+static stat_var *active_workers;
+
+static long _bench_worker(hpc_malloc_f do_malloc, hpc_free_f do_free)
+{
+	void *set[HPC_WORKING_SET];
+	struct timeval start, end;
+	int i, idx, failed = 0;
+
+	memset(set, 0, sizeof set);
+	srand(getpid());
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < HPC_OPS; i++) {
+		idx = rand() % HPC_WORKING_SET;
+		if (set[idx]) {
+			do_free(shm_block, set[idx]);
+			set[idx] = NULL;
+		} else {
+			set[idx] = do_malloc(shm_block,
+				hpc_sizes[rand() % (sizeof hpc_sizes / sizeof *hpc_sizes)]);
+			if (!set[idx])
+				failed++;
+		}
+	}
+
+	for (i = 0; i < HPC_WORKING_SET; i++)
+		if (set[i])
+			do_free(shm_block, set[i]);
+
+	gettimeofday(&end, NULL);
+
+	if (failed)
+		LM_ERR("%d allocations failed\n", failed);
+
+	return (end.tv_sec - start.tv_sec) * 1000000L +
+	       (end.tv_usec - start.tv_usec);
+}
+
+/* runs one round with TEST_CACHE_PROCS workers, returns the wall time */
+static long bench_round(const char *desc, hpc_malloc_f do_malloc,
+                        hpc_free_f do_free)
+{
+	struct timeval start, end;
+	int i, my_pid = 0;
+	long usec;
+
+	reset_stat(forked_workers);
+	update_stat(forked_workers, +1);
+	update_stat(active_workers, +1);
+
+	for (i = 1; i < TEST_CACHE_PROCS; i++) {
+		if (internal_fork("shm cache bench", OSS_FORK_NO_IPC|OSS_FORK_NO_LOAD)
+		        == 0) {
+			my_pid = i;
+			update_stat(forked_workers, +1);
+			update_stat(active_workers, +1);
+			break;
+		}
+	}
+
+	/* start all the workers at once */
+	while (get_stat_val(forked_workers) < TEST_CACHE_PROCS)
+		usleep(10);
+
+	gettimeofday(&start, NULL);
+
+	usec = _bench_worker(do_malloc, do_free);
+
+	if (my_pid != 0) {
+		/* give back everything the worker cached */
+		hp_cache_destroy(shm_block);
+		update_stat(active_workers, -1);
+		exit(0);
+	}
+
+	update_stat(active_workers, -1);
+	while (get_stat_val(active_workers) > 0)
+		usleep(100);
+
+	gettimeofday(&end, NULL);
+
+	usec = (end.tv_sec - start.tv_sec) * 1000000L +
+	       (end.tv_usec - start.tv_usec);
+
+	LM_INFO("%s: %d workers x %d ops in %ld ms (%ld ops/sec)\n", desc,
+	        TEST_CACHE_PROCS, HPC_OPS, usec / 1000,
+	        (long)((double)TEST_CACHE_PROCS * HPC_OPS * 1000000 / usec));
+
+	return usec;
+}
+
+void test_hp_cache(void)
+{
+	unsigned long used, rused, frags;
+	long locked, cached;
+
+	used = get_stat_val(get_stat(_str("used_size")));
+	rused = get_stat_val(get_stat(_str("real_used_size")));
+
+	locked = bench_round("locked hp_shm_malloc()", hp_shm_malloc, hp_shm_free);
+
+	ok(get_stat_val(get_stat(_str("used_size"))) == used,
+	    "check stats: shm_used after the locked round");
+
+	/* the attendant is not a forked process, it has no cache of its own */
+	hp_cache_enable();
+
+	frags = get_stat_val(get_stat(_str("fragments")));
+	cached = bench_round("cached hp_shm_cache_malloc()",
+	                     hp_shm_cache_malloc, hp_shm_cache_free);
+	hp_cache_flush(shm_block);
+
+	LM_INFO("fragments: %lu before, %lu after the cached round\n", frags,
+	        get_stat_val(get_stat(_str("fragments"))));
+
+	ok(get_stat_val(get_stat(_str("real_used_size"))) == rused,
+	    "check stats: shm_rused after the cached round");
+	ok(hp_cache_stats[process_no].cached == 0,
+	    "check cache: nothing left cached after flush");
+
+	/* timing only, the wall clock depends on the load of the machine */
+	diag("front cache speedup: %.2fx", (double)locked / cached);
+}
+
+void init_hp_cache_tests(void)
+{
+	if (register_stat("test_hp_cache", "forked-workers",
+	        &forked_workers, 0) != 0) {
+		LM_ERR("failed to register stat\n");
+		return;
+	}
+
+	if (register_stat("test_hp_cache", "active-workers",
+	        &active_workers, 0) != 0) {
+		LM_ERR("failed to register stat\n");
+		return;
+	}
+}
+
+#endif /* HP_MALLOC && HP_MALLOC_FRONT_CACHE */
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#ifndef __TEST_HP_CACHE_H__
+#define __TEST_HP_CACHE_H__
+
+/* attendant + 31 more, for each of the two benchmark rounds */
+#define TEST_CACHE_PROCS  32
+
+/* benchmark the HP_MALLOC shm front cache against the locked path */
+void init_hp_cache_tests(void);
+void test_hp_cache(void);
+
+#endif /* __TEST_HP_CACHE_H__ */
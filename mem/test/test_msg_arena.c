@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <tap.h>
+#include <string.h>
+
+#include "../../dprint.h"
+#include "../../data_lump.h"
+#include "../../parser/msg_parser.h"
+#include "../../parser/parse_from.h"
+#include "../mem.h"
+#include "../msg_arena.h"
+
+#include "test_msg_arena.h"
+
+static char msg_buf[] =
+	"INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bK776asdhdt;rport\r\n"
+	"Max-Forwards: 70\r\n"
+	"To: Bob <sip:bob@biloxi.example.com>;x=1\r\n"
+	"From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+	"Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+	"CSeq: 314159 INVITE\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n";
+
+#if defined(PKG_MALLOC) && !defined(DBG_MALLOC)
+
+static int parse(struct sip_msg *msg)
+{
+	memset(msg, 0, sizeof *msg);
+	msg->buf = msg_buf;
+	msg->len = strlen(msg_buf);
+
+	if (parse_msg(msg->buf, msg->len, msg) != 0 ||
+	parse_headers(msg, HDR_EOH_F, 0) < 0 || parse_from_header(msg) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void test_msg_arena_lifetime(void)
+{
+	struct sip_msg msg, other;
+	struct lump *anchor, *l;
+	struct hdr_field *first_hf;
+	char *s;
+
+	if (!ok(msg_arena_open(&msg) == 1, "arena bound"))
+		return;
+	ok(msg_arena_open(&other) == 0, "no nested binding");
+
+	if (!ok(parse(&msg) == 0, "message parsed"))
+		return;
+
+	ok(in_msg_arena(msg.headers) && in_msg_arena(msg.last_header),
+	   "header fields in the arena");
+	ok(in_msg_arena(msg.via1) && in_msg_arena(msg.via1->param_lst) &&
+	   in_msg_arena(msg.via2) && in_msg_arena(msg.via2->param_lst),
+	   "Via bodies and params in the arena");
+	ok(in_msg_arena(msg.to->parsed) && in_msg_arena(msg.cseq->parsed) &&
+	   in_msg_arena(msg.from->parsed) &&
+	   in_msg_arena(get_to(&msg)->param_lst), "To/From/CSeq in the arena");
+
+	anchor = anchor_lump(&msg, msg.via1->hdr.s - msg.buf, HDR_VIA_T);
+	s = pkg_malloc(4);
+	if (!ok(anchor && s, "anchor added"))
+		return;
+	memcpy(s, "X: 1", 4);
+	l = insert_new_lump_before(anchor, s, 4, HDR_OTHER_T);
+	ok(in_msg_arena(anchor) && in_msg_arena(l) && !in_msg_arena(s),
+	   "lumps in the arena, their value in pkg");
+
+	/* any other message keeps using pkg */
+	if (ok(parse(&other) == 0, "other message parsed")) {
+		ok(!in_msg_arena(other.headers) && !in_msg_arena(other.via1) &&
+		   !in_msg_arena(other.to->parsed) &&
+		   !in_msg_arena(get_to(&other)->param_lst),
+		   "other message not in the arena");
+		l = anchor_lump(&other, 0, HDR_OTHER_T);
+		ok(l && !in_msg_arena(l), "other message lumps not in the arena");
+	}
+	free_sip_msg(&other);
+
+	first_hf = msg.headers;
+	free_sip_msg(&msg);
+	msg_arena_close(MSG_ARENA_REQUEST);
+
+	/* the next message reuses the arena from its start */
+	if (!ok(msg_arena_open(&msg) == 1, "arena bound again"))
+		return;
+	if (ok(parse(&msg) == 0, "message parsed again"))
+		ok(msg.headers == first_hf, "arena reset");
+	free_sip_msg(&msg);
+	msg_arena_close(MSG_ARENA_REQUEST);
+}
+
+static void test_msg_arena_limit(void)
+{
+	struct sip_msg msg;
+	void *p, *big;
+	int i, in = 0, out = 0;
+
+	memset(&msg, 0, sizeof msg);
+	if (!ok(msg_arena_open(&msg) == 1, "arena bound"))
+		return;
+
+	big = msg_malloc(&msg, MSG_ARENA_CHUNK_SIZE);
+	ok(big && !in_msg_arena(big), "large objects in pkg");
+	pkg_free(big);
+
+	for (i = 0; i < 2 * MSG_ARENA_MAX_SIZE / 64; i++) {
+		p = msg_malloc(&msg, 64);
+		if (!p)
+			break;
+		if (in_msg_arena(p)) {
+			in++;
+		} else {
+			out++;
+			msg_free(p);
+		}
+	}
+
+	ok(in > 0 && out > 0 && in * 64 <= MSG_ARENA_MAX_SIZE,
+	   "pkg fallback past the arena size");
+	msg_arena_close(MSG_ARENA_REQUEST);
+}
+
+void test_msg_arena(void)
+{
+	test_msg_arena_lifetime();
+	test_msg_arena_limit();
+}
+
+#else
+
+void test_msg_arena(void)
+{
+	ok(1, "no msg arena with DBG_MALLOC");
+}
+
+#endif
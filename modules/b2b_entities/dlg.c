@@ -2866,7 +2866,7 @@ int b2breq_complete_ehdr(str* extra_headers, str *client_headers,
 
 		if (parse_headers( &foo_msg, HDR_EOH_F, 0) == -1) {
 			LM_ERR("Failed to parse headers\n");
-			return -1;
+			goto error;
 		}
 
 		if (!is_CT_present(foo_msg.headers)) {
@@ -2874,7 +2874,7 @@ int b2breq_complete_ehdr(str* extra_headers, str *client_headers,
 			if(ehdr.len + 32 > BUF_LEN)
 			{
 				LM_ERR("Buffer too small, can not add Content-Type header\n");
-				return -1;
+				goto error;
 			}
 			memcpy(ehdr.s+ ehdr.len, "Content-Type: application/sdp\r\n", 31);
 			ehdr.len += 31;
@@ -2882,10 +2882,15 @@ int b2breq_complete_ehdr(str* extra_headers, str *client_headers,
 		}
 
 		if (foo_msg.headers) free_hdr_field_lst(foo_msg.headers);
+		free_hdr_scan(&foo_msg);
 	}
 	*ehdr_out = ehdr;
 
 	return 0;
+error:
+	if (foo_msg.headers) free_hdr_field_lst(foo_msg.headers);
+	free_hdr_scan(&foo_msg);
+	return -1;
 }
 
 
@@ -33,6 +33,7 @@
 #include "../../timer.h"
 #include "../../error.h"
 #include "../../ut.h"
+#include "../../trim.h"
 #include "../../mem/mem.h"
 #include "../../mem/shm_mem.h"
 #include "../../mod_fix.h"
@@ -40,6 +41,7 @@
 #include "../../lib/csv.h"
 
 #include "cachedb_local.h"
+#include "lcache_repl.h"
 #include "hash.h"
 
 #include <fnmatch.h>
@@ -55,6 +57,7 @@ int local_exec_threshold = 0;
 
 lcache_col_t* lcache_collection = NULL;
 url_lst_t* url_list=NULL;
+static url_lst_t* limit_list=NULL;
 
 
 static int w_remove_chunk_1(struct sip_msg* msg, char* glob);
@@ -64,12 +67,16 @@ struct mi_root * mi_cache_remove_chunk(struct mi_root *cmd_tree,void *param);
 void localcache_clean(unsigned int ticks,void *param);
 static int parse_collections(unsigned int type, void *val);
 static int store_urls(unsigned int type, void *val);
+static int store_limits(unsigned int type, void *val);
+static int apply_limits(void);
 
 static param_export_t params[]={
 	{ "cache_clean_period", INT_PARAM, &cache_clean_period },
 	{ "exec_threshold",     INT_PARAM, &local_exec_threshold },
 	{ "cache_collections",  STR_PARAM|USE_FUNC_PARAM, (void *)parse_collections },
 	{ "cachedb_url",        STR_PARAM|USE_FUNC_PARAM, (void *)store_urls },
+	{ "collection_size_limit", STR_PARAM|USE_FUNC_PARAM, (void *)store_limits },
+	{ "cache_replication_cluster", INT_PARAM, &lcache_repl_cluster },
 	{0,0,0}
 };
 
@@ -127,32 +134,51 @@ static int w_remove_chunk_2(struct sip_msg* msg, char* collection, char* glob)
 }
 
 
+lcache_col_t *lcache_get_collection(str *name)
+{
+	lcache_col_t *col;
+
+	for ( col=lcache_collection; col; col=col->next ) {
+		if ( !str_strcmp( &col->col_name, name) )
+			break;
+	}
+
+	return col;
+}
+
 static int remove_chunk_f(struct sip_msg* msg, char* collection, char* glob)
 {
-	int i;
 	str *pat = (str *)glob;
 	str *col_s = (str *)collection;
-	lcache_entry_t* me1, *me2;
-	struct timeval start;
-
 	lcache_col_t* col;
-	lcache_t* cache_htable;
 
 	if ( !collection ) {
 		/* use default collection; default collection is always first in list */
 		col = lcache_collection;
 	} else {
-		for ( col=lcache_collection; col; col=col->next ) {
-			if ( !str_strcmp( &col->col_name, col_s) )
-				break;
-		}
-
+		col = lcache_get_collection(col_s);
 		if ( !col ) {
 			LM_ERR("collection <%.*s> not defined!\n", col_s->len, col_s->s);
 			return -1;
 		}
 	}
 
+	if (lcache_remove_chunk(col, pat) < 0)
+		return -1;
+
+	if (lcache_repl_cluster)
+		replicate_lcache_remove_chunk(col, pat);
+
+	return 1;
+}
+
+int lcache_remove_chunk(lcache_col_t *col, str *pat)
+{
+	int i;
+	lcache_entry_t* me1, *me2;
+	struct timeval start;
+	lcache_t* cache_htable;
+
 	cache_htable = col->col_htable;
 
 	if (pat->len+1 > pat_buff_size) {
@@ -201,11 +227,11 @@ static int remove_chunk_f(struct sip_msg* msg, char* collection, char* glob)
 
 				if(me2) {
 					me2->next = me1->next;
-					shm_free(me1);
+					lcache_free_entry(col, me1);
 					me1 = me2->next;
 				} else{
 					cache_htable[i].entries = me1->next;
-					shm_free(me1);
+					lcache_free_entry(col, me1);
 					me1 = cache_htable[i].entries;
 				}
 			} else {
@@ -218,7 +244,7 @@ static int remove_chunk_f(struct sip_msg* msg, char* collection, char* glob)
 
 	stop_expire_timer(start,local_exec_threshold,
 	"cachedb_local remove_chunk",pat->s,pat->len,0);
-	return 1;
+	return 0;
 }
 
 struct mi_root * mi_cache_remove_chunk(struct mi_root *cmd_tree,void *param)
@@ -372,6 +398,7 @@ static int mod_init(void)
 			LM_ERR("no more shared memory!\n");
 			return -1;
 		}
+		memset(default_col, 0, sizeof(lcache_col_t));
 
 		default_col->col_name.s = DEFAULT_COLLECTION_NAME;
 		default_col->col_name.len = sizeof(DEFAULT_COLLECTION_NAME) - 1;
@@ -423,6 +450,9 @@ static int mod_init(void)
 		}
 	}
 
+	if (apply_limits() < 0)
+		return -1;
+
 	/* check to see if we've got unused collections */
 	for ( col_it=lcache_collection; col_it; col_it=col_it->next ) {
 		if ( !col_it->is_used ) {
@@ -435,6 +465,9 @@ static int mod_init(void)
 	register_timer("localcache-expire",localcache_clean, 0,
 		cache_clean_period, TIMER_FLAG_DELAY_ON_DELAY);
 
+	if (lcache_repl_init() < 0)
+		return -1;
+
 	return 0;
 }
 
@@ -485,13 +518,13 @@ void localcache_clean(unsigned int ticks,void *param)
 					if(me2)
 					{
 						me2->next = me1->next;
-						shm_free(me1);
+						lcache_free_entry(it, me1);
 						me1 = me2->next;
 					}
 					else
 					{
 						cache_htable[i].entries = me1->next;
-						shm_free(me1);
+						lcache_free_entry(it, me1);
 						me1 = cache_htable[i].entries;
 					}
 				}
@@ -619,3 +652,111 @@ static int store_urls(unsigned int type, void *val)
 	return 0;
 }
 
+
+
+/**
+ * same as the urls, the limits wait for all the collections to be defined
+ */
+static int store_limits(unsigned int type, void *val)
+{
+	url_lst_t* new_limit;
+
+	new_limit = pkg_malloc(sizeof(url_lst_t));
+	if ( !new_limit ) {
+		LM_ERR("no more pkg mem!\n");
+		return -1;
+	}
+
+	new_limit->url.s = (char *)val;
+	new_limit->url.len = strlen(new_limit->url.s);
+	new_limit->next = limit_list;
+	limit_list = new_limit;
+
+	return 0;
+}
+
+/* a number of bytes, with an optional K, M or G suffix */
+static int parse_size(str *in, unsigned long *size)
+{
+	str s = *in;
+	unsigned int n, mult = 1;
+
+	if (s.len > 0) {
+		switch (s.s[s.len - 1]) {
+		case 'k': case 'K': mult = 1 << 10; s.len--; break;
+		case 'm': case 'M': mult = 1 << 20; s.len--; break;
+		case 'g': case 'G': mult = 1 << 30; s.len--; break;
+		}
+	}
+
+	trim(&s);
+	if (str2int(&s, &n) < 0)
+		return -1;
+
+	*size = (unsigned long)n * mult;
+	return 0;
+}
+
+static int apply_limits(void)
+{
+	url_lst_t *it, *next;
+	csv_record *limits, *limit, *kv;
+	lcache_col_t *col;
+	unsigned long size;
+
+	for (it = limit_list; it; it = next) {
+		next = it->next;
+
+		limits = __parse_csv_record(&it->url, 0, ';');
+		if (!limits)
+			goto bad_input;
+
+		for (limit = limits; limit; limit = limit->next) {
+			if (ZSTR(limit->s))
+				continue;
+
+			kv = __parse_csv_record(&limit->s, 0, '=');
+			if (!kv) {
+				free_csv_record(limits);
+				goto bad_input;
+			}
+
+			if (!kv->next || parse_size(&kv->next->s, &size) < 0 || !size) {
+				LM_ERR("invalid size limit <%.*s>!\n",
+					limit->s.len, limit->s.s);
+				goto error;
+			}
+
+			col = lcache_get_collection(&kv->s);
+			if (!col) {
+				LM_ERR("size limit for undefined collection <%.*s>!\n",
+					kv->s.len, kv->s.s);
+				goto error;
+			}
+
+			if (!col->max_size && !lock_init(&col->evict_lock)) {
+				LM_ERR("failed to init the eviction lock\n");
+				goto error;
+			}
+
+			LM_DBG("collection '%.*s' limited to %lu bytes\n",
+				col->col_name.len, col->col_name.s, size);
+			col->max_size = size;
+			free_csv_record(kv);
+		}
+
+		free_csv_record(limits);
+		pkg_free(it);
+		limit_list = next;
+	}
+
+	return 0;
+
+error:
+	free_csv_record(kv);
+	free_csv_record(limits);
+	return -1;
+bad_input:
+	LM_ERR("failed to parse 'collection_size_limit'!\n");
+	return -1;
+}
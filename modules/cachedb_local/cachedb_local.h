@@ -56,6 +56,13 @@ typedef struct lcache_col {
 	 * if not used we'll need to throw an error */
 	int is_used;
 
+	/* bytes used by the entries; over max_size (if set), the least
+	 * recently used ones are evicted, in CLOCK order */
+	unsigned long mem;
+	unsigned long max_size;
+	unsigned int hand;
+	gen_lock_t evict_lock;
+
 	struct lcache_col* next;
 } lcache_col_t;
 
@@ -67,4 +74,7 @@ typedef struct url_lst {
 extern lcache_col_t* lcache_collection;
 extern url_lst_t* url_list;
 
+lcache_col_t *lcache_get_collection(str *name);
+int lcache_remove_chunk(lcache_col_t *col, str *glob);
+
 #endif
@@ -33,9 +33,11 @@
 #include "../../mem/mem.h"
 #include "../../mem/shm_mem.h"
 #include "cachedb_local.h"
+#include "lcache_repl.h"
 #include "hash.h"
 
-void lcache_htable_remove_safe(str attr, lcache_entry_t** it);
+void lcache_htable_remove_safe(lcache_col_t *col, str attr,
+		lcache_entry_t** it);
 
 int lcache_htable_init(lcache_t** cache_htable_p, int size)
 {
@@ -102,7 +104,79 @@ void lcache_htable_destroy(lcache_t** cache_htable_p, int size)
 	*cache_htable_p = NULL;
 }
 
-int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
+void lcache_free_entry(lcache_col_t *col, lcache_entry_t *me)
+{
+	__sync_sub_and_fetch(&col->mem, lcache_entry_size(me));
+	shm_free(me);
+}
+
+/* makes room for @size bytes in a size-limited collection: the hand goes
+ * through the buckets, evicting the entries not used since its last pass */
+static int lcache_evict(lcache_col_t *col, unsigned long size)
+{
+	lcache_entry_t *it, *prev, *next;
+	lcache_t *bucket;
+	unsigned int now;
+	int n, evicted = 0;
+
+	if (size > col->max_size) {
+		LM_ERR("%lu bytes entry over the size limit of collection <%.*s>\n",
+			size, col->col_name.len, col->col_name.s);
+		return -1;
+	}
+
+	if (col->mem + size <= col->max_size)
+		return 0;
+
+	lock_get(&col->evict_lock);
+
+	now = get_ticks();
+	/* the first round may only clear the reference bits */
+	for (n = 0; n < 2 * col->size && col->mem + size > col->max_size; n++) {
+		bucket = &col->col_htable[col->hand];
+		col->hand = (col->hand + 1) & (col->size - 1);
+
+		lock_get(&bucket->lock);
+		for (prev = NULL, it = bucket->entries;
+		     it && col->mem + size > col->max_size; it = next) {
+			next = it->next;
+			if (it->ref && (it->expires == 0 || it->expires >= now)) {
+				it->ref = 0;
+				prev = it;
+				continue;
+			}
+
+			if (prev)
+				prev->next = next;
+			else
+				bucket->entries = next;
+
+			lcache_free_entry(col, it);
+			evicted++;
+		}
+		lock_release(&bucket->lock);
+	}
+
+	lock_release(&col->evict_lock);
+
+	LM_DBG("evicted %d entries from collection <%.*s>, %lu bytes used\n",
+		evicted, col->col_name.len, col->col_name.s, col->mem);
+	return 0;
+}
+
+static inline lcache_col_t *lcache_con_col(cachedb_con *con)
+{
+	lcache_col_t* cache_col = ((lcache_con*)con->data)->col;
+
+	if ( !cache_col )
+		LM_ERR("url <%.*s> does not have any collection associated with!",
+				con->url.len, con->url.s);
+
+	return cache_col;
+}
+
+int lcache_col_insert(lcache_col_t *cache_col, str* attr, str* value,
+		int expires)
 {
 	lcache_entry_t* me, *it;
 	int hash_code;
@@ -110,19 +184,14 @@ int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
 	struct timeval start;
 
 	lcache_t* cache_htable;
-	lcache_col_t* cache_col;
-
-	cache_col = ((lcache_con*)con->data)->col;
-	if ( !cache_col ) {
-		LM_ERR("url <%.*s> does not have any collection associated with!",
-				con->url.len, con->url.s);
-		return -1;
-	}
 
 	cache_htable = cache_col->col_htable;
 
 	size= sizeof(lcache_entry_t) + attr->len + value->len;
 
+	if (cache_col->max_size && lcache_evict(cache_col, size) < 0)
+		return -1;
+
 	me = (lcache_entry_t*)shm_malloc(size);
 	if(me == NULL)
 	{
@@ -142,6 +211,7 @@ int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
 	me->value.len = value->len;
 	if( expires != 0)
 		me->expires = get_ticks() + expires;
+	me->ref = 1;
 
 	hash_code= core_hash( attr, 0, cache_col->size);
 	lock_get(&cache_htable[hash_code].lock);
@@ -149,10 +219,11 @@ int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
 	it = cache_htable[hash_code].entries;
 
 	/* if a previous record for the same attr delete it */
-	lcache_htable_remove_safe( *attr, &it);
+	lcache_htable_remove_safe(cache_col, *attr, &it);
 
 	me->next = it;
 	cache_htable[hash_code].entries = me;
+	__sync_add_and_fetch(&cache_col->mem, size);
 
 	lock_release(&cache_htable[hash_code].lock);
 
@@ -161,7 +232,24 @@ int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
 	return 1;
 }
 
-void lcache_htable_remove_safe(str attr, lcache_entry_t** it_p)
+int lcache_htable_insert(cachedb_con *con,str* attr, str* value, int expires)
+{
+	lcache_col_t* cache_col;
+
+	if ( !(cache_col = lcache_con_col(con)) )
+		return -1;
+
+	if (lcache_col_insert(cache_col, attr, value, expires) < 0)
+		return -1;
+
+	if (lcache_repl_cluster)
+		replicate_lcache_insert(cache_col, attr, value, expires);
+
+	return 1;
+}
+
+void lcache_htable_remove_safe(lcache_col_t *col, str attr,
+		lcache_entry_t** it_p)
 {
 	lcache_entry_t* me = NULL, *it= *it_p;
 
@@ -176,7 +264,7 @@ void lcache_htable_remove_safe(str attr, lcache_entry_t** it_p)
 			else
 				*it_p = it->next;
 
-			shm_free(it);
+			lcache_free_entry(col, it);
 
 			return;
 		}
@@ -186,20 +274,12 @@ void lcache_htable_remove_safe(str attr, lcache_entry_t** it_p)
 	LM_DBG("entry not found\n");
 }
 
-int lcache_htable_remove(cachedb_con *con,str* attr)
+int lcache_col_remove(lcache_col_t *cache_col, str* attr)
 {
 	int hash_code;
 	struct timeval start;
 
 	lcache_t* cache_htable;
-	lcache_col_t* cache_col;
-
-	cache_col = ((lcache_con*)con->data)->col;
-	if ( !cache_col ) {
-		LM_ERR("url <%.*s> does not have any collection associated with!",
-				con->url.len, con->url.s);
-		return -1;
-	}
 
 	cache_htable = cache_col->col_htable;
 
@@ -209,7 +289,8 @@ int lcache_htable_remove(cachedb_con *con,str* attr)
 	hash_code= core_hash( attr, 0, cache_col->size);
 	lock_get(&cache_htable[hash_code].lock);
 
-	lcache_htable_remove_safe( *attr, &cache_htable[hash_code].entries);
+	lcache_htable_remove_safe(cache_col, *attr,
+		&cache_htable[hash_code].entries);
 
 	lock_release(&cache_htable[hash_code].lock);
 
@@ -219,33 +300,44 @@ int lcache_htable_remove(cachedb_con *con,str* attr)
 	return 0;
 }
 
-int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_val)
+int lcache_htable_remove(cachedb_con *con,str* attr)
+{
+	lcache_col_t* cache_col;
+
+	if ( !(cache_col = lcache_con_col(con)) )
+		return -1;
+
+	lcache_col_remove(cache_col, attr);
+
+	if (lcache_repl_cluster)
+		replicate_lcache_remove(cache_col, attr);
+
+	return 0;
+}
+
+int lcache_col_add(lcache_col_t *cache_col, str *attr, int val, int expires,
+		int *new_val)
 {
 	int hash_code;
 	lcache_entry_t *it=NULL,*it_prev=NULL;
 	int old_value;
 	char *new_value;
-	int new_len;
+	int new_len, old_len;
 	str ins_val;
 	struct timeval start;
+	int evicted = 0;
 
 	lcache_t* cache_htable;
-	lcache_col_t* cache_col;
-
-	cache_col = ((lcache_con*)con->data)->col;
-	if ( !cache_col ) {
-		LM_ERR("url <%.*s> does not have any collection associated with!",
-				con->url.len, con->url.s);
-		return -1;
-	}
 
 	cache_htable = cache_col->col_htable;
 
 	start_expire_timer(start,local_exec_threshold);
 
 	hash_code = core_hash(attr,0,cache_col->size);
+again:
 	lock_get(&cache_htable[hash_code].lock);
 
+	it_prev = NULL;
 	it = cache_htable[hash_code].entries;
 	while (it) {
 		if (it->attr.len == attr->len &&
@@ -257,11 +349,11 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 				else
 					cache_htable[hash_code].entries = it->next;
 
-				shm_free(it);
+				lcache_free_entry(cache_col, it);
 				lock_release(&cache_htable[hash_code].lock);
 
 				ins_val.s = sint2str(val,&ins_val.len);
-				if (lcache_htable_insert(con,attr,&ins_val,expires) < 0) {
+				if (lcache_col_insert(cache_col,attr,&ins_val,expires) < 0) {
 					LM_ERR("failed to insert value\n");
 					stop_expire_timer(start,local_exec_threshold,
 					"cachedb_local add",attr->s,attr->len,0);
@@ -286,8 +378,25 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 			}
 
 			old_value+=val;
-			expires = it->expires;
 			new_value = sint2str(old_value,&new_len);
+			old_len = it->value.len;
+
+			/* a longer value may push the collection over its limit; the
+			 * eviction takes the bucket locks, so do it unlocked and look
+			 * the entry up again (it may have been evicted meanwhile) */
+			if (cache_col->max_size && !evicted && new_len > old_len &&
+			cache_col->mem + (new_len - old_len) > cache_col->max_size) {
+				lock_release(&cache_htable[hash_code].lock);
+				if (lcache_evict(cache_col, new_len - old_len) < 0) {
+					stop_expire_timer(start,local_exec_threshold,
+					"cachedb_local add",attr->s,attr->len,0);
+					return -1;
+				}
+				evicted = 1;
+				goto again;
+			}
+
+			expires = it->expires;
 			it = shm_realloc(it,sizeof(lcache_entry_t) + attr->len +new_len);
 			if (it == NULL) {
 				LM_ERR("failed to realloc struct\n");
@@ -308,6 +417,8 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 
 			memcpy(it->value.s,new_value,new_len);
 			it->value.len = new_len;
+			it->ref = 1;
+			__sync_add_and_fetch(&cache_col->mem, new_len - old_len);
 			lock_release(&cache_htable[hash_code].lock);
 			if (new_val)
 				*new_val = old_value;
@@ -324,7 +435,7 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 
 	/* not found */
 	ins_val.s = sint2str(val,&ins_val.len);
-	if (lcache_htable_insert(con,attr,&ins_val,expires) < 0) {
+	if (lcache_col_insert(cache_col,attr,&ins_val,expires) < 0) {
 		LM_ERR("failed to insert value\n");
 		stop_expire_timer(start,local_exec_threshold,
 		"cachedb_local add",attr->s,attr->len,0);
@@ -338,6 +449,23 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 	return 0;
 }
 
+int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_val)
+{
+	lcache_col_t* cache_col;
+
+	if ( !(cache_col = lcache_con_col(con)) )
+		return -1;
+
+	if (lcache_col_add(cache_col, attr, val, expires, new_val) < 0)
+		return -1;
+
+	/* the peers apply the same change, not its result */
+	if (lcache_repl_cluster)
+		replicate_lcache_add(cache_col, attr, val, expires);
+
+	return 0;
+}
+
 int lcache_htable_sub(cachedb_con *con,str *attr,int val,int expires,int *new_val)
 {
 	return lcache_htable_add(con,attr,-val,expires,new_val);
@@ -389,7 +517,7 @@ int lcache_htable_fetch(cachedb_con *con,str* attr, str* res)
 				else
 					cache_htable[hash_code].entries = it->next;
 
-				shm_free(it);
+				lcache_free_entry(cache_col, it);
 
 				lock_release(&cache_htable[hash_code].lock);
 				stop_expire_timer(start,local_exec_threshold,
@@ -408,6 +536,7 @@ int lcache_htable_fetch(cachedb_con *con,str* attr, str* res)
 			memcpy(value, it->value.s, it->value.len);
 			res->len = it->value.len;
 			res->s = value;
+			it->ref = 1;
 			lock_release(&cache_htable[hash_code].lock);
 			stop_expire_timer(start,local_exec_threshold,
 			"cachedb_local fetch",attr->s,attr->len,0);
@@ -463,7 +592,7 @@ int lcache_htable_fetch_counter(cachedb_con* con,str* attr,int *val)
 				else
 					cache_htable[hash_code].entries = it->next;
 
-				shm_free(it);
+				lcache_free_entry(cache_col, it);
 
 				lock_release(&cache_htable[hash_code].lock);
 				stop_expire_timer(start,local_exec_threshold,
@@ -479,6 +608,7 @@ int lcache_htable_fetch_counter(cachedb_con* con,str* attr,int *val)
 			}
 			if (val)
 				*val = ret;
+			it->ref = 1;
 			lock_release(&cache_htable[hash_code].lock);
 			stop_expire_timer(start,local_exec_threshold,
 			"cachedb_local fetch_counter",attr->s,attr->len,0);
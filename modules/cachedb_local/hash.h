@@ -37,9 +37,14 @@ typedef struct lcache_entry
 	str attr;
 	str value;
 	unsigned int expires;
+	/* set when read or written; cleared by the eviction hand */
+	unsigned char ref;
 	struct lcache_entry* next;
 }lcache_entry_t;
 
+#define lcache_entry_size(_e) \
+	(sizeof(lcache_entry_t) + (_e)->attr.len + (_e)->value.len)
+
 
 typedef struct lcache
 {
@@ -47,6 +52,8 @@ typedef struct lcache
 	gen_lock_t lock;
 }lcache_t;
 
+struct lcache_col;
+
 
 int lcache_htable_init(lcache_t** cache_htable_p, int size);
 void lcache_htable_destroy();
@@ -57,4 +64,12 @@ int lcache_htable_add(cachedb_con *con,str *attr,int val,int expires,int *new_va
 int lcache_htable_sub(cachedb_con *con,str *attr,int val,int expires,int *new_val);
 int lcache_htable_fetch_counter(cachedb_con* con,str* attr,int *val);
 
+/* operations on a collection, without replicating them */
+int lcache_col_insert(struct lcache_col *col, str *attr, str *value,
+		int expires);
+int lcache_col_remove(struct lcache_col *col, str *attr);
+int lcache_col_add(struct lcache_col *col, str *attr, int val, int expires,
+		int *new_val);
+void lcache_free_entry(struct lcache_col *col, lcache_entry_t *me);
+
 #endif
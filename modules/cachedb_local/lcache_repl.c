@@ -0,0 +1,333 @@
+/*
+ * cachedb_local replication of the changes in a cluster
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#include "../../dprint.h"
+#include "../../timer.h"
+#include "lcache_repl.h"
+#include "hash.h"
+
+int lcache_repl_cluster = 0;
+str lcache_repl_cap = str_init("cachedb-local-repl");
+struct clusterer_binds clusterer_api;
+
+static void receive_lcache_repl(bin_packet_t *packet);
+static void rcv_lcache_cluster_event(enum clusterer_event ev, int node_id);
+
+
+int lcache_repl_init(void)
+{
+	if (lcache_repl_cluster < 0) {
+		LM_ERR("Invalid cache_replication_cluster, must be 0 or "
+			"a positive cluster id\n");
+		return -1;
+	}
+
+	if (!lcache_repl_cluster)
+		return 0;
+
+	if (load_clusterer_api(&clusterer_api) < 0) {
+		LM_DBG("failed to load clusterer API - is clusterer module loaded?\n");
+		return -1;
+	}
+
+	if (clusterer_api.register_capability(&lcache_repl_cap,
+	        receive_lcache_repl, rcv_lcache_cluster_event, lcache_repl_cluster,
+	        1, NODE_CMP_ANY) < 0) {
+		LM_ERR("Cannot register clusterer callback for cache replication!\n");
+		return -1;
+	}
+
+	if (clusterer_api.request_sync(&lcache_repl_cap, lcache_repl_cluster, 0) < 0)
+		LM_ERR("Sync request failed\n");
+
+	return 0;
+}
+
+
+static void lcache_replicate_packet(bin_packet_t *packet)
+{
+	int rc;
+
+	rc = clusterer_api.send_all(packet, lcache_repl_cluster);
+	switch (rc) {
+	case CLUSTERER_CURR_DISABLED:
+		LM_INFO("Current node is disabled in cluster: %d\n",
+			lcache_repl_cluster);
+		break;
+	case CLUSTERER_DEST_DOWN:
+		LM_INFO("All destinations in cluster: %d are down or probing\n",
+			lcache_repl_cluster);
+		break;
+	case CLUSTERER_SEND_ERR:
+		LM_ERR("Error sending in cluster: %d\n", lcache_repl_cluster);
+		break;
+	}
+
+	bin_free_packet(packet);
+}
+
+
+void replicate_lcache_insert(lcache_col_t *col, str *attr, str *value,
+		int expires)
+{
+	bin_packet_t packet;
+
+	if (bin_init(&packet, &lcache_repl_cap, REPL_LCACHE_INSERT,
+	        LCACHE_BIN_VERSION, 0) != 0) {
+		LM_ERR("failed to replicate the insert of <%.*s>\n",
+			attr->len, attr->s);
+		return;
+	}
+
+	bin_push_str(&packet, &col->col_name);
+	bin_push_str(&packet, attr);
+	bin_push_str(&packet, value);
+	bin_push_int(&packet, expires);
+
+	lcache_replicate_packet(&packet);
+}
+
+
+void replicate_lcache_remove(lcache_col_t *col, str *attr)
+{
+	bin_packet_t packet;
+
+	if (bin_init(&packet, &lcache_repl_cap, REPL_LCACHE_REMOVE,
+	        LCACHE_BIN_VERSION, 0) != 0) {
+		LM_ERR("failed to replicate the removal of <%.*s>\n",
+			attr->len, attr->s);
+		return;
+	}
+
+	bin_push_str(&packet, &col->col_name);
+	bin_push_str(&packet, attr);
+
+	lcache_replicate_packet(&packet);
+}
+
+
+void replicate_lcache_add(lcache_col_t *col, str *attr, int val, int expires)
+{
+	bin_packet_t packet;
+
+	if (bin_init(&packet, &lcache_repl_cap, REPL_LCACHE_ADD,
+	        LCACHE_BIN_VERSION, 0) != 0) {
+		LM_ERR("failed to replicate the update of <%.*s>\n",
+			attr->len, attr->s);
+		return;
+	}
+
+	bin_push_str(&packet, &col->col_name);
+	bin_push_str(&packet, attr);
+	bin_push_int(&packet, val);
+	bin_push_int(&packet, expires);
+
+	lcache_replicate_packet(&packet);
+}
+
+
+void replicate_lcache_remove_chunk(lcache_col_t *col, str *glob)
+{
+	bin_packet_t packet;
+
+	if (bin_init(&packet, &lcache_repl_cap, REPL_LCACHE_REMOVE_CHUNK,
+	        LCACHE_BIN_VERSION, 0) != 0) {
+		LM_ERR("failed to replicate the removal of <%.*s>\n",
+			glob->len, glob->s);
+		return;
+	}
+
+	bin_push_str(&packet, &col->col_name);
+	bin_push_str(&packet, glob);
+
+	lcache_replicate_packet(&packet);
+}
+
+
+static lcache_col_t *lcache_pop_collection(bin_packet_t *packet)
+{
+	lcache_col_t *col;
+	str name;
+
+	if (bin_pop_str(packet, &name) != 0)
+		return NULL;
+
+	col = lcache_get_collection(&name);
+	if (!col)
+		LM_WARN("collection <%.*s> not defined on this node\n",
+			name.len, name.s);
+
+	return col;
+}
+
+
+static int lcache_repl_insert(bin_packet_t *packet)
+{
+	lcache_col_t *col;
+	str attr, value;
+	int expires;
+
+	if (!(col = lcache_pop_collection(packet)))
+		return -1;
+
+	if (bin_pop_str(packet, &attr) != 0 || bin_pop_str(packet, &value) != 0 ||
+	    bin_pop_int(packet, &expires) != 0)
+		return -1;
+
+	return lcache_col_insert(col, &attr, &value, expires) < 0 ? -1 : 0;
+}
+
+
+static int lcache_repl_remove(bin_packet_t *packet)
+{
+	lcache_col_t *col;
+	str attr;
+
+	if (!(col = lcache_pop_collection(packet)))
+		return -1;
+
+	if (bin_pop_str(packet, &attr) != 0)
+		return -1;
+
+	return lcache_col_remove(col, &attr);
+}
+
+
+static int lcache_repl_add(bin_packet_t *packet)
+{
+	lcache_col_t *col;
+	str attr;
+	int val, expires;
+
+	if (!(col = lcache_pop_collection(packet)))
+		return -1;
+
+	if (bin_pop_str(packet, &attr) != 0 || bin_pop_int(packet, &val) != 0 ||
+	    bin_pop_int(packet, &expires) != 0)
+		return -1;
+
+	return lcache_col_add(col, &attr, val, expires, NULL);
+}
+
+
+static int lcache_repl_remove_chunk(bin_packet_t *packet)
+{
+	lcache_col_t *col;
+	str glob;
+
+	if (!(col = lcache_pop_collection(packet)))
+		return -1;
+
+	if (bin_pop_str(packet, &glob) != 0)
+		return -1;
+
+	return lcache_remove_chunk(col, &glob);
+}
+
+
+static void receive_lcache_repl(bin_packet_t *packet)
+{
+	int rc = 0;
+	bin_packet_t *pkt;
+
+	for (pkt = packet; pkt; pkt = pkt->next) {
+		if (pkt->type == SYNC_PACKET_TYPE)
+			_ensure_bin_version(pkt, LCACHE_BIN_VERSION,
+				"cachedb_local sync packet");
+		else
+			ensure_bin_version(pkt, LCACHE_BIN_VERSION);
+
+		switch (pkt->type) {
+		case REPL_LCACHE_INSERT:
+			rc = lcache_repl_insert(pkt);
+			break;
+		case REPL_LCACHE_REMOVE:
+			rc = lcache_repl_remove(pkt);
+			break;
+		case REPL_LCACHE_ADD:
+			rc = lcache_repl_add(pkt);
+			break;
+		case REPL_LCACHE_REMOVE_CHUNK:
+			rc = lcache_repl_remove_chunk(pkt);
+			break;
+		case SYNC_PACKET_TYPE:
+			/* a bad chunk only costs its own entry, the iterator
+			 * jumps to the next chunk on its own */
+			rc = 0;
+			while (clusterer_api.sync_chunk_iter(pkt))
+				if (lcache_repl_insert(pkt) < 0)
+					LM_ERR("failed to process a sync chunk, skipping it\n");
+			break;
+		default:
+			rc = -1;
+			LM_WARN("Invalid cachedb_local binary packet command: %d "
+				"(from node: %d in cluster: %d)\n", pkt->type, pkt->src_id,
+				lcache_repl_cluster);
+		}
+
+		if (rc != 0)
+			LM_ERR("Failed to process a binary packet!\n");
+	}
+}
+
+
+/* sends all the valid entries, with their remaining lifetime */
+static int receive_sync_request(int node_id)
+{
+	lcache_col_t *col;
+	lcache_entry_t *it;
+	bin_packet_t *sync_packet;
+	unsigned int now = get_ticks();
+	int i;
+
+	for (col = lcache_collection; col; col = col->next) {
+		for (i = 0; i < col->size; i++) {
+			lock_get(&col->col_htable[i].lock);
+			for (it = col->col_htable[i].entries; it; it = it->next) {
+				if (it->expires != 0 && it->expires <= now)
+					continue;
+
+				sync_packet = clusterer_api.sync_chunk_start(&lcache_repl_cap,
+				                lcache_repl_cluster, node_id, LCACHE_BIN_VERSION);
+				if (!sync_packet) {
+					lock_release(&col->col_htable[i].lock);
+					return -1;
+				}
+
+				bin_push_str(sync_packet, &col->col_name);
+				bin_push_str(sync_packet, &it->attr);
+				bin_push_str(sync_packet, &it->value);
+				bin_push_int(sync_packet, it->expires ? it->expires - now : 0);
+			}
+			lock_release(&col->col_htable[i].lock);
+		}
+	}
+
+	return 0;
+}
+
+
+static void rcv_lcache_cluster_event(enum clusterer_event ev, int node_id)
+{
+	if (ev == SYNC_REQ_RCV && receive_sync_request(node_id) < 0)
+		LM_ERR("Failed to reply to sync request from node: %d\n", node_id);
+}
@@ -0,0 +1,50 @@
+/*
+ * cachedb_local replication of the changes in a cluster
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#ifndef _LCACHE_REPL_H_
+#define _LCACHE_REPL_H_
+
+#include "../../bin_interface.h"
+#include "../clusterer/api.h"
+#include "cachedb_local.h"
+
+#define LCACHE_BIN_VERSION 1
+
+#define REPL_LCACHE_INSERT       1
+#define REPL_LCACHE_REMOVE       2
+#define REPL_LCACHE_ADD          3
+#define REPL_LCACHE_REMOVE_CHUNK 4
+
+extern int lcache_repl_cluster;
+extern str lcache_repl_cap;
+extern struct clusterer_binds clusterer_api;
+
+/* registers the capability and requests the startup sync, if replicating */
+int lcache_repl_init(void);
+
+void replicate_lcache_insert(lcache_col_t *col, str *attr, str *value,
+		int expires);
+void replicate_lcache_remove(lcache_col_t *col, str *attr);
+void replicate_lcache_add(lcache_col_t *col, str *attr, int val, int expires);
+void replicate_lcache_remove_chunk(lcache_col_t *col, str *glob);
+
+#endif
@@ -36,6 +36,7 @@
 #include "../../dprint.h"
 #include "../../error.h"
 #include "../../pt.h"
+#include "../../script_cb.h"
 #include "../../cachedb/cachedb.h"
 
 #include "cachedb_redis_dbase.h"
@@ -56,6 +57,7 @@ static param_export_t params[]={
 	{ "connect_timeout",             INT_PARAM,                &redis_connnection_tout},
 	{ "query_timeout",               INT_PARAM,                &redis_query_tout      },
 	{ "shutdown_on_error",           INT_PARAM,                &shutdown_on_error     },
+	{ "pipeline_writes",             INT_PARAM,                &pipeline_writes       },
 	{ "cachedb_url",                 STR_PARAM|USE_FUNC_PARAM, (void *)&set_connection},
 	{0,0,0}
 };
@@ -100,6 +102,7 @@ static int mod_init(void)
 	cde.cdb_func.init = redis_init;
 	cde.cdb_func.destroy = redis_destroy;
 	cde.cdb_func.get = redis_get;
+	cde.cdb_func.get_multi = redis_get_multi;
 	cde.cdb_func.get_counter = redis_get_counter;
 	cde.cdb_func.set = redis_set;
 	cde.cdb_func.remove = redis_remove;
@@ -114,6 +117,14 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if (pipeline_writes && (register_script_cb(redis_pipeline_start,
+	        PRE_SCRIPT_CB|REQ_TYPE_CB|RPL_TYPE_CB, 0) < 0 ||
+	    register_script_cb(redis_pipeline_end,
+	        POST_SCRIPT_CB|REQ_TYPE_CB|RPL_TYPE_CB, 0) < 0)) {
+		LM_ERR("failed to register the script callbacks\n");
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -28,9 +28,13 @@
 #include "cachedb_redis_utils.h"
 #include "../../mem/mem.h"
 #include "../../ut.h"
+#include "../../async.h"
+#include "../../script_cb.h"
 #include "../../cachedb/cachedb.h"
 
+#include <errno.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <hiredis/hiredis.h>
 
 #define QUERY_ATTEMPTS 2
@@ -38,6 +42,12 @@
 int redis_query_tout = CACHEDB_REDIS_DEFAULT_TIMEOUT;
 int redis_connnection_tout = CACHEDB_REDIS_DEFAULT_TIMEOUT;
 int shutdown_on_error = 0;
+int pipeline_writes = 0;
+
+/* set while running a route, when the writes are pipelined */
+static int pipelining;
+/* the nodes with pipelined queries to be sent at the end of the route */
+static cluster_node *queued_nodes;
 
 redisContext *redis_get_ctx(char *ip, int port)
 {
@@ -109,17 +119,71 @@ int redis_connect_node(redis_con *con,cluster_node *node)
 	return 0;
 }
 
+static void redis_close_node(cluster_node *node)
+{
+	if (node->listening) {
+		unregister_async_fd(node->context->fd);
+		node->listening = 0;
+	}
+
+	if (node->pending) {
+		LM_WARN("lost the replies of %d pipelined queries to %s:%hu\n",
+			node->pending, node->ip, (unsigned short)node->port);
+		node->pending = 0;
+	}
+
+	redisFree(node->context);
+	node->context = NULL;
+}
+
 int redis_reconnect_node(redis_con *con,cluster_node *node)
 {
 	LM_DBG("reconnecting node %s:%d \n",node->ip,node->port);
 
 	/* close the old connection */
 	if(node->context)
-		redisFree(node->context);
+		redis_close_node(node);
 
 	return redis_connect_node(con,node);
 }
 
+/* reads the replies of the queries pipelined so far on a node */
+static void redis_drain_node(cluster_node *node)
+{
+	redisReply *reply;
+
+	while (node->pending) {
+		if (redisGetReply(node->context, (void **)&reply) != REDIS_OK) {
+			LM_ERR("failed to read pipelined replies from %s:%hu - %s\n",
+				node->ip, (unsigned short)node->port, node->context->errstr);
+			redis_close_node(node);
+			return;
+		}
+
+		node->pending--;
+		if (reply->type == REDIS_REPLY_ERROR)
+			LM_ERR("pipelined query failed: %.*s\n",
+				(unsigned)reply->len, reply->str);
+		freeReplyObject(reply);
+	}
+}
+
+static int redis_write_node(cluster_node *node)
+{
+	int done = 0;
+
+	do {
+		if (redisBufferWrite(node->context, &done) != REDIS_OK) {
+			LM_ERR("failed to send pipelined queries to %s:%hu - %s\n",
+				node->ip, (unsigned short)node->port, node->context->errstr);
+			redis_close_node(node);
+			return -1;
+		}
+	} while (!done);
+
+	return 0;
+}
+
 
 int redis_connect(redis_con *con)
 {
@@ -260,6 +324,159 @@ void redis_destroy(cachedb_con *con) {
 	cachedb_do_close(con,redis_free_connection);
 }
 
+static cluster_node *redis_get_node(redis_con *con, str *key)
+{
+	cluster_node *node;
+
+	if (!(con->flags & REDIS_INIT_NODES) && redis_connect(con) < 0) {
+		LM_ERR("failed to connect to DB\n");
+		return NULL;
+	}
+
+	node = get_redis_connection(con,key);
+	if (node == NULL) {
+		LM_ERR("Bad cluster configuration\n");
+		return NULL;
+	}
+
+	if (node->pending)
+		redis_drain_node(node);
+
+	if (node->context == NULL && redis_reconnect_node(con,node) < 0)
+		return NULL;
+
+	return node;
+}
+
+/*
+ * appends a query whose reply is read later on, along with the next query
+ * on the node or from the reactor; during a route it is only sent at its
+ * end, together with all the other pipelined queries
+ */
+static int redis_append_command(cluster_node *node, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = redisvAppendCommand(node->context, fmt, ap);
+	va_end(ap);
+
+	if (rc != REDIS_OK) {
+		LM_ERR("failed to append query for %s:%hu - %s\n", node->ip,
+			(unsigned short)node->port, node->context->errstr);
+		return -1;
+	}
+	node->pending++;
+
+	if (!pipelining)
+		return redis_write_node(node);
+
+	if (!node->queued) {
+		node->queued = 1;
+		node->next_queued = queued_nodes;
+		queued_nodes = node;
+	}
+
+	return 0;
+}
+
+#define redis_queue_command(con,key,fmt,args...) \
+	do {\
+		con = (redis_con *)connection->data; \
+		node = redis_get_node(con,key); \
+		if (node == NULL || redis_append_command(node,fmt,##args) < 0) \
+			return -1; \
+	} while (0)
+
+static int redis_pipeline_resume(int fd, void *param)
+{
+	cluster_node *node = (cluster_node *)param;
+	redisReply *reply;
+	char c;
+	int n;
+
+	/* the replies may have been read already, along with a sync query */
+	n = recv(fd, &c, 1, MSG_PEEK|MSG_DONTWAIT);
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+		async_status = ASYNC_CONTINUE;
+		return 0;
+	}
+
+	if (n <= 0 || redisBufferRead(node->context) != REDIS_OK)
+		goto closed;
+
+	while (node->pending) {
+		if (redisGetReplyFromReader(node->context, (void **)&reply) != REDIS_OK)
+			goto closed;
+		if (reply == NULL)
+			break;
+
+		node->pending--;
+		if (reply->type == REDIS_REPLY_ERROR)
+			LM_ERR("pipelined query failed: %.*s\n",
+				(unsigned)reply->len, reply->str);
+		freeReplyObject(reply);
+	}
+
+	async_status = ASYNC_CONTINUE;
+	return 0;
+
+closed:
+	LM_INFO("connection to %s:%hu closed\n", node->ip,
+		(unsigned short)node->port);
+	/* the reactor drops the fd by itself */
+	node->listening = 0;
+	redis_close_node(node);
+	async_status = ASYNC_DONE;
+	return -1;
+}
+
+/* sends the queries pipelined during the route, without waiting for them */
+static void redis_pipeline_flush(void)
+{
+	cluster_node *node, *next;
+
+	for (node = queued_nodes; node; node = next) {
+		next = node->next_queued;
+		node->next_queued = NULL;
+		node->queued = 0;
+
+		if (node->context == NULL || redis_write_node(node) < 0)
+			continue;
+
+		if (node->listening)
+			continue;
+
+		if (register_async_fd(node->context->fd, redis_pipeline_resume,
+		        node) < 0) {
+			LM_ERR("failed to add the connection to the reactor\n");
+			redis_drain_node(node);
+			continue;
+		}
+		node->listening = 1;
+	}
+
+	queued_nodes = NULL;
+}
+
+int redis_pipeline_start(struct sip_msg *msg, void *param)
+{
+	/* left over by a route which was suspended */
+	if (queued_nodes)
+		redis_pipeline_flush();
+
+	pipelining = 1;
+	return SCB_RUN_ALL;
+}
+
+int redis_pipeline_end(struct sip_msg *msg, void *param)
+{
+	pipelining = 0;
+	redis_pipeline_flush();
+	return SCB_RUN_ALL;
+}
+
 #define redis_run_command(con,key,fmt,args...) \
 	do {\
 		con = (redis_con *)connection->data; \
@@ -272,6 +489,8 @@ void redis_destroy(cachedb_con *con) {
 			LM_ERR("Bad cluster configuration\n"); \
 			return -10; \
 		} \
+		if (node->pending) \
+			redis_drain_node(node); \
 		if (node->context == NULL) { \
 			if (redis_reconnect_node(con,node) < 0) { \
 				return -1; \
@@ -336,34 +555,136 @@ int redis_get(cachedb_con *connection,str *attr,str *val)
 	return 0;
 }
 
-int redis_set(cachedb_con *connection,str *attr,str *val,int expires)
+/*
+ * all the GET queries are pipelined, then their replies are read in the
+ * same order, so each node is waited for only once; a failed query is
+ * retried alone
+ */
+int redis_get_multi(cachedb_con *connection,str *attrs,str *vals,int n)
 {
 	redis_con *con;
-	cluster_node *node;
+	cluster_node **nodes;
 	redisReply *reply;
-	int i;
+	int i, ret, found = 0, failed = 0;
 
-	if (!attr || !val || !connection) {
+	if (!attrs || !vals || !connection || n < 0) {
 		LM_ERR("null parameter\n");
 		return -1;
 	}
 
-	redis_run_command(con,attr,"SET %b %b",attr->s,attr->len,val->s,val->len);
+	if (n == 0)
+		return 0;
 
-	LM_DBG("set %.*s to %.*s - status = %d - %.*s\n",attr->len,attr->s,val->len,
-			val->s,reply->type,(unsigned)reply->len,reply->str);
+	con = (redis_con *)connection->data;
 
-	freeReplyObject(reply);
+	nodes = pkg_malloc(n * sizeof *nodes);
+	if (nodes == NULL) {
+		LM_ERR("no more pkg\n");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		vals[i].s = NULL;
+		vals[i].len = 0;
+
+		nodes[i] = redis_get_node(con,&attrs[i]);
+		if (nodes[i] && redisAppendCommand(nodes[i]->context,"GET %b",
+		        attrs[i].s,attrs[i].len) != REDIS_OK)
+			nodes[i] = NULL;
+	}
 
-	if (expires) {
-		redis_run_command(con,attr,"EXPIRE %b %d",attr->s,attr->len,expires);
+	for (i = 0; i < n; i++) {
+		if (nodes[i] == NULL)
+			continue;
 
-		LM_DBG("set %.*s to expire in %d s - %.*s\n",attr->len,attr->s,expires,
+		if (redisGetReply(nodes[i]->context,(void **)&reply) != REDIS_OK) {
+			LM_INFO("Redis query failed: %s\n",nodes[i]->context->errstr);
+			nodes[i] = NULL;
+			continue;
+		}
+
+		if (reply->type == REDIS_REPLY_ERROR) {
+			LM_INFO("Redis query failed: %.*s\n",
 				(unsigned)reply->len,reply->str);
+			nodes[i] = NULL;
+		} else if (reply->type != REDIS_REPLY_NIL && reply->str != NULL
+				&& reply->len != 0 && !failed) {
+			vals[i].s = pkg_malloc(reply->len);
+			if (vals[i].s == NULL) {
+				LM_ERR("no more pkg\n");
+				/* the other replies must still be read */
+				failed = 1;
+			} else {
+				memcpy(vals[i].s,reply->str,reply->len);
+				vals[i].len = reply->len;
+				found++;
+			}
+		}
 
 		freeReplyObject(reply);
 	}
 
+	for (i = 0; i < n && !failed; i++) {
+		if (nodes[i])
+			continue;
+
+		ret = redis_get(connection,&attrs[i],&vals[i]);
+		if (ret == 0)
+			found++;
+		else if (ret != -2)
+			failed = 1;
+	}
+
+	pkg_free(nodes);
+
+	if (failed) {
+		for (i = 0; i < n; i++)
+			if (vals[i].s) {
+				pkg_free(vals[i].s);
+				vals[i].s = NULL;
+				vals[i].len = 0;
+			}
+		return -1;
+	}
+
+	LM_DBG("MGET %d keys - %d found\n",n,found);
+	return found;
+}
+
+int redis_set(cachedb_con *connection,str *attr,str *val,int expires)
+{
+	redis_con *con;
+	cluster_node *node;
+	redisReply *reply;
+	int i;
+
+	if (!attr || !val || !connection) {
+		LM_ERR("null parameter\n");
+		return -1;
+	}
+
+	if (pipelining) {
+		if (expires)
+			redis_queue_command(con,attr,"SET %b %b EX %d",attr->s,attr->len,
+				val->s,val->len,expires);
+		else
+			redis_queue_command(con,attr,"SET %b %b",attr->s,attr->len,
+				val->s,val->len);
+		return 0;
+	}
+
+	if (expires)
+		redis_run_command(con,attr,"SET %b %b EX %d",attr->s,attr->len,
+			val->s,val->len,expires);
+	else
+		redis_run_command(con,attr,"SET %b %b",attr->s,attr->len,
+			val->s,val->len);
+
+	LM_DBG("set %.*s to %.*s (expires %d) - status = %d - %.*s\n",attr->len,
+			attr->s,val->len,val->s,expires,reply->type,(unsigned)reply->len,
+			reply->str);
+
+	freeReplyObject(reply);
 	return 0;
 }
 
@@ -382,6 +703,7 @@ int redis_remove(cachedb_con *connection,str *attr)
 		return -1;
 	}
 
+	/* not pipelined, the caller may need to know if the key existed */
 	redis_run_command(con,attr,"DEL %b",attr->s,attr->len);
 
 	if (reply->integer == 0) {
@@ -407,52 +729,41 @@ int redis_add(cachedb_con *connection,str *attr,int val,int expires,int *new_val
 		return -1;
 	}
 
+	/* nobody waits for the new value */
+	if (pipelining && !new_val) {
+		redis_queue_command(con,attr,"INCRBY %b %d",attr->s,attr->len,val);
+		if (expires && redis_append_command(node,"EXPIRE %b %d",
+		        attr->s,attr->len,expires) < 0)
+			return -1;
+		return 0;
+	}
+
 	redis_run_command(con,attr,"INCRBY %b %d",attr->s,attr->len,val);
 
 	if (new_val)
 		*new_val = reply->integer;
 	freeReplyObject(reply);
 
-	if (expires) {
-		redis_run_command(con,attr,"EXPIRE %b %d",attr->s,attr->len,expires);
+	if (!expires)
+		return 0;
 
-		LM_DBG("set %.*s to expire in %d s - %.*s\n",attr->len,attr->s,expires,
-				(unsigned)reply->len,reply->str);
+	/* no need to wait for the expire to be set */
+	if (pipelining)
+		return redis_append_command(node,"EXPIRE %b %d",
+			attr->s,attr->len,expires) < 0 ? -1 : 0;
 
-		freeReplyObject(reply);
-	}
+	redis_run_command(con,attr,"EXPIRE %b %d",attr->s,attr->len,expires);
+
+	LM_DBG("set %.*s to expire in %d s - %.*s\n",attr->len,attr->s,expires,
+			(unsigned)reply->len,reply->str);
 
+	freeReplyObject(reply);
 	return 0;
 }
 
 int redis_sub(cachedb_con *connection,str *attr,int val,int expires,int *new_val)
 {
-	redis_con *con;
-	cluster_node *node;
-	redisReply *reply;
-	int i;
-
-	if (!attr || !connection) {
-		LM_ERR("null parameter\n");
-		return -1;
-	}
-
-	redis_run_command(con,attr,"DECRBY %b %d",attr->s,attr->len,val);
-
-	if (new_val)
-		*new_val = reply->integer;
-	freeReplyObject(reply);
-
-	if (expires) {
-		redis_run_command(con,attr,"EXPIRE %b %d",attr->s,attr->len,expires);
-
-		LM_DBG("set %.*s to expire in %d s - %.*s\n",attr->len,attr->s,expires,
-				(unsigned)reply->len,reply->str);
-
-		freeReplyObject(reply);
-	}
-
-	return 0;
+	return redis_add(connection,attr,-val,expires,new_val);
 }
 
 int redis_get_counter(cachedb_con *connection,str *attr,int *val)
@@ -670,6 +981,9 @@ int redis_raw_query_send(cachedb_con *connection,redisReply **reply,cdb_raw_entr
 		return -10;
 	}
 
+	if (node->pending)
+		redis_drain_node(node);
+
 	if (node->context == NULL) {
 		if (redis_reconnect_node(con,node) < 0) {
 			return -1;
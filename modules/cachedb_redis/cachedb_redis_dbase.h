@@ -28,6 +28,7 @@
 
 #include <hiredis/hiredis.h>
 #include "../../cachedb/cachedb.h"
+#include "../../parser/msg_parser.h"
 
 typedef struct cluster_nodes {
 	char *ip;							/* ip of this cluster node */
@@ -36,6 +37,12 @@ typedef struct cluster_nodes {
 	unsigned short end_slot;		/* last slot for this server */
 
 	redisContext *context;			/* actual connection to this node */
+
+	int pending;					/* pipelined queries, not replied yet */
+	int listening;					/* the connection is in the reactor */
+	int queued;						/* has pipelined queries to be sent */
+	struct cluster_nodes *next_queued;
+
 	struct cluster_nodes *next;
 } cluster_node;
 
@@ -45,6 +52,7 @@ typedef struct cluster_nodes {
 extern int redis_query_tout;
 extern int redis_connnection_tout;
 extern int shutdown_on_error;
+extern int pipeline_writes;
 
 enum redis_flag {
 	REDIS_SINGLE_INSTANCE  = 1 << 0,
@@ -65,6 +73,7 @@ typedef struct {
 cachedb_con* redis_init(str *url);
 void redis_destroy(cachedb_con *con);
 int redis_get(cachedb_con *con,str *attr,str *val);
+int redis_get_multi(cachedb_con *con,str *attrs,str *vals,int n);
 int redis_set(cachedb_con *con,str *attr,str *val,int expires);
 int redis_remove(cachedb_con *con,str *attr);
 int redis_add(cachedb_con *con,str *attr,int val,int expires,int *new_val);
@@ -72,5 +81,8 @@ int redis_sub(cachedb_con *con,str *attr,int val,int expires,int *new_val);
 int redis_get_counter(cachedb_con *connection,str *attr,int *val);
 int redis_raw_query(cachedb_con *connection,str *attr,cdb_raw_entry ***reply,int expected_kv_no,int *reply_no);
 
+int redis_pipeline_start(struct sip_msg *msg, void *param);
+int redis_pipeline_end(struct sip_msg *msg, void *param);
+
 #endif /* CACHEDBREDIS_DBASE_H */
 
@@ -170,6 +170,7 @@ int db_mysql_bind_api(const str* mod, db_func_t *dbb)
 	dbb->replace           = db_mysql_replace;
 	dbb->last_inserted_id  = db_last_inserted_id;
 	dbb->insert_update     = db_insert_update;
+	dbb->insert_update_rows = db_insert_update_rows;
 	dbb->async_raw_query   = db_mysql_async_raw_query;
 	dbb->async_resume      = db_mysql_async_resume;
 	dbb->async_free_result = db_mysql_async_free_result;
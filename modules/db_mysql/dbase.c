@@ -1471,6 +1471,111 @@ error:
 }
 
 
+/**
+  * Insert several rows into a specified table, update on duplicate key.
+  * The rows are packed into as few statements as the query buffer allows.
+  * \param _h structure representing database connection
+  * \param _k key names
+  * \param _v values of the keys, one array for each row
+  * \param _n number of key=value pairs of a row
+  * \param _r number of rows
+  * \return the number of submitted statements, negative on error
+ */
+int db_insert_update_rows(const db_con_t* _h, const db_key_t* _k,
+	db_val_t** _v, const int _n, const int _r)
+{
+	static char sql_buf[SQL_BUF_LEN];
+	static char row_buf[SQL_BUF_LEN];
+	static char upd_buf[SQL_BUF_LEN];
+	int off, head, upd_len, row_len, ret, i, rows, queries = 0;
+	str sql_str;
+
+	if ((!_h) || (!_k) || (!_v) || (!_n) || (_r <= 0)) {
+		LM_ERR("invalid parameter value\n");
+		return -1;
+	}
+
+	CON_RESET_CURR_PS(_h); /* no prepared statements support */
+
+	/* the update part is the same for all statements */
+	ret = snprintf(upd_buf, SQL_BUF_LEN, " on duplicate key update ");
+	if (ret < 0 || ret >= SQL_BUF_LEN) goto error;
+	upd_len = ret;
+
+	for (i = 0; i < _n; i++) {
+		ret = snprintf(upd_buf + upd_len, SQL_BUF_LEN - upd_len,
+			"%s%.*s=values(%.*s)", i ? "," : "",
+			_k[i]->len, _k[i]->s, _k[i]->len, _k[i]->s);
+		if (ret < 0 || ret >= SQL_BUF_LEN - upd_len) goto error;
+		upd_len += ret;
+	}
+
+	ret = snprintf(sql_buf, SQL_BUF_LEN, "insert into %.*s (",
+		CON_TABLE(_h)->len, CON_TABLE(_h)->s);
+	if (ret < 0 || ret >= SQL_BUF_LEN) goto error;
+	head = ret;
+
+	ret = db_print_columns(sql_buf + head, SQL_BUF_LEN - head, _k, _n);
+	if (ret < 0) return -1;
+	head += ret;
+
+	ret = snprintf(sql_buf + head, SQL_BUF_LEN - head, ") values ");
+	if (ret < 0 || ret >= SQL_BUF_LEN - head) goto error;
+	head += ret;
+
+	off = head;
+	rows = 0;
+	for (i = 0; i < _r; i++) {
+		row_buf[0] = '(';
+		ret = db_print_values(_h, row_buf + 1, SQL_BUF_LEN - 2, _v[i], _n,
+			db_mysql_val2str);
+		if (ret < 0) return -1;
+		row_buf[ret + 1] = ')';
+		row_len = ret + 2;
+
+		/* submit what we have so far if this row does not fit anymore */
+		if (off + 1 + row_len + upd_len > SQL_BUF_LEN) {
+			if (rows == 0) {
+				LM_ERR("row %d does not fit into a query\n", i);
+				return -1;
+			}
+
+			memcpy(sql_buf + off, upd_buf, upd_len);
+			sql_str.s = sql_buf;
+			sql_str.len = off + upd_len;
+			if (db_mysql_submit_query(_h, &sql_str) < 0) {
+				LM_ERR("error while submitting query\n");
+				return -2;
+			}
+			queries++;
+
+			off = head;
+			rows = 0;
+		}
+
+		if (rows)
+			sql_buf[off++] = ',';
+		memcpy(sql_buf + off, row_buf, row_len);
+		off += row_len;
+		rows++;
+	}
+
+	memcpy(sql_buf + off, upd_buf, upd_len);
+	sql_str.s = sql_buf;
+	sql_str.len = off + upd_len;
+	if (db_mysql_submit_query(_h, &sql_str) < 0) {
+		LM_ERR("error while submitting query\n");
+		return -2;
+	}
+
+	return queries + 1;
+
+error:
+	LM_ERR("error while preparing insert_update operation\n");
+	return -1;
+}
+
+
 /**
  * Store the name of table that will be used by subsequent database functions
  * \param _h database handle
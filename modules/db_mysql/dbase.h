@@ -137,6 +137,12 @@ int db_mysql_async_free_result(db_con_t *_h, db_res_t *_r, void *_data);
 int db_insert_update(const db_con_t* _h, const db_key_t* _k, const db_val_t* _v,
 	const int _n);
 
+/*
+ * Insert several rows into table, update on duplicate key
+ */
+int db_insert_update_rows(const db_con_t* _h, const db_key_t* _k,
+	db_val_t** _v, const int _n, const int _r);
+
 
 /*
  * Store name of table that will be used by
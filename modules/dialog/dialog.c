@@ -241,6 +241,7 @@ static param_export_t mod_params[]={
 	{ "default_timeout",       INT_PARAM, &default_timeout          },
 	{ "options_ping_interval", INT_PARAM, &options_ping_interval    },
 	{ "reinvite_ping_interval",INT_PARAM, &reinvite_ping_interval   },
+	{ "timer_shards",          INT_PARAM, &dlg_timer_shards         },
 	{ "dlg_extra_hdrs",        STR_PARAM, &dlg_extra_hdrs.s         },
 	{ "dlg_match_mode",        INT_PARAM, &seq_match_mode           },
 	{ "db_url",                STR_PARAM, &db_url.s                 },
@@ -279,6 +280,7 @@ static param_export_t mod_params[]={
 	{ "profile_no_value_prefix", STR_PARAM, &cdb_noval_prefix.s     },
 	{ "profile_size_prefix",     STR_PARAM, &cdb_size_prefix.s      },
 	{ "profile_timeout",         INT_PARAM, &profile_timeout        },
+	{ "approx_profile_size",     INT_PARAM, &approx_profile_size    },
 	/* dialog replication through clusterer using TCP binary packets */
 	{ "dialog_replication_cluster",     INT_PARAM, &dialog_repl_cluster  },
 	{ "profile_replication_cluster",	INT_PARAM, &profile_repl_cluster },
@@ -287,6 +289,9 @@ static param_export_t mod_params[]={
 	{ "replicate_profiles_buffer",INT_PARAM, &repl_prof_buffer_th   },
 	{ "replicate_profiles_expire",INT_PARAM, &repl_prof_timer_expire},
 	{ "dlg_sharing_tag", STR_PARAM|USE_FUNC_PARAM, &dlg_sharing_tag_paramf},
+	/* local snapshot file */
+	{ "persist_file",            STR_PARAM, &dlg_persist_file       },
+	{ "persist_interval",        INT_PARAM, &dlg_persist_interval   },
 	{ 0,0,0 }
 };
 
@@ -739,6 +744,7 @@ static void ctx_dlg_idx_destroy(void *v)
 static int mod_init(void)
 {
 	unsigned int n;
+	int i;
 
 	LM_INFO("Dialog module - initializing\n");
 
@@ -800,6 +806,11 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if (dlg_timer_shards<=0) {
+		LM_ERR("Non-positive number of timer shards not accepted!!\n");
+		return -1;
+	}
+
 	/* update the len of the extra headers */
 	if (dlg_extra_hdrs.s)
 		dlg_extra_hdrs.len = strlen(dlg_extra_hdrs.s);
@@ -929,22 +940,27 @@ static int mod_init(void)
 		}
 	}
 
-	if ( register_timer( "dlg-timer", dlg_timer_routine, NULL, 1,
-	TIMER_FLAG_DELAY_ON_DELAY)<0 ) {
-		LM_ERR("failed to register timer\n");
-		return -1;
-	}
+	/* one timer job per shard, so the shards get expired in parallel */
+	for (i = 0; i < dlg_timer_shards; i++) {
+		if ( register_timer( "dlg-timer", dlg_timer_routine, (void*)(long)i,
+		1, TIMER_FLAG_DELAY_ON_DELAY)<0 ) {
+			LM_ERR("failed to register timer\n");
+			return -1;
+		}
 
-	if ( register_timer( "dlg-options-pinger", dlg_options_routine, NULL,
-	1 /* check every second if we need to ping */, TIMER_FLAG_DELAY_ON_DELAY)<0) {
-		LM_ERR("failed to register timer 2\n");
-		return -1;
-	}
+		if ( register_timer( "dlg-options-pinger", dlg_options_routine,
+		(void*)(long)i, 1 /* check every second if we need to ping */,
+		TIMER_FLAG_DELAY_ON_DELAY)<0) {
+			LM_ERR("failed to register timer 2\n");
+			return -1;
+		}
 
-	if ( register_timer( "dlg-reinvite-pinger", dlg_reinvite_routine, NULL,
-	1 /* check every second if we need to ping */, TIMER_FLAG_DELAY_ON_DELAY)<0) {
-		LM_ERR("failed to register timer 2\n");
-		return -1;
+		if ( register_timer( "dlg-reinvite-pinger", dlg_reinvite_routine,
+		(void*)(long)i, 1 /* check every second if we need to ping */,
+		TIMER_FLAG_DELAY_ON_DELAY)<0) {
+			LM_ERR("failed to register timer 2\n");
+			return -1;
+		}
 	}
 
 	/* init handlers */
@@ -1008,6 +1024,18 @@ static int mod_init(void)
 		}
 	}
 
+	if (dlg_persist_file) {
+		if (dlg_db_mode != DB_MODE_NONE) {
+			LM_ERR("persist_file cannot be used along with db_mode %d\n",
+				dlg_db_mode);
+			return -1;
+		}
+		if (dlg_persist_init() < 0) {
+			LM_ERR("failed to initialize the file persistence\n");
+			return -1;
+		}
+	}
+
 	destroy_cachedb(0);
 	
 	return 0;
@@ -1020,6 +1048,11 @@ static void rpc_load_dlg_db(int sender, void *param)
 	load_dlg_db(dlg_hash_size);
 }
 
+static void rpc_load_dlg_file(int sender, void *param)
+{
+	dlg_persist_load();
+}
+
 static int child_init(int rank)
 {
 	if ( (dlg_db_mode==DB_MODE_REALTIME || dlg_db_mode==DB_MODE_DELAYED ) &&
@@ -1034,6 +1067,12 @@ static int child_init(int rank)
 		}
 	}
 
+	if (dlg_persist_file && rank == 1 &&
+	    ipc_dispatch_rpc(rpc_load_dlg_file, NULL) < 0) {
+		LM_CRIT("failed to RPC the dialogs loading\n");
+		return -1;
+	}
+
 	if (cdb_url.s && cdb_url.len && init_cachedb() < 0) {
 		LM_ERR("cannot init cachedb feature\n");
 		return -1;
@@ -1055,6 +1094,8 @@ static void mod_destroy(void)
 		}
 	}
 
+	dlg_persist_destroy();
+
 	if (shtags_list) {
 		if (*shtags_list) {
 			for (tag = *shtags_list; tag; ) {
@@ -1930,7 +1971,7 @@ int pv_set_dlg_timeout(struct sip_msg *msg, pv_param_t *param,
 
 		if (db_update)
 			update_dialog_timeout_info(dlg);
-		if (dialog_repl_cluster)
+		if (dlg_repl_changes())
 			replicate_dialog_updated(dlg);
 
 		}
@@ -492,7 +492,7 @@ static void dlg_onreply(struct cell* t, int type, struct tmcb_params *param)
 		return;
 	}
 	if (type==TMCB_RESPONSE_OUT) {
-		if (dlg->state == DLG_STATE_CONFIRMED_NA && dialog_repl_cluster &&
+		if (dlg->state == DLG_STATE_CONFIRMED_NA && dlg_repl_changes() &&
 			param->code >= 200 && param->code < 300)
 			replicate_dialog_created(dlg);
 		return;
@@ -1452,7 +1452,7 @@ int dlg_create_dialog(struct cell* t, struct sip_msg *req,unsigned int flags)
 	types = TMCB_RESPONSE_PRE_OUT|TMCB_RESPONSE_FWDED|TMCB_TRANS_CANCELLED;
 	/* replicate dialogs after the 200 OK was fwded - speed & after all msg
 	 * processing was done ( eg. ACC ) */
-	if (dialog_repl_cluster)
+	if (dlg_repl_changes())
 		types |= TMCB_RESPONSE_OUT;
 
 	if ( d_tmb.register_tmcb( req, t,types,dlg_onreply,
@@ -1932,7 +1932,7 @@ after_unlock5:
 				if (dlg_db_mode==DB_MODE_REALTIME)
 					update_dialog_dbinfo(dlg);
 
-				if (dialog_repl_cluster)
+				if (dlg_repl_changes())
 					replicate_dialog_updated(dlg);
 			}
 		} else {
@@ -2046,7 +2046,7 @@ early_check:
 		if (dlg_db_mode == DB_MODE_REALTIME)
 			update_dialog_dbinfo(dlg);
 
-		if (dialog_repl_cluster && is_active)
+		if (dlg_repl_changes() && is_active)
 			replicate_dialog_updated(dlg);
 
 		if (dlg->flags & DLG_FLAG_PING_CALLER ||
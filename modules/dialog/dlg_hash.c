@@ -155,14 +155,9 @@ int init_dlg_table(unsigned int size)
 
 	n = (size<MAX_LDG_LOCKS)?size:MAX_LDG_LOCKS;
 	for(  ; n>=MIN_LDG_LOCKS ; n-- ) {
-		d_table->locks = lock_set_alloc(n);
+		d_table->locks = lock_init_rw_set(n);
 		if (d_table->locks==0)
 			continue;
-		if (lock_set_init(d_table->locks)==0) {
-			lock_set_dealloc(d_table->locks);
-			d_table->locks = 0;
-			continue;
-		}
 		d_table->locks_no = n;
 		break;
 	}
@@ -281,10 +276,8 @@ void destroy_dlg_table(void)
 	if (d_table==0)
 		return;
 
-	if (d_table->locks) {
-		lock_set_destroy(d_table->locks);
-		lock_set_dealloc(d_table->locks);
-	}
+	if (d_table->locks)
+		lock_destroy_rw_set(d_table->locks);
 
 	for( i=0 ; i<d_table->size; i++ ) {
 		dlg = d_table->entries[i].first;
@@ -667,23 +660,22 @@ struct dlg_cell* lookup_dlg( unsigned int h_entry, unsigned int h_id)
 
 	d_entry = &(d_table->entries[h_entry]);
 
-	dlg_lock( d_table, d_entry);
+	dlg_lock_read( d_table, d_entry);
 
 	for( dlg=d_entry->first ; dlg ; dlg=dlg->next ) {
 		if (dlg->h_id == h_id) {
 			if (dlg->state==DLG_STATE_DELETED) {
-				dlg_unlock( d_table, d_entry);
+				dlg_unlock_read( d_table, d_entry);
 				goto not_found;
 			}
-			DBG_REF(dlg, 1);
-			dlg->ref++;
-			dlg_unlock( d_table, d_entry);
+			ref_dlg_shared(dlg, 1);
+			dlg_unlock_read( d_table, d_entry);
 			LM_DBG("dialog id=%u found on entry %u\n", h_id, h_entry);
 			return dlg;
 		}
 	}
 
-	dlg_unlock( d_table, d_entry);
+	dlg_unlock_read( d_table, d_entry);
 not_found:
 	LM_DBG("no dialog id=%u found on entry %u\n", h_id, h_entry);
 	return 0;
@@ -706,7 +698,7 @@ struct dlg_cell* get_dlg( str *callid, str *ftag, str *ttag,
 	h_entry = dlg_hash(callid);
 	d_entry = &(d_table->entries[h_entry]);
 
-	dlg_lock( d_table, d_entry);
+	dlg_lock_read( d_table, d_entry);
 
 	LM_DBG("input ci=<%.*s>(%d), tt=<%.*s>(%d), ft=<%.*s>(%d)\n",
 		callid->len,callid->s, callid->len,
@@ -733,16 +725,15 @@ struct dlg_cell* get_dlg( str *callid, str *ftag, str *ttag,
 				   with the same callid and fromtag - like in auth/challenge
 				   case -bogdan */
 				continue;
-			DBG_REF(dlg, 1);
-			dlg->ref++;
-			dlg_unlock( d_table, d_entry);
+			ref_dlg_shared(dlg, 1);
+			dlg_unlock_read( d_table, d_entry);
 			LM_DBG("dialog callid='%.*s' found\n on entry %u, dir=%d\n",
 				callid->len, callid->s,h_entry,*dir);
 			return dlg;
 		}
 	}
 
-	dlg_unlock( d_table, d_entry);
+	dlg_unlock_read( d_table, d_entry);
 
 	LM_DBG("no dialog callid='%.*s' found\n", callid->len, callid->s);
 	return 0;
@@ -759,7 +750,7 @@ struct dlg_cell* get_dlg_by_val(str *attr, str *val)
 	for ( h=0 ; h<d_table->size ; h++ ) {
 
 		d_entry = &(d_table->entries[h]);
-		dlg_lock( d_table, d_entry);
+		dlg_lock_read( d_table, d_entry);
 
 		/* go through all dialogs on entry */
 		for( dlg = d_entry->first ; dlg ; dlg = dlg->next ) {
@@ -767,13 +758,13 @@ struct dlg_cell* get_dlg_by_val(str *attr, str *val)
 			if ( dlg->state>DLG_STATE_CONFIRMED )
 				continue;
 			if (check_dlg_value_unsafe( dlg, attr, val)==0) {
-				ref_dlg_unsafe( dlg, 1);
-				dlg_unlock( d_table, d_entry);
+				ref_dlg_shared( dlg, 1);
+				dlg_unlock_read( d_table, d_entry);
 				return dlg;
 			}
 		}
 
-		dlg_unlock( d_table, d_entry);
+		dlg_unlock_read( d_table, d_entry);
 	}
 
 	return NULL;
@@ -789,7 +780,7 @@ struct dlg_cell* get_dlg_by_callid( str *callid)
 	h_entry = dlg_hash(callid);
 	d_entry = &(d_table->entries[h_entry]);
 
-	dlg_lock( d_table, d_entry);
+	dlg_lock_read( d_table, d_entry);
 
 	LM_DBG("input ci=<%.*s>(%d)\n", callid->len,callid->s, callid->len);
 
@@ -798,13 +789,13 @@ struct dlg_cell* get_dlg_by_callid( str *callid)
 			continue;
 		if ( dlg->callid.len==callid->len &&
 		strncmp( dlg->callid.s, callid->s, callid->len)==0 ) {
-			ref_dlg_unsafe( dlg, 1);
-			dlg_unlock( d_table, d_entry);
+			ref_dlg_shared( dlg, 1);
+			dlg_unlock_read( d_table, d_entry);
 			return dlg;
 		}
 	}
 
-	dlg_unlock( d_table, d_entry);
+	dlg_unlock_read( d_table, d_entry);
 	return NULL;
 }
 
@@ -844,6 +835,7 @@ void unlink_unsafe_dlg(struct dlg_entry *d_entry,
 
 	dlg->next = dlg->prev = 0;
 	d_entry->cnt--;
+	d_entry->gen++;
 
 	return;
 }
@@ -1162,7 +1154,7 @@ void next_state_dlg(struct dlg_cell *dlg, int event, int dir, int *old_state,
 		raise_state_changed_event(dlg, (unsigned int)(*old_state),
 			(unsigned int)(*new_state));
 
-	 if (dialog_repl_cluster && replicate_events &&
+	 if (dlg_repl_changes() && replicate_events &&
 	(*old_state==DLG_STATE_CONFIRMED_NA || *old_state==DLG_STATE_CONFIRMED) &&
 	*new_state==DLG_STATE_DELETED )
 		replicate_dialog_deleted(dlg);
@@ -1422,10 +1414,12 @@ int mi_print_dlg(struct mi_node *rpl, struct dlg_cell *dlg, int with_context)
 static int internal_mi_print_dlgs(struct mi_root *rpl_tree,struct mi_node *rpl,
 						int with_context, unsigned int idx, unsigned int cnt)
 {
-	struct dlg_cell *dlg;
-	unsigned int i;
-	unsigned int n;
+	struct dlg_cell *dlg, *it;
+	struct dlg_entry *d_entry;
+	unsigned int i, j;
+	unsigned int n, pos;
 	unsigned int total;
+	unsigned int gen;
 	char *p;
 
 	total = 0;
@@ -1440,26 +1434,56 @@ static int internal_mi_print_dlgs(struct mi_root *rpl_tree,struct mi_node *rpl,
 	rpl->flags |= MI_NOT_COMPLETED;
 
 	for( i=0,n=0 ; i<d_table->size ; i++ ) {
-		dlg_lock( d_table, &(d_table->entries[i]) );
+		d_entry = &(d_table->entries[i]);
+		dlg_lock_read( d_table, d_entry);
 
-		for( dlg=d_table->entries[i].first ; dlg ; dlg=dlg->next ) {
-			if (cnt && n<idx) {n++;continue;}
+		dlg = d_entry->first;
+		pos = 0;
+		while (dlg) {
+			if (cnt && n<idx) {
+				n++;
+				dlg = dlg->next;
+				pos++;
+				continue;
+			}
 			if (internal_mi_print_dlg(rpl, dlg, with_context)!=0)
 				goto error;
 			n++;
 			if (cnt && n>=idx+cnt) {
-				dlg_unlock( d_table, &(d_table->entries[i]) );
+				dlg_unlock_read( d_table, d_entry);
 				return 0;
 			}
-			if ( (n % 50) == 0 )
+			if ( (n % 50) == 0 ) {
+				/* do not hold the entry while writing out the reply */
+				gen = d_entry->gen;
+				dlg_unlock_read( d_table, d_entry);
 				flush_mi_tree(rpl_tree);
+				dlg_lock_read( d_table, d_entry);
+
+				/* the list changed meanwhile -> go on right after the last
+				 * printed dialog, if still there (only compared, it may be
+				 * freed by now); if it ended too, go on from its position,
+				 * so the rest of the entry may be listed approximately */
+				if (d_entry->gen != gen) {
+					for( it=d_entry->first,j=0 ; it && it!=dlg ;
+						it=it->next,j++ );
+					if (!it) {
+						for( dlg=d_entry->first,j=0 ; dlg && j<pos ;
+							dlg=dlg->next,j++ );
+						continue;
+					}
+					pos = j;
+				}
+			}
+			dlg = dlg->next;
+			pos++;
 		}
-		dlg_unlock( d_table, &(d_table->entries[i]) );
+		dlg_unlock_read( d_table, d_entry);
 	}
 	return 0;
 
 error:
-	dlg_unlock( d_table, &(d_table->entries[i]) );
+	dlg_unlock_read( d_table, d_entry);
 	LM_ERR("failed to print dialog\n");
 	return -1;
 }
@@ -1529,7 +1553,7 @@ static inline struct mi_root* process_mi_params(struct mi_root *cmd_tree,
 	h_entry = dlg_hash( p1/*callid*/ );
 
 	d_entry = &(d_table->entries[h_entry]);
-	dlg_lock( d_table, d_entry);
+	dlg_lock_read( d_table, d_entry);
 
 	for( dlg = d_entry->first ; dlg ; dlg = dlg->next ) {
 		if (match_downstream_dialog( dlg, p1/*callid*/, p2/*from_tag*/)==1) {
@@ -1542,7 +1566,7 @@ static inline struct mi_root* process_mi_params(struct mi_root *cmd_tree,
 			}
 		}
 	}
-	dlg_unlock( d_table, d_entry);
+	dlg_unlock_read( d_table, d_entry);
 
 	return init_mi_tree( 404, MI_SSTR("No such dialog"));
 }
@@ -1574,13 +1598,13 @@ struct mi_root * mi_print_dlgs(struct mi_root *cmd_tree, void *param )
 		if ( internal_mi_print_dlg(rpl,dlg,0)!=0 )
 			goto error;
 		/* done with the dialog -> unlock it */
-		dlg_unlock_dlg(dlg);
+		dlg_unlock_read( d_table, &(d_table->entries[dlg->h_entry]));
 	}
 
 	return rpl_tree;
 error:
 	/* if a dialog ref was returned, unlock it now */
-	if (dlg) dlg_unlock_dlg(dlg);
+	if (dlg) dlg_unlock_read( d_table, &(d_table->entries[dlg->h_entry]));
 	/* trash everything that was built so far */
 	if (rpl_tree) free_mi_tree(rpl_tree);
 	return NULL;
@@ -1613,13 +1637,13 @@ struct mi_root * mi_print_dlgs_ctx(struct mi_root *cmd_tree, void *param )
 		if ( internal_mi_print_dlg(rpl,dlg,1)!=0 )
 			goto error;
 		/* done with the dialog -> unlock it */
-		dlg_unlock_dlg(dlg);
+		dlg_unlock_read( d_table, &(d_table->entries[dlg->h_entry]));
 	}
 
 	return rpl_tree;
 error:
 	/* if a dialog ref was returned, unlock it now */
-	if (dlg) dlg_unlock_dlg(dlg);
+	if (dlg) dlg_unlock_read( d_table, &(d_table->entries[dlg->h_entry]));
 	/* trash everything that was built so far */
 	if (rpl_tree) free_mi_tree(rpl_tree);
 	return NULL;
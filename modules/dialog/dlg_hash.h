@@ -40,6 +40,7 @@
 #define _DIALOG_DLG_HASH_H_
 
 #include "../../locking.h"
+#include "../../rw_locking.h"
 #include "../../context.h"
 #include "../../mi/mi.h"
 #include "../../lib/dbg/struct_hist.h"
@@ -176,6 +177,9 @@ struct dlg_entry
 	unsigned int        next_id;
 	unsigned int        cnt;
 	unsigned int        lock_idx;
+	/* increased on each link/unlink, so readers may drop the lock and
+	 * later tell whether their position in the list is still valid */
+	unsigned int        gen;
 };
 
 
@@ -185,7 +189,7 @@ struct dlg_table
 	unsigned int       size;
 	struct dlg_entry   *entries;
 	unsigned int       locks_no;
-	gen_lock_set_t     *locks;
+	rw_lock_set_t      *locks;
 };
 
 extern stat_var *active_dlgs;
@@ -210,9 +214,16 @@ struct dlg_cell *get_current_dialog();
 #define dlg_hash(_callid) core_hash(_callid, 0, d_table->size)
 
 #define dlg_lock(_table, _entry) \
-		lock_set_get( (_table)->locks, (_entry)->lock_idx);
+		lock_set_start_write( (_table)->locks, (_entry)->lock_idx)
 #define dlg_unlock(_table, _entry) \
-		lock_set_release( (_table)->locks, (_entry)->lock_idx);
+		lock_set_stop_write( (_table)->locks, (_entry)->lock_idx)
+
+/* shared access, for the lookups only reading the entry (and refs taken
+ * with ref_dlg_shared()) */
+#define dlg_lock_read(_table, _entry) \
+		lock_set_start_read( (_table)->locks, (_entry)->lock_idx)
+#define dlg_unlock_read(_table, _entry) \
+		lock_set_stop_read( (_table)->locks, (_entry)->lock_idx)
 
 #define dlg_leg_print_info(_dlg, _leg, _field) \
 	((_dlg)->legs_no[DLG_LEGS_USED]>_leg)?(_dlg)->legs[_leg]._field.len:4, \
@@ -297,6 +308,13 @@ void destroy_dlg(struct dlg_cell *dlg);
 		(_dlg)->ref += (_cnt); \
 	}while(0)
 
+/* ref under a shared entry lock, concurrent with other readers */
+#define ref_dlg_shared(_dlg,_cnt)     \
+	do { \
+		DBG_REF(_dlg, _cnt); \
+		__sync_add_and_fetch(&(_dlg)->ref, (_cnt)); \
+	}while(0)
+
 #define unref_dlg_unsafe(_dlg,_cnt,_d_entry)   \
 	do { \
 		DBG_UNREF(_dlg, _cnt); \
@@ -405,6 +423,7 @@ void link_dlg(struct dlg_cell *dlg, int extra_refs);
 		DBG_REF(dlg, 1); \
 		dlg->ref++; \
 		d_entry->cnt++; \
+		d_entry->gen++; \
 	} while (0)
 
 #define link_dlg_unsafe(d_entry, dlg) \
@@ -0,0 +1,162 @@
+/*
+ * Dialog persistence to a local snapshot file
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#include "../../bin_persist.h"
+#include "../../dprint.h"
+#include "../../timer.h"
+#include "dlg_hash.h"
+#include "dlg_replication.h"
+#include "dlg_persist.h"
+
+char *dlg_persist_file;
+int dlg_persist_interval = 60;
+
+static bin_persist_t *dlg_bp;
+
+
+static int dlg_persist_apply(bin_packet_t *packet, void *param)
+{
+	str cap;
+
+	bin_get_capability(packet, &cap);
+	if (str_strcmp(&cap, &dlg_repl_cap) != 0 ||
+	    get_bin_pkg_version(packet) != BIN_VERSION) {
+		LM_INFO("discarding packet type %d, ver %d: need ver %d\n",
+		        packet->type, get_bin_pkg_version(packet), BIN_VERSION);
+		return -1;
+	}
+
+	switch (packet->type) {
+	case REPLICATION_DLG_CREATED:
+		return dlg_replicated_create(packet, NULL, NULL, NULL, 1);
+	case REPLICATION_DLG_UPDATED:
+		return dlg_replicated_update(packet);
+	case REPLICATION_DLG_DELETED:
+		return dlg_replicated_delete(packet);
+	case REPLICATION_DLG_CSEQ:
+		return dlg_replicated_cseq_updated(packet);
+	default:
+		LM_WARN("unexpected dialog packet type %d\n", packet->type);
+		return -1;
+	}
+}
+
+
+/* the confirmed dialogs, as created ones, all hash entries locked in turn */
+static int dlg_persist_dump(bin_persist_t *bp, void *param)
+{
+	bin_packet_t packet;
+	struct dlg_cell *dlg;
+	unsigned long dlgs = 0;
+	int i, rc = -1;
+
+	if (bin_init(&packet, &dlg_repl_cap, REPLICATION_DLG_CREATED,
+	             BIN_VERSION, 0) != 0)
+		return -1;
+
+	for (i = 0; i < d_table->size; i++) {
+		dlg_lock(d_table, &(d_table->entries[i]));
+		for (dlg = d_table->entries[i].first; dlg; dlg = dlg->next) {
+			if (dlg->state != DLG_STATE_CONFIRMED_NA &&
+			        dlg->state != DLG_STATE_CONFIRMED)
+				continue;
+
+			bin_reset_back_pointer(&packet);
+			bin_push_dlg(&packet, dlg);
+			if (bin_persist_write(bp, &packet) < 0)
+				goto error_unlock;
+			dlgs++;
+		}
+		dlg_unlock(d_table, &(d_table->entries[i]));
+	}
+
+	LM_DBG("dumped %lu dialogs\n", dlgs);
+	rc = 0;
+	goto out;
+
+error_unlock:
+	dlg_unlock(d_table, &(d_table->entries[i]));
+out:
+	bin_free_packet(&packet);
+	return rc;
+}
+
+
+static void dlg_persist_timer(unsigned int ticks, void *param)
+{
+	if (bin_persist_snapshot(dlg_bp, dlg_persist_dump, NULL) < 0)
+		LM_ERR("failed to write the dialogs snapshot\n");
+}
+
+
+int dlg_persist_init(void)
+{
+	if (dlg_persist_interval <= 0) {
+		LM_ERR("invalid persist_interval %d, must be positive\n",
+		       dlg_persist_interval);
+		return -1;
+	}
+
+	dlg_bp = bin_persist_init(dlg_persist_file);
+	if (!dlg_bp) {
+		LM_ERR("failed to init the persistence to %s\n", dlg_persist_file);
+		return -1;
+	}
+
+	if (register_timer("dlg-persist", dlg_persist_timer, NULL,
+	    dlg_persist_interval, TIMER_FLAG_SKIP_ON_DELAY) < 0) {
+		LM_ERR("failed to register the snapshot timer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void dlg_persist_destroy(void)
+{
+	bin_persist_destroy(dlg_bp);
+	dlg_bp = NULL;
+}
+
+
+void dlg_persist_load(void)
+{
+	utime_t start = get_uticks();
+	int n;
+
+	n = bin_persist_load(dlg_bp, dlg_persist_apply, NULL);
+	if (n < 0) {
+		LM_ERR("failed to load the dialogs from %s\n", dlg_persist_file);
+		return;
+	}
+
+	LM_INFO("loaded %d dialog changes from %s in %llu ms\n", n,
+		dlg_persist_file, (unsigned long long)(get_uticks() - start) / 1000);
+}
+
+
+void dlg_persist_journal(bin_packet_t *packet)
+{
+	if (dlg_bp && bin_persist_journal(dlg_bp, packet) < 0)
+		LM_ERR("failed to journal a dialog change\n");
+}
@@ -0,0 +1,40 @@
+/*
+ * Dialog persistence to a local snapshot file
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#ifndef _DIALOG_DLG_PERSIST_H_
+#define _DIALOG_DLG_PERSIST_H_
+
+#include "../../bin_interface.h"
+
+extern char *dlg_persist_file;
+extern int dlg_persist_interval;
+
+int dlg_persist_init(void);
+void dlg_persist_destroy(void);
+
+/* loads the snapshot and the journal; to be run in a single process */
+void dlg_persist_load(void);
+
+/* appends a dialog change, in its replication format, to the journal */
+void dlg_persist_journal(bin_packet_t *packet);
+
+#endif /* _DIALOG_DLG_PERSIST_H_ */
@@ -64,6 +64,131 @@ str dlg_prof_size_buf = {0, 0};
 /* TODO if needed to change the separator */
 str dlg_prof_sep = str_init("_");
 
+/* sum up the lock-free counters once, without waiting for them to settle */
+int approx_profile_size = 0;
+
+/* how many times an exact read sums up the shards, at most */
+#define PROF_COUNTER_MAX_READS 8
+
+static inline void prof_counter_add(struct dlg_profile_table *profile, long n)
+{
+	__sync_add_and_fetch(
+		&profile->local_count[process_no % PROF_COUNTER_SHARDS].n, n);
+}
+
+static inline long prof_shards_sum(struct prof_counter_shard *shards,
+		int no)
+{
+	long n = 0;
+	int i;
+
+	for (i = 0; i < no; i++)
+		n += shards[i].n;
+
+	return n;
+}
+
+/*
+ * a dialog may be counted on a shard and uncounted on another one, so a
+ * single pass may see only one of the two; unless approx_profile_size is
+ * set, the shards are summed up until two consecutive passes agree, but at
+ * most PROF_COUNTER_MAX_READS times. Either way, the result is best-effort:
+ * the counters keep changing while being read, so it is not a snapshot
+ * of the profile at any given moment
+ */
+static unsigned int prof_shards_get(struct prof_counter_shard *shards,
+		int no)
+{
+	long n, prev;
+	int i;
+
+	n = prof_shards_sum(shards, no);
+	if (!approx_profile_size)
+		for (i = 1; i < PROF_COUNTER_MAX_READS; i++) {
+			prev = n;
+			n = prof_shards_sum(shards, no);
+			if (n == prev)
+				break;
+		}
+
+	return n < 0 ? 0 : (unsigned int)n;
+}
+
+#define prof_counter_get(_profile) \
+	prof_shards_get((_profile)->local_count, PROF_COUNTER_SHARDS)
+
+/* FNV-1a hash of a profile value, never 0 (the mark of an unused counter) */
+static inline unsigned long prof_value_key(str *value)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	int i;
+
+	for (i = 0; i < value->len; i++) {
+		h ^= (unsigned char)value->s[i];
+		h *= 1099511628211ULL;
+	}
+
+	return (unsigned long)h ? (unsigned long)h : 1;
+}
+
+/* the counter of a value, if counted; needs no lock */
+static inline struct prof_value_counter *prof_value_find(
+		struct dlg_profile_table *profile, unsigned int hash,
+		unsigned long key)
+{
+	struct prof_value_counter *vc;
+
+	for (vc = profile->value_counters[hash]; vc; vc = vc->next)
+		if (vc->key == key)
+			return vc;
+
+	return NULL;
+}
+
+/* the counter of a value, taking an unused (or a new) one if the value is
+ * not counted yet; to be called under the bucket lock */
+static struct prof_value_counter *prof_value_get(
+		struct dlg_profile_table *profile, unsigned int hash,
+		unsigned long key)
+{
+	struct prof_value_counter *vc;
+	int i;
+
+	if ((vc = prof_value_find(profile, hash, key)))
+		return vc;
+
+	for (vc = profile->value_counters[hash]; vc && vc->key; vc = vc->next) ;
+
+	if (vc) {
+		/* the previous value may be uncounted on other shards than the
+		 * ones it was counted on */
+		for (i = 0; i < PROF_VALUE_SHARDS; i++)
+			vc->shards[i].n = 0;
+		__sync_synchronize();
+		vc->key = key;
+		return vc;
+	}
+
+	vc = shm_malloc(sizeof *vc);
+	if (!vc) {
+		LM_ERR("no more shm mem\n");
+		return NULL;
+	}
+	memset(vc, 0, sizeof *vc);
+	vc->key = key;
+	vc->next = profile->value_counters[hash];
+
+	/* the readers may walk the list at any time */
+	__sync_synchronize();
+	profile->value_counters[hash] = vc;
+
+	return vc;
+}
+
+#define prof_value_add(_vc, _n) \
+	__sync_add_and_fetch( \
+		&(_vc)->shards[process_no % PROF_VALUE_SHARDS].n, (_n))
+
 /* method that tries to get a new lock_set, if one cannot be allocated
  * an older one is reused */
 static gen_lock_set_t * get_a_lock_set(int no )
@@ -478,6 +603,31 @@ static struct dlg_profile_table* new_dlg_profile( str *name, unsigned int size,
 	if (!has_value)
 		profile->noval_rcv_counters = repl_prof_allocate();
 
+	if (repl_type != REPL_CACHEDB) {
+		profile->local_count = shm_malloc(PROF_COUNTER_SHARDS *
+			sizeof *profile->local_count);
+		if (!profile->local_count) {
+			LM_ERR("no more shm mem\n");
+			shm_free(profile);
+			return NULL;
+		}
+		memset(profile->local_count, 0,
+			PROF_COUNTER_SHARDS * sizeof *profile->local_count);
+	}
+
+	if (repl_type != REPL_CACHEDB && has_value) {
+		profile->value_counters = shm_malloc(size *
+			sizeof *profile->value_counters);
+		if (!profile->value_counters) {
+			LM_ERR("no more shm mem\n");
+			shm_free(profile->local_count);
+			shm_free(profile);
+			return NULL;
+		}
+		memset((void *)profile->value_counters, 0,
+			size * sizeof *profile->value_counters);
+	}
+
 	profile->size = size;
 	profile->has_value = (has_value==0)?0:1;
 	profile->repl_type = repl_type;
@@ -534,6 +684,7 @@ static struct dlg_profile_table* new_dlg_profile( str *name, unsigned int size,
 
 static void destroy_dlg_profile(struct dlg_profile_table *profile)
 {
+	struct prof_value_counter *vc;
 	int i;
 
 	if (profile==NULL)
@@ -544,6 +695,17 @@ static void destroy_dlg_profile(struct dlg_profile_table *profile)
 			map_destroy( profile->entries[i], free_profile_val);
 	}
 
+	if (profile->value_counters) {
+		for (i = 0; i < profile->size; i++)
+			while ((vc = profile->value_counters[i])) {
+				profile->value_counters[i] = vc->next;
+				shm_free(vc);
+			}
+		shm_free((void *)profile->value_counters);
+	}
+
+	if (profile->local_count)
+		shm_free(profile->local_count);
 	shm_free( profile );
 	return;
 }
@@ -649,8 +811,11 @@ static void destroy_linker(struct dlg_profile_link *l, struct dlg_cell *dlg,
 	str shtag = {0,0};
 	int prev_locked_by;
 	int repl_remove = 0;
+	struct prof_value_counter *vc;
 
-	if (!(l->profile->repl_type==REPL_CACHEDB)) {
+	if (!l->profile->has_value && prof_counted_lockless(l->profile)) {
+		prof_counter_add(l->profile, -1);
+	} else if (!(l->profile->repl_type==REPL_CACHEDB)) {
 		if (safe) {
 			prev_locked_by = dlg->locked_by;
 			dlg->locked_by = process_no;
@@ -673,6 +838,18 @@ static void destroy_linker(struct dlg_profile_link *l, struct dlg_cell *dlg,
 			{
 				prof_val_local_dec(dest, &shtag,
 					l->profile->repl_type==REPL_PROTOBIN);
+				if (prof_counted_lockless(l->profile)) {
+					prof_counter_add(l->profile, -1);
+
+					vc = prof_value_find(l->profile, l->hash_idx,
+						prof_value_key(&l->value));
+					if (vc) {
+						prof_value_add(vc, -1);
+						/* the value is gone, free its counter */
+						if (*dest == 0)
+							vc->key = 0;
+					}
+				}
 
 				if( *dest == 0 )
 				{
@@ -684,12 +861,8 @@ static void destroy_linker(struct dlg_profile_link *l, struct dlg_cell *dlg,
 			}
 		}
 		else {
-			if (l->profile->repl_type==REPL_PROTOBIN && profile_repl_cluster)
-				remove_local_counter(&l->profile->noval_local_counters[l->hash_idx],
-					&shtag);
-			else
-				l->profile->noval_local_counters[l->hash_idx] =
-					(void *)((long)l->profile->noval_local_counters[l->hash_idx] - 1);
+			remove_local_counter(&l->profile->noval_local_counters[l->hash_idx],
+				&shtag);
 		}
 
 		lock_set_release( l->profile->locks, l->hash_idx  );
@@ -778,11 +951,16 @@ static int link_dlg_profile(struct dlg_profile_link *linker,
 	struct dlg_entry *d_entry;
 	void ** dest;
 	struct prof_local_count *cnt;
+	struct prof_value_counter *vc;
 	struct dlg_profile_table *profile = linker->profile;
 	str shtag = {0,0};
 
 	/* insert into profile hash table */
-	if (profile->repl_type != REPL_CACHEDB) {
+	if (!profile->has_value && prof_counted_lockless(profile)) {
+		/* nothing to keep per value, just count it */
+		linker->hash_idx = calc_hash_profile(&linker->value, dlg, profile);
+		prof_counter_add(profile, 1);
+	} else if (profile->repl_type != REPL_CACHEDB) {
 		/* calculate the hash position */
 		hash = calc_hash_profile(&linker->value, dlg, profile);
 		linker->hash_idx = hash;
@@ -797,31 +975,41 @@ static int link_dlg_profile(struct dlg_profile_link *linker,
 
 		LM_DBG("Entered here with hash = %d \n",hash);
 		if (profile->has_value) {
+			vc = NULL;
+			if (prof_counted_lockless(profile) &&
+			!(vc = prof_value_get(profile, hash,
+			prof_value_key(&linker->value)))) {
+				lock_set_release( profile->locks,hash );
+				return -1;
+			}
+
 			p_entry = profile->entries[hash];
 			dest = map_get(p_entry, linker->value);
 			if (!dest) {
 				LM_ERR("No more shm memory\n");
+				/* do not keep the counter taken for a new value */
+				if (vc && prof_shards_sum(vc->shards, PROF_VALUE_SHARDS)==0)
+					vc->key = 0;
 				lock_set_release( profile->locks,hash );
 				return -1;
 			}
 
 			prof_val_local_inc(dest, &shtag,
 				profile->repl_type == REPL_PROTOBIN);
+			if (vc) {
+				prof_counter_add(profile, 1);
+				prof_value_add(vc, 1);
+			}
 		}
 		else {
-			if (profile->repl_type == REPL_PROTOBIN && profile_repl_cluster) {
-				cnt = get_local_counter(&profile->noval_local_counters[hash],
-					&shtag);
-				if (!cnt) {
-					lock_set_release(profile->locks, hash);
-					return -1;
-				}
-
-				cnt->n++;
-			} else {
-				profile->noval_local_counters[hash] =
-					(void *)((long)profile->noval_local_counters[hash] + 1);
+			cnt = get_local_counter(&profile->noval_local_counters[hash],
+				&shtag);
+			if (!cnt) {
+				lock_set_release(profile->locks, hash);
+				return -1;
 			}
+
+			cnt->n++;
 		}
 
 		lock_set_release(profile->locks, hash);
@@ -1020,6 +1208,7 @@ unsigned int get_profile_size(struct dlg_profile_table *profile, str *value)
 	unsigned int n = 0, i;
 	map_t entry ;
 	void ** dest;
+	struct prof_value_counter *vc;
 	int ret;
 	map_iterator_t it;
 
@@ -1060,6 +1249,8 @@ unsigned int get_profile_size(struct dlg_profile_table *profile, str *value)
 					goto failed;
 				}
 
+			} else if (prof_counted_lockless(profile)) {
+				n = prof_counter_get(profile);
 			} else {
 
 				for( i=0; i<profile->size; i++ )
@@ -1104,8 +1295,11 @@ next_val:
 					goto failed;
 				}
 
+			} else if (prof_counted_lockless(profile)) {
+				i = calc_hash_profile( value, NULL, profile);
+				vc = prof_value_find(profile, i, prof_value_key(value));
+				n = vc ? prof_shards_get(vc->shards, PROF_VALUE_SHARDS) : 0;
 			} else {
-				/* iterate through the hash entry and count only matching */
 				/* calculate the hash position */
 				i = calc_hash_profile( value, NULL, profile);
 				n = 0;
@@ -1136,6 +1330,9 @@ int noval_get_local_count(struct dlg_profile_table *profile)
 	struct prof_local_count *cnt;
 	int rc;
 
+	if (prof_counted_lockless(profile))
+		return prof_counter_get(profile);
+
 	for (i = 0; i < profile->size; i++) {
 		lock_set_get(profile->locks, i);
 
@@ -1144,20 +1341,17 @@ int noval_get_local_count(struct dlg_profile_table *profile)
 			continue;
 		}
 
-		if (profile->repl_type==REPL_PROTOBIN && profile_repl_cluster) {
-			for (cnt = profile->noval_local_counters[i]; cnt; cnt = cnt->next)
-				if (dialog_repl_cluster && cnt->shtag.s) {
-					/* don't count dialogs for which we have a backup role */
-					if ((rc = get_shtag(&cnt->shtag)) < 0)
-						LM_ERR("Failed to get state for sharing tag: <%.*s>\n",
-							cnt->shtag.len, cnt->shtag.s);
-
-					if (rc != SHTAG_STATE_BACKUP)
-						n += cnt->n;
-				} else
+		for (cnt = profile->noval_local_counters[i]; cnt; cnt = cnt->next)
+			if (dialog_repl_cluster && cnt->shtag.s) {
+				/* don't count dialogs for which we have a backup role */
+				if ((rc = get_shtag(&cnt->shtag)) < 0)
+					LM_ERR("Failed to get state for sharing tag: <%.*s>\n",
+						cnt->shtag.len, cnt->shtag.s);
+
+				if (rc != SHTAG_STATE_BACKUP)
 					n += cnt->n;
-		} else
-			n += (long)profile->noval_local_counters[i];
+			} else
+				n += cnt->n;
 
 		lock_set_release(profile->locks, i);
 	}
@@ -1448,7 +1642,7 @@ struct mi_root * mi_profile_list(struct mi_root *cmd_tree, void *param )
 	for( n=0,i=0; i<d_table->size; i++)
 	{
 		d_entry = &(d_table->entries[i]);
-		lock_set_get(d_table->locks,d_entry->lock_idx);
+		dlg_lock_read( d_table, d_entry);
 
 
 		cur_dlg = d_entry->first;
@@ -1475,7 +1669,7 @@ struct mi_root * mi_profile_list(struct mi_root *cmd_tree, void *param )
 			if( found ) {
 
 				if( mi_print_dlg( rpl, cur_dlg, 0) ) {
-					lock_set_release(d_table->locks,d_entry->lock_idx);
+					dlg_unlock_read( d_table, d_entry);
 					goto error;
 				}
 
@@ -1488,7 +1682,7 @@ struct mi_root * mi_profile_list(struct mi_root *cmd_tree, void *param )
 			cur_dlg = cur_dlg->next;
 		}
 
-		lock_set_release(d_table->locks,d_entry->lock_idx);
+		dlg_unlock_read( d_table, d_entry);
 	}
 
 
@@ -1567,7 +1761,7 @@ struct mi_root * mi_profile_terminate(struct mi_root *cmd_tree, void *param ) {
 
 	for (i = 0; i < d_table->size; i++) {
 		d_entry = &(d_table->entries[i]);
-		lock_set_get(d_table->locks,d_entry->lock_idx);
+		dlg_lock( d_table, d_entry);
 
 		cur_dlg = d_entry->first;
 		while( cur_dlg ) {
@@ -1582,7 +1776,7 @@ struct mi_root * mi_profile_terminate(struct mi_root *cmd_tree, void *param ) {
 					)) {
 					delete_entry = pkg_malloc(sizeof(struct dialog_list));
 					if (!delete_entry) {
-						lock_set_release(d_table->locks,d_entry->lock_idx);
+						dlg_unlock( d_table, d_entry);
 						pkg_free_all(deleted);
 						LM_CRIT("no more pkg memory\n");
 						return init_mi_tree( 400, MI_SSTR(MI_INTERNAL_ERR));
@@ -1601,7 +1795,7 @@ struct mi_root * mi_profile_terminate(struct mi_root *cmd_tree, void *param ) {
 			cur_dlg = cur_dlg->next;
 		}
 
-		lock_set_release(d_table->locks,d_entry->lock_idx);
+		dlg_unlock( d_table, d_entry);
 
 		delete_entry = deleted;
 		while(delete_entry){
@@ -59,6 +59,33 @@ struct prof_local_count {
 };
 
 enum repl_types {REPL_NONE=0, REPL_CACHEDB=1, REPL_PROTOBIN};
+
+/*
+ * local dialogs counter, sharded by process so that concurrent updates do
+ * not bounce the same cache line; reading it sums up the shards
+ */
+#define PROF_COUNTER_SHARDS 16
+#define PROF_COUNTER_LINE 64
+
+struct prof_counter_shard {
+	volatile long n;
+	char pad[PROF_COUNTER_LINE - sizeof(long)];
+};
+
+/*
+ * local dialogs of a profile value, read with no lock: the counters of a
+ * hash bucket are listed by the bucket, found by the hash of the value.
+ * They are only added to the list (under the bucket lock) and freed at
+ * shutdown; once its value is gone, a counter is taken by the next value
+ */
+#define PROF_VALUE_SHARDS 4
+
+struct prof_value_counter {
+	volatile unsigned long key;	/* hash of the value, 0 if unused */
+	struct prof_value_counter *volatile next;
+	struct prof_counter_shard shards[PROF_VALUE_SHARDS];
+};
+
 struct dlg_profile_table {
 	str name;
 	unsigned int has_value;
@@ -78,6 +105,14 @@ struct dlg_profile_table {
 	struct prof_local_count **noval_local_counters;
 	struct prof_rcv_count *noval_rcv_counters;
 
+	/*
+	 * all the local dialogs of the profile, when not counted per
+	 * sharing tag (see prof_counted_lockless())
+	 */
+	struct prof_counter_shard *local_count;
+	/* per value, the same (per hash bucket, for profiles with values) */
+	struct prof_value_counter *volatile *value_counters;
+
 	struct dlg_profile_table *next;
 };
 
@@ -106,6 +141,13 @@ struct dlg_profile_value_name {
 };
 
 
+/* local counts not kept per sharing tag go to the lock-free counter */
+#define prof_counted_lockless(_profile) \
+	((_profile)->repl_type == REPL_NONE || \
+	((_profile)->repl_type == REPL_PROTOBIN && !profile_repl_cluster))
+
+extern int approx_profile_size;
+
 int add_profile_definitions( char* profiles, unsigned int has_value);
 
 void destroy_dlg_profiles();
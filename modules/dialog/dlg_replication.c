@@ -599,6 +599,37 @@ void bin_push_dlg(bin_packet_t *packet, struct dlg_cell *dlg)
 
 /*  Binary Packet sending functions   */
 
+/**
+ * journals a local dialog change and sends it in the cluster, if any
+ *
+ * @return: 0 if sent, 1 if only journaled, -1 on error
+ */
+static int dlg_replicate_packet(bin_packet_t *packet)
+{
+	int rc;
+
+	dlg_persist_journal(packet);
+
+	if (!dialog_repl_cluster)
+		return 1;
+
+	rc = clusterer_api.send_all(packet, dialog_repl_cluster);
+	switch (rc) {
+	case CLUSTERER_CURR_DISABLED:
+		LM_INFO("Current node is disabled in cluster: %d\n", dialog_repl_cluster);
+		return -1;
+	case CLUSTERER_DEST_DOWN:
+		LM_INFO("All destinations in cluster: %d are down or probing\n",
+			dialog_repl_cluster);
+		return -1;
+	case CLUSTERER_SEND_ERR:
+		LM_ERR("Error sending in cluster: %d\n", dialog_repl_cluster);
+		return -1;
+	}
+
+	return 0;
+}
+
 
 /**
  * replicates a locally created dialog to all the destinations
@@ -637,21 +668,11 @@ void replicate_dialog_created(struct dlg_cell *dlg)
 
 	dlg_unlock_dlg(dlg);
 
-	rc = clusterer_api.send_all(&packet, dialog_repl_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", dialog_repl_cluster);
-		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			dialog_repl_cluster);
-		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", dialog_repl_cluster);
+	rc = dlg_replicate_packet(&packet);
+	if (rc < 0)
 		goto error;
-	}
 
-	if_update_stat(dlg_enable_stats,create_sent,1);
+	if_update_stat(dlg_enable_stats && rc == 0, create_sent, 1);
 	bin_free_packet(&packet);
 	return;
 
@@ -701,21 +722,11 @@ void replicate_dialog_updated(struct dlg_cell *dlg)
 
 	dlg_unlock_dlg(dlg);
 
-	rc = clusterer_api.send_all(&packet, dialog_repl_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", dialog_repl_cluster);
+	rc = dlg_replicate_packet(&packet);
+	if (rc < 0)
 		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_ERR("All destinations in cluster: %d are down or probing\n",
-			dialog_repl_cluster);
-		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", dialog_repl_cluster);
-		goto error;
-	}
 
-	if_update_stat(dlg_enable_stats,update_sent,1);
+	if_update_stat(dlg_enable_stats && rc == 0, update_sent, 1);
 	bin_free_packet(&packet);
 	return;
 
@@ -746,21 +757,11 @@ void replicate_dialog_deleted(struct dlg_cell *dlg)
 	bin_push_str(&packet, &dlg->legs[DLG_CALLER_LEG].tag);
 	bin_push_str(&packet, &dlg->legs[callee_idx(dlg)].tag);
 
-	rc = clusterer_api.send_all(&packet, dialog_repl_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", dialog_repl_cluster);
-		goto error_free;
-	case CLUSTERER_DEST_DOWN:
-		LM_ERR("All destinations in cluster: %d are down or probing\n",
-			dialog_repl_cluster);
-		goto error_free;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", dialog_repl_cluster);
+	rc = dlg_replicate_packet(&packet);
+	if (rc < 0)
 		goto error_free;
-	}
 
-	if_update_stat(dlg_enable_stats, delete_sent, 1);
+	if_update_stat(dlg_enable_stats && rc == 0, delete_sent, 1);
 	bin_free_packet(&packet);
 	return;
 error_free:
@@ -891,19 +892,9 @@ void replicate_dialog_cseq_updated(struct dlg_cell *dlg, int leg)
 	bin_push_str(&packet, &dlg->legs[leg].tag);
 	bin_push_int(&packet, dlg->legs[leg].last_gen_cseq);
 
-	rc = clusterer_api.send_all(&packet, dialog_repl_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", dialog_repl_cluster);
+	rc = dlg_replicate_packet(&packet);
+	if (rc < 0)
 		goto error_free;
-	case CLUSTERER_DEST_DOWN:
-		LM_ERR("All destinations in cluster: %d are down or probing\n",
-			dialog_repl_cluster);
-		goto error_free;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", dialog_repl_cluster);
-		goto error_free;
-	}
 
 	bin_free_packet(&packet);
 	return;
@@ -960,6 +951,9 @@ void receive_dlg_repl(bin_packet_t *packet)
 
 		if (rc != 0)
 			LM_ERR("Failed to process a binary packet!\n");
+		else if (pkt->type != DLG_SHARING_TAG_ACTIVE &&
+		         pkt->type != SYNC_PACKET_TYPE)
+			dlg_persist_journal(pkt);
 	}
 }
 
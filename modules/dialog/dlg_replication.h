@@ -30,6 +30,7 @@
 #include "../../timer.h"
 #include "../../rw_locking.h"
 #include "../clusterer/api.h"
+#include "dlg_persist.h"
 
 #ifndef _DIALOG_DLG_REPLICATION_H_
 #define _DIALOG_DLG_REPLICATION_H_
@@ -64,6 +65,9 @@ extern rw_lock_t *shtags_lock;
 extern int dialog_repl_cluster;
 extern int profile_repl_cluster;
 
+/* local dialog changes are replicated in the cluster and/or journaled */
+#define dlg_repl_changes() (dialog_repl_cluster || dlg_persist_file)
+
 extern str dlg_repl_cap;
 extern str prof_repl_cap;
 
@@ -80,6 +84,8 @@ int dlg_replicated_create(bin_packet_t *packet, struct dlg_cell *cell, str *ftag
 							str *ttag, int safe);
 int dlg_replicated_update(bin_packet_t *packet);
 int dlg_replicated_delete(bin_packet_t *packet);
+int dlg_replicated_cseq_updated(bin_packet_t *packet);
+void bin_push_dlg(bin_packet_t *packet, struct dlg_cell *dlg);
 
 void receive_dlg_repl(bin_packet_t *packet);
 void rcv_cluster_event(enum clusterer_event ev, int node_id);
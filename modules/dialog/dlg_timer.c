@@ -36,49 +36,70 @@ struct dlg_timer *d_timer = 0;
 dlg_timer_handler timer_hdl = 0;
 
 struct dlg_ping_timer *ping_timer=0;
-struct dlg_reinvite_ping_timer *reinvite_ping_timer=0;
+struct dlg_ping_timer *reinvite_ping_timer=0;
 str options_str=str_init("OPTIONS");
 str invite_str=str_init("INVITE");
 
 extern int reinvite_ping_interval;
 extern int options_ping_interval;
 
-/* for the dlg timer, there are 3 possible states :
- * prev=next=0 -> dialog not in timer list
- * prev=0 -> dialog expired
- * otherwise - dialog still in timer list
+/* number of independent (locking and processing wise) timer shards; each
+ * shard has its own timer job, so the shards expire in parallel */
+int dlg_timer_shards = 1;
+
+/* the shard of a timer link or of a dialog (for its ping timers) */
+#define dlg_shard(_p) \
+	((((unsigned long)(_p))>>6) % dlg_timer_shards)
+
+/* is the link currently hashed into the wheel of its shard? */
+#define tw_linked(_tw) ((_tw)->list.next!=NULL)
+
+/* for the dlg timer, there are 4 possible states :
+ * next=0, not linked -> dialog not in timer list
+ * next=0, linked -> dialog in timer list
+ * next!=0, timeout!=0 -> dialog expired, in process by the timer routine
+ * next=FAKE_DIALOG_TL, timeout=0 -> dialog expired or removed from timer
  */
 #define FAKE_DIALOG_TL ((struct dlg_tl*)-1)
 
 int init_dlg_timer( dlg_timer_handler hdl )
 {
-	d_timer = (struct dlg_timer*)shm_malloc(sizeof(struct dlg_timer));
+	int i;
+
+	if (dlg_timer_shards<1) {
+		LM_ERR("invalid number of timer shards %d\n", dlg_timer_shards);
+		return -1;
+	}
+
+	d_timer = (struct dlg_timer*)shm_malloc
+		(dlg_timer_shards * sizeof(struct dlg_timer));
 	if (d_timer==0) {
 		LM_ERR("no more shm mem\n");
 		return -1;
 	}
-	memset( d_timer, 0, sizeof(struct dlg_timer) );
+	memset( d_timer, 0, dlg_timer_shards * sizeof(struct dlg_timer) );
 
-	d_timer->first.next = d_timer->first.prev = &(d_timer->first);
+	for (i=0; i<dlg_timer_shards; i++) {
+		tw_init( &d_timer[i].wheel, 1, get_ticks());
 
-	d_timer->lock = lock_alloc();
-	if (d_timer->lock==0) {
-		LM_ERR("failed to alloc lock\n");
-		goto error0;
-	}
+		d_timer[i].lock = lock_alloc();
+		if (d_timer[i].lock==0) {
+			LM_ERR("failed to alloc lock\n");
+			goto error;
+		}
 
-	if (lock_init(d_timer->lock)==0) {
-		LM_ERR("failed to init lock\n");
-		goto error1;
+		if (lock_init(d_timer[i].lock)==0) {
+			LM_ERR("failed to init lock\n");
+			lock_dealloc(d_timer[i].lock);
+			d_timer[i].lock = 0;
+			goto error;
+		}
 	}
 
 	timer_hdl = hdl;
 	return 0;
-error1:
-	lock_dealloc(d_timer->lock);
-error0:
-	shm_free(d_timer);
-	d_timer = 0;
+error:
+	destroy_dlg_timer();
 	return -1;
 }
 
@@ -93,7 +114,7 @@ void debug_detached_timer_list(struct dlg_tl *detached)
 
 	/* check the detached list is not circular */
 	while (detached != FAKE_DIALOG_TL) {
-		if (detached->prev != NULL || detached->visited==1) {
+		if (tw_linked(&detached->tw) || detached->visited==1) {
 			dlg = tl_get_dlg(detached);
 			LM_ERR("Detected something wrong with dialog %p [%.*s]. Aborting. Visited = %d \n",
 					dlg,dlg->callid.len,dlg->callid.s,detached->visited);
@@ -104,132 +125,100 @@ void debug_detached_timer_list(struct dlg_tl *detached)
 	}
 
 }
+#endif
 
-/* assumed to be always called under timer lock */
-void debug_main_timer_list(void)
+static struct dlg_ping_timer *init_ping_shards(void)
 {
-	struct dlg_tl *start,*finish;
-	int visited=1;
+	struct dlg_ping_timer *pt;
+	int i;
 
-	start = finish = &(d_timer->first);
-	LM_DBG("testing forward loop with visited = %d\n",visited);
+	pt = (struct dlg_ping_timer*)shm_malloc
+		(dlg_timer_shards * sizeof(struct dlg_ping_timer));
+	if (pt==0) {
+		LM_ERR("no more shm mem\n");
+		return 0;
+	}
+	memset(pt, 0, dlg_timer_shards * sizeof(struct dlg_ping_timer));
 
-	/* check the main list is circular in both directions from start to end,
-	 * with no loops in the middle */
-	while (start) {
-		start->visited=visited;
-		start = start->next;
+	for (i=0; i<dlg_timer_shards; i++) {
+		tw_init( &pt[i].wheel, 1, get_ticks());
 
-		if (start == finish)
-			break;
+		pt[i].lock = lock_alloc();
+		if (pt[i].lock == 0) {
+			LM_ERR("failed to alloc lock\n");
+			goto error;
+		}
 
-		if (start == NULL || start->visited == visited) {
-			LM_ERR("Detected something wrong with main timer list on forward linking for entry %p \n",start);
-			abort();
+		if (lock_init(pt[i].lock) == 0) {
+			LM_ERR("failed to init lock\n");
+			lock_dealloc(pt[i].lock);
+			pt[i].lock = 0;
+			goto error;
 		}
 	}
 
-	visited++;
-	start = &(d_timer->first);
+	return pt;
 
-	LM_DBG("testing backward loop with visited = %d\n",visited);
-
-	while (start) {
-		start->visited=visited;
-		start = start->prev;
-
-		if (start == finish)
-			break;
-
-		if (start == NULL || start->visited == visited) {
-			LM_ERR("Detected something wrong with main timer list on backward linking for entry %p \n",start);
-			abort();
-		}
+error:
+	while (--i>=0) {
+		lock_destroy(pt[i].lock);
+		lock_dealloc(pt[i].lock);
 	}
+	shm_free(pt);
+	return 0;
 }
 
-#endif
-
-int init_dlg_ping_timer(void)
+static void destroy_ping_shards(struct dlg_ping_timer *pt)
 {
-	ping_timer = (struct dlg_ping_timer*)shm_malloc(sizeof(struct dlg_timer));
-	if (ping_timer==0) {
-		LM_ERR("no more shm mem\n");
-		return -1;
-	}
-
-	memset(ping_timer,0,sizeof(struct dlg_ping_timer));
-	ping_timer->lock = lock_alloc();
-	if (ping_timer->lock == 0) {
-		LM_ERR("failed to alloc lock\n");
-		goto error0;
-	}
+	int i;
 
-	if (lock_init(ping_timer->lock) == 0) {
-		LM_ERR("failed to init lock\n");
-		goto error1;
+	for (i=0; i<dlg_timer_shards; i++) {
+		lock_destroy(pt[i].lock);
+		lock_dealloc(pt[i].lock);
 	}
 
-	return 0;
+	shm_free(pt);
+}
 
-error1:
-	lock_dealloc(ping_timer->lock);
-error0:
-	shm_free(ping_timer);
-	ping_timer=0;
-	return -1;
+int init_dlg_ping_timer(void)
+{
+	ping_timer = init_ping_shards();
+	return ping_timer ? 0 : -1;
 }
 
 int init_dlg_reinvite_ping_timer(void)
 {
-	reinvite_ping_timer = (struct dlg_reinvite_ping_timer*)shm_malloc(sizeof(struct dlg_timer));
-	if (reinvite_ping_timer==0) {
-		LM_ERR("no more shm mem\n");
-		return -1;
-	}
-
-	memset(reinvite_ping_timer,0,sizeof(struct dlg_reinvite_ping_timer));
-	reinvite_ping_timer->lock = lock_alloc();
-	if (reinvite_ping_timer->lock == 0) {
-		LM_ERR("failed to alloc lock\n");
-		goto error0;
-	}
-
-	if (lock_init(reinvite_ping_timer->lock) == 0) {
-		LM_ERR("failed to init lock\n");
-		goto error1;
-	}
-
-	return 0;
-
-error1:
-	lock_dealloc(reinvite_ping_timer->lock);
-error0:
-	shm_free(reinvite_ping_timer);
-	reinvite_ping_timer=0;
-	return -1;
+	reinvite_ping_timer = init_ping_shards();
+	return reinvite_ping_timer ? 0 : -1;
 }
 
 void destroy_ping_timer(void)
 {
-	if (ping_timer ==0)
-		return;
-
-	lock_destroy(ping_timer->lock);
-	lock_dealloc(ping_timer->lock);
+	if (ping_timer) {
+		destroy_ping_shards(ping_timer);
+		ping_timer=0;
+	}
 
-	shm_free(ping_timer);
-	ping_timer=0;
+	if (reinvite_ping_timer) {
+		destroy_ping_shards(reinvite_ping_timer);
+		reinvite_ping_timer=0;
+	}
 }
 
 
 void destroy_dlg_timer(void)
 {
+	int i;
+
 	if (d_timer==0)
 		return;
 
-	lock_destroy(d_timer->lock);
-	lock_dealloc(d_timer->lock);
+	for (i=0; i<dlg_timer_shards; i++) {
+		if (d_timer[i].lock==0)
+			break;
+		lock_destroy(d_timer[i].lock);
+		lock_dealloc(d_timer[i].lock);
+	}
 
 	shm_free(d_timer);
 	d_timer = 0;
@@ -237,92 +226,51 @@ void destroy_dlg_timer(void)
 
 
 
-static inline void insert_dlg_timer_unsafe(struct dlg_tl *tl)
+static inline void insert_dlg_timer_unsafe(struct dlg_timer *dt,
+													struct dlg_tl *tl)
 {
-	struct dlg_tl* ptr;
-
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
-
-	for(ptr = d_timer->first.prev; ptr != &d_timer->first ; ptr = ptr->prev) {
-		if ( ptr->timeout <= tl->timeout )
-			break;
-	}
-
 	LM_DBG("inserting %p for %d\n", tl,tl->timeout);
-	tl->prev = ptr;
-	tl->next = ptr->next;
-	tl->prev->next = tl;
-	tl->next->prev = tl;
-
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
+	tw_add( &dt->wheel, &tl->tw, tl->timeout, get_ticks());
 }
 
 int insert_dlg_timer(struct dlg_tl *tl, int interval)
 {
-	lock_get( d_timer->lock);
+	struct dlg_timer *dt = &d_timer[dlg_shard(tl)];
+
+	lock_get( dt->lock);
 
-	if (tl->next!=0 || tl->prev!=0) {
-		lock_release( d_timer->lock);
-		LM_CRIT("Trying to insert a bogus dlg tl=%p tl->next=%p tl->prev=%p\n",
-			tl, tl->next, tl->prev);
+	if (tl->next!=0 || tw_linked(&tl->tw)) {
+		lock_release( dt->lock);
+		LM_CRIT("Trying to insert a bogus dlg tl=%p tl->next=%p linked=%d\n",
+			tl, tl->next, tw_linked(&tl->tw));
 		return -1;
 	}
 	tl->timeout = get_ticks()+interval;
 
-	insert_dlg_timer_unsafe( tl );
+	insert_dlg_timer_unsafe( dt, tl );
 
-	lock_release( d_timer->lock);
+	lock_release( dt->lock);
 
 	return 0;
 }
 
-void unsafe_insert_ping_timer(struct dlg_ping_list *node,int new_timeout)
+static inline void unsafe_insert_ping_timer(struct dlg_ping_timer *pt,
+								struct dlg_ping_list *node, int new_timeout)
 {
-	struct dlg_ping_list *it;
-
 	node->timeout = get_ticks() + new_timeout;
+	tw_add( &pt->wheel, &node->tw, node->timeout, get_ticks());
+}
 
-	if (ping_timer->first == 0) {
-		ping_timer->first = node;
-		ping_timer->last = node;
-	} else {
-		/* quick optimisation, always check if our timeout is bigger than last
-		if not, lookup our position, might be useful in the future if we want
-		to set different ping intervals per dialog */
-		if (node->timeout >= ping_timer->last->timeout) {
-			node->prev = ping_timer->last;
-			ping_timer->last->next = node;
-			ping_timer->last = node;
-		} else {
-			for (it=ping_timer->first;it;it=it->next) {
-				if (it->timeout >= node->timeout)
-					break;
-			}
-
-			/* we need to insert ourselves before the found node */
-			if (it == NULL) {
-				/* we're going to be the last node 
-				should never get here due to the above optimisation ... paranoia */
-				node->prev = ping_timer->last;
-				ping_timer->last->next = node;
-				ping_timer->last = node;
-			} else {
-				it->prev->next=node;
-				node->prev = it->prev;
-				node->next = it;
-				it->prev = node;
-			}
-
-		}
-	}
+static inline void unsafe_detach_ping_node(struct dlg_ping_timer *pt,
+												struct dlg_ping_list *node)
+{
+	tw_del( &pt->wheel, &node->tw);
+	node->tw.list.next = NULL;
 }
 
 int insert_ping_timer(struct dlg_cell* dlg)
 {
+	struct dlg_ping_timer *pt = &ping_timer[dlg_shard(dlg)];
 	struct dlg_ping_list *node;
 
 	node = shm_malloc(sizeof(struct dlg_ping_list));
@@ -331,66 +279,26 @@ int insert_ping_timer(struct dlg_cell* dlg)
 		return -1;
 	}
 
+	memset(node, 0, sizeof *node);
 	node->dlg = dlg;
-	node->next = 0;
-	node->prev = 0;
 
-	lock_get( ping_timer->lock );
+	lock_get( pt->lock );
 
-	unsafe_insert_ping_timer(node,options_ping_interval);
+	unsafe_insert_ping_timer(pt,node,options_ping_interval);
 	dlg->pl = node;
 
 	dlg->legs[DLG_CALLER_LEG].reply_received = DLG_PING_SUCCESS;
 	dlg->legs[callee_idx(dlg)].reply_received = DLG_PING_SUCCESS;
 
-	lock_release( ping_timer->lock);
+	lock_release( pt->lock);
 	LM_DBG("Inserted dlg [%p] in ping timer list\n",dlg);
 
 	return 0;
 }
 
-void unsafe_insert_reinvite_ping_timer(struct dlg_ping_list *node,int new_timeout)
-{
-	struct dlg_ping_list *it;
-
-	node->timeout = get_ticks() + new_timeout;
-
-	if (reinvite_ping_timer->first == 0) {
-		reinvite_ping_timer->first = node;
-		reinvite_ping_timer->last = node;
-	} else {
-		/* quick optimisation, always check if our timeout is bigger than last
-		if not, lookup our position, might be useful in the future if we want
-		to set different ping intervals per dialog */
-		if (node->timeout >= reinvite_ping_timer->last->timeout) {
-			node->prev = reinvite_ping_timer->last;
-			reinvite_ping_timer->last->next = node;
-			reinvite_ping_timer->last = node;
-		} else {
-			for (it=reinvite_ping_timer->first;it;it=it->next) {
-				if (it->timeout >= node->timeout)
-					break;
-			}
-
-			/* we need to insert ourselves before the found node */
-			if (it == NULL) {
-				/* we're going to be the last node 
-				should never get here due to the above optimisation ... paranoia */
-				node->prev = reinvite_ping_timer->last;
-				reinvite_ping_timer->last->next = node;
-				reinvite_ping_timer->last = node;
-			} else {
-				it->prev->next=node;
-				node->prev = it->prev;
-				node->next = it;
-				it->prev = node;
-			}
-		}
-	}
-}
-
 int insert_reinvite_ping_timer(struct dlg_cell* dlg)
 {
+	struct dlg_ping_timer *pt = &reinvite_ping_timer[dlg_shard(dlg)];
 	struct dlg_ping_list *node;
 
 	node = shm_malloc(sizeof(struct dlg_ping_list));
@@ -399,36 +307,51 @@ int insert_reinvite_ping_timer(struct dlg_cell* dlg)
 		return -1;
 	}
 
+	memset(node, 0, sizeof *node);
 	node->dlg = dlg;
-	node->next = 0;
-	node->prev = 0;
 
-	lock_get( reinvite_ping_timer->lock );
+	lock_get( pt->lock );
 
-	unsafe_insert_reinvite_ping_timer(node,reinvite_ping_interval);
+	unsafe_insert_ping_timer(pt,node,reinvite_ping_interval);
 	dlg->reinvite_pl = node;
 
 	dlg->legs[DLG_CALLER_LEG].reinvite_confirmed = DLG_PING_SUCCESS;
 	dlg->legs[callee_idx(dlg)].reinvite_confirmed = DLG_PING_SUCCESS;
 
-	lock_release( reinvite_ping_timer->lock);
+	lock_release( pt->lock);
 	LM_DBG("Inserted dlg [%p] in reinvite ping timer list\n",dlg);
 
 	return 0;
 }
 
-static inline void remove_dlg_timer_unsafe(struct dlg_tl *tl)
+/* a ping of the dialog failed - move its ping timer to the current tick,
+ * so the dialog gets terminated by the next run of the ping routine */
+static void expire_ping_timer(struct dlg_cell *dlg, int reinvite)
 {
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
+	struct dlg_ping_timer *pt;
+	struct dlg_ping_list *node;
 
-	tl->prev->next = tl->next;
-	tl->next->prev = tl->prev;
+	pt = &(reinvite ? reinvite_ping_timer : ping_timer)[dlg_shard(dlg)];
 
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
+	lock_get(pt->lock);
+
+	node = reinvite ? dlg->reinvite_pl : dlg->pl;
+	/* if not linked, it is just being processed by the ping routine,
+	 * which will check the ping status anyhow */
+	if (node && tw_linked(&node->tw)) {
+		unsafe_detach_ping_node(pt, node);
+		node->timeout = get_ticks();
+		tw_add( &pt->wheel, &node->tw, node->timeout, node->timeout);
+	}
+
+	lock_release(pt->lock);
+}
+
+static inline void remove_dlg_timer_unsafe(struct dlg_timer *dt,
+													struct dlg_tl *tl)
+{
+	tw_del( &dt->wheel, &tl->tw);
+	tl->tw.list.next = NULL;
 }
 
 
@@ -440,63 +363,35 @@ static inline void remove_dlg_timer_unsafe(struct dlg_tl *tl)
  */
 int remove_dlg_timer(struct dlg_tl *tl)
 {
-	lock_get( d_timer->lock);
+	struct dlg_timer *dt = &d_timer[dlg_shard(tl)];
+
+	lock_get( dt->lock);
 
-	if (tl->prev==NULL && tl->timeout==0) {
+	if (!tw_linked(&tl->tw) && tl->timeout==0) {
 		/* dialog is not in timer list; either it is completly removed
-		   (prev=next=timeout=0), either is in process by timeout routine
-		   (prev=timeout=0;next!=0) */
-		lock_release( d_timer->lock);
+		   (next=timeout=0), either is in process by timeout routine
+		   (timeout=0;next!=0) */
+		lock_release( dt->lock);
 		return 1;
 	}
 
-	if (tl->prev==NULL || tl->next==NULL || tl->next == FAKE_DIALOG_TL) {
-		LM_CRIT("bogus tl=%p tl->prev=%p tl->next=%p\n",
-			tl, tl->prev, tl->next);
-		lock_release( d_timer->lock);
+	if (!tw_linked(&tl->tw) || tl->next!=NULL) {
+		LM_CRIT("bogus tl=%p tl->next=%p linked=%d\n",
+			tl, tl->next, tw_linked(&tl->tw));
+		lock_release( dt->lock);
 		return -1;
 	}
 
-	remove_dlg_timer_unsafe(tl);
+	remove_dlg_timer_unsafe(dt, tl);
 	/* mark that this dialog was one a part of the timer list */
 	tl->next = FAKE_DIALOG_TL;
-	tl->prev = NULL;
 	tl->timeout = 0;
 
-	lock_release( d_timer->lock);
+	lock_release( dt->lock);
 	return 0;
 }
 
-static inline void detach_ping_node_unsafe(struct dlg_ping_list *it,int reinvite)
-{
-	if (it->next && it->prev) {
-		it->prev->next = it->next;
-		it->next->prev = it->prev;
-	}
-	else if (it->next) {
-		it->next->prev = 0;
-		if (reinvite)
-			reinvite_ping_timer->first = it->next;
-		else
-			ping_timer->first = it->next;
-	} else if (it->prev) {
-		it->prev->next = 0;
-		if (reinvite)
-			reinvite_ping_timer->last = it->prev;
-		else
-			ping_timer->last = it->prev;
-	} else {
-		if (reinvite) {
-			reinvite_ping_timer->first = 0;
-			reinvite_ping_timer->last = 0;
-		} else {
-			ping_timer->first = 0;
-			ping_timer->last = 0;
-		}
-	}
 
-	it->next = it->prev = 0;
-}
 
 /* returns :
      0 - dialog was inserted in timer list with the new timeout
@@ -504,82 +399,64 @@ static inline void detach_ping_node_unsafe(struct dlg_ping_list *it,int reinvite
     -1 - failure (dialog is expired, so it cannot be added again) */
 int update_dlg_timer( struct dlg_tl *tl, int timeout )
 {
+	struct dlg_timer *dt = &d_timer[dlg_shard(tl)];
 	int ret;
 
-	lock_get( d_timer->lock);
+	lock_get( dt->lock);
 
 	if ( tl->next == FAKE_DIALOG_TL ) {
 		/* previously removed from timer list - we will not add it again */
-		lock_release( d_timer->lock);
+		lock_release( dt->lock);
 		return 0;
 	}
 
 	if ( tl->next ) {
-		if (tl->prev==0) {
-			lock_release( d_timer->lock);
-			return -1;
-		}
-		remove_dlg_timer_unsafe(tl);
+		/* detached, in process by the timer routine */
+		lock_release( dt->lock);
+		return -1;
+	}
+
+	if ( tw_linked(&tl->tw) ) {
+		remove_dlg_timer_unsafe(dt, tl);
 		ret = 0;
 	} else {
 		ret = 1;
 	}
 
 	tl->timeout = get_ticks()+timeout;
-	insert_dlg_timer_unsafe( tl );
+	insert_dlg_timer_unsafe( dt, tl );
 
-	lock_release( d_timer->lock);
+	lock_release( dt->lock);
 	return ret;
 }
 
-static inline struct dlg_tl* get_expired_dlgs(unsigned int time)
+static inline struct dlg_tl* get_expired_dlgs(struct dlg_timer *dt,
+															unsigned int time)
 {
-	struct dlg_tl *tl , *end, *ret;
-
-	lock_get( d_timer->lock);
+	struct list_head expired, *it, *next;
+	struct dlg_tl *tl, *ret;
 
-	if (d_timer->first.next==&(d_timer->first)
-	|| d_timer->first.next->timeout > time ) {
-		lock_release( d_timer->lock);
+	/* quick check whether it is worth entering the lock */
+	if (dt->wheel.count==0)
 		return FAKE_DIALOG_TL;
-	}
 
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
+	INIT_LIST_HEAD( &expired );
 
-	end = &d_timer->first;
-	tl = d_timer->first.next;
-	LM_DBG("start with tl=%p tl->prev=%p tl->next=%p (%d) at %d "
-		"and end with end=%p end->prev=%p end->next=%p\n",
-		tl,tl->prev,tl->next,tl->timeout,time,
-		end,end->prev,end->next);
-	while( tl!=end && tl->timeout <= time) {
-		LM_DBG("getting tl=%p tl->prev=%p tl->next=%p with %d\n",
-			tl,tl->prev,tl->next,tl->timeout);
-		tl->prev = 0;
-		tl->timeout = 0;
-		tl=tl->next;
-	}
-	LM_DBG("end with tl=%p tl->prev=%p tl->next=%p and "
-		"d_timer->first.next->prev=%p\n",
-		tl,tl->prev,tl->next,d_timer->first.next->prev);
+	lock_get( dt->lock);
 
-	if (tl==end && d_timer->first.next->prev) {
-		LM_DBG("no dialog to return\n");
-		ret = FAKE_DIALOG_TL;
-	} else {
-		ret = d_timer->first.next;
-		tl->prev->next = FAKE_DIALOG_TL;
-		d_timer->first.next = tl;
-		tl->prev = &d_timer->first;
-	}
+	tw_expire( &dt->wheel, time, &expired);
 
-#ifdef EXTRA_DEBUG
-	debug_main_timer_list();
-#endif
+	ret = FAKE_DIALOG_TL;
+	list_for_each_prev_safe( it, next, &expired) {
+		tl = list_entry(it, struct dlg_tl, tw.list);
+		LM_DBG("getting tl=%p with %d\n", tl, tl->timeout);
+		tl->tw.list.next = NULL;
+		tl->timeout = 0;
+		tl->next = ret;
+		ret = tl;
+	}
 
-	lock_release( d_timer->lock);
+	lock_release( dt->lock);
 
 #ifdef EXTRA_DEBUG
 	debug_detached_timer_list(ret);
@@ -591,7 +468,7 @@ void dlg_timer_routine(unsigned int ticks , void * attr)
 {
 	struct dlg_tl *tl, *ctl;
 
-	tl = get_expired_dlgs( ticks );
+	tl = get_expired_dlgs( &d_timer[(long)attr], ticks );
 
 	while (tl != FAKE_DIALOG_TL) {
 		ctl = tl;
@@ -603,98 +480,101 @@ void dlg_timer_routine(unsigned int ticks , void * attr)
 	}
 }
 
-/* removes expired dlgs from main ping_timer list
- * and links them back into a new list */
-void get_timeout_dlgs(struct dlg_ping_list **expired,
-		struct dlg_ping_list **to_be_deleted,int reinvite)
+/* did any of the pinged legs fail to reply? */
+static inline int dlg_ping_failed(struct dlg_cell *dlg, int reinvite)
+{
+	if (reinvite) {
+		return ((dlg->flags & DLG_FLAG_REINVITE_PING_CALLER) &&
+			dlg->legs[DLG_CALLER_LEG].reinvite_confirmed == DLG_PING_FAIL) ||
+			((dlg->flags & DLG_FLAG_REINVITE_PING_CALLEE) &&
+			dlg->legs[callee_idx(dlg)].reinvite_confirmed == DLG_PING_FAIL);
+	} else {
+		return ((dlg->flags & DLG_FLAG_PING_CALLER) &&
+			dlg->legs[DLG_CALLER_LEG].reply_received == DLG_PING_FAIL) ||
+			((dlg->flags & DLG_FLAG_PING_CALLEE) &&
+			dlg->legs[callee_idx(dlg)].reply_received == DLG_PING_FAIL);
+	}
+}
+
+/* detaches the due nodes from a ping timer shard and sorts them into:
+ * the dialogs with a failed ping, the terminated dialogs and the dialogs
+ * to be pinged now (these ones are still referred by the dialog) */
+static void get_timeout_dlgs(struct dlg_ping_timer *pt, unsigned int ticks,
+		struct dlg_ping_list **expired, struct dlg_ping_list **to_be_deleted,
+		struct dlg_ping_list **to_ping, int reinvite)
 {
-	struct dlg_ping_list *exp = NULL,*del=NULL,*it=NULL,*next=NULL;
+	struct dlg_ping_list *exp = NULL,*del=NULL,*ping=NULL,*node;
+	struct list_head due, *it, *next;
 	struct dlg_cell *current;
-	int detached;
 
-	if (reinvite)
-		lock_get(reinvite_ping_timer->lock);
-	else
-		lock_get(ping_timer->lock);
+	*to_be_deleted = *expired = *to_ping = NULL;
+
+	/* quick check whether it is worth entering the lock */
+	if (pt->wheel.count==0)
+		return;
 
-	for (it=reinvite?reinvite_ping_timer->first:ping_timer->first;it;it=next) {
-		/* FIXME - optimisation needed here : only iterate on the nodes that we need to
-		eg. where pinging is in progress */
+	INIT_LIST_HEAD( &due );
 
-		current = it->dlg;
-		next = it->next;
-		detached = 0;
+	lock_get(pt->lock);
+
+	tw_expire( &pt->wheel, ticks, &due);
+
+	list_for_each_safe( it, next, &due) {
+		node = list_entry(it, struct dlg_ping_list, tw.list);
+		node->tw.list.next = NULL;
+		current = node->dlg;
 
 		if (current->state == DLG_STATE_DELETED) {
 			/* the dialog has terminated - we remove it as well
 			 * since we also have a ref */
-			detach_ping_node_unsafe(it,reinvite);
 			if (reinvite)
-				it->dlg->reinvite_pl = 0;
+				current->reinvite_pl = 0;
 			else
-				it->dlg->pl = 0;
-
-			if (del == NULL)
-				del = it;
-			else {
-				it->next = del;
-				del = it;
-			}
-
-			continue;
-		}
+				current->pl = 0;
 
-		if (reinvite?(current->flags & DLG_FLAG_REINVITE_PING_CALLER):
-		(current->flags & DLG_FLAG_PING_CALLER)) {
-			if (reinvite?(current->legs[DLG_CALLER_LEG].reinvite_confirmed == DLG_PING_FAIL):
-			(current->legs[DLG_CALLER_LEG].reply_received == DLG_PING_FAIL)) {
-				detach_ping_node_unsafe(it,reinvite);
-				detached=1;
-
-				if (reinvite)
-					it->dlg->reinvite_pl = 0;
-				else
-					it->dlg->pl = 0;
-
-				if (exp == NULL)
-					exp = it;
-				else {
-					it->next = exp;
-					exp = it;
-				}
-			}
-		}
+			node->next = del;
+			del = node;
+		} else if (dlg_ping_failed(current, reinvite)) {
+			if (reinvite)
+				current->reinvite_pl = 0;
+			else
+				current->pl = 0;
 
-		if (detached == 0) {
-			if (reinvite?(current->flags & DLG_FLAG_REINVITE_PING_CALLEE):
-			(current->flags & DLG_FLAG_PING_CALLEE)) {
-				if (reinvite?(current->legs[callee_idx(current)].reinvite_confirmed == DLG_PING_FAIL):
-				current->legs[callee_idx(current)].reply_received == DLG_PING_FAIL) {
-					detach_ping_node_unsafe(it,reinvite);
-					if (reinvite)
-						it->dlg->reinvite_pl = 0;
-					else
-						it->dlg->pl = 0;
-
-
-					if (exp == NULL)
-						exp = it;
-					else {
-						it->next = exp;
-						exp = it;
-					}
-				}
-			}
+			node->next = exp;
+			exp = node;
+		} else {
+			node->next = ping;
+			ping = node;
 		}
 	}
 
-	if (reinvite)
-		lock_release(reinvite_ping_timer->lock);
-	else
-		lock_release(ping_timer->lock);
+	lock_release(pt->lock);
 
 	*to_be_deleted = del;
 	*expired = exp;
+	*to_ping = ping;
+}
+
+/* links the pinged nodes back into their ping timer shard */
+static void rearm_ping_nodes(struct dlg_ping_timer *pt,
+							struct dlg_ping_list *nodes, int interval, int reinvite)
+{
+	struct dlg_ping_list *next;
+
+	if (nodes==NULL)
+		return;
+
+	lock_get(pt->lock);
+
+	for ( ; nodes ; nodes=next) {
+		next = nodes->next;
+		nodes->next = NULL;
+		/* a ping may have already failed meanwhile */
+		unsafe_insert_ping_timer(pt, nodes,
+			dlg_ping_failed(nodes->dlg, reinvite) ? 0 : interval);
+	}
+
+	lock_release(pt->lock);
 }
 
 void reply_from_caller(struct cell* t, int type, struct tmcb_params* ps)
@@ -722,11 +602,12 @@ void reply_from_caller(struct cell* t, int type, struct tmcb_params* ps)
 
 	if (rpl == FAKED_REPLY || statuscode == 408) {
 		/* timeout occurred, nothing else to do now
-		 * next time timer fires, it will detect ping reply was not received
+		 * the ping timer is moved to now, to detect the failed ping
 		 */
 		LM_INFO("terminating dialog ( due to timeout ) "
 					"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[DLG_CALLER_LEG].reply_received = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 0);
 		return;
 	}
 
@@ -738,6 +619,7 @@ void reply_from_caller(struct cell* t, int type, struct tmcb_params* ps)
 				"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 
 		dlg->legs[DLG_CALLER_LEG].reply_received = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 0);
 		return;
 	}
 
@@ -770,11 +652,12 @@ void reinvite_reply_from_caller(struct cell* t, int type, struct tmcb_params* ps
 
 	if (rpl == FAKED_REPLY || statuscode == 408) {
 		/* timeout occurred, nothing else to do now
-		 * next time timer fires, it will detect ping reply was not received
+		 * the ping timer is moved to now, to detect the failed ping
 		 */
 		LM_INFO("terminating dialog ( due to timeout ) "
 					"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[DLG_CALLER_LEG].reinvite_confirmed = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 1);
 		return;
 	}
 
@@ -785,6 +668,7 @@ void reinvite_reply_from_caller(struct cell* t, int type, struct tmcb_params* ps
 		LM_INFO("terminating dialog ( due to 481 ) "
 				"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[DLG_CALLER_LEG].reinvite_confirmed = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 1);
 		return;
 	}
 
@@ -821,11 +705,12 @@ void reply_from_callee(struct cell* t, int type, struct tmcb_params* ps)
 
 	if (rpl == FAKED_REPLY || statuscode == 408) {
 		/* timeout occurred, nothing else to do now
-		 * next time timer fires, it will detect ping reply was not received
+		 * the ping timer is moved to now, to detect the failed ping
 		 */
 		LM_INFO("terminating dialog ( due to timeout ) "
 					"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[callee_idx(dlg)].reply_received = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 0);
 		return;
 	}
 
@@ -836,6 +721,7 @@ void reply_from_callee(struct cell* t, int type, struct tmcb_params* ps)
 		LM_INFO("terminating dialog ( due to 481 ) "
 				"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[callee_idx(dlg)].reply_received = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 0);
 		return;
 	}
 
@@ -870,11 +756,12 @@ void reinvite_reply_from_callee(struct cell* t, int type, struct tmcb_params* ps
 
 	if (rpl == FAKED_REPLY || statuscode == 408) {
 		/* timeout occurred, nothing else to do now
-		 * next time timer fires, it will detect ping reply was not received
+		 * the ping timer is moved to now, to detect the failed ping
 		 */
 		LM_INFO("terminating dialog ( due to timeout ) "
 					"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[callee_idx(dlg)].reinvite_confirmed = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 1);
 		return;
 	}
 
@@ -885,6 +772,7 @@ void reinvite_reply_from_callee(struct cell* t, int type, struct tmcb_params* ps
 		LM_INFO("terminating dialog ( due to 481 ) "
 				"with callid = [%.*s] \n",dlg->callid.len,dlg->callid.s);
 		dlg->legs[callee_idx(dlg)].reinvite_confirmed = DLG_PING_FAIL;
+		expire_ping_timer(dlg, 1);
 		return;
 	}
 
@@ -901,11 +789,11 @@ void unref_dlg_cb(void *dlg)
 
 void dlg_options_routine(unsigned int ticks , void * attr)
 {
-	struct dlg_ping_list *expired,*to_be_deleted,*it,*curr,*next;
+	struct dlg_ping_timer *pt = &ping_timer[(long)attr];
+	struct dlg_ping_list *expired,*to_be_deleted,*to_ping,*it,*curr;
 	struct dlg_cell *dlg;
-	int current_ticks;
 
-	get_timeout_dlgs(&expired,&to_be_deleted,0);
+	get_timeout_dlgs(pt,ticks,&expired,&to_be_deleted,&to_ping,0);
 
 	it = expired;
 	while (it) {
@@ -936,59 +824,44 @@ void dlg_options_routine(unsigned int ticks , void * attr)
 		it = curr;
 	}
 
-	tcp_no_new_conn = 1;
+	if (to_ping==NULL)
+		return;
 
-	current_ticks = get_ticks();
-	/* ping_timer->first now contains all active dialogs
-	ping all dialogs with a lower timeout than now */
-	lock_get(ping_timer->lock);
-	it = ping_timer->first;
-	while (it) {
-		/* iterated across all the nodes that need pinging now */
-		if (it->timeout > current_ticks)
-			break;
+	/* the detached nodes are not reachable by anybody else, so the
+	 * pinging is done without holding the timer lock */
+	tcp_no_new_conn = 1;
 
+	for (it = to_ping; it; it = it->next) {
 		dlg = it->dlg;
-		next=it->next;
 
-		if (dialog_repl_cluster && get_shtag_state(dlg) == SHTAG_STATE_BACKUP) {
-			it = next;
+		if (dialog_repl_cluster && get_shtag_state(dlg) == SHTAG_STATE_BACKUP)
 			continue;
-		}
 
-		/* do not ping ended dialogs - we might have missed them earlier or
-		 * might have terminated in the mean time - we'll clean them up on
-		 * our next iteration */
-		if (dlg->state != DLG_STATE_DELETED && it->timeout <= current_ticks) {
-			if (dlg->flags & DLG_FLAG_PING_CALLER) {
-				ref_dlg(dlg,1);
-				if (send_leg_msg(dlg,&options_str,callee_idx(dlg),
-				DLG_CALLER_LEG,0,0,reply_from_caller,dlg,unref_dlg_cb,
-				&dlg->legs[DLG_CALLER_LEG].reply_received, 0) < 0) {
-					LM_ERR("failed to ping caller\n");
-					unref_dlg(dlg,1);
-				}
+		if (dlg->flags & DLG_FLAG_PING_CALLER) {
+			ref_dlg(dlg,1);
+			if (send_leg_msg(dlg,&options_str,callee_idx(dlg),
+			DLG_CALLER_LEG,0,0,reply_from_caller,dlg,unref_dlg_cb,
+			&dlg->legs[DLG_CALLER_LEG].reply_received, 0) < 0) {
+				LM_ERR("failed to ping caller\n");
+				unref_dlg(dlg,1);
 			}
+		}
 
-			if (dlg->flags & DLG_FLAG_PING_CALLEE) {
-				ref_dlg(dlg,1);
-				if (send_leg_msg(dlg,&options_str,DLG_CALLER_LEG,
-				callee_idx(dlg),0,0,reply_from_callee,dlg,unref_dlg_cb,
-				&dlg->legs[callee_idx(dlg)].reply_received, 0) < 0) {
-					LM_ERR("failed to ping callee\n");
-					unref_dlg(dlg,1);
-				}
+		if (dlg->flags & DLG_FLAG_PING_CALLEE) {
+			ref_dlg(dlg,1);
+			if (send_leg_msg(dlg,&options_str,DLG_CALLER_LEG,
+			callee_idx(dlg),0,0,reply_from_callee,dlg,unref_dlg_cb,
+			&dlg->legs[callee_idx(dlg)].reply_received, 0) < 0) {
+				LM_ERR("failed to ping callee\n");
+				unref_dlg(dlg,1);
 			}
-
-			/* we've pinged, now update the timeout & move the entry further down the list */
-			detach_ping_node_unsafe(it,0);
-			unsafe_insert_ping_timer(it,options_ping_interval);
 		}
-		it = next;
 	}
 
-	lock_release(ping_timer->lock);
 	tcp_no_new_conn = 0;
+
+	/* we've pinged, now schedule the next ping */
+	rearm_ping_nodes(pt,to_ping,options_ping_interval,0);
 }
 
 #define CONTACT_STR_START "Contact: <"
@@ -1000,15 +873,56 @@ void dlg_options_routine(unsigned int ticks , void * attr)
 #define HEADERS_STR_END ">\r\nContent-Type: application/sdp\r\n"
 #define HEADERS_STR_END_LEN (sizeof(HEADERS_STR_END)-1)
 
-void dlg_reinvite_routine(unsigned int ticks , void * attr)
+/* sends the re-INVITE ping towards the "dst" leg of the dialog */
+static void reinvite_ping_leg(struct dlg_cell *dlg, int dst, int src,
+													dlg_request_callback reply_cb)
 {
-	struct dlg_ping_list *expired,*to_be_deleted,*it,*curr,*next;
-	struct dlg_cell *dlg;
 	str extra_headers;
 	char *p;
-	int current_ticks;
 
-	get_timeout_dlgs(&expired,&to_be_deleted,1);
+	if (dlg->legs[dst].adv_contact.len)
+		extra_headers.len = dlg->legs[dst].adv_contact.len +
+			HEADERS_STR_END_NOCRLF_LEN;
+	else
+		extra_headers.len = CONTACT_STR_START_LEN +
+			dlg->legs[src].contact.len + HEADERS_STR_END_LEN;
+	extra_headers.s = pkg_malloc(extra_headers.len);
+	if (!extra_headers.s) {
+		LM_ERR("No more pkg for extra headers \n");
+		return;
+	}
+
+	p = extra_headers.s;
+	if (dlg->legs[dst].adv_contact.len) {
+		memcpy(p,dlg->legs[dst].adv_contact.s,dlg->legs[dst].adv_contact.len);
+		p += dlg->legs[dst].adv_contact.len;
+		memcpy(p,HEADERS_STR_END_NOCRLF,HEADERS_STR_END_NOCRLF_LEN);
+	} else {
+		memcpy(p,CONTACT_STR_START,CONTACT_STR_START_LEN);
+		p += CONTACT_STR_START_LEN;
+		memcpy(p,dlg->legs[src].contact.s,dlg->legs[src].contact.len);
+		p += dlg->legs[src].contact.len;
+		memcpy(p,HEADERS_STR_END,HEADERS_STR_END_LEN);
+	}
+
+	ref_dlg(dlg,1);
+	if (send_leg_msg(dlg,&invite_str,src,dst,&extra_headers,
+	&dlg->legs[dst].adv_sdp,reply_cb,dlg,unref_dlg_cb,
+	&dlg->legs[dst].reinvite_confirmed, 1) < 0) {
+		LM_ERR("failed to ping %s\n", dst==DLG_CALLER_LEG?"caller":"callee");
+		unref_dlg(dlg,1);
+	}
+
+	pkg_free(extra_headers.s);
+}
+
+void dlg_reinvite_routine(unsigned int ticks , void * attr)
+{
+	struct dlg_ping_timer *pt = &reinvite_ping_timer[(long)attr];
+	struct dlg_ping_list *expired,*to_be_deleted,*to_ping,*it,*curr;
+	struct dlg_cell *dlg;
+
+	get_timeout_dlgs(pt,ticks,&expired,&to_be_deleted,&to_ping,1);
 
 	it = expired;
 	while (it) {
@@ -1039,131 +953,30 @@ void dlg_reinvite_routine(unsigned int ticks , void * attr)
 		it = curr;
 	}
 
-	tcp_no_new_conn = 1;
+	if (to_ping==NULL)
+		return;
 
-	current_ticks = get_ticks();
-	/* reinvite_ping_timer->first now contains all active dialogs
-	ping all dialogs with a lower timeout than now */
-	lock_get(reinvite_ping_timer->lock);
-	it = reinvite_ping_timer->first;
-	while (it) {
-		/* iterated across all the nodes that need pinging now */
-		if (it->timeout > current_ticks)
-			break;
+	/* the detached nodes are not reachable by anybody else, so the
+	 * pinging is done without holding the timer lock */
+	tcp_no_new_conn = 1;
 
+	for (it = to_ping; it; it = it->next) {
 		dlg = it->dlg;
-		next=it->next;
 
-		if (dialog_repl_cluster && get_shtag_state(dlg) == SHTAG_STATE_BACKUP) {
-			it = next;
+		if (dialog_repl_cluster && get_shtag_state(dlg) == SHTAG_STATE_BACKUP)
 			continue;
-		}
 
-		/* do not ping ended dialogs - we might have missed them earlier or
-		 * might have terminated in the mean time - we'll clean them up on
-		 * our next iteration */
-		if (dlg->state != DLG_STATE_DELETED && it->timeout <= current_ticks) {
-			if (dlg->flags & DLG_FLAG_REINVITE_PING_CALLER) {
-
-				if (dlg->legs[DLG_CALLER_LEG].adv_contact.len)
-					extra_headers.len = 
-					dlg->legs[DLG_CALLER_LEG].adv_contact.len +
-					HEADERS_STR_END_NOCRLF_LEN;
-				else
-					extra_headers.len = CONTACT_STR_START_LEN +
-						dlg->legs[callee_idx(dlg)].contact.len +
-						HEADERS_STR_END_LEN;
-				extra_headers.s = pkg_malloc(extra_headers.len);
-				if (!extra_headers.s) {
-					LM_ERR("No more pkg for extra headers \n");
-					it = it->next;
-					return;
-				}
-
-				if (dlg->legs[DLG_CALLER_LEG].adv_contact.len) {
-					p = extra_headers.s;
-					memcpy(p,dlg->legs[DLG_CALLER_LEG].adv_contact.s,
-					dlg->legs[DLG_CALLER_LEG].adv_contact.len);
-
-					p+= dlg->legs[DLG_CALLER_LEG].adv_contact.len;
-					memcpy(p,HEADERS_STR_END_NOCRLF,HEADERS_STR_END_NOCRLF_LEN);
-				} else {
-					p = extra_headers.s;
-					memcpy(p,CONTACT_STR_START,CONTACT_STR_START_LEN);
-					p += CONTACT_STR_START_LEN;
-					memcpy(p,dlg->legs[callee_idx(dlg)].contact.s,
-					dlg->legs[callee_idx(dlg)].contact.len);
-
-					p += dlg->legs[callee_idx(dlg)].contact.len;
-					memcpy(p,HEADERS_STR_END,HEADERS_STR_END_LEN);
-				}
-				
-				ref_dlg(dlg,1);
-				if (send_leg_msg(dlg,&invite_str,callee_idx(dlg),
-				DLG_CALLER_LEG,&extra_headers,&dlg->legs[DLG_CALLER_LEG].adv_sdp,
-				reinvite_reply_from_caller,dlg,unref_dlg_cb,
-				&dlg->legs[DLG_CALLER_LEG].reinvite_confirmed, 1) < 0) {
-					LM_ERR("failed to ping caller\n");
-					unref_dlg(dlg,1);
-				}
-
-				pkg_free(extra_headers.s);
-			}
-
-
-			if (dlg->flags & DLG_FLAG_REINVITE_PING_CALLEE) {
-				if (dlg->legs[callee_idx(dlg)].adv_contact.len)
-					extra_headers.len = 
-					dlg->legs[callee_idx(dlg)].adv_contact.len +
-					HEADERS_STR_END_NOCRLF_LEN;
-				else
-					extra_headers.len = CONTACT_STR_START_LEN +
-							dlg->legs[DLG_CALLER_LEG].contact.len +
-							HEADERS_STR_END_LEN;
-				extra_headers.s = pkg_malloc(extra_headers.len);
-				if (!extra_headers.s) {
-					LM_ERR("No more pkg for extra headers \n");
-					it = it->next;
-					return ;
-				}
-						
-				if (dlg->legs[callee_idx(dlg)].adv_contact.len) {
-					p = extra_headers.s;
-					memcpy(extra_headers.s,
-					dlg->legs[callee_idx(dlg)].adv_contact.s,
-					dlg->legs[callee_idx(dlg)].adv_contact.len);
-
-					p+= dlg->legs[callee_idx(dlg)].adv_contact.len;
-					memcpy(p,HEADERS_STR_END_NOCRLF,HEADERS_STR_END_NOCRLF_LEN);
-				} else {
-					p = extra_headers.s;
-					memcpy(p,CONTACT_STR_START,CONTACT_STR_START_LEN);
-					p += CONTACT_STR_START_LEN;
-					memcpy(p,dlg->legs[DLG_CALLER_LEG].contact.s,
-					dlg->legs[DLG_CALLER_LEG].contact.len);
-
-					p += dlg->legs[DLG_CALLER_LEG].contact.len;
-					memcpy(p,HEADERS_STR_END,HEADERS_STR_END_LEN);
-				}
-
-				ref_dlg(dlg,1);
-				if (send_leg_msg(dlg,&invite_str,DLG_CALLER_LEG,
-				callee_idx(dlg),&extra_headers,&dlg->legs[callee_idx(dlg)].adv_sdp,reinvite_reply_from_callee,
-				dlg,unref_dlg_cb,&dlg->legs[callee_idx(dlg)].reinvite_confirmed, 1) < 0) {
-					LM_ERR("failed to ping callee\n");
-					unref_dlg(dlg,1);
-				}
-
-				pkg_free(extra_headers.s);
-			}
+		if (dlg->flags & DLG_FLAG_REINVITE_PING_CALLER)
+			reinvite_ping_leg(dlg, DLG_CALLER_LEG, callee_idx(dlg),
+				reinvite_reply_from_caller);
 
-			/* we've pinged, now update the timeout & move the entry further down the list */
-			detach_ping_node_unsafe(it,1);
-			unsafe_insert_reinvite_ping_timer(it,reinvite_ping_interval);
-		}
-		it = next;
+		if (dlg->flags & DLG_FLAG_REINVITE_PING_CALLEE)
+			reinvite_ping_leg(dlg, callee_idx(dlg), DLG_CALLER_LEG,
+				reinvite_reply_from_callee);
 	}
 
-	lock_release(reinvite_ping_timer->lock);
 	tcp_no_new_conn = 0;
+
+	/* we've pinged, now schedule the next ping */
+	rearm_ping_nodes(pt,to_ping,reinvite_ping_interval,1);
 }
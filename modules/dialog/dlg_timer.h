@@ -28,12 +28,15 @@
 
 
 #include "../../locking.h"
+#include "../../lib/timer_wheel.h"
 
 
 struct dlg_tl
 {
+	/* linkage into the timing wheel of its shard */
+	struct tw_link    tw;
+	/* linkage into the list of expired dialogs, once detached */
 	struct dlg_tl     *next;
-	struct dlg_tl     *prev;
 #ifdef EXTRA_DEBUG
 	int visited;
 #endif
@@ -41,33 +44,30 @@ struct dlg_tl
 };
 
 
+/* one shard of the dialog timer */
 struct  dlg_timer
 {
-	struct dlg_tl   first;
+	struct timer_wheel wheel;
 	gen_lock_t      *lock;
 };
 
 struct dlg_ping_list
 {
+	/* linkage into the timing wheel of its shard */
+	struct tw_link tw;
 	struct dlg_cell* dlg;
 	volatile unsigned int timeout;
 	struct dlg_ping_list *next;
-	struct dlg_ping_list *prev;
 };
 
+/* one shard of the OPTIONS or re-INVITE ping timer */
 struct dlg_ping_timer
 {
-	struct dlg_ping_list *first;
-	struct dlg_ping_list *last;
+	struct timer_wheel wheel;
 	gen_lock_t *lock;
 };
 
-struct dlg_reinvite_ping_timer
-{
-	struct dlg_ping_list *first;
-	struct dlg_ping_list *last;
-	gen_lock_t *lock;
-};
+extern int dlg_timer_shards;
 
 typedef void (*dlg_timer_handler)(struct dlg_tl *);
 
@@ -93,6 +93,7 @@ int remove_ping_timer(struct dlg_cell *dlg);
 
 int update_dlg_timer( struct dlg_tl *tl, int timeout );
 
+/* "attr" is the index of the shard to be processed */
 void dlg_timer_routine(unsigned int ticks , void * attr);
 
 void dlg_options_routine(unsigned int ticks , void * attr);
@@ -56,6 +56,7 @@
 #define DP_CHAR_SCOLON     ';'
 #define DP_TYPE_URL 	    0
 #define DP_TYPE_TABLE 	    1
+#define DP_MAX_ROUNDS       1000000
 #define is_space(p) (*(p) == ' ' || *(p) == '\t' || \
 					 *(p) == '\r' || *(p) == '\n')
 
@@ -1000,6 +1001,7 @@ static struct mi_root * mi_reload_rules(struct mi_root *cmd_tree, void *param)
  *  mi cmd:  dp_translate
  *			<dialplan id>
  *			<input>
+ *			[rounds]
  *		* */
 
 static struct mi_root * mi_translate(struct mi_root *cmd, void *param)
@@ -1013,6 +1015,11 @@ static struct mi_root * mi_translate(struct mi_root *cmd, void *param)
 	int dpid;
 	str attrs;
 	str output= {0, 0};
+	str rounds_str = {NULL, 0};
+	unsigned int rounds = 1, i;
+	struct timeval start;
+	long long usec = 0;
+	int rc;
 	dp_connection_list_p connection = NULL;
 
 	node = cmd->node.kids;
@@ -1054,35 +1061,56 @@ static struct mi_root * mi_translate(struct mi_root *cmd, void *param)
 	if(node == NULL)
 		return init_mi_tree( 400, MI_MISSING_PARM_S, MI_MISSING_PARM_LEN);
 
-	if(node->next!= NULL)
-		return init_mi_tree( 400, MI_MISSING_PARM_S, MI_MISSING_PARM_LEN);
-
 	input = node->value;
 	if(input.s == NULL || input.len== 0)	{
 		LM_ERR( "empty input parameter\n");
 		return init_mi_tree(404, "Empty input parameter", 21);
 	}
 
-	/* ref the data for reading */
-	lock_start_read( connection->ref_lock );
-
-	if ((idp = select_dpid(connection, dpid, connection->crt_index)) ==0 ){
-		LM_ERR("no information available for dpid %i\n", dpid);
-		lock_stop_read( connection->ref_lock );
-		return init_mi_tree(404, "No information available for dpid", 33);
+	/* optionally, repeat the translation to measure it */
+	node = node->next;
+	if(node != NULL) {
+		if(node->next != NULL)
+			return init_mi_tree( 400, MI_MISSING_PARM_S, MI_MISSING_PARM_LEN);
+
+		rounds_str = node->value;
+		if(str2int(&rounds_str, &rounds) != 0 || rounds == 0 ||
+		rounds > DP_MAX_ROUNDS) {
+			LM_ERR("Wrong rounds parameter - should be an integer "
+				"between 1 and %d\n", DP_MAX_ROUNDS);
+			return init_mi_tree(404, "Wrong rounds parameter", 22);
+		}
 	}
 
-	if (translate(NULL, input, &output, idp, &attrs)!=0){
-		LM_DBG("could not translate %.*s with dpid %i\n",
-			input.len, input.s, idp->dp_id);
+	/* each round refs the data on its own, so that a long benchmark
+	 * does not hold back a reload */
+	for (i = 0; i < rounds; i++) {
+		/* ref the data for reading */
+		lock_start_read( connection->ref_lock );
+
+		idp = select_dpid(connection, dpid, connection->crt_index);
+		if (idp == 0) {
+			LM_ERR("no information available for dpid %i\n", dpid);
+			lock_stop_read( connection->ref_lock );
+			return init_mi_tree(404, "No information available for dpid", 33);
+		}
+
+		gettimeofday(&start, NULL);
+		rc = translate(NULL, input, &output, idp, &attrs);
+		usec += get_time_diff(&start);
+
+		/* we are done reading -> unref the data */
 		lock_stop_read( connection->ref_lock );
-		return init_mi_tree(404, "No translation", 14);
+
+		if (rc != 0) {
+			LM_DBG("could not translate %.*s with dpid %i\n",
+				input.len, input.s, dpid);
+			return init_mi_tree(404, "No translation", 14);
+		}
 	}
-	/* we are done reading -> unref the data */
-	lock_stop_read( connection->ref_lock );
 
 	LM_DBG("input %.*s with dpid %i => output %.*s\n",
-			input.len, input.s, idp->dp_id, output.len, output.s);
+			input.len, input.s, dpid, output.len, output.s);
 
 	rpl = init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
 	if (rpl==0)
@@ -1098,6 +1126,17 @@ static struct mi_root * mi_translate(struct mi_root *cmd, void *param)
 	if( node == NULL)
 		goto error;
 
+	if (rounds_str.s) {
+		node = addf_mi_node_child(root, 0, "Rounds", 6, "%u", rounds);
+		if( node == NULL)
+			goto error;
+
+		node = addf_mi_node_child(root, 0, "Avg_usec", 8, "%.3f",
+			(double)usec / rounds);
+		if( node == NULL)
+			goto error;
+	}
+
 	return rpl;
 
 error:
@@ -1151,6 +1190,31 @@ pcre * wrap_pcre_compile(char *  pattern, int flags)
 		return ret;
 }
 
+/* no JIT: its code would be private to the process (re)loading the rules */
+pcre_extra * wrap_pcre_study(pcre * re)
+{
+		pcre_extra * ret;
+		func_malloc old_malloc ;
+		func_free old_free;
+		const char * error = NULL;
+
+		old_malloc = pcre_malloc;
+		old_free = pcre_free;
+
+		pcre_malloc = wrap_shm_malloc;
+		pcre_free = wrap_shm_free;
+
+		ret = pcre_study(re, 0, &error);
+
+		pcre_malloc = old_malloc;
+		pcre_free = old_free;
+
+		if (error)
+			LM_WARN("failed to study the pattern: %s\n", error);
+
+		return ret;
+}
+
 void wrap_pcre_free( pcre* re)
 {
 	shm_free(re);
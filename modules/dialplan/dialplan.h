@@ -49,12 +49,15 @@ typedef struct dpl_node{
 	int match_flags;
 	str match_exp, subst_exp, repl_exp; /*keeping the original strings*/
 	pcre * match_comp, * subst_comp; /*compiled patterns*/
+	pcre_extra * match_extra; /*study data of the match pattern*/
 	struct subst_expr * repl_comp;
 	str attrs;
 	str timerec;
 	tmrec_t *parsed_timerec;
+	int order; /*position among the regexp rules of the dpid*/
 
 	struct dpl_node * next; /*next rule*/
+	struct dpl_node * next_match; /*next rule in the same matcher bucket*/
 }dpl_node_t, *dpl_node_p;
 
 /* HASH_SIZE	buckets of matching strings (lowercase hashing)
@@ -65,10 +68,43 @@ typedef struct dpl_index{
 
 }dpl_index_t, *dpl_index_p;
 
+/* longest literal prefix of a regexp used to index it */
+#define DP_MAX_PREFIX_LEN		16
+
+/* regexp rules whose matches start with the same literal string */
+typedef struct dpl_prefix{
+	str prefix;
+	unsigned int hash;
+	dpl_index_t rules;
+	struct dpl_prefix * next;
+}dpl_prefix_t, *dpl_prefix_p;
+
+/* all the rules of a DPID, indexed once loaded; the rules of any bucket
+   are chained (next_match) in the order of the table */
+typedef struct dpl_matcher{
+	/* EQUAL_OP rules, hashed by their (lowercase) string */
+	unsigned int eq_size;
+	dpl_index_t * eq_hash;
+	/* REGEX_OP rules anchored by a literal prefix, hashed by it */
+	unsigned int pfx_size;
+	unsigned int pfx_max_len;
+	dpl_prefix_t ** pfx_hash;
+	/* REGEX_OP rules to be tried against any input */
+	dpl_index_t any;
+
+	unsigned int eq_rules, pfx_rules, any_rules;
+}dpl_matcher_t, *dpl_matcher_p;
+
+/* incremental hash of a prefix, char by char */
+#define DP_PREFIX_HASH_INIT		2166136261u
+#define dp_prefix_hash_next(_h, _c) \
+	(((_h) ^ (unsigned char)(_c)) * 16777619u)
+
 /*For every DPID*/
 typedef struct dpl_id{
 	int dp_id;
 	dpl_index_t* rule_hash;/*fast access :string rules are hashed*/
+	struct dpl_matcher *matcher;/*all the rules, indexed for lookups*/
 	struct dpl_id * next;
 }dpl_id_t,*dpl_id_p;
 
@@ -121,7 +157,8 @@ struct subst_expr* repl_exp_parse(str subst);
 void repl_expr_free(struct subst_expr *se);
 int translate(struct sip_msg *msg, str user_name, str* repl_user, dpl_id_p idp, str *);
 int rule_translate(struct sip_msg *msg, str , dpl_node_t * rule,  str *);
-int test_match(str string, pcre * exp, int * out, int out_max);
+int test_match(str string, pcre * exp, pcre_extra * extra,
+		int * out, int out_max);
 
 
 typedef void * (*func_malloc)(size_t );
@@ -132,6 +169,7 @@ void  wrap_shm_free(void *);
 
 
 pcre * wrap_pcre_compile(char *  pattern, int flags);
+pcre_extra * wrap_pcre_study(pcre * re);
 void wrap_pcre_free( pcre*);
 
 
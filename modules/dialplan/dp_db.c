@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "../../dprint.h"
 #include "../../ut.h"
@@ -67,6 +68,8 @@ str timerec_column       =   str_init(TIMEREC_COL);
 
 void destroy_rule(dpl_node_t * rule);
 void destroy_hash(dpl_id_t **rules_hash);
+int build_matcher(dpl_id_t *idp);
+void destroy_matcher(dpl_matcher_t *m);
 
 dpl_node_t * build_rule(db_val_t * values);
 int add_rule2hash(dpl_node_t * rule, dp_connection_list_t *table, int index);
@@ -281,6 +284,7 @@ int dp_load_db(dp_connection_list_p dp_conn)
 	db_val_t cond_val[1];
 
 	dpl_node_t *rule;
+	dpl_id_t *idp;
 	int no_rows = 10;
 
 
@@ -378,6 +382,12 @@ int dp_load_db(dp_connection_list_p dp_conn)
 
 
 end:
+	for (idp = dp_conn->hash[dp_conn->next_index]; idp; idp = idp->next)
+		if (build_matcher(idp) != 0) {
+			LM_ERR("failed to index the rules of dpid %d\n", idp->dp_id);
+			rule = NULL;
+			goto err2;
+		}
 
 
 	/*update data*/
@@ -483,6 +493,7 @@ dpl_node_t * build_rule(db_val_t * values)
 {
 	tmrec_t *parsed_timerec;
 	pcre * match_comp, *subst_comp;
+	pcre_extra * match_extra;
 	struct subst_expr * repl_comp;
 	dpl_node_t * new_rule;
 	str match_exp, subst_exp, repl_exp, attrs, timerec;
@@ -498,6 +509,7 @@ dpl_node_t * build_rule(db_val_t * values)
 
 	parsed_timerec = 0;
 	match_comp = subst_comp = 0;
+	match_extra = 0;
 	repl_comp = 0;
 	new_rule = 0;
 
@@ -514,6 +526,9 @@ dpl_node_t * build_rule(db_val_t * values)
 				match_exp.len, match_exp.s);
 			goto err;
 		}
+
+		/* tried against many inputs, so worth studying */
+		match_extra = wrap_pcre_study(match_comp);
 	}
 
 	LM_DBG("building subst rule\n");
@@ -608,6 +623,9 @@ dpl_node_t * build_rule(db_val_t * values)
 	if (match_comp)
 		new_rule->match_comp = match_comp;
 
+	if (match_extra)
+		new_rule->match_extra = match_extra;
+
 	if (subst_comp)
 		new_rule->subst_comp = subst_comp;
 
@@ -619,6 +637,7 @@ dpl_node_t * build_rule(db_val_t * values)
 err:
 	if(parsed_timerec)	shm_free(parsed_timerec);
 	if(match_comp)		wrap_pcre_free(match_comp);
+	if(match_extra)		shm_free(match_extra);
 	if(subst_comp)		wrap_pcre_free(subst_comp);
 	if(repl_comp)		repl_expr_free(repl_comp);
 	if(new_rule)		destroy_rule(new_rule);
@@ -730,6 +749,9 @@ void destroy_hash(dpl_id_t **rules_hash)
 		}
 		*rules_hash = crt_idp->next;
 
+		if (crt_idp->matcher)
+			destroy_matcher(crt_idp->matcher);
+
 		shm_free(crt_idp);
 		crt_idp = NULL;
 	}
@@ -749,6 +771,9 @@ void destroy_rule(dpl_node_t * rule){
 	if(rule->match_comp)
 		wrap_pcre_free(rule->match_comp);
 
+	if(rule->match_extra)
+		shm_free(rule->match_extra);
+
 	if(rule->subst_comp)
 		wrap_pcre_free(rule->subst_comp);
 
@@ -776,6 +801,185 @@ void destroy_rule(dpl_node_t * rule){
 }
 
 
+static inline void dp_index_append(dpl_index_p indexp, dpl_node_p rule)
+{
+	rule->next_match = NULL;
+	if (indexp->last_rule)
+		indexp->last_rule->next_match = rule;
+	else
+		indexp->first_rule = rule;
+	indexp->last_rule = rule;
+}
+
+
+/* the literal string any match of a regexp rule starts with, if any */
+static int dp_regexp_prefix(dpl_node_t *rule, char *buf)
+{
+	char *p, *end;
+	int len = 0;
+
+	p = rule->match_exp.s;
+	end = p + rule->match_exp.len;
+	if (p == end || *p != '^')
+		return 0;
+
+	/* an alternative may match without the prefix */
+	if (memchr(p, '|', end - p))
+		return 0;
+
+	for (p++; p < end && len < DP_MAX_PREFIX_LEN; p++) {
+		if (*p == '\\') {
+			/* only an escaped punctuation char stands for itself */
+			if (p + 1 == end || !ispunct((unsigned char)p[1]))
+				break;
+			p++;
+		} else if (strchr("^$.[]|()?*+{}", *p)) {
+			break;
+		} else if ((rule->match_flags & DP_CASE_INSENSITIVE) &&
+		isalpha((unsigned char)*p)) {
+			break;
+		}
+
+		buf[len++] = *p;
+	}
+
+	/* the last literal may be optional */
+	if (len && p < end && (*p == '?' || *p == '*' || *p == '{'))
+		len--;
+
+	return len;
+}
+
+
+static dpl_prefix_p dp_get_prefix(dpl_matcher_p m, char *prefix, int len)
+{
+	dpl_prefix_p pfx;
+	unsigned int h;
+	int i;
+
+	for (h = DP_PREFIX_HASH_INIT, i = 0; i < len; i++)
+		h = dp_prefix_hash_next(h, prefix[i]);
+
+	for (pfx = m->pfx_hash[h & (m->pfx_size - 1)]; pfx; pfx = pfx->next)
+		if (pfx->hash == h && pfx->prefix.len == len &&
+		memcmp(pfx->prefix.s, prefix, len) == 0)
+			return pfx;
+
+	pfx = shm_malloc(sizeof(dpl_prefix_t) + len);
+	if (!pfx) {
+		LM_ERR("out of shm memory (prefix)\n");
+		return NULL;
+	}
+	memset(pfx, 0, sizeof(dpl_prefix_t));
+
+	pfx->prefix.s = (char *)(pfx + 1);
+	memcpy(pfx->prefix.s, prefix, len);
+	pfx->prefix.len = len;
+	pfx->hash = h;
+
+	pfx->next = m->pfx_hash[h & (m->pfx_size - 1)];
+	m->pfx_hash[h & (m->pfx_size - 1)] = pfx;
+
+	if (len > m->pfx_max_len)
+		m->pfx_max_len = len;
+
+	return pfx;
+}
+
+
+/* indexes all the loaded rules of a dpid for translate() */
+int build_matcher(dpl_id_t *idp)
+{
+	dpl_matcher_p m;
+	dpl_node_p rule;
+	dpl_prefix_p pfx;
+	char prefix[DP_MAX_PREFIX_LEN];
+	unsigned int eq_rules = 0, re_rules = 0, i;
+	int len, order = 0;
+
+	for (i = 0; i < DP_INDEX_HASH_SIZE; i++)
+		for (rule = idp->rule_hash[i].first_rule; rule; rule = rule->next)
+			eq_rules++;
+
+	for (rule = idp->rule_hash[DP_INDEX_HASH_SIZE].first_rule; rule;
+	rule = rule->next)
+		re_rules++;
+
+	m = shm_malloc(sizeof(dpl_matcher_t));
+	if (!m) {
+		LM_ERR("out of shm memory (matcher)\n");
+		return -1;
+	}
+	memset(m, 0, sizeof(dpl_matcher_t));
+
+	/* about one rule per bucket */
+	for (m->eq_size = DP_INDEX_HASH_SIZE; m->eq_size < eq_rules;
+	m->eq_size <<= 1);
+	for (m->pfx_size = DP_INDEX_HASH_SIZE; m->pfx_size < re_rules;
+	m->pfx_size <<= 1);
+
+	m->eq_hash = shm_malloc(m->eq_size * sizeof(dpl_index_t) +
+		m->pfx_size * sizeof(dpl_prefix_p));
+	if (!m->eq_hash) {
+		LM_ERR("out of shm memory (matcher buckets)\n");
+		shm_free(m);
+		return -1;
+	}
+	memset(m->eq_hash, 0, m->eq_size * sizeof(dpl_index_t) +
+		m->pfx_size * sizeof(dpl_prefix_p));
+	m->pfx_hash = (dpl_prefix_p *)(m->eq_hash + m->eq_size);
+
+	idp->matcher = m;
+
+	/* equal strings share a bucket of rule_hash, so their order is kept */
+	for (i = 0; i < DP_INDEX_HASH_SIZE; i++)
+		for (rule = idp->rule_hash[i].first_rule; rule; rule = rule->next)
+			dp_index_append(&m->eq_hash[core_case_hash(&rule->match_exp,
+				NULL, m->eq_size)], rule);
+	m->eq_rules = eq_rules;
+
+	for (rule = idp->rule_hash[DP_INDEX_HASH_SIZE].first_rule; rule;
+	rule = rule->next) {
+		rule->order = order++;
+
+		len = dp_regexp_prefix(rule, prefix);
+		if (len == 0) {
+			dp_index_append(&m->any, rule);
+			m->any_rules++;
+			continue;
+		}
+
+		if (!(pfx = dp_get_prefix(m, prefix, len)))
+			return -1;
+
+		dp_index_append(&pfx->rules, rule);
+		m->pfx_rules++;
+	}
+
+	LM_DBG("dpid %d: %u string rules in %u buckets, %u regexp rules "
+		"by prefix, %u regexp rules to always try\n", idp->dp_id,
+		m->eq_rules, m->eq_size, m->pfx_rules, m->any_rules);
+
+	return 0;
+}
+
+
+void destroy_matcher(dpl_matcher_t *m)
+{
+	dpl_prefix_p pfx;
+	unsigned int i;
+
+	for (i = 0; i < m->pfx_size; i++)
+		while ((pfx = m->pfx_hash[i])) {
+			m->pfx_hash[i] = pfx->next;
+			shm_free(pfx);
+		}
+
+	shm_free(m->eq_hash);
+	shm_free(m);
+}
+
+
 dpl_id_p select_dpid(dp_connection_list_p conn, int id, int index)
 {
 	dpl_id_p idp;
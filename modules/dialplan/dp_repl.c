@@ -148,7 +148,8 @@ int rule_translate(struct sip_msg *msg, str string, dpl_node_t * rule,
 		}
 
 		/*search for the pattern from the compiled subst_exp*/
-		if(test_match(string, rule->subst_comp,matches,MAX_MATCHES) <= 0){
+		if(test_match(string, rule->subst_comp, NULL, matches,
+		MAX_MATCHES) <= 0){
 			LM_ERR("the string %.*s "
 				"matched the match_exp %.*s but not the subst_exp %.*s!\n",
 				string.len, string.s,
@@ -360,6 +361,55 @@ static inline int check_time(tmrec_t *time_rec) {
 	return 1;
 }
 
+/*
+ * the first regexp rule (in table order) matching the input, out of the
+ * ones to always try and the ones anchored by a prefix of the input
+ */
+static dpl_node_p match_regexp(dpl_matcher_p m, str input)
+{
+	dpl_node_p heads[DP_MAX_PREFIX_LEN + 1], rule;
+	dpl_prefix_p pfx;
+	unsigned int h;
+	int n = 0, i, best, len, max_len;
+
+	if (m->any.first_rule)
+		heads[n++] = m->any.first_rule;
+
+	max_len = input.len < (int)m->pfx_max_len ? input.len : m->pfx_max_len;
+	for (len = 1, h = DP_PREFIX_HASH_INIT; len <= max_len; len++) {
+		h = dp_prefix_hash_next(h, input.s[len - 1]);
+
+		for (pfx = m->pfx_hash[h & (m->pfx_size - 1)]; pfx; pfx = pfx->next)
+			if (pfx->hash == h && pfx->prefix.len == len &&
+			memcmp(pfx->prefix.s, input.s, len) == 0) {
+				heads[n++] = pfx->rules.first_rule;
+				break;
+			}
+	}
+
+	/* walk the candidate lists merged by the order of the rules */
+	while (n > 0) {
+		for (best = 0, i = 1; i < n; i++)
+			if (heads[i]->order < heads[best]->order)
+				best = i;
+		rule = heads[best];
+
+		if (rule->parsed_timerec && !check_time(rule->parsed_timerec)) {
+			LM_DBG("Time rule doesn't match: skip next!\n");
+		} else if (test_match(input, rule->match_comp, rule->match_extra,
+		matches, MAX_MATCHES) >= 0) {
+			LM_DBG("Regex rule %.*s matched\n",
+				rule->match_exp.len, rule->match_exp.s);
+			return rule;
+		}
+
+		if (!(heads[best] = rule->next_match))
+			heads[best] = heads[--n];
+	}
+
+	return NULL;
+}
+
 #define DP_MAX_ATTRS_LEN	256
 static char dp_attrs_buf[DP_MAX_ATTRS_LEN+1];
 int translate(struct sip_msg *msg, str input, str * output, dpl_id_p idp, str * attrs) {
@@ -372,10 +422,11 @@ int translate(struct sip_msg *msg, str input, str * output, dpl_id_p idp, str *
 		return -1;
 	}
 
-	bucket = core_case_hash(&input, NULL, DP_INDEX_HASH_SIZE);
+	bucket = core_case_hash(&input, NULL, idp->matcher->eq_size);
 
 	/* try to match the input in the corresponding string bucket */
-	for (rulep = idp->rule_hash[bucket].first_rule; rulep; rulep=rulep->next) {
+	for (rulep = idp->matcher->eq_hash[bucket].first_rule; rulep;
+	rulep = rulep->next_match) {
 
 		LM_DBG("Equal operator testing\n");
 
@@ -407,28 +458,10 @@ int translate(struct sip_msg *msg, str input, str * output, dpl_id_p idp, str *
 		}
 	}
 
-	/* try to match the input in the regexp bucket */
-	for (rrulep = idp->rule_hash[DP_INDEX_HASH_SIZE].first_rule; rrulep; rrulep=rrulep->next) {
-
-		// Check for Time Period if Set
-		if(rrulep->parsed_timerec) {
-			LM_DBG("Timerec exists for rule checking: %.*s\n", rrulep->timerec.len, rrulep->timerec.s);
-			// Doesn't matches time period continue with next rule
-			if(!check_time(rrulep->parsed_timerec)) {
-				LM_DBG("Time rule doesn't match: skip next!\n");
-				continue;
-			}
-		}
-
-		regexp_res = (test_match(input, rrulep->match_comp, matches, MAX_MATCHES)
-					>= 0 ? 0 : -1);
-
-		LM_DBG("Regex operator testing. Got result: %d\n", regexp_res);
-
-		if (regexp_res == 0) {
-			break;
-		}
-	}
+	/* try to match the input against the regexps */
+	rrulep = match_regexp(idp->matcher, input);
+	if (rrulep)
+		regexp_res = 0;
 
 	if (string_res != 0 && regexp_res != 0) {
 		LM_DBG("No matching rule for input %.*s\n", input.len, input.s);
@@ -483,7 +516,8 @@ int translate(struct sip_msg *msg, str input, str * output, dpl_id_p idp, str *
 }
 
 
-int test_match(str string, pcre * exp, int * out, int out_max)
+int test_match(str string, pcre * exp, pcre_extra * extra,
+		int * out, int out_max)
 {
 	int i, result_count;
 	char *substring_start;
@@ -498,7 +532,7 @@ int test_match(str string, pcre * exp, int * out, int out_max)
 
 	result_count = pcre_exec(
 							exp, /* the compiled pattern */
-							NULL, /* no extra data - we didn't study the pattern */
+							extra, /* the study data, if any */
 							string.s, /* the subject string */
 							string.len, /* the length of the subject */
 							0, /* start at offset 0 in the subject */
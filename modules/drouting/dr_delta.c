@@ -0,0 +1,545 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Project
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "../../dprint.h"
+#include "../../ut.h"
+#include "../../map.h"
+#include "../../mem/mem.h"
+#include "../../mem/shm_mem.h"
+#include "../../time_rec.h"
+#include "dr_load.h"
+#include "dr_delta.h"
+
+
+int dr_delta_type(str *name)
+{
+	static str gw = str_init("gw");
+	static str carrier = str_init("carrier");
+	static str rule = str_init("rule");
+
+	if (str_match(name, &gw))
+		return DR_DELTA_GW;
+	if (str_match(name, &carrier))
+		return DR_DELTA_CARRIER;
+	if (str_match(name, &rule))
+		return DR_DELTA_RULE;
+	return -1;
+}
+
+
+/* The elements of the old generation replaced in the new one are kept in
+ * a (pkg) map, indexed by their address; a NULL replacement means the
+ * element was dropped */
+
+#define REMAP_KEY_LEN (2 * sizeof(void*))
+
+/* the map compares the keys as strings, so the address is hex printed */
+static inline void remap_key(str *key, void *p, char *buf)
+{
+	unsigned long a = (unsigned long)p;
+	int i;
+
+	for (i = REMAP_KEY_LEN - 1; i >= 0; i--, a >>= 4)
+		buf[i] = "0123456789abcdef"[a & 0xf];
+	key->s = buf;
+	key->len = REMAP_KEY_LEN;
+}
+
+static inline int remap_put(map_t remap, void *old, void *new)
+{
+	char buf[REMAP_KEY_LEN];
+	void **val;
+	str key;
+
+	remap_key(&key, old, buf);
+	if ( (val=map_get(remap, key))==NULL ) {
+		LM_ERR("no more pkg mem\n");
+		return -1;
+	}
+	*val = new;
+	return 0;
+}
+
+static inline int remap_get(map_t remap, void *old, void **new)
+{
+	char buf[REMAP_KEY_LEN];
+	void **val;
+	str key;
+
+	remap_key(&key, old, buf);
+	if ( (val=map_find(remap, key))==NULL )
+		return 0;
+	*new = *val;
+	return 1;
+}
+
+
+/* re-points a destination list to the replacing gateways/carriers,
+ * dropping the removed ones; returns 1 if a new list was built, 0 if the
+ * list is not affected and -1 on error */
+static int remap_pgwl(map_t remap, pgw_list_t *pgwl, unsigned short len,
+		pgw_list_t **new_pgwl, unsigned short *new_len)
+{
+	pgw_list_t *p;
+	void *rep;
+	unsigned short i, n;
+
+	for (i = 0; i < len; i++)
+		if (remap_get(remap, pgwl[i].dst.gw, &rep))
+			break;
+	if (i == len)
+		return 0;
+
+	*new_pgwl = NULL;
+	*new_len = 0;
+
+	p = (pgw_list_t*)shm_malloc(len * sizeof(pgw_list_t));
+	if (p == NULL) {
+		LM_ERR("no more shm mem\n");
+		return -1;
+	}
+
+	for (i = 0, n = 0; i < len; i++) {
+		p[n] = pgwl[i];
+		if (remap_get(remap, pgwl[i].dst.gw, &rep)) {
+			if (rep == NULL)
+				continue;
+			p[n].dst.gw = rep;
+		}
+		n++;
+	}
+
+	if (n == 0) {
+		shm_free(p);
+		return 1;
+	}
+
+	*new_pgwl = p;
+	*new_len = n;
+	return 1;
+}
+
+
+/* the replacement of a destination list: as remap_pgwl(), but the list is
+ * resolved again, against the new generation, if it refers the newly
+ * added gateway/carrier "added" (dropped by the previous loads, as it was
+ * not found) */
+static int derive_pgwl(map_t remap, rt_data_t *rdata, str *added,
+		int added_carrier, str *dstlist, pgw_list_t *pgwl,
+		unsigned short len, pgw_list_t **new_pgwl, unsigned short *new_len)
+{
+	if (added && dstlist->s &&
+	dst_list_has_id(dstlist->s, added, added_carrier)) {
+		if (parse_destination_list(rdata, dstlist->s, new_pgwl, new_len,
+		0) != 0) {
+			LM_ERR("failed to parse the destinations\n");
+			return -1;
+		}
+		return 1;
+	}
+
+	return remap_pgwl(remap, pgwl, len, new_pgwl, new_len);
+}
+
+
+static tr_byxxx_p dup_byxxx(tr_byxxx_p bx)
+{
+	tr_byxxx_p nbx;
+
+	if ( (nbx=tr_byxxx_new(SHM_ALLOC))==NULL )
+		return NULL;
+
+	if (bx->nr) {
+		if (tr_byxxx_init(nbx, bx->nr) < 0) {
+			tr_byxxx_free(nbx);
+			return NULL;
+		}
+		memcpy(nbx->xxx, bx->xxx, bx->nr * sizeof(int));
+		memcpy(nbx->req, bx->req, bx->nr * sizeof(int));
+	}
+
+	return nbx;
+}
+
+static tmrec_t* dup_tmrec(tmrec_t *tr)
+{
+	tmrec_t *ntr;
+
+	if ( (ntr=tmrec_new(SHM_ALLOC))==NULL )
+		return NULL;
+
+	memcpy(ntr, tr, sizeof *ntr);
+	ntr->flags = SHM_ALLOC;
+	ntr->byday = ntr->bymday = ntr->byyday = NULL;
+	ntr->bymonth = ntr->byweekno = NULL;
+
+	if ((tr->byday && (ntr->byday=dup_byxxx(tr->byday))==NULL) ||
+	(tr->bymday && (ntr->bymday=dup_byxxx(tr->bymday))==NULL) ||
+	(tr->byyday && (ntr->byyday=dup_byxxx(tr->byyday))==NULL) ||
+	(tr->bymonth && (ntr->bymonth=dup_byxxx(tr->bymonth))==NULL) ||
+	(tr->byweekno && (ntr->byweekno=dup_byxxx(tr->byweekno))==NULL)) {
+		tmrec_free(ntr);
+		return NULL;
+	}
+
+	return ntr;
+}
+
+
+/* a copy of the carrier, using the given destination list */
+static pcr_t* clone_carrier(pcr_t *cr, pgw_list_t *pgwl, unsigned short len)
+{
+	pcr_t *ncr;
+
+	ncr = (pcr_t*)shm_malloc(sizeof(pcr_t) + cr->id.len + cr->attrs.len +
+		(cr->gwlist.s ? cr->gwlist.len + 1 : 0));
+	if (ncr == NULL) {
+		LM_ERR("no more shm mem for a new carrier\n");
+		return NULL;
+	}
+	memcpy(ncr, cr, sizeof(pcr_t));
+
+	ncr->id.s = (char*)(ncr+1);
+	memcpy(ncr->id.s, cr->id.s, cr->id.len);
+	if (cr->attrs.s) {
+		ncr->attrs.s = ncr->id.s + ncr->id.len;
+		memcpy(ncr->attrs.s, cr->attrs.s, cr->attrs.len);
+	}
+	if (cr->gwlist.s) {
+		ncr->gwlist.s = ncr->id.s + ncr->id.len + ncr->attrs.len;
+		memcpy(ncr->gwlist.s, cr->gwlist.s, cr->gwlist.len + 1);
+	}
+
+	ncr->pgwl = pgwl;
+	ncr->pgwa_len = len;
+	ncr->next = NULL;
+	ncr->ref_cnt = 1;
+
+	return ncr;
+}
+
+/* a copy of the rule, using the given destination list */
+static rt_info_t* clone_rule(rt_info_t *rt, pgw_list_t *pgwl,
+														unsigned short len)
+{
+	rt_info_t *nrt;
+
+	nrt = (rt_info_t*)shm_malloc(sizeof(rt_info_t) + rt->attrs.len +
+		(rt->dstlist.s ? rt->dstlist.len + 1 : 0));
+	if (nrt == NULL) {
+		LM_ERR("no more shm mem for a new rule\n");
+		return NULL;
+	}
+	memcpy(nrt, rt, sizeof(rt_info_t));
+
+	if (rt->attrs.s) {
+		nrt->attrs.s = (char*)(nrt+1);
+		memcpy(nrt->attrs.s, rt->attrs.s, rt->attrs.len);
+	}
+	if (rt->dstlist.s) {
+		nrt->dstlist.s = (char*)(nrt+1) + nrt->attrs.len;
+		memcpy(nrt->dstlist.s, rt->dstlist.s, rt->dstlist.len + 1);
+	}
+
+	if (rt->time_rec && (nrt->time_rec=dup_tmrec(rt->time_rec))==NULL) {
+		LM_ERR("no more shm mem for the time recurrence\n");
+		shm_free(nrt);
+		return NULL;
+	}
+
+	nrt->pgwl = pgwl;
+	nrt->pgwa_len = len;
+	nrt->ref_cnt = 0;
+
+	return nrt;
+}
+
+
+/* the version of the rule to be linked by the new generation: the same
+ * one if not affected by the replaced or added gateways/carriers, or a copy
+ * of it (only one, no matter how many times the rule is linked) */
+static rt_info_t* derive_rule(map_t remap, rt_data_t *rdata, str *added,
+		int added_carrier, rt_info_t *rt)
+{
+	rt_info_t *nrt;
+	pgw_list_t *pgwl;
+	unsigned short len;
+	void *rep;
+	int n;
+
+	if (remap_get(remap, rt, &rep))
+		return (rt_info_t*)rep;
+
+	if ( (n=derive_pgwl(remap, rdata, added, added_carrier, &rt->dstlist,
+	rt->pgwl, rt->pgwa_len, &pgwl, &len))<0 )
+		return NULL;
+	if (n == 0)
+		return rt;
+
+	if ( (nrt=clone_rule(rt, pgwl, len))==NULL ) {
+		if (pgwl)
+			shm_free(pgwl);
+		return NULL;
+	}
+
+	if (remap_put(remap, rt, nrt) < 0) {
+		free_rt_info(nrt);
+		return NULL;
+	}
+
+	return nrt;
+}
+
+
+rt_data_t* dr_snapshot_rt_data(rt_data_t *old)
+{
+	rt_data_t *rdata;
+	map_iterator_t it;
+	void **dest;
+	pgw_t *gw;
+	pcr_t *cr;
+	rt_info_wrp_t *rtlw;
+	unsigned int i;
+
+	if ( (rdata=build_rt_data())==NULL ) {
+		LM_ERR("failed to build rdata\n");
+		return NULL;
+	}
+
+	for (map_first(old->pgw_tree, &it);
+			iterator_is_valid(&it); iterator_next(&it)) {
+		if ( (dest=iterator_val(&it))==NULL )
+			break;
+		gw = (pgw_t*)*dest;
+		dr_ref(gw);
+		map_put(rdata->pgw_tree, gw->id, gw);
+	}
+
+	for (map_first(old->carriers_tree, &it);
+			iterator_is_valid(&it); iterator_next(&it)) {
+		if ( (dest=iterator_val(&it))==NULL )
+			break;
+		cr = (pcr_t*)*dest;
+		dr_ref(cr);
+		map_put(rdata->carriers_tree, cr->id, cr);
+	}
+
+	for (i = 0; i < old->noprefix.rg_pos; i++)
+		for (rtlw = old->noprefix.rg[i].rtlw; rtlw; rtlw = rtlw->next)
+			if (add_rt_info(&rdata->noprefix, rtlw->rtl,
+			old->noprefix.rg[i].rgid)!=0) {
+				LM_ERR("failed to add prefixless route\n");
+				goto error;
+			}
+
+	if (old->pt && (rdata->pt=cptree_dup(old->pt))==NULL)
+		goto error;
+
+	return rdata;
+error:
+	free_rt_data(rdata, 1);
+	return NULL;
+}
+
+
+rt_data_t* dr_derive_rt_data(struct head_db *part, rt_data_t *old,
+		int type, str *id, int persistent_state)
+{
+	rt_data_t *rdata = NULL;
+	map_t remap;
+	map_iterator_t it;
+	void **dest;
+	pgw_t *gw, *ngw;
+	pcr_t *cr, *ncr;
+	rt_info_t *rt, *nrt;
+	rt_info_wrp_t *rtlw;
+	pgw_list_t *pgwl;
+	unsigned short len;
+	str *added = NULL;
+	unsigned int rule_id = 0;
+	unsigned int i, g, r;
+	cptree_t *pt;
+	str prefix;
+	int n = 0;
+
+	if (type==DR_DELTA_RULE && str2int(id, &rule_id)!=0) {
+		LM_ERR("invalid rule id <%.*s>\n", id->len, id->s);
+		return NULL;
+	}
+
+	remap = map_create(0);
+	if (remap == NULL) {
+		LM_ERR("failed to create the replacements map\n");
+		return NULL;
+	}
+
+	if ( (rdata=build_rt_data())==NULL ) {
+		LM_ERR("failed to build rdata\n");
+		goto error;
+	}
+
+	/* the gateways - all shared, but the changed one */
+	for (map_first(old->pgw_tree, &it);
+			iterator_is_valid(&it); iterator_next(&it)) {
+		if ( (dest=iterator_val(&it))==NULL )
+			break;
+		gw = (pgw_t*)*dest;
+
+		if (type==DR_DELTA_GW && str_match(&gw->id, id))
+			continue;
+
+		dr_ref(gw);
+		map_put(rdata->pgw_tree, gw->id, gw);
+	}
+
+	if (type == DR_DELTA_GW) {
+		if ( (n=dr_load_delta(part, persistent_state, rdata, type, id))<0 )
+			goto error;
+
+		if ( (gw=get_gw_by_id(old->pgw_tree, id))!=NULL ) {
+			ngw = get_gw_by_id(rdata->pgw_tree, id);
+			if (ngw) {
+				/* keep the current state of the gateway */
+				ngw->flags &= ~DR_DST_STAT_MASK;
+				ngw->flags |= gw->flags&DR_DST_STAT_MASK;
+			}
+			if (remap_put(remap, gw, ngw) < 0)
+				goto error;
+		} else if (get_gw_by_id(rdata->pgw_tree, id)) {
+			/* a new gateway - may be already referred */
+			added = id;
+		}
+	}
+
+	/* the carriers - shared, unless pointing to the changed gateway */
+	for (map_first(old->carriers_tree, &it);
+			iterator_is_valid(&it); iterator_next(&it)) {
+		if ( (dest=iterator_val(&it))==NULL )
+			break;
+		cr = (pcr_t*)*dest;
+
+		if (type==DR_DELTA_CARRIER && str_match(&cr->id, id))
+			continue;
+
+		switch (derive_pgwl(remap, rdata, added, 0, &cr->gwlist,
+		cr->pgwl, cr->pgwa_len, &pgwl, &len)) {
+			case 0:
+				dr_ref(cr);
+				map_put(rdata->carriers_tree, cr->id, cr);
+				break;
+			case 1:
+				if ( (ncr=clone_carrier(cr, pgwl, len))==NULL ) {
+					if (pgwl)
+						shm_free(pgwl);
+					goto error;
+				}
+				map_put(rdata->carriers_tree, ncr->id, ncr);
+				if (remap_put(remap, cr, ncr) < 0)
+					goto error;
+				break;
+			default:
+				goto error;
+		}
+	}
+
+	if (type == DR_DELTA_CARRIER) {
+		if ( (n=dr_load_delta(part, persistent_state, rdata, type, id))<0 )
+			goto error;
+
+		if ( (cr=get_carrier_by_id(old->carriers_tree, id))!=NULL ) {
+			ncr = get_carrier_by_id(rdata->carriers_tree, id);
+			if (ncr) {
+				/* keep the current state of the carrier */
+				ncr->flags &= ~DR_CR_FLAG_IS_OFF;
+				ncr->flags |= cr->flags&DR_CR_FLAG_IS_OFF;
+			}
+			if (remap_put(remap, cr, ncr) < 0)
+				goto error;
+		} else if (get_carrier_by_id(rdata->carriers_tree, id)) {
+			/* a new carrier - may be already referred */
+			added = id;
+		}
+	}
+
+	/* the rules - linked again, in the same order, by the new generation */
+	for (i = 0; i < old->noprefix.rg_pos; i++) {
+		for (rtlw = old->noprefix.rg[i].rtlw; rtlw; rtlw = rtlw->next) {
+			rt = rtlw->rtl;
+			if (type==DR_DELTA_RULE && rt->id==rule_id)
+				continue;
+			if ( (nrt=derive_rule(remap, rdata, added,
+			type==DR_DELTA_CARRIER, rt))==NULL )
+				goto error;
+			if (add_rt_info(&rdata->noprefix, nrt, old->noprefix.rg[i].rgid)!=0){
+				LM_ERR("failed to add prefixless route\n");
+				goto error;
+			}
+		}
+	}
+
+	if ( (pt=old->pt)!=NULL ) {
+		for (i = 0; i < pt->nodes_no; i++) {
+			prefix.s = pt->digits + pt->nodes[i].key;
+			prefix.len = pt->nodes[i].depth;
+			for (g = pt->nodes[i].rg; g < pt->nodes[i+1].rg; g++) {
+				for (r = pt->rgs[g].rule; r < pt->rgs[g+1].rule; r++) {
+					rt = pt->rules[r];
+					if (type==DR_DELTA_RULE && rt->id==rule_id)
+						continue;
+					if ( (nrt=derive_rule(remap, rdata, added,
+			type==DR_DELTA_CARRIER, rt))==NULL )
+						goto error;
+					if (cptree_add_prefix(&rdata->ptb, &prefix, nrt,
+					pt->rgs[g].rgid)!=0) {
+						LM_ERR("failed to add prefix route\n");
+						goto error;
+					}
+				}
+			}
+		}
+	}
+
+	if (type == DR_DELTA_RULE &&
+	(n=dr_load_delta(part, persistent_state, rdata, type, id))<0)
+		goto error;
+
+	if (rdata->ptb.recs_no &&
+	(rdata->pt=cptree_build(&rdata->ptb))==NULL) {
+		LM_ERR("failed to build the prefix tree\n");
+		goto error;
+	}
+
+	LM_INFO("%s <%.*s> %s in partition %.*s (%d elements replaced)\n",
+		type==DR_DELTA_GW ? "gateway" :
+			(type==DR_DELTA_CARRIER ? "carrier" : "rule"),
+		id->len, id->s, n ? "updated" : "removed",
+		part->partition.len, part->partition.s, map_size(remap));
+
+	map_destroy(remap, 0);
+	return rdata;
+error:
+	map_destroy(remap, 0);
+	if (rdata)
+		free_rt_data(rdata, 1);
+	return NULL;
+}
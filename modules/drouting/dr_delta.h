@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Project
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * Incremental (delta) update of the routing data
+ *
+ * A single gateway, carrier or rule is re-read from DB (by its ID) and a
+ * new generation of the routing data is derived out of the current one:
+ * the unchanged gateways, carriers and rules are shared (referenced) by
+ * the two generations; only the changed element and the ones pointing to
+ * it (the carriers and rules using a changed gateway or carrier) are
+ * re-created, as are the ones referring a newly added gateway or carrier
+ * (their provisioned destination lists are resolved again). The derivation
+ * (DB query, prefix tree compilation) works on a snapshot of the current
+ * generation, taken in the RCU read section (see dr_rcu.h); the new
+ * generation is published only if no other reload/delta was published in
+ * the meantime, so the routing is not stopped during the update.
+ */
+
+#ifndef _DROUTING_DELTA_H_
+#define _DROUTING_DELTA_H_
+
+#include "../../str.h"
+#include "dr_partitions.h"
+#include "routing.h"
+
+#define DR_DELTA_GW       1
+#define DR_DELTA_CARRIER  2
+#define DR_DELTA_RULE     3
+
+/* "gw", "carrier" or "rule" -> delta type; -1 if unknown */
+int dr_delta_type(str *name);
+
+/* a copy of "old", sharing (referencing) all its gateways, carriers and
+ * rules - to be taken in the RCU read section, so the (slow) derivation
+ * can be done out of it */
+rt_data_t* dr_snapshot_rt_data(rt_data_t *old);
+
+/* derives from "old" a new generation of the routing data, with the
+ * given element re-loaded from DB (or removed, if no longer in DB) */
+rt_data_t* dr_derive_rt_data(struct head_db *part, rt_data_t *old,
+		int type, str *id, int persistent_state);
+
+#endif
@@ -43,6 +43,7 @@
 #include "../../socket_info.h"
 
 #include "dr_load.h"
+#include "dr_delta.h"
 #include "routing.h"
 #include "prefix_tree.h"
 #include "parse.h"
@@ -160,7 +161,8 @@ static int add_rule(rt_data_t *rdata, char *grplst, str *prefix, rt_info_t *rule
 		/* add rule -> has prefix? */
 		if (prefix->len) {
 			/* add the routing rule */
-			if ( add_prefix(rdata->pt, prefix, rule, (unsigned int)t)!=0 ) {
+			if ( cptree_add_prefix(&rdata->ptb, prefix, rule,
+			(unsigned int)t)!=0 ) {
 				LM_ERR("failed to add prefix route\n");
 				goto error;
 			}
@@ -221,6 +223,307 @@ error:
 #define STR_VALS_DSTLIST_DRR_COL  4
 #define STR_VALS_ATTRS_DRR_COL    5
 
+
+static inline int set_gw_columns(db_key_t *columns, int persistent_state)
+{
+	columns[0] = &id_drd_col;
+	columns[1] = &gwid_drd_col;
+	columns[2] = &address_drd_col;
+	columns[3] = &strip_drd_col;
+	columns[4] = &prefix_drd_col;
+	columns[5] = &type_drd_col;
+	columns[6] = &attrs_drd_col;
+	columns[7] = &probe_drd_col;
+	columns[8] = &sock_drd_col;
+	if (persistent_state) {
+		columns[9] = &state_drd_col;
+		return 10;
+	}
+	return 9;
+}
+
+static inline int set_carrier_columns(db_key_t *columns, int persistent_state)
+{
+	columns[0] = &id_drc_col;
+	columns[1] = &cid_drc_col;
+	columns[2] = &flags_drc_col;
+	columns[3] = &gwlist_drc_col;
+	columns[4] = &attrs_drc_col;
+	if (persistent_state) {
+		columns[5] = &state_drc_col;
+		return 6;
+	}
+	return 5;
+}
+
+static inline int set_rule_columns(db_key_t *columns)
+{
+	columns[0] = &rule_id_drr_col;
+	columns[1] = &group_drr_col;
+	columns[2] = &prefix_drr_col;
+	columns[3] = &time_drr_col;
+	columns[4] = &priority_drr_col;
+	columns[5] = &routeid_drr_col;
+	columns[6] = &dstlist_drr_col;
+	columns[7] = &attrs_drr_col;
+	return 8;
+}
+
+
+/* the row loaders return 0 if the row was loaded, 1 if it was skipped
+ * (bad definition) and -1 if the row does not match the table format */
+
+static int load_gw_row(rt_data_t *rdata, db_row_t *row, int persistent_state)
+{
+	int    int_vals[5];
+	char * str_vals[6];
+	struct socket_info *sock;
+	str s_sock, host;
+	int proto, port;
+	char id_buf[INT2STR_MAX_LEN];
+
+	/* DB ID column */
+	if ( VAL_TYPE( ROW_VALUES(row) ) == DB_INT ) {
+		/* if INT type, convert it to string */
+		check_val( id_drd_col, ROW_VALUES(row), DB_INT, 1, 0);
+		/* int2bstr returns a null terminated string */
+		str_vals[STR_VALS_ID_DRD_COL] =
+			int2bstr((unsigned long)VAL_INT(ROW_VALUES(row)),
+					id_buf, &int_vals[0]/*useless*/);
+	} else {
+		/* if not INT, accept only STRING type */
+		check_val( id_drd_col, ROW_VALUES(row), DB_STRING, 1, 0);
+		str_vals[STR_VALS_ID_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row));
+	}
+	/* GW ID column */
+	check_val( gwid_drd_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
+	str_vals[STR_VALS_GWID_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+1);
+	/* ADDRESS column */
+	check_val( address_drd_col, ROW_VALUES(row)+2, DB_STRING, 1, 1);
+	str_vals[STR_VALS_ADDRESS_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+2);
+	/* STRIP column */
+	check_val2( strip_drd_col, ROW_VALUES(row)+3, DB_INT, DB_BIGINT, 1, 0);
+	int_vals[INT_VALS_STRIP_DRD_COL] = VAL_INT   (ROW_VALUES(row)+3);
+	/* PREFIX column */
+	check_val( prefix_drd_col, ROW_VALUES(row)+4, DB_STRING, 0, 0);
+	str_vals[STR_VALS_PREFIX_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+4);
+	/* TYPE column */
+	check_val2( type_drd_col, ROW_VALUES(row)+5, DB_INT, DB_BIGINT, 1, 0);
+	int_vals[INT_VALS_TYPE_DRD_COL] = VAL_INT(ROW_VALUES(row)+5);
+	/* ATTRS column */
+	check_val( attrs_drd_col, ROW_VALUES(row)+6, DB_STRING, 0, 0);
+	str_vals[STR_VALS_ATTRS_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+6);
+	/* PROBE_MODE column */
+	check_val2( probe_drd_col, ROW_VALUES(row)+7, DB_INT, DB_BIGINT, 1, 0);
+	int_vals[INT_VALS_PROBE_DRD_COL] = VAL_INT(ROW_VALUES(row)+7);
+	/* SOCKET column */
+	check_val( sock_drd_col, ROW_VALUES(row)+8, DB_STRING, 0, 0);
+	if ( !VAL_NULL(ROW_VALUES(row)+8) &&
+			(s_sock.s=(char*)VAL_STRING(ROW_VALUES(row)+8))[0]!=0 ) {
+		s_sock.len = strlen(s_sock.s);
+		if (parse_phostport( s_sock.s, s_sock.len, &host.s, &host.len,
+					&port, &proto)!=0){
+			LM_ERR("GW <%s>(%s): socket description <%.*s> "
+					"is not valid -> ignoring socket\n",
+					str_vals[STR_VALS_GWID_DRD_COL],
+					str_vals[STR_VALS_ID_DRD_COL], s_sock.len,s_sock.s);
+			sock = NULL;
+		} else {
+			sock = grep_sock_info( &host, port, proto);
+			if (sock == NULL) {
+				LM_ERR("GW <%s>(%s): socket <%.*s> is not local to "
+						"OpenSIPS (we must listen on it) -> ignoring socket\n",
+						str_vals[STR_VALS_GWID_DRD_COL],
+						str_vals[STR_VALS_ID_DRD_COL], s_sock.len,s_sock.s);
+			}
+		}
+	} else {
+		sock = NULL;
+	}
+	/*STATE column */
+	if (persistent_state) {
+		check_val2( state_drd_col, ROW_VALUES(row)+9, DB_INT,
+			DB_BIGINT, 1, 0);
+		int_vals[INT_VALS_STATE_DRD_COL] = VAL_INT(ROW_VALUES(row)+9);
+	} else {
+		int_vals[INT_VALS_STATE_DRD_COL] = 0; /* by default enabled */
+	}
+
+	/* add the destinaton definition in */
+	if ( add_dst( rdata, str_vals[STR_VALS_GWID_DRD_COL],
+				str_vals[STR_VALS_ADDRESS_DRD_COL],
+				int_vals[INT_VALS_STRIP_DRD_COL],
+				str_vals[STR_VALS_PREFIX_DRD_COL],
+				int_vals[INT_VALS_TYPE_DRD_COL],
+				str_vals[STR_VALS_ATTRS_DRD_COL],
+				int_vals[INT_VALS_PROBE_DRD_COL],
+				sock,
+				int_vals[INT_VALS_STATE_DRD_COL] )<0 ) {
+		LM_ERR("failed to add destination <%s>(%s) -> skipping\n",
+				str_vals[STR_VALS_GWID_DRD_COL],
+				str_vals[STR_VALS_ID_DRD_COL]);
+		return 1;
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+
+static int load_carrier_row(rt_data_t *rdata, db_row_t *row,
+														int persistent_state)
+{
+	int    int_vals[5];
+	char * str_vals[6];
+	char id_buf[INT2STR_MAX_LEN];
+
+	/* DB ID column */
+	if ( VAL_TYPE( ROW_VALUES(row) ) == DB_INT ) {
+		/* if INT type, convert it to string */
+		check_val( id_drc_col, ROW_VALUES(row), DB_INT, 1, 0);
+		/* int2bstr returns a null terminated string */
+		str_vals[STR_VALS_ID_DRC_COL] =
+			int2bstr((unsigned long)VAL_INT(ROW_VALUES(row)),
+					id_buf, &int_vals[0]/*useless*/);
+	} else {
+		/* if not INT, accept only STRING type */
+		check_val( id_drd_col, ROW_VALUES(row), DB_STRING, 1, 0);
+		str_vals[STR_VALS_ID_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row));
+	}
+	/* CARRIER_ID column */
+	check_val( cid_drc_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
+	str_vals[STR_VALS_CID_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+1);
+	/* flags column */
+	check_val2( flags_drc_col, ROW_VALUES(row)+2, DB_INT, DB_BIGINT, 1, 0);
+	int_vals[INT_VALS_FLAGS_DRC_COL] = VAL_INT(ROW_VALUES(row)+2);
+	/* GWLIST column */
+	check_val( gwlist_drc_col, ROW_VALUES(row)+3, DB_STRING, 1, 1);
+	str_vals[STR_VALS_GWLIST_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+3);
+	/* ATTRS column */
+	check_val( attrs_drc_col, ROW_VALUES(row)+4, DB_STRING, 0, 0);
+	str_vals[STR_VALS_ATTRS_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+4);
+	/* STATE column */
+	if (persistent_state) {
+		check_val2( state_drc_col, ROW_VALUES(row)+5, DB_INT, DB_BIGINT, 1, 0);
+		int_vals[INT_VALS_STATE_DRC_COL] = VAL_INT(ROW_VALUES(row)+5);
+	} else {
+		/* by default enabled */
+		int_vals[INT_VALS_STATE_DRC_COL] = 0;
+	}
+
+	/* add the new carrier */
+	if ( add_carrier( str_vals[STR_VALS_CID_DRC_COL],
+				int_vals[INT_VALS_FLAGS_DRC_COL],
+				str_vals[STR_VALS_GWLIST_DRC_COL],
+				str_vals[STR_VALS_ATTRS_DRC_COL],
+				int_vals[INT_VALS_STATE_DRC_COL], rdata) != 0 ) {
+		LM_ERR("failed to add carrier db_id <%s> -> skipping\n",
+				str_vals[STR_VALS_ID_DRC_COL]);
+		return 1;
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+
+static int load_rule_row(rt_data_t *rdata, db_row_t *row)
+{
+	int    int_vals[5];
+	char * str_vals[6];
+	str tmp;
+	rt_info_t *ri;
+	tmrec_t   *time_rec;
+
+	/* RULE_ID column */
+	check_val( rule_id_drr_col, ROW_VALUES(row), DB_INT, 1, 0);
+	int_vals[INT_VALS_RULE_ID_DRR_COL] = VAL_INT (ROW_VALUES(row));
+	/* GROUP column */
+	check_val( group_drr_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
+	str_vals[STR_VALS_GROUP_DRR_COL] =
+		(char*)VAL_STRING(ROW_VALUES(row)+1);
+	/* PREFIX column - it may be null or empty */
+	check_val( prefix_drr_col, ROW_VALUES(row)+2, DB_STRING, 0, 0);
+	if ((ROW_VALUES(row)+2)->nul || VAL_STRING(ROW_VALUES(row)+2)==0){
+		tmp.s = NULL;
+		tmp.len = 0;
+	} else {
+		str_vals[STR_VALS_PREFIX_DRR_COL] =
+			(char*)VAL_STRING(ROW_VALUES(row)+2);
+		tmp.s = str_vals[STR_VALS_PREFIX_DRR_COL];
+		tmp.len = strlen(str_vals[STR_VALS_PREFIX_DRR_COL]);
+	}
+	/* TIME column */
+	check_val( time_drr_col, ROW_VALUES(row)+3, DB_STRING, 0, 0);
+	/* PRIORITY column */
+	check_val2( priority_drr_col, ROW_VALUES(row)+4, DB_INT, DB_BIGINT, 1, 0);
+	int_vals[INT_VALS_PRIORITY_DRR_COL] = VAL_INT(ROW_VALUES(row)+4);
+	/* ROUTE_ID column */
+	check_val( routeid_drr_col, ROW_VALUES(row)+5, DB_STRING, 0, 0);
+	/* DSTLIST column */
+	check_val( dstlist_drr_col, ROW_VALUES(row)+6, DB_STRING, 0, 1);
+	str_vals[STR_VALS_DSTLIST_DRR_COL] =
+		(char*)VAL_STRING(ROW_VALUES(row)+6);
+	/* ATTRS column */
+	check_val( attrs_drr_col, ROW_VALUES(row)+7, DB_STRING, 0, 0);
+	str_vals[STR_VALS_ATTRS_DRR_COL] =
+		(char*)VAL_STRING(ROW_VALUES(row)+7);
+	/* parse the time definition */
+	if ( VAL_NULL(ROW_VALUES(row)+3) ||
+	((str_vals[STR_VALS_TIME_DRR_COL]=
+		(char*)VAL_STRING(ROW_VALUES(row)+3))==NULL ) ||
+	*(str_vals[STR_VALS_TIME_DRR_COL]) == 0)
+		time_rec = NULL;
+	else if ((time_rec=
+	parse_time_def(str_vals[STR_VALS_TIME_DRR_COL]))==0) {
+		LM_ERR("bad time definition <%s> for rule id %d -> skipping\n",
+			str_vals[STR_VALS_TIME_DRR_COL],
+			int_vals[INT_VALS_RULE_ID_DRR_COL]);
+		return 1;
+	}
+	/* lookup for the script route ID */
+	if ( !VAL_NULL(ROW_VALUES(row)+5) &&
+	((str_vals[STR_VALS_ROUTEID_DRR_COL]=
+		(char*)VAL_STRING(ROW_VALUES(row)+5))!=NULL ) &&
+	str_vals[STR_VALS_ROUTEID_DRR_COL][0] ) {
+		int_vals[INT_VALS_SCRIPT_ROUTE_ID] =
+			get_script_route_ID_by_name
+			( str_vals[STR_VALS_ROUTEID_DRR_COL], rlist, RT_NO);
+		if (int_vals[INT_VALS_SCRIPT_ROUTE_ID]==-1) {
+			LM_WARN("route <%s> does not exist\n",
+					str_vals[STR_VALS_ROUTEID_DRR_COL]);
+			int_vals[INT_VALS_SCRIPT_ROUTE_ID] = 0;
+		}
+	} else {
+		int_vals[INT_VALS_SCRIPT_ROUTE_ID] = 0;
+	}
+	/* build the routing rule */
+	if ((ri = build_rt_info( int_vals[INT_VALS_RULE_ID_DRR_COL],
+					int_vals[INT_VALS_PRIORITY_DRR_COL], time_rec,
+					int_vals[INT_VALS_SCRIPT_ROUTE_ID],
+					str_vals[STR_VALS_DSTLIST_DRR_COL],
+					str_vals[STR_VALS_ATTRS_DRR_COL], rdata))== 0 ) {
+		LM_ERR("failed to add routing info for rule id %d -> "
+				"skipping\n", int_vals[INT_VALS_RULE_ID_DRR_COL]);
+		tmrec_free( time_rec );
+		return 1;
+	}
+	/* add the rule */
+	if (add_rule( rdata, str_vals[STR_VALS_GROUP_DRR_COL], &tmp, ri)!=0) {
+		LM_ERR("failed to add rule id %d -> skipping\n",
+				int_vals[INT_VALS_RULE_ID_DRR_COL]);
+		free_rt_info( ri );
+		return 1;
+	}
+
+	return 0;
+error:
+	return -1;
+}
+
+
 /* loads routing info for given partition; if partition_name is NULL
  * loads all partitions
  */
@@ -228,9 +531,6 @@ error:
 rt_data_t* dr_load_routing_info(struct head_db *current_partition
 		, int persistent_state)
 {
-	int    int_vals[5];
-	char * str_vals[6];
-	str tmp;
 	db_func_t *dr_dbf = &current_partition->db_funcs;
 	db_con_t* db_hdl = *current_partition->db_con;
 	str *drd_table = &current_partition->drd_table;
@@ -238,20 +538,12 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 	str *drr_table = &current_partition->drr_table;
 	db_key_t columns[10];
 	db_res_t* res;
-	db_row_t* row;
-	rt_info_t *ri;
 	rt_data_t *rdata;
-	tmrec_t   *time_rec;
-	int i,n;
+	int i,n,rc;
 	int no_rows = 10;
 	int db_cols;
-	struct socket_info *sock;
-	str s_sock, host;
-	int proto, port;
-	char id_buf[INT2STR_MAX_LEN];
 
 	res = 0;
-	ri = 0;
 	rdata = 0;
 
 	/* init new data structure */
@@ -269,21 +561,7 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 		goto error;
 	}
 
-	columns[0] = &id_drd_col;
-	columns[1] = &gwid_drd_col;
-	columns[2] = &address_drd_col;
-	columns[3] = &strip_drd_col;
-	columns[4] = &prefix_drd_col;
-	columns[5] = &type_drd_col;
-	columns[6] = &attrs_drd_col;
-	columns[7] = &probe_drd_col;
-	columns[8] = &sock_drd_col;
-	if (persistent_state) {
-		columns[9] = &state_drd_col;
-		db_cols = 10;
-	} else {
-		db_cols = 9;
-	}
+	db_cols = set_gw_columns(columns, persistent_state);
 
 	if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
 		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, db_cols, 0, 0 ) < 0) {
@@ -309,90 +587,10 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 	n = 0;
 	do {
 		for(i=0; i < RES_ROW_N(res); i++) {
-			row = RES_ROWS(res) + i;
-			/* DB ID column */
-			if ( VAL_TYPE( ROW_VALUES(row) ) == DB_INT ) {
-				/* if INT type, convert it to string */
-				check_val( id_drd_col, ROW_VALUES(row), DB_INT, 1, 0);
-				/* int2bstr returns a null terminated string */
-				str_vals[STR_VALS_ID_DRD_COL] =
-					int2bstr((unsigned long)VAL_INT(ROW_VALUES(row)),
-							id_buf, &int_vals[0]/*useless*/);
-			} else {
-				/* if not INT, accept only STRING type */
-				check_val( id_drd_col, ROW_VALUES(row), DB_STRING, 1, 0);
-				str_vals[STR_VALS_ID_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row));
-			}
-			/* GW ID column */
-			check_val( gwid_drd_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
-			str_vals[STR_VALS_GWID_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+1);
-			/* ADDRESS column */
-			check_val( address_drd_col, ROW_VALUES(row)+2, DB_STRING, 1, 1);
-			str_vals[STR_VALS_ADDRESS_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+2);
-			/* STRIP column */
-			check_val2( strip_drd_col, ROW_VALUES(row)+3, DB_INT, DB_BIGINT, 1, 0);
-			int_vals[INT_VALS_STRIP_DRD_COL] = VAL_INT   (ROW_VALUES(row)+3);
-			/* PREFIX column */
-			check_val( prefix_drd_col, ROW_VALUES(row)+4, DB_STRING, 0, 0);
-			str_vals[STR_VALS_PREFIX_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+4);
-			/* TYPE column */
-			check_val2( type_drd_col, ROW_VALUES(row)+5, DB_INT, DB_BIGINT, 1, 0);
-			int_vals[INT_VALS_TYPE_DRD_COL] = VAL_INT(ROW_VALUES(row)+5);
-			/* ATTRS column */
-			check_val( attrs_drd_col, ROW_VALUES(row)+6, DB_STRING, 0, 0);
-			str_vals[STR_VALS_ATTRS_DRD_COL] = (char*)VAL_STRING(ROW_VALUES(row)+6);
-			/* PROBE_MODE column */
-			check_val2( probe_drd_col, ROW_VALUES(row)+7, DB_INT, DB_BIGINT, 1, 0);
-			int_vals[INT_VALS_PROBE_DRD_COL] = VAL_INT(ROW_VALUES(row)+7);
-			/* SOCKET column */
-			check_val( sock_drd_col, ROW_VALUES(row)+8, DB_STRING, 0, 0);
-			if ( !VAL_NULL(ROW_VALUES(row)+8) &&
-					(s_sock.s=(char*)VAL_STRING(ROW_VALUES(row)+8))[0]!=0 ) {
-				s_sock.len = strlen(s_sock.s);
-				if (parse_phostport( s_sock.s, s_sock.len, &host.s, &host.len,
-							&port, &proto)!=0){
-					LM_ERR("GW <%s>(%s): socket description <%.*s> "
-							"is not valid -> ignoring socket\n",
-							str_vals[STR_VALS_GWID_DRD_COL],
-							str_vals[STR_VALS_ID_DRD_COL], s_sock.len,s_sock.s);
-					sock = NULL;
-				} else {
-					sock = grep_sock_info( &host, port, proto);
-					if (sock == NULL) {
-						LM_ERR("GW <%s>(%s): socket <%.*s> is not local to "
-								"OpenSIPS (we must listen on it) -> ignoring socket\n",
-								str_vals[STR_VALS_GWID_DRD_COL],
-								str_vals[STR_VALS_ID_DRD_COL], s_sock.len,s_sock.s);
-					}
-				}
-			} else {
-				sock = NULL;
-			}
-			/*STATE column */
-			if (persistent_state) {
-				check_val2( state_drd_col, ROW_VALUES(row)+9, DB_INT,
-					DB_BIGINT, 1, 0);
-				int_vals[INT_VALS_STATE_DRD_COL] = VAL_INT(ROW_VALUES(row)+9);
-			} else {
-				int_vals[INT_VALS_STATE_DRD_COL] = 0; /* by default enabled */
-			}
-
-			/* add the destinaton definition in */
-			if ( add_dst( rdata, str_vals[STR_VALS_GWID_DRD_COL],
-						str_vals[STR_VALS_ADDRESS_DRD_COL],
-						int_vals[INT_VALS_STRIP_DRD_COL],
-						str_vals[STR_VALS_PREFIX_DRD_COL],
-						int_vals[INT_VALS_TYPE_DRD_COL],
-						str_vals[STR_VALS_ATTRS_DRD_COL],
-						int_vals[INT_VALS_PROBE_DRD_COL],
-						sock,
-						int_vals[INT_VALS_STATE_DRD_COL] )<0 ) {
-				LM_ERR("failed to add destination <%s>(%s) -> skipping\n",
-						str_vals[STR_VALS_GWID_DRD_COL],
-						str_vals[STR_VALS_ID_DRD_COL]);
-				continue;
-			}
-			n++;
+			if ( (rc=load_gw_row(rdata, RES_ROWS(res)+i, persistent_state))<0 )
+				goto error;
+			if (rc==0)
+				n++;
 		}
 		if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
 			if(dr_dbf->fetch_result(db_hdl, &res, no_rows)<0) {
@@ -413,17 +611,7 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 		goto error;
 	}
 
-	columns[0] = &id_drc_col;
-	columns[1] = &cid_drc_col;
-	columns[2] = &flags_drc_col;
-	columns[3] = &gwlist_drc_col;
-	columns[4] = &attrs_drc_col;
-	if (persistent_state) {
-		columns[5] = &state_drc_col;
-		db_cols = 6;
-	} else {
-		db_cols = 5;
-	}
+	db_cols = set_carrier_columns(columns, persistent_state);
 
 	if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
 		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, db_cols, 0, 0 ) < 0) {
@@ -450,51 +638,9 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 				RES_ROW_N(res), drc_table->len,drc_table->s);
 		do {
 			for(i=0; i < RES_ROW_N(res); i++) {
-				row = RES_ROWS(res) + i;
-				/* DB ID column */
-				if ( VAL_TYPE( ROW_VALUES(row) ) == DB_INT ) {
-					/* if INT type, convert it to string */
-					check_val( id_drc_col, ROW_VALUES(row), DB_INT, 1, 0);
-					/* int2bstr returns a null terminated string */
-					str_vals[STR_VALS_ID_DRC_COL] =
-						int2bstr((unsigned long)VAL_INT(ROW_VALUES(row)),
-								id_buf, &int_vals[0]/*useless*/);
-				} else {
-					/* if not INT, accept only STRING type */
-					check_val( id_drd_col, ROW_VALUES(row), DB_STRING, 1, 0);
-					str_vals[STR_VALS_ID_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row));
-				}
-				/* CARRIER_ID column */
-				check_val( cid_drc_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
-				str_vals[STR_VALS_CID_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+1);
-				/* flags column */
-				check_val2( flags_drc_col, ROW_VALUES(row)+2, DB_INT, DB_BIGINT, 1, 0);
-				int_vals[INT_VALS_FLAGS_DRC_COL] = VAL_INT(ROW_VALUES(row)+2);
-				/* GWLIST column */
-				check_val( gwlist_drc_col, ROW_VALUES(row)+3, DB_STRING, 1, 1);
-				str_vals[STR_VALS_GWLIST_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+3);
-				/* ATTRS column */
-				check_val( attrs_drc_col, ROW_VALUES(row)+4, DB_STRING, 0, 0);
-				str_vals[STR_VALS_ATTRS_DRC_COL] = (char*)VAL_STRING(ROW_VALUES(row)+4);
-				/* STATE column */
-				if (persistent_state) {
-					check_val2( state_drc_col, ROW_VALUES(row)+5, DB_INT, DB_BIGINT, 1, 0);
-					int_vals[INT_VALS_STATE_DRC_COL] = VAL_INT(ROW_VALUES(row)+5);
-				} else {
-					/* by default enabled */
-					int_vals[INT_VALS_STATE_DRC_COL] = 0;
-				}
-
-				/* add the new carrier */
-				if ( add_carrier( str_vals[STR_VALS_CID_DRC_COL],
-							int_vals[INT_VALS_FLAGS_DRC_COL],
-							str_vals[STR_VALS_GWLIST_DRC_COL],
-							str_vals[STR_VALS_ATTRS_DRC_COL],
-							int_vals[INT_VALS_STATE_DRC_COL], rdata) != 0 ) {
-					LM_ERR("failed to add carrier db_id <%s> -> skipping\n",
-							str_vals[STR_VALS_ID_DRC_COL]);
-					continue;
-				}
+				if ( load_carrier_row(rdata, RES_ROWS(res)+i,
+				persistent_state)<0 )
+					goto error;
 			}
 			if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
 				if(dr_dbf->fetch_result(db_hdl, &res, no_rows)<0) {
@@ -516,28 +662,21 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 		goto error;
 	}
 
-	columns[0] = &rule_id_drr_col;
-	columns[1] = &group_drr_col;
-	columns[2] = &prefix_drr_col;
-	columns[3] = &time_drr_col;
-	columns[4] = &priority_drr_col;
-	columns[5] = &routeid_drr_col;
-	columns[6] = &dstlist_drr_col;
-	columns[7] = &attrs_drr_col;
+	db_cols = set_rule_columns(columns);
 
 	if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
-		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, 8, 0, 0) < 0) {
+		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, db_cols, 0, 0) < 0) {
 			LM_ERR("DB query failed\n");
 			goto error;
 		}
-		no_rows = estimate_available_rows( 4+32+32+128+32+64+128, 8/*cols*/);
+		no_rows = estimate_available_rows( 4+32+32+128+32+64+128, db_cols);
 		if (no_rows==0) no_rows = 10;
 		if(dr_dbf->fetch_result(db_hdl, &res, no_rows)<0) {
 			LM_ERR("Error fetching rows\n");
 			goto error;
 		}
 	} else {
-		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, 8, 0, &res) < 0) {
+		if ( dr_dbf->query( db_hdl, 0, 0, 0, columns, 0, db_cols, 0, &res) < 0) {
 			LM_ERR("DB query failed\n");
 			goto error;
 		}
@@ -553,88 +692,10 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 	n = 0;
 	do {
 		for(i=0; i < RES_ROW_N(res); i++) {
-			row = RES_ROWS(res) + i;
-			/* RULE_ID column */
-			check_val( rule_id_drr_col, ROW_VALUES(row), DB_INT, 1, 0);
-			int_vals[INT_VALS_RULE_ID_DRR_COL] = VAL_INT (ROW_VALUES(row));
-			/* GROUP column */
-			check_val( group_drr_col, ROW_VALUES(row)+1, DB_STRING, 1, 1);
-			str_vals[STR_VALS_GROUP_DRR_COL] =
-				(char*)VAL_STRING(ROW_VALUES(row)+1);
-			/* PREFIX column - it may be null or empty */
-			check_val( prefix_drr_col, ROW_VALUES(row)+2, DB_STRING, 0, 0);
-			if ((ROW_VALUES(row)+2)->nul || VAL_STRING(ROW_VALUES(row)+2)==0){
-				tmp.s = NULL;
-				tmp.len = 0;
-			} else {
-				str_vals[STR_VALS_PREFIX_DRR_COL] =
-					(char*)VAL_STRING(ROW_VALUES(row)+2);
-				tmp.s = str_vals[STR_VALS_PREFIX_DRR_COL];
-				tmp.len = strlen(str_vals[STR_VALS_PREFIX_DRR_COL]);
-			}
-			/* TIME column */
-			check_val( time_drr_col, ROW_VALUES(row)+3, DB_STRING, 0, 0);
-			/* PRIORITY column */
-			check_val2( priority_drr_col, ROW_VALUES(row)+4, DB_INT, DB_BIGINT, 1, 0);
-			int_vals[INT_VALS_PRIORITY_DRR_COL] = VAL_INT(ROW_VALUES(row)+4);
-			/* ROUTE_ID column */
-			check_val( routeid_drr_col, ROW_VALUES(row)+5, DB_STRING, 0, 0);
-			/* DSTLIST column */
-			check_val( dstlist_drr_col, ROW_VALUES(row)+6, DB_STRING, 0, 1);
-			str_vals[STR_VALS_DSTLIST_DRR_COL] =
-				(char*)VAL_STRING(ROW_VALUES(row)+6);
-			/* ATTRS column */
-			check_val( attrs_drr_col, ROW_VALUES(row)+7, DB_STRING, 0, 0);
-			str_vals[STR_VALS_ATTRS_DRR_COL] =
-				(char*)VAL_STRING(ROW_VALUES(row)+7);
-			/* parse the time definition */
-			if ( VAL_NULL(ROW_VALUES(row)+3) ||
-			((str_vals[STR_VALS_TIME_DRR_COL]=
-				(char*)VAL_STRING(ROW_VALUES(row)+3))==NULL ) ||
-			*(str_vals[STR_VALS_TIME_DRR_COL]) == 0)
-				time_rec = NULL;
-			else if ((time_rec=
-			parse_time_def(str_vals[STR_VALS_TIME_DRR_COL]))==0) {
-				LM_ERR("bad time definition <%s> for rule id %d -> skipping\n",
-					str_vals[STR_VALS_TIME_DRR_COL],
-					int_vals[INT_VALS_RULE_ID_DRR_COL]);
-				continue;
-			}
-			/* lookup for the script route ID */
-			if ( !VAL_NULL(ROW_VALUES(row)+5) &&
-			((str_vals[STR_VALS_ROUTEID_DRR_COL]=
-				(char*)VAL_STRING(ROW_VALUES(row)+5))!=NULL ) &&
-			str_vals[STR_VALS_ROUTEID_DRR_COL][0] ) {
-				int_vals[INT_VALS_SCRIPT_ROUTE_ID] =
-					get_script_route_ID_by_name
-					( str_vals[STR_VALS_ROUTEID_DRR_COL], rlist, RT_NO);
-				if (int_vals[INT_VALS_SCRIPT_ROUTE_ID]==-1) {
-					LM_WARN("route <%s> does not exist\n",
-							str_vals[STR_VALS_ROUTEID_DRR_COL]);
-					int_vals[INT_VALS_SCRIPT_ROUTE_ID] = 0;
-				}
-			} else {
-				int_vals[INT_VALS_SCRIPT_ROUTE_ID] = 0;
-			}
-			/* build the routing rule */
-			if ((ri = build_rt_info( int_vals[INT_VALS_RULE_ID_DRR_COL],
-							int_vals[INT_VALS_PRIORITY_DRR_COL], time_rec,
-							int_vals[INT_VALS_SCRIPT_ROUTE_ID],
-							str_vals[STR_VALS_DSTLIST_DRR_COL],
-							str_vals[STR_VALS_ATTRS_DRR_COL], rdata))== 0 ) {
-				LM_ERR("failed to add routing info for rule id %d -> "
-						"skipping\n", int_vals[INT_VALS_RULE_ID_DRR_COL]);
-				tmrec_free( time_rec );
-				continue;
-			}
-			/* add the rule */
-			if (add_rule( rdata, str_vals[STR_VALS_GROUP_DRR_COL], &tmp, ri)!=0) {
-				LM_ERR("failed to add rule id %d -> skipping\n",
-						int_vals[INT_VALS_RULE_ID_DRR_COL]);
-				free_rt_info( ri );
-				continue;
-			}
-			n++;
+			if ( (rc=load_rule_row(rdata, RES_ROWS(res)+i))<0 )
+				goto error;
+			if (rc==0)
+				n++;
 		}
 		if (DB_CAPABILITY(*dr_dbf, DB_CAP_FETCH)) {
 			if(dr_dbf->fetch_result(db_hdl, &res, no_rows)<0) {
@@ -653,6 +714,19 @@ rt_data_t* dr_load_routing_info(struct head_db *current_partition
 
 	LM_DBG("%d total records loaded from table %.*s\n", n,
 			drr_table->len, drr_table->s);
+
+	/* compile all the prefix rules at once */
+	if (rdata->ptb.recs_no) {
+		if ( (rdata->pt=cptree_build(&rdata->ptb))==NULL ) {
+			LM_ERR("failed to build the prefix tree\n");
+			goto error;
+		}
+		LM_INFO("prefix tree for partition %.*s: %u prefixes, %u nodes, "
+			"%lu bytes\n", current_partition->partition.len,
+			current_partition->partition.s, rdata->pt->prefixes_no,
+			rdata->pt->nodes_no, rdata->pt->size);
+	}
+
 	return rdata;
 error:
 	if (res)
@@ -662,3 +736,92 @@ error:
 	rdata = NULL;
 	return 0;
 }
+
+
+/* loads from DB, into "rdata", the definition of a single gateway, carrier
+ * or rule, identified by its gwid, carrierid or ruleid; returns the number
+ * of loaded definitions (0 if missing from DB) or -1 on error */
+int dr_load_delta(struct head_db *current_partition, int persistent_state,
+									rt_data_t *rdata, int type, str *id)
+{
+	db_func_t *dr_dbf = &current_partition->db_funcs;
+	db_con_t* db_hdl = *current_partition->db_con;
+	db_key_t columns[10];
+	db_key_t key;
+	db_val_t val;
+	db_res_t* res;
+	str *table;
+	int i,n,rc;
+	int db_cols;
+
+	switch (type) {
+		case DR_DELTA_GW:
+			table = &current_partition->drd_table;
+			db_cols = set_gw_columns(columns, persistent_state);
+			key = &gwid_drd_col;
+			break;
+		case DR_DELTA_CARRIER:
+			table = &current_partition->drc_table;
+			db_cols = set_carrier_columns(columns, persistent_state);
+			key = &cid_drc_col;
+			break;
+		case DR_DELTA_RULE:
+			table = &current_partition->drr_table;
+			db_cols = set_rule_columns(columns);
+			key = &rule_id_drr_col;
+			break;
+		default:
+			LM_BUG("unknown delta type %d\n", type);
+			return -1;
+	}
+
+	memset(&val, 0, sizeof val);
+	if (type==DR_DELTA_RULE) {
+		VAL_TYPE(&val) = DB_INT;
+		if (str2sint(id, &VAL_INT(&val))!=0) {
+			LM_ERR("invalid rule id <%.*s>\n", id->len, id->s);
+			return -1;
+		}
+	} else {
+		VAL_TYPE(&val) = DB_STR;
+		VAL_STR(&val) = *id;
+	}
+
+	if (dr_dbf->use_table( db_hdl, table) < 0) {
+		LM_ERR("cannot select table \"%.*s\"\n", table->len, table->s);
+		return -1;
+	}
+
+	if ( dr_dbf->query( db_hdl, &key, 0, &val, columns, 1, db_cols, 0,
+	&res) < 0) {
+		LM_ERR("DB query failed\n");
+		return -1;
+	}
+
+	LM_DBG("%d records found in %.*s for <%.*s>\n", RES_ROW_N(res),
+		table->len, table->s, id->len, id->s);
+
+	n = 0;
+	for(i=0; i < RES_ROW_N(res); i++) {
+		switch (type) {
+			case DR_DELTA_GW:
+				rc = load_gw_row(rdata, RES_ROWS(res)+i, persistent_state);
+				break;
+			case DR_DELTA_CARRIER:
+				rc = load_carrier_row(rdata, RES_ROWS(res)+i, persistent_state);
+				break;
+			default:
+				rc = load_rule_row(rdata, RES_ROWS(res)+i);
+		}
+		if (rc<0) {
+			dr_dbf->free_result(db_hdl, res);
+			return -1;
+		}
+		if (rc==0)
+			n++;
+	}
+
+	dr_dbf->free_result(db_hdl, res);
+
+	return n;
+}
@@ -38,4 +38,7 @@
 
 rt_data_t* dr_load_routing_info(struct head_db * ,int persistent_state);
 
+int dr_load_delta(struct head_db *current_partition, int persistent_state,
+		rt_data_t *rdata, int type, str *id);
+
 #endif
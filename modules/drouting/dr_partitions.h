@@ -36,7 +36,8 @@
 #include "../../db/db.h"
 #include "../../mem/mem.h"
 #include "../../mem/shm_mem.h"
-#include "../../rw_locking.h"
+#include "../../locking.h"
+#include "../../timer.h"
 #include "../../action.h"
 #include "../../error.h"
 #include "../../ut.h"
@@ -75,9 +76,19 @@ struct head_db {
 	int gw_attrs_avp;
 	int rule_attrs_avp;
 	int carrier_attrs_avp;
+	/* published via RCU - see dr_rcu.h */
 	rt_data_t **rdata;
-	rw_lock_t *ref_lock;
+	/* incremented with each publishing of rdata */
+	unsigned int rdata_gen;
+	/* serializes the reloads and the publishing of rdata */
+	gen_lock_t *reload_lock;
 	int ongoing_reload;
+	/* reload statistics */
+	unsigned long reloads;
+	utime_t last_reload_duration;
+	utime_t max_reload_duration;
+	unsigned long deltas;
+	utime_t last_delta_duration;
 	struct head_db *next;
 };
 
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Project
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+#include <unistd.h>
+
+#include "../../mem/shm_mem.h"
+#include "../../dprint.h"
+#include "dr_rcu.h"
+
+struct dr_rcu *dr_rcu = NULL;
+
+/* read sections of the current process may nest */
+int dr_rcu_nesting = 0;
+
+int dr_rcu_init(void)
+{
+	unsigned int slots_no;
+	char *p;
+
+	slots_no = count_child_processes();
+
+	/* one slot per process, each on its own cache line */
+	p = shm_malloc(sizeof *dr_rcu + (slots_no + 1) * sizeof(struct dr_rcu_slot));
+	if (p == NULL) {
+		LM_ERR("no more shm mem\n");
+		return -1;
+	}
+	memset(p, 0, sizeof *dr_rcu + (slots_no + 1) * sizeof(struct dr_rcu_slot));
+
+	dr_rcu = (struct dr_rcu *)p;
+	dr_rcu->slots = (struct dr_rcu_slot *)(void *)(((unsigned long)
+		(p + sizeof *dr_rcu) + DR_RCU_CACHE_LINE - 1) &
+		~(unsigned long)(DR_RCU_CACHE_LINE - 1));
+	dr_rcu->slots_no = slots_no;
+	dr_rcu->epoch = 1;
+
+	if (lock_init(&dr_rcu->lock) == NULL) {
+		LM_ERR("failed to init lock\n");
+		shm_free(dr_rcu);
+		dr_rcu = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void dr_rcu_destroy(void)
+{
+	struct dr_rcu_gen *gen;
+
+	if (dr_rcu == NULL)
+		return;
+
+	/* no more readers at this point */
+	while ((gen = dr_rcu->retired) != NULL) {
+		dr_rcu->retired = gen->next;
+		gen->free_f(gen->data);
+		shm_free(gen);
+	}
+
+	lock_destroy(&dr_rcu->lock);
+	shm_free(dr_rcu);
+	dr_rcu = NULL;
+}
+
+/* the oldest epoch still being read in, 0 if no reader at all */
+static unsigned long dr_rcu_oldest_reader(void)
+{
+	unsigned long e, min = 0;
+	unsigned int i;
+
+	for (i = 0; i < dr_rcu->slots_no; i++) {
+		e = dr_rcu->slots[i].epoch;
+		if (e && (min == 0 || e < min))
+			min = e;
+	}
+
+	return min;
+}
+
+void dr_rcu_reclaim(void)
+{
+	struct dr_rcu_gen *gen, *done = NULL, **last = &done;
+	unsigned long oldest;
+	utime_t now, grace;
+
+	if (dr_rcu->pending == 0)
+		return;
+
+	lock_get(&dr_rcu->lock);
+
+	oldest = dr_rcu_oldest_reader();
+
+	/* the retired list is ordered by epoch */
+	while ((gen = dr_rcu->retired) != NULL &&
+	(oldest == 0 || oldest >= gen->epoch)) {
+		dr_rcu->retired = gen->next;
+		dr_rcu->pending--;
+		*last = gen;
+		last = &gen->next;
+	}
+	*last = NULL;
+	if (dr_rcu->retired == NULL)
+		dr_rcu->retired_last = NULL;
+	else
+		/* some reader is late */
+		dr_rcu->stalls++;
+
+	now = get_uticks();
+	for (gen = done; gen; gen = gen->next) {
+		grace = now - gen->retired;
+		dr_rcu->grace_periods++;
+		dr_rcu->last_grace = grace;
+		if (grace > dr_rcu->max_grace)
+			dr_rcu->max_grace = grace;
+	}
+
+	lock_release(&dr_rcu->lock);
+
+	while ((gen = done) != NULL) {
+		done = gen->next;
+		gen->free_f(gen->data);
+		shm_free(gen);
+	}
+}
+
+void dr_rcu_retire(void *data, void (*free_f)(void *data))
+{
+	struct dr_rcu_gen *gen;
+
+	gen = shm_malloc(sizeof *gen);
+	if (gen == NULL) {
+		if (dr_rcu_nesting) {
+			LM_CRIT("no more shm mem, leaking the retired data\n");
+			return;
+		}
+		LM_ERR("no more shm mem, waiting for the readers\n");
+		/* enter a new epoch and wait for all the older readers */
+		__sync_add_and_fetch(&dr_rcu->epoch, 1);
+		while (dr_rcu_oldest_reader() &&
+		dr_rcu_oldest_reader() < dr_rcu->epoch)
+			usleep(1000);
+		free_f(data);
+		return;
+	}
+
+	gen->data = data;
+	gen->free_f = free_f;
+	gen->next = NULL;
+	gen->retired = get_uticks();
+
+	lock_get(&dr_rcu->lock);
+
+	/* the readers entering from now on can no longer see the data */
+	gen->epoch = __sync_add_and_fetch(&dr_rcu->epoch, 1);
+
+	if (dr_rcu->retired_last)
+		dr_rcu->retired_last->next = gen;
+	else
+		dr_rcu->retired = gen;
+	dr_rcu->retired_last = gen;
+	dr_rcu->pending++;
+
+	lock_release(&dr_rcu->lock);
+
+	/* most of the time, the readers are already gone */
+	dr_rcu_reclaim();
+}
+
+void dr_rcu_timer(unsigned int ticks, void *param)
+{
+	dr_rcu_reclaim();
+}
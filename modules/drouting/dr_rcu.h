@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Project
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ */
+
+/*
+ * Read-copy-update publishing of the routing data
+ *
+ * The readers take no lock: entering a read section only publishes, in a
+ * per-process slot, the epoch the process is reading in. A reload builds
+ * the new data aside, publishes it by swapping the partition's pointer
+ * and retires the old data under a new epoch; the old data is freed once
+ * no process is still reading in an older epoch (all of them passed a
+ * quiescent point - outside of any read section).
+ */
+
+#ifndef _DROUTING_RCU_H_
+#define _DROUTING_RCU_H_
+
+#include "../../pt.h"
+#include "../../locking.h"
+#include "../../timer.h"
+
+#define DR_RCU_CACHE_LINE 64
+
+struct dr_rcu_slot {
+	/* epoch the process reads in, 0 if quiescent */
+	volatile unsigned long epoch;
+	char _pad[DR_RCU_CACHE_LINE - sizeof(unsigned long)];
+};
+
+/* data retired by a reload, waiting for the readers to go */
+struct dr_rcu_gen {
+	void *data;
+	void (*free_f)(void *data);
+	unsigned long epoch;
+	utime_t retired;
+	struct dr_rcu_gen *next;
+};
+
+struct dr_rcu {
+	volatile unsigned long epoch;
+	gen_lock_t lock;
+	/* retired data, oldest first */
+	struct dr_rcu_gen *retired;
+	struct dr_rcu_gen *retired_last;
+	unsigned int pending;
+	/* statistics */
+	unsigned long grace_periods;
+	utime_t last_grace;
+	utime_t max_grace;
+	unsigned long stalls;
+	unsigned int slots_no;
+	struct dr_rcu_slot *slots;
+};
+
+extern struct dr_rcu *dr_rcu;
+extern int dr_rcu_nesting;
+
+int dr_rcu_init(void);
+void dr_rcu_destroy(void);
+
+/* queues the data to be freed (via free_f) once all the readers which may
+ * still see it are gone */
+void dr_rcu_retire(void *data, void (*free_f)(void *data));
+
+/* frees all the retired data no longer visible to any reader */
+void dr_rcu_reclaim(void);
+
+void dr_rcu_timer(unsigned int ticks, void *param);
+
+static inline void dr_rcu_read_lock(void)
+{
+	if (dr_rcu_nesting++ == 0) {
+		dr_rcu->slots[process_no].epoch = dr_rcu->epoch;
+		/* make the slot visible before reading any shared pointer */
+		__sync_synchronize();
+	}
+}
+
+static inline void dr_rcu_read_unlock(void)
+{
+	if (--dr_rcu_nesting == 0) {
+		/* all the reads are done before becoming quiescent */
+		__sync_synchronize();
+		dr_rcu->slots[process_no].epoch = 0;
+	}
+}
+
+/* loads a pointer published via RCU */
+#define dr_rcu_dereference(_p) (*(volatile typeof(_p) *)&(_p))
+
+/* publishes a pointer to fully initialized data */
+#define dr_rcu_assign_pointer(_p, _v) \
+	do { \
+		__sync_synchronize(); \
+		(_p) = (_v); \
+	} while (0)
+
+#endif
@@ -24,6 +24,8 @@
 #include "prefix_tree.h"
 #include "dr_partitions.h"
 #include "dr_replication.h"
+#include "dr_rcu.h"
+#include "dr_delta.h"
 
 
 /* module parameter to control the replication */
@@ -34,6 +36,7 @@ struct clusterer_binds clusterer_api;
 
 /* implemented in drouting.c */
 void dr_raise_event(struct head_db *p, pgw_t *gw);
+int dr_delta_data_head(struct head_db *hd, int type, str *id);
 
 extern struct head_db * head_db_start;
 
@@ -109,6 +112,42 @@ void replicate_dr_carrier_status_event(struct head_db *p, pcr_t *cr,
 }
 
 
+void replicate_dr_delta_event(struct head_db *p, int type, str *id,
+																int cluster)
+{
+	bin_packet_t packet;
+	int rc;
+
+	if(bin_init(&packet, &status_repl_cap, REPL_DR_DELTA, BIN_VERSION, 0)!=0){
+		LM_ERR("failed to replicate this event\n");
+		return;
+	}
+
+	/* replicate the partition name */
+	bin_push_str(&packet, &p->partition);
+	/* replicate the type and the ID of the changed element; the peers
+	 * re-read it from DB, the same as the local node did */
+	bin_push_int(&packet, type);
+	bin_push_str(&packet, id);
+
+	rc = clusterer_api.send_all(&packet, cluster);
+	switch (rc) {
+	case CLUSTERER_CURR_DISABLED:
+		LM_INFO("Current node is disabled in cluster: %d\n", cluster);
+		break;
+	case CLUSTERER_DEST_DOWN:
+		LM_INFO("All destinations in cluster: %d are down or probing\n",
+			cluster);
+		break;
+	case CLUSTERER_SEND_ERR:
+		LM_ERR("Error sending in cluster: %d\n", cluster);
+		break;
+	}
+
+	bin_free_packet(&packet);
+}
+
+
 static int gw_status_update(bin_packet_t *packet)
 {
 	struct head_db *part;
@@ -125,7 +164,7 @@ static int gw_status_update(bin_packet_t *packet)
 	if (part==NULL)
 		return -1;
 
-	lock_start_read(part->ref_lock);
+	dr_rcu_read_lock();
 
 	gw = get_gw_by_id( (*part->rdata)->pgw_tree, &gw_id);
 	if (gw && ((gw->flags&DR_DST_STAT_MASK)!=flags)) {
@@ -135,11 +174,11 @@ static int gw_status_update(bin_packet_t *packet)
 		gw->flags |= DR_DST_STAT_DIRT_FLAG;
 		/* raise event for the status change */
 		dr_raise_event(part, gw);
-		lock_stop_read(part->ref_lock);
+		dr_rcu_read_unlock();
 		return 0;
 	}
 
-	lock_stop_read(part->ref_lock);
+	dr_rcu_read_unlock();
 
 	return -1;
 }
@@ -161,7 +200,7 @@ static int cr_status_update(bin_packet_t *packet)
 	if (part==NULL)
 		return -1;
 
-	lock_start_read(part->ref_lock);
+	dr_rcu_read_lock();
 
 	cr = get_carrier_by_id( (*part->rdata)->carriers_tree, &cr_id);
 	if (cr && ((cr->flags&DR_CR_FLAG_IS_OFF)!=flags)) {
@@ -169,16 +208,40 @@ static int cr_status_update(bin_packet_t *packet)
 		cr->flags = ((~DR_CR_FLAG_IS_OFF)&cr->flags)|(DR_CR_FLAG_IS_OFF&flags);
 		/* set the DIRTY flag to force flushing to DB */
 		cr->flags |= DR_CR_FLAG_DIRTY;
-		lock_stop_read(part->ref_lock);
+		dr_rcu_read_unlock();
 		return 0;
 	}
 
-	lock_stop_read(part->ref_lock);
+	dr_rcu_read_unlock();
 
 	return -1;
 }
 
 
+static int delta_update(bin_packet_t *packet)
+{
+	struct head_db *part;
+	str part_name;
+	str id;
+	int type;
+
+	bin_pop_str(packet, &part_name);
+	bin_pop_int(packet, &type);
+	bin_pop_str(packet, &id);
+
+	if (type!=DR_DELTA_GW && type!=DR_DELTA_CARRIER && type!=DR_DELTA_RULE) {
+		LM_ERR("unknown delta type %d\n", type);
+		return -1;
+	}
+
+	part = get_partition( &part_name );
+	if (part==NULL)
+		return -1;
+
+	return dr_delta_data_head(part, type, &id);
+}
+
+
 void receive_dr_binary_packet(bin_packet_t *packet)
 {
 	LM_DBG("received a binary packet [%d]!\n", packet->type);
@@ -195,6 +258,9 @@ void receive_dr_binary_packet(bin_packet_t *packet)
 	case REPL_CR_STATUS_UPDATE:
 		cr_status_update(packet);
 		break;
+	case REPL_DR_DELTA:
+		delta_update(packet);
+		break;
 	default:
 		LM_WARN("Invalid drouting binary packet command: %d (from node: %d in cluster: %d)\n",
 			packet->type, packet->src_id, dr_repl_cluster);
@@ -30,6 +30,7 @@
 
 #define REPL_GW_STATUS_UPDATE 1
 #define REPL_CR_STATUS_UPDATE 2
+#define REPL_DR_DELTA 3
 
 extern int dr_repl_cluster;
 
@@ -45,6 +46,10 @@ void replicate_dr_gw_status_event(struct head_db *p, pgw_t *gw, int cluster);
 void replicate_dr_carrier_status_event(struct head_db *p, pcr_t *cr,
 																int cluster);
 
+/* replicate an incremental change (gw, carrier or rule) via BIN */
+void replicate_dr_delta_event(struct head_db *p, int type, str *id,
+																int cluster);
+
 /* handler for incoming BIN packets */
 void receive_dr_binary_packet(bin_packet_t *packet);
 
@@ -31,11 +31,13 @@
 #include <stdio.h>
 #include <assert.h>
 #include <unistd.h>
+#include <time.h>
 
 
 #include "../../evi/evi.h"
 #include "../../map.h"
 #include "../../ipc.h"
+#include "../../statistics.h"
 
 #include "dr_load.h"
 #include "prefix_tree.h"
@@ -43,6 +45,8 @@
 #include "dr_db_def.h"
 #include "dr_partitions.h"
 #include "dr_replication.h"
+#include "dr_rcu.h"
+#include "dr_delta.h"
 #include "dr_api.h"
 #include "dr_api_internal.h"
 
@@ -150,6 +154,14 @@ static int populate_carrier_attrs;
 int tree_size = 0;
 int inode = 0;
 int unode = 0;
+
+static stat_var *prefix_lookups = 0;
+static stat_var *prefix_lookup_ns = 0;
+/* time one prefix lookup out of this many (0 - none) */
+static int lookup_stats_sampling = 100;
+static unsigned long get_prefix_tree_size(void *context);
+static unsigned long get_prefix_tree_nodes(void *context);
+static unsigned long get_prefix_lookup_avg(void *context);
 static str attrs_empty = str_init("");
 
 /* configuration loader from db specific stuff */
@@ -243,7 +255,6 @@ static int to_partition(struct sip_msg*, dr_partition_t *,
 
 
 /* reader-writers lock for reloading the data */
-static rw_lock_t *ref_lock = NULL;
 
 static int dr_init(void);
 static int dr_child_init(int rank);
@@ -284,6 +295,10 @@ static struct mi_root* mi_dr_number_routing(struct mi_root *cmd_tree,
 		void *param);
 static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree,
 		void *param);
+static struct mi_root* mi_dr_reload_stats(struct mi_root *cmd_tree,
+		void *param);
+static struct mi_root* mi_dr_reload_delta(struct mi_root *cmd_tree,
+		void *param);
 
 
 /* event */
@@ -415,6 +430,7 @@ static param_export_t params[] = {
 	{"probing_reply_codes",STR_PARAM, &dr_probe_replies.s     },
 	{"persistent_state", INT_PARAM, &dr_persistent_state      },
 	{"no_concurrent_reload",INT_PARAM, &no_concurrent_reload  },
+	{"lookup_stats_sampling",INT_PARAM, &lookup_stats_sampling },
 	{"partition_id_pvar", STR_PARAM, &partition_pvar.s},
 	{"status_replication_cluster",INT_PARAM, &dr_repl_cluster },
 	{0, 0, 0}
@@ -439,12 +455,33 @@ static param_export_t params[] = {
 	" (load from database) for all partitions if no parameter is supplied, or"\
 " for a partition given as parameter. If use_partitions is 0, you should"\
 " not specify a partition."
+static stat_export_t dr_stats[] = {
+	{"prefix_tree_size",     STAT_IS_FUNC,
+		(stat_var**)get_prefix_tree_size   },
+	{"prefix_tree_nodes",    STAT_IS_FUNC,
+		(stat_var**)get_prefix_tree_nodes  },
+	{"prefix_lookups",       0, &prefix_lookups         },
+	{"prefix_lookup_ns",     0, &prefix_lookup_ns       },
+	{"prefix_lookup_avg_ns", STAT_IS_FUNC,
+		(stat_var**)get_prefix_lookup_avg  },
+	{0,0,0}
+};
+
+#define HLP6 "Params: none; Lists, for all partitions, the number and the "\
+	"duration of the reloads, together with the statistics of the freeing "\
+	"of the reloaded data (waiting for the readers to release it)."
+#define HLP7 "Params: [partition] gw|carrier|rule id ; Re-loads from DB "\
+	"only the given gateway, carrier or rule (removing it, if no longer in "\
+	"DB), without stopping the routing; the change is also replicated to "\
+	"the cluster."
 static mi_export_t mi_cmds[] = {
 	{ "dr_reload",         HLP1, dr_reload_cmd,    0, 0,  0},
 	{ "dr_gw_status",      HLP2, mi_dr_gw_status,  0,                0,  0},
 	{ "dr_carrier_status", HLP3, mi_dr_cr_status,  0,                0,  0},
 	{ "dr_number_routing", HLP4, mi_dr_number_routing, 0,            0,  0},
 	{ "dr_reload_status", HLP5, mi_dr_reload_status,   0,            0,  0},
+	{ "dr_reload_stats",  HLP6, mi_dr_reload_stats,    0,            0,  0},
+	{ "dr_reload_delta",  HLP7, mi_dr_reload_delta,    0,            0,  0},
 	{ 0, 0, 0, 0, 0, 0}
 };
 
@@ -478,7 +515,7 @@ struct module_exports exports = {
 	cmds,            /* Exported functions */
 	0,               /* Exported async functions */
 	params,          /* Exported parameters */
-	0,               /* exported statistics */
+	dr_stats,        /* exported statistics */
 	mi_cmds,         /* exported MI functions */
 	0,               /* exported pseudo-variables */
 	0,			 	 /* exported transformations */
@@ -615,12 +652,12 @@ static int dr_disable_w_part(struct sip_msg *req, struct head_db *current_partit
 	int_str id_val;
 	pgw_t *gw;
 
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	avp = search_first_avp( AVP_VAL_STR, current_partition->gw_id_avp, &id_val,0);
 	if (avp==NULL) {
 		LM_DBG(" no AVP ID ->nothing to disable\n");
-		lock_stop_read( current_partition->ref_lock );
+		dr_rcu_read_unlock();
 		return -1;
 	}
 
@@ -632,7 +669,7 @@ static int dr_disable_w_part(struct sip_msg *req, struct head_db *current_partit
 		dr_gw_status_changed( current_partition, gw);
 	}
 
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	return 1;
 }
@@ -660,7 +697,7 @@ static void dr_probing_callback( struct cell *t, int type,
 
 
 
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	_id = ((param_prob_callback_t*)*ps->param)->_id;
 
@@ -687,7 +724,7 @@ static void dr_probing_callback( struct cell *t, int type,
 
 
 end:
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	return;
 }
@@ -710,7 +747,7 @@ static void dr_prob_handler(unsigned int ticks, void* param)
 		if (it->rdata==NULL || *(it->rdata)==NULL)
 			return;
 
-		lock_start_read( it->ref_lock );
+		dr_rcu_read_lock();
 
 		/* go through all destinations */
 		for (map_first( (*(it->rdata))->pgw_tree, &map_it);
@@ -768,7 +805,7 @@ static void dr_prob_handler(unsigned int ticks, void* param)
 
 		}
 
-		lock_stop_read( it->ref_lock );
+		dr_rcu_read_unlock();
 		it = it->next;
 	}
 }
@@ -887,11 +924,11 @@ static void dr_state_timer(unsigned int ticks, void* param)
 	struct head_db * it;
 	it = head_db_start;
 	while( it!=NULL ) {
-		lock_start_read( it->ref_lock );
+		dr_rcu_read_lock();
 
 		dr_state_flusher(it);
 
-		lock_stop_read( it->ref_lock );
+		dr_rcu_read_unlock();
 		it = it->next;
 	}
 }
@@ -901,6 +938,11 @@ static void dr_state_timer(unsigned int ticks, void* param)
  * -1, else return 0
  */
 
+static void free_rt_data_gen(void *data)
+{
+	free_rt_data( (rt_data_t*)data, 1 );
+}
+
 static inline int dr_reload_data_head( struct head_db *hd )
 {
 	rt_data_t *new_data;
@@ -908,39 +950,34 @@ static inline int dr_reload_data_head( struct head_db *hd )
 	pgw_t *gw, *old_gw;
 	pcr_t *cr, *old_cr;
 	time_t rawtime;
+	utime_t start, duration;
 
 	void **dest;
 	map_iterator_t it;
 
 	if (no_concurrent_reload) {
-		lock_get( hd->ref_lock->lock );
+		lock_get( hd->reload_lock );
 		if (hd->ongoing_reload) {
-			lock_release( hd->ref_lock->lock );
+			lock_release( hd->reload_lock );
 			LM_WARN("Reload already in progress, discarding this one\n");
 			return -2;
 		}
 		hd->ongoing_reload = 1;
-		lock_release( hd->ref_lock->lock );
+		lock_release( hd->reload_lock );
 	}
 
+	start = get_uticks();
+
+	/* the readers keep working with the current data in the meantime */
 	new_data = dr_load_routing_info(hd, dr_persistent_state);
 	if ( new_data==0 ) {
 		LM_CRIT("failed to load routing info\n");
 		goto error;
 	}
 
-	lock_start_write( hd->ref_lock );
+	dr_rcu_read_lock();
 
-	/* no more activ readers -> do the swapping */
-	old_data = *(hd->rdata);
-	*(hd->rdata) = new_data;
-	/* update the time of the last reload for the current partition */
-	time(&rawtime);
-	hd->time_last_update = rawtime;
-
-	lock_stop_write( (hd->ref_lock) );
-
-	/* destroy old data */
+	old_data = dr_rcu_dereference(*(hd->rdata));
 	if (old_data) {
 		/* copy the state of gw/cr from old data */
 		/* interate new gws and search them into old data */
@@ -974,13 +1011,35 @@ static inline int dr_reload_data_head( struct head_db *hd )
 				cr->flags |= old_cr->flags&DR_CR_FLAG_IS_OFF;
 			}
 		}
-
-		/* free old data */
-		free_rt_data( old_data, 1 );
 	}
 
+	dr_rcu_read_unlock();
+
+	/* publish the new data - no waiting for the readers */
+	lock_get( hd->reload_lock );
+	old_data = *(hd->rdata);
+	dr_rcu_assign_pointer(*(hd->rdata), new_data);
+	hd->rdata_gen++;
+	lock_release( hd->reload_lock );
+
+	/* update the time of the last reload for the current partition */
+	time(&rawtime);
+	hd->time_last_update = rawtime;
+
+	duration = get_uticks() - start;
+	hd->reloads++;
+	hd->last_reload_duration = duration;
+	if (duration > hd->max_reload_duration)
+		hd->max_reload_duration = duration;
+
+	/* destroy old data, once no longer used by any reader */
+	if (old_data)
+		dr_rcu_retire( old_data, free_rt_data_gen );
+
 	/* generate new blacklist from the routing info */
-	populate_dr_bls((*(hd->rdata))->pgw_tree);
+	dr_rcu_read_lock();
+	populate_dr_bls(dr_rcu_dereference(*(hd->rdata))->pgw_tree);
+	dr_rcu_read_unlock();
 
 	if (no_concurrent_reload)
 		hd->ongoing_reload = 0;
@@ -992,6 +1051,96 @@ error:
 	return -1;
 }
 
+/* how many times a delta is derived again, if the routing data changed
+ * (reload, other delta) while deriving it */
+#define DR_DELTA_RETRIES 3
+
+/* applies an incremental change - a single gateway, carrier or rule,
+ * re-read from DB - to the routing data of the partition */
+int dr_delta_data_head(struct head_db *hd, int type, str *id)
+{
+	rt_data_t *new_data;
+	rt_data_t *old_data;
+	rt_data_t *snap;
+	unsigned int gen;
+	utime_t start;
+	int retries;
+
+	start = get_uticks();
+
+	for (retries = 0; ; retries++) {
+		/* only a copy of the current data is taken in the read section,
+		 * the DB query and the prefix tree build are done out of it */
+		dr_rcu_read_lock();
+
+		lock_get( hd->reload_lock );
+		old_data = dr_rcu_dereference(*(hd->rdata));
+		gen = hd->rdata_gen;
+		lock_release( hd->reload_lock );
+
+		if (old_data == NULL) {
+			dr_rcu_read_unlock();
+			LM_ERR("no routing data loaded for partition %.*s\n",
+				hd->partition.len, hd->partition.s);
+			return -1;
+		}
+
+		snap = dr_snapshot_rt_data(old_data);
+
+		dr_rcu_read_unlock();
+
+		if (snap == NULL) {
+			LM_ERR("failed to copy the routing data of partition %.*s\n",
+				hd->partition.len, hd->partition.s);
+			return -1;
+		}
+
+		new_data = dr_derive_rt_data(hd, snap, type, id,
+			dr_persistent_state);
+		free_rt_data(snap, 1);
+		if (new_data == NULL) {
+			LM_ERR("failed to apply the change of <%.*s> in partition "
+				"%.*s\n", id->len, id->s,
+				hd->partition.len, hd->partition.s);
+			return -1;
+		}
+
+		/* publish the new data only if derived from the current one (the
+		 * generation number, as the address of a retired data may be
+		 * reused) */
+		lock_get( hd->reload_lock );
+		if (hd->rdata_gen == gen) {
+			old_data = *(hd->rdata);
+			dr_rcu_assign_pointer(*(hd->rdata), new_data);
+			hd->rdata_gen++;
+			lock_release( hd->reload_lock );
+			break;
+		}
+		lock_release( hd->reload_lock );
+
+		free_rt_data(new_data, 1);
+
+		if (retries == DR_DELTA_RETRIES) {
+			LM_ERR("routing data of partition %.*s keeps changing, "
+				"giving up\n", hd->partition.len, hd->partition.s);
+			return -1;
+		}
+		LM_DBG("routing data changed meanwhile, deriving again\n");
+	}
+
+	hd->deltas++;
+	hd->last_delta_duration = get_uticks() - start;
+
+	dr_rcu_retire( old_data, free_rt_data_gen );
+
+	/* generate new blacklist from the routing info */
+	dr_rcu_read_lock();
+	populate_dr_bls(dr_rcu_dereference(*(hd->rdata))->pgw_tree);
+	dr_rcu_read_unlock();
+
+	return 0;
+}
+
 static inline int dr_reload_data( void ) {
 	struct head_db * it_head_db;
 	int ret_val = 0;
@@ -1097,8 +1246,9 @@ static int cleanup_head_db( struct head_db *hd) {
 		if( hd->db_con &&  *(hd->db_con) ) {
 			hd->db_funcs.close(*(hd->db_con));
 		}
-		if( hd->ref_lock ) {
-			lock_destroy_rw( ref_lock );
+		if( hd->reload_lock ) {
+			lock_destroy( hd->reload_lock );
+			lock_dealloc( hd->reload_lock );
 		}
 		if ( hd->rdata ) {
 			shm_free(hd->rdata);
@@ -1208,6 +1358,18 @@ static int dr_init(void)
 
 	LM_INFO("Dynamic-Routing - initializing\n");
 
+	if (dr_rcu_init()!=0) {
+		LM_ERR("failed to init the data publishing\n");
+		return -1;
+	}
+
+	/* free the data retired by reloads, once no longer used */
+	if (register_timer("dr-reclaim", dr_rcu_timer, NULL, 1,
+	TIMER_FLAG_SKIP_ON_DELAY)<0) {
+		LM_ERR("failed to register reclaim handler\n");
+		return -1;
+	}
+
 	name_w_part.s = shm_malloc( MAX_LEN_NAME_W_PART /* length of
 													   fixed string */);
 	if( name_w_part.s == 0 ) {
@@ -1497,8 +1659,13 @@ static int dr_init(void)
 		*(head_db_end->rdata) = 0;
 
 		/* create & init lock */
-		if ((head_db_end->ref_lock = lock_init_rw()) == NULL) {
+		if ((head_db_end->reload_lock = lock_alloc()) == NULL ||
+		lock_init(head_db_end->reload_lock) == NULL) {
 			LM_CRIT("failed to init lock\n");
+			if (head_db_end->reload_lock) {
+				lock_dealloc(head_db_end->reload_lock);
+				head_db_end->reload_lock = 0;
+			}
 			head_db_end->db_url.s = 0;
 			goto skip;
 		}
@@ -1819,9 +1986,10 @@ static int dr_exit(void)
 		}
 
 		/* destroy lock */
-		if (to_clean->ref_lock) {
-			lock_destroy_rw( to_clean->ref_lock );
-			to_clean->ref_lock = 0;
+		if (to_clean->reload_lock) {
+			lock_destroy( to_clean->reload_lock );
+			lock_dealloc( to_clean->reload_lock );
+			to_clean->reload_lock = 0;
 
 		}
 
@@ -1851,6 +2019,9 @@ static int dr_exit(void)
 	/* destroy all callbacks */
 	destroy_dr_cbs();
 
+	/* free any data still waiting for the readers */
+	dr_rcu_destroy();
+
 	return 0;
 }
 
@@ -2324,12 +2495,12 @@ static int use_next_gw_w_part(struct sip_msg* msg,
 		get_avp_val(avp, &val);
 
 		/* we have an ID, so we can check the GW state */
-		lock_start_read( current_partition->ref_lock );
+		dr_rcu_read_lock();
 		dst = get_gw_by_id( (*current_partition->rdata)->pgw_tree, &val.s);
 		if (dst && (dst->flags & DR_DST_STAT_DSBL_FLAG) == 0)
 			ok = 1;
 
-		lock_stop_read( current_partition->ref_lock );
+		dr_rcu_read_unlock();
 
 		if ( ok )
 			break;
@@ -2604,6 +2775,65 @@ struct head_db * get_partition(const str *name) {
 }
 
 
+/* prefix lookup, accounting the time of a sample of the lookups in the
+ * statistics */
+static inline rt_info_t* dr_get_prefix(cptree_t *pt, str *prefix,
+		unsigned int rgid, unsigned int *matched_len, unsigned int *rgidx)
+{
+	static unsigned int lookups_left = 0;
+	struct timespec begin, end;
+	rt_info_t *rt;
+
+	if (lookup_stats_sampling <= 0 || lookups_left-- > 0)
+		return cptree_get_prefix(pt, prefix, rgid, matched_len, rgidx);
+	lookups_left = lookup_stats_sampling - 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	rt = cptree_get_prefix(pt, prefix, rgid, matched_len, rgidx);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	update_stat(prefix_lookups, 1);
+	update_stat(prefix_lookup_ns, (end.tv_sec - begin.tv_sec) * 1000000000L +
+		(end.tv_nsec - begin.tv_nsec));
+
+	return rt;
+}
+
+
+static unsigned long get_prefix_tree_stat(int nodes)
+{
+	struct head_db *it;
+	unsigned long ret = 0;
+
+	for (it = head_db_start; it; it = it->next) {
+		dr_rcu_read_lock();
+		if (*(it->rdata) && (*(it->rdata))->pt)
+			ret += nodes ? (*(it->rdata))->pt->nodes_no :
+				(*(it->rdata))->pt->size;
+		dr_rcu_read_unlock();
+	}
+
+	return ret;
+}
+
+static unsigned long get_prefix_tree_size(void *context)
+{
+	return get_prefix_tree_stat(0);
+}
+
+static unsigned long get_prefix_tree_nodes(void *context)
+{
+	return get_prefix_tree_stat(1);
+}
+
+static unsigned long get_prefix_lookup_avg(void *context)
+{
+	unsigned long lookups = get_stat_val(prefix_lookups);
+
+	return lookups ? get_stat_val(prefix_lookup_ns) / lookups : 0;
+}
+
+
 static int do_routing(struct sip_msg* msg, dr_part_group_t * part_group,
 												int flags, gparam_t* whitelist)
 {
@@ -2818,7 +3048,7 @@ static int do_routing(struct sip_msg* msg, dr_part_group_t * part_group,
 			grp_id,rule_idx,username.len,username.s);
 
 	/* ref the data for reading */
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 search_again:
 
@@ -2837,7 +3067,7 @@ search_again:
 	}
 
 	/* search a prefix */
-	rt_info = get_prefix( (*(current_partition->rdata))->pt, &username,
+	rt_info = dr_get_prefix( (*(current_partition->rdata))->pt, &username,
 			(unsigned int)grp_id,&prefix_len, &rule_idx);
 
 	if (flags & DR_PARAM_STRICT_LEN) {
@@ -3076,7 +3306,7 @@ no_gws:
 	}
 
 	/* we are done reading -> unref the data */
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	/* prepare/update data for fallback */
 	if ( flags & DR_PARAM_RULE_FALLBACK ) {
@@ -3155,7 +3385,7 @@ no_gws:
 error2:
 	if (wl_list) pkg_free(wl_list);
 	/* we are done reading -> unref the data */
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 error1:
 	if (ruri_buf) pkg_free(ruri_buf);
 	return ret;
@@ -3244,7 +3474,7 @@ static int route2_carrier(struct sip_msg* msg, char* part_carrier,
 	}
 
 	/* ref the data for reading */
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	cr = get_carrier_by_id( (*current_partition->rdata)->carriers_tree, &id );
 	if (cr==NULL) {
@@ -3334,13 +3564,13 @@ static int route2_carrier(struct sip_msg* msg, char* part_carrier,
 no_gws:
 
 	/* we are done reading -> unref the data */
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 	if (ruri_buf) pkg_free(ruri_buf);
 
 	return 1;
 error:
 	/* we are done reading -> unref the data */
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 error_free:
 	if (ruri_buf) pkg_free(ruri_buf);
 	return -1;
@@ -3420,7 +3650,7 @@ static int route2_gw(struct sip_msg* msg, char* ch_part_gw, char* gw_att_pv)
 	}
 
 	/* ref the data for reading */
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 
 	idx = 0;
@@ -3435,7 +3665,7 @@ static int route2_gw(struct sip_msg* msg, char* ch_part_gw, char* gw_att_pv)
 		str_trim_spaces_lr(id);
 		if (id.len<=0) {
 			LM_ERR("empty slot\n");
-			lock_stop_read( current_partition->ref_lock );
+			dr_rcu_read_unlock();
 			return -1;
 		} else {
 			LM_DBG("found and looking for gw id <%.*s>,len=%d\n",id.len, id.s, id.len);
@@ -3462,7 +3692,7 @@ static int route2_gw(struct sip_msg* msg, char* ch_part_gw, char* gw_att_pv)
 	} while(ids.len>0);
 
 	/* we are done reading -> unref the data */
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	if ( idx==0 ) {
 		LM_ERR("no GW added at all\n");
@@ -4144,7 +4374,7 @@ static int _is_dr_gw_w_part(struct sip_msg* msg, char * part, char* flags_pv,
 		}
 	}
 
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	if(current_partition->rdata!=NULL && *current_partition->rdata!=NULL) {
 		for (map_first((*current_partition->rdata)->pgw_tree, &gw_it);
@@ -4217,13 +4447,13 @@ static int _is_dr_gw_w_part(struct sip_msg* msg, char * part, char* flags_pv,
 					}
 				}
 end:
-				lock_stop_read( current_partition->ref_lock );
+				dr_rcu_read_unlock();
 				return 1;
 			}
 		}
 	}
 
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	return -1;
 }
@@ -4434,7 +4664,7 @@ static struct mi_root* mi_dr_gw_status(struct mi_root *cmd, void *param)
 	if( (rpl_tree = mi_w_partition(&node, &current_partition))!=NULL )
 		return rpl_tree; /* something went wrong: bad command format */
 
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	if (current_partition->rdata==NULL || *current_partition->rdata==NULL) {
 		rpl_tree = init_mi_tree( 404, MI_SSTR("No Data available yet"));
@@ -4546,10 +4776,10 @@ static struct mi_root* mi_dr_gw_status(struct mi_root *cmd, void *param)
 	rpl_tree = init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
 
 done:
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 	return rpl_tree;
 error:
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 	if(rpl_tree) free_mi_tree(rpl_tree);
 	return NULL;
 }
@@ -4576,7 +4806,7 @@ static struct mi_root* mi_dr_cr_status(struct mi_root *cmd, void *param)
 		return rpl_tree;
 	}
 
-	lock_start_read( current_partition->ref_lock );
+	dr_rcu_read_lock();
 
 	if (current_partition->rdata==NULL || *current_partition->rdata==NULL) {
 		rpl_tree = init_mi_tree( 404, MI_SSTR("No Data available yet"));
@@ -4663,10 +4893,10 @@ static struct mi_root* mi_dr_cr_status(struct mi_root *cmd, void *param)
 	rpl_tree = init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
 
 done:
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 	return rpl_tree;
 error:
-	lock_stop_read( current_partition->ref_lock );
+	dr_rcu_read_unlock();
 	if(rpl_tree) free_mi_tree(rpl_tree);
 	return NULL;
 }
@@ -4922,6 +5152,7 @@ static struct mi_root* mi_dr_number_routing(struct mi_root *cmd_tree, void *para
 	str s;
 	int grp_id;
 	unsigned int matched_len;
+	unsigned int rule_idx = 0;
 	struct mi_node *prefix_node;
 	rt_info_t *route;
 
@@ -4956,17 +5187,20 @@ static struct mi_root* mi_dr_number_routing(struct mi_root *cmd_tree, void *para
 		return init_mi_tree(200, MI_OK_S, MI_OK_LEN);
 	}
 
-	lock_start_read( partition->ref_lock );
-	route = find_rule_by_prefix_unsafe((*(partition->rdata))->pt,
-			&(*(partition->rdata))->noprefix, node->value, grp_id, &matched_len);
+	dr_rcu_read_lock();
+	route = cptree_get_prefix((*(partition->rdata))->pt, &node->value,
+			(unsigned int)grp_id, &matched_len, &rule_idx);
+	if (route == NULL)
+		route = check_rt(&(*(partition->rdata))->noprefix,
+			(unsigned int)grp_id);
 	if (route == NULL){
-		lock_stop_read( partition->ref_lock );
+		dr_rcu_read_unlock();
 		return init_mi_tree(200, MI_OK_S, MI_OK_LEN);
 	}
 
 	struct mi_root* rpl_tree = init_mi_tree(200, MI_OK_S, MI_OK_LEN);
 	if (rpl_tree == NULL){
-		lock_stop_read( partition->ref_lock );
+		dr_rcu_read_unlock();
 		return 0;
 	}
 
@@ -4979,7 +5213,7 @@ static struct mi_root* mi_dr_number_routing(struct mi_root *cmd_tree, void *para
 	if ((prefix_node = add_mi_node_child(&rpl_tree->node, 0, matched_str.s,
 		matched_str.len, node->value.s, matched_len)) == NULL) {
 		LM_ERR("failed to add node\n");
-		lock_stop_read( partition->ref_lock );
+		dr_rcu_read_unlock();
 		free_mi_tree(rpl_tree);
 		return 0;
 	}
@@ -5000,12 +5234,12 @@ static struct mi_root* mi_dr_number_routing(struct mi_root *cmd_tree, void *para
 					chosen_desc.len, chosen_id.s, chosen_id.len) == NULL) {
 
 			LM_ERR("failed to add node\n");
-			lock_stop_read( partition->ref_lock );
+			dr_rcu_read_unlock();
 			free_mi_tree(rpl_tree);
 			return 0;
 		}
 	}
-	lock_stop_read( partition->ref_lock );
+	dr_rcu_read_unlock();
 
 	return rpl_tree;
 }
@@ -5028,7 +5262,7 @@ static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree, void *param
 				return init_mi_tree(400, MI_BAD_PARM_S, MI_BAD_PARM_LEN);
 			}
 			/* display just for given partition */
-			lock_start_read(partition->ref_lock);
+			dr_rcu_read_lock();
 			/* take care as ctime puts an '\n' at the end of the
 			 * returned string - we will get rid of it by len-1 later */
 			ch_time = ctime(&partition->time_last_update);
@@ -5045,7 +5279,7 @@ static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree, void *param
 				LM_ERR("failed to add mi_attr\n");
 				goto error;
 			}
-			lock_stop_read(partition->ref_lock);
+			dr_rcu_read_unlock();
 		} else {
 			return init_mi_tree(400, MI_NO_PART_S, MI_NO_PART_LEN);
 		}
@@ -5055,7 +5289,7 @@ static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree, void *param
 
 		/* display for all partitions */
 		for(partition = head_db_start; partition; partition = partition->next) {
-			lock_start_read(partition->ref_lock);
+			dr_rcu_read_lock();
 			ch_time = ctime(&partition->time_last_update);
 			LM_DBG("partition  %.*s was last updated:%s\n",
 					partition->partition.len, partition->partition.s,
@@ -5072,14 +5306,14 @@ static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree, void *param
 				LM_ERR("failed to add attr to mi_node\n");
 				goto error;
 			}
-			lock_stop_read(partition->ref_lock);
+			dr_rcu_read_unlock();
 		}
 	}
 	else {
 		/* just one partition */
 		partition = head_db_start;
 
-		lock_start_read(partition->ref_lock);
+		dr_rcu_read_lock();
 		ch_time = ctime(&partition->time_last_update);
 		if((ans = add_mi_node_child(&rpl_tree->node, 0,
 						MI_LAST_UPDATE_S, MI_LAST_UPDATE_LEN,
@@ -5087,14 +5321,104 @@ static struct mi_root* mi_dr_reload_status(struct mi_root *cmd_tree, void *param
 			LM_ERR("failed to add mi_node\n");
 			goto error;
 		}
-		lock_stop_read(partition->ref_lock);
+		dr_rcu_read_unlock();
 
 	}
 	return rpl_tree;
 error:
-	lock_stop_read(partition->ref_lock);
+	dr_rcu_read_unlock();
 	free_mi_tree(rpl_tree);
 	return 0;
 }
 
 
+
+static struct mi_root* mi_dr_reload_stats(struct mi_root *cmd_tree, void *param)
+{
+	struct mi_root *rpl_tree;
+	struct mi_node *node, *rpl;
+	struct head_db *partition;
+
+	rpl_tree = init_mi_tree(200, MI_OK_S, MI_OK_LEN);
+	if (rpl_tree == NULL)
+		return NULL;
+	rpl = &rpl_tree->node;
+
+	for (partition = head_db_start; partition; partition = partition->next) {
+		node = add_mi_node_child(rpl, MI_DUP_VALUE, MI_PART_NAME_S,
+			MI_PART_NAME_LEN, partition->partition.s, partition->partition.len);
+		if (node == NULL)
+			goto error;
+		if (addf_mi_attr(node, 0, MI_SSTR("Reloads"), "%lu",
+				partition->reloads) == NULL ||
+			addf_mi_attr(node, 0, MI_SSTR("Last duration (ms)"), "%llu",
+				(unsigned long long)partition->last_reload_duration/1000) == NULL ||
+			addf_mi_attr(node, 0, MI_SSTR("Max duration (ms)"), "%llu",
+				(unsigned long long)partition->max_reload_duration/1000) == NULL ||
+			addf_mi_attr(node, 0, MI_SSTR("Deltas"), "%lu",
+				partition->deltas) == NULL ||
+			addf_mi_attr(node, 0, MI_SSTR("Last delta duration (ms)"), "%llu",
+				(unsigned long long)partition->last_delta_duration/1000) == NULL)
+			goto error;
+	}
+
+	/* the freeing of the old data, delayed by the readers still using it */
+	node = add_mi_node_child(rpl, 0, MI_SSTR("Reclaim"), NULL, 0);
+	if (node == NULL)
+		goto error;
+
+	lock_get(&dr_rcu->lock);
+	if (addf_mi_attr(node, 0, MI_SSTR("Pending"), "%u",
+			dr_rcu->pending) == NULL ||
+		addf_mi_attr(node, 0, MI_SSTR("Reclaimed"), "%lu",
+			dr_rcu->grace_periods) == NULL ||
+		addf_mi_attr(node, 0, MI_SSTR("Last grace period (ms)"), "%llu",
+			(unsigned long long)dr_rcu->last_grace/1000) == NULL ||
+		addf_mi_attr(node, 0, MI_SSTR("Max grace period (ms)"), "%llu",
+			(unsigned long long)dr_rcu->max_grace/1000) == NULL ||
+		addf_mi_attr(node, 0, MI_SSTR("Reader stalls"), "%lu",
+			dr_rcu->stalls) == NULL) {
+		lock_release(&dr_rcu->lock);
+		goto error;
+	}
+	lock_release(&dr_rcu->lock);
+
+	return rpl_tree;
+error:
+	LM_ERR("failed to build the MI reply\n");
+	free_mi_tree(rpl_tree);
+	return init_mi_tree(500, MI_INTERNAL_ERR_S, MI_INTERNAL_ERR_LEN);
+}
+
+
+static struct mi_root* mi_dr_reload_delta(struct mi_root *cmd_tree, void *param)
+{
+	struct mi_root *rpl_tree;
+	struct mi_node *node;
+	struct head_db *partition;
+	str *id;
+	int type;
+
+	node = cmd_tree->node.kids;
+
+	if ( (rpl_tree=mi_w_partition(&node, &partition))!=NULL )
+		return rpl_tree;
+
+	if (node==NULL || node->next==NULL || node->next->next!=NULL)
+		return init_mi_tree( 400, MI_MISSING_PARM_S, MI_MISSING_PARM_LEN);
+
+	if ( (type=dr_delta_type(&node->value))<0 )
+		return init_mi_tree( 400, MI_SSTR("Bad type (gw, carrier or rule)"));
+
+	id = &node->next->value;
+	if (id->s==NULL || id->len==0)
+		return init_mi_tree( 400, MI_BAD_PARM_S, MI_BAD_PARM_LEN);
+
+	if ( dr_delta_data_head(partition, type, id)<0 )
+		return init_mi_tree( 500, MI_SSTR("Failed to apply the change"));
+
+	if (dr_repl_cluster > 0)
+		replicate_dr_delta_event(partition, type, id, dr_repl_cluster);
+
+	return init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
+}
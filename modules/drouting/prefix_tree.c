@@ -330,7 +330,7 @@ del_rt_list(
 	while(rwl!=NULL) {
 		t=rwl;
 		rwl=rwl->next;
-		if ( (--t->rtl->ref_cnt)==0)
+		if ( dr_unref(t->rtl) )
 			free_rt_info(t->rtl);
 		shm_free(t);
 	}
@@ -351,3 +351,471 @@ free_rt_info(
 	return;
 }
 
+
+
+/*
+ * Compressed prefix tree
+ */
+
+#define CPTREE_CHILD(_pt, _n, _d) \
+	((_pt)->nodes + (_n)->child + \
+		__builtin_popcount((_n)->mask & ((1<<(_d))-1)))
+
+#define CPTREE_HAS_RULES(_n) ((_n)->rg != ((_n)+1)->rg)
+
+#define CPTREE_ALIGN(_s) (((_s) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+int
+cptree_add_prefix(
+	cptree_builder_t *ptb,
+	str *prefix,
+	rt_info_t *r,
+	unsigned int rgid
+	)
+{
+	cptree_rec_t *recs;
+	char *digits;
+	unsigned int size;
+	int i;
+
+	if (prefix->len > CPTREE_MAX_DEPTH) {
+		LM_ERR("prefix too long (%d)\n", prefix->len);
+		return -1;
+	}
+	for (i = 0; i < prefix->len; i++) {
+		if ( !IS_DECIMAL_DIGIT(prefix->s[i]) ) {
+			LM_ERR("is not decimal digit\n");
+			return -1;
+		}
+	}
+
+	if (ptb->recs_no == ptb->recs_size) {
+		size = ptb->recs_size ? 2 * ptb->recs_size : 256;
+		recs = shm_realloc(ptb->recs, size * sizeof *recs);
+		if (recs == NULL) {
+			LM_ERR("no more shm mem\n");
+			return -1;
+		}
+		ptb->recs = recs;
+		ptb->recs_size = size;
+	}
+
+	/* the same prefix is usually added for several groups in a row */
+	if (ptb->recs_no &&
+	ptb->recs[ptb->recs_no-1].len == prefix->len &&
+	memcmp(ptb->digits + ptb->recs[ptb->recs_no-1].pos, prefix->s,
+	prefix->len) == 0) {
+		ptb->recs[ptb->recs_no].pos = ptb->recs[ptb->recs_no-1].pos;
+	} else {
+		if (ptb->digits_len + prefix->len > ptb->digits_size) {
+			size = ptb->digits_size ? 2 * ptb->digits_size : 4096;
+			while (size < ptb->digits_len + prefix->len)
+				size *= 2;
+			digits = shm_realloc(ptb->digits, size);
+			if (digits == NULL) {
+				LM_ERR("no more shm mem\n");
+				return -1;
+			}
+			ptb->digits = digits;
+			ptb->digits_size = size;
+		}
+		memcpy(ptb->digits + ptb->digits_len, prefix->s, prefix->len);
+		ptb->recs[ptb->recs_no].pos = ptb->digits_len;
+		ptb->digits_len += prefix->len;
+	}
+
+	ptb->recs[ptb->recs_no].rule = r;
+	ptb->recs[ptb->recs_no].rgid = rgid;
+	ptb->recs[ptb->recs_no].len = prefix->len;
+	ptb->recs[ptb->recs_no].seq = ptb->recs_no;
+	ptb->recs_no++;
+
+	dr_ref(r);
+	unode++;
+
+	return 0;
+}
+
+
+void
+cptree_builder_free(
+	cptree_builder_t *ptb
+	)
+{
+	unsigned int i;
+
+	for (i = 0; i < ptb->recs_no; i++)
+		if ( dr_unref(ptb->recs[i].rule) )
+			free_rt_info(ptb->recs[i].rule);
+
+	if (ptb->recs)
+		shm_free(ptb->recs);
+	if (ptb->digits)
+		shm_free(ptb->digits);
+	memset(ptb, 0, sizeof *ptb);
+}
+
+
+/* the digits buffer of the builder being sorted (qsort has no context) */
+static char *cptree_sort_digits;
+
+static int
+cptree_rec_cmp(
+	const void *a,
+	const void *b
+	)
+{
+	const cptree_rec_t *ra = a, *rb = b;
+	int ret;
+
+	ret = memcmp(cptree_sort_digits + ra->pos, cptree_sort_digits + rb->pos,
+		ra->len < rb->len ? ra->len : rb->len);
+	if (ret)
+		return ret;
+	if (ra->len != rb->len)
+		return ra->len < rb->len ? -1 : 1;
+	if (ra->rgid != rb->rgid)
+		return ra->rgid < rb->rgid ? -1 : 1;
+	/* higher priority first, then in the loading order */
+	if (ra->rule->priority != rb->rule->priority)
+		return ra->rule->priority > rb->rule->priority ? -1 : 1;
+	return ra->seq < rb->seq ? -1 : (ra->seq > rb->seq);
+}
+
+
+static inline void
+cptree_set_ptrs(
+	cptree_t *pt,
+	unsigned int digits_len
+	)
+{
+	char *p = (char*)pt + CPTREE_ALIGN(sizeof *pt);
+
+	pt->rgs = (cptree_rg_t*)p;
+	p += CPTREE_ALIGN((pt->rgs_no + 1) * sizeof(cptree_rg_t));
+	pt->rules = (rt_info_t**)p;
+	p += CPTREE_ALIGN(pt->rules_no * sizeof(rt_info_t*));
+	pt->digits = p;
+	p += CPTREE_ALIGN(digits_len);
+	pt->nodes = (cptree_node_t*)p;
+}
+
+
+/* compiles all the prefix rules of the builder into a compressed tree;
+ * on success, the builder is emptied (the tree takes over the references
+ * to the rules) */
+cptree_t*
+cptree_build(
+	cptree_builder_t *ptb
+	)
+{
+	cptree_rec_t *recs = ptb->recs;
+	cptree_node_t *n, *c;
+	cptree_t *pt, *npt;
+	unsigned int *pfx = NULL;
+	unsigned int pfx_no, rgs_no, digits_len, max_nodes;
+	unsigned int i, j, k, lo, hi, e, r, g, next, d, len;
+	unsigned long size;
+	char *a, *b;
+
+	if (ptb->recs_no == 0)
+		return NULL;
+
+	cptree_sort_digits = ptb->digits;
+	qsort(recs, ptb->recs_no, sizeof *recs, cptree_rec_cmp);
+
+	/* index the distinct prefixes (by their first record) */
+	pfx = shm_malloc((ptb->recs_no + 1) * sizeof *pfx);
+	if (pfx == NULL) {
+		LM_ERR("no more shm mem\n");
+		return NULL;
+	}
+
+	pfx_no = rgs_no = digits_len = 0;
+	for (i = 0; i < ptb->recs_no; i++) {
+		if (i == 0 || recs[i].len != recs[i-1].len ||
+		memcmp(ptb->digits + recs[i].pos, ptb->digits + recs[i-1].pos,
+		recs[i].len) != 0) {
+			pfx[pfx_no++] = i;
+			digits_len += recs[i].len;
+			rgs_no++;
+		} else if (recs[i].rgid != recs[i-1].rgid) {
+			rgs_no++;
+		}
+	}
+	pfx[pfx_no] = ptb->recs_no;
+
+	/* root + one node per prefix + at most one branching node per
+	 * prefix, plus the terminating node */
+	max_nodes = 2 * pfx_no + 2;
+
+	size = CPTREE_ALIGN(sizeof *pt) +
+		CPTREE_ALIGN((rgs_no + 1) * sizeof(cptree_rg_t)) +
+		CPTREE_ALIGN(ptb->recs_no * sizeof(rt_info_t*)) +
+		CPTREE_ALIGN(digits_len);
+
+	pt = shm_malloc(size + max_nodes * sizeof(cptree_node_t));
+	if (pt == NULL) {
+		LM_ERR("no more shm mem for a %lu bytes prefix tree\n",
+			size + max_nodes * sizeof(cptree_node_t));
+		shm_free(pfx);
+		return NULL;
+	}
+	memset(pt, 0, sizeof *pt);
+	pt->rgs_no = rgs_no;
+	pt->rules_no = ptb->recs_no;
+	pt->prefixes_no = pfx_no;
+	cptree_set_ptrs(pt, digits_len);
+
+	/* the digits pool - from now on, the records point into it */
+	for (i = 0, k = 0; i < pfx_no; i++) {
+		memcpy(pt->digits + k, ptb->digits + recs[pfx[i]].pos,
+			recs[pfx[i]].len);
+		recs[pfx[i]].pos = k;
+		k += recs[pfx[i]].len;
+	}
+
+	/* BFS build; until processed, a node keeps the range of prefixes it
+	 * covers in its "key" (first) and "rg" (end) fields */
+	memset(pt->nodes, 0, sizeof(cptree_node_t));
+	pt->nodes[0].rg = pfx_no;
+	next = 1;
+	r = g = 0;
+
+	for (i = 0; i < next; i++) {
+		n = pt->nodes + i;
+		lo = n->key;
+		hi = n->rg;
+		d = n->depth;
+
+		n->key = recs[pfx[lo]].pos;
+		n->rg = g;
+
+		/* the node itself is a prefix -> attach its routing groups */
+		if (recs[pfx[lo]].len == d) {
+			for (j = pfx[lo]; j < pfx[lo+1]; j++) {
+				if (j == pfx[lo] || recs[j].rgid != recs[j-1].rgid) {
+					pt->rgs[g].rgid = recs[j].rgid;
+					pt->rgs[g].rule = r;
+					g++;
+				}
+				pt->rules[r++] = recs[j].rule;
+			}
+			lo++;
+		}
+
+		/* one child for each digit following the node's prefix */
+		for ( ; lo < hi; lo = e) {
+			a = pt->digits + recs[pfx[lo]].pos;
+			for (e = lo + 1; e < hi &&
+				pt->digits[recs[pfx[e]].pos + d] == a[d]; e++);
+
+			/* the child goes down to the longest common prefix */
+			b = pt->digits + recs[pfx[e-1]].pos;
+			len = recs[pfx[e-1]].len < recs[pfx[lo]].len ?
+				recs[pfx[e-1]].len : recs[pfx[lo]].len;
+			for (k = d + 1; k < len && a[k] == b[k]; k++);
+
+			if (n->mask == 0)
+				n->child = next;
+			n->mask |= 1 << (a[d] - '0');
+
+			c = pt->nodes + next++;
+			c->child = 0;
+			c->mask = 0;
+			c->key = lo;
+			c->rg = e;
+			c->depth = k;
+		}
+	}
+
+	/* the terminating elements */
+	memset(pt->nodes + next, 0, sizeof(cptree_node_t));
+	pt->nodes[next].rg = g;
+	pt->rgs[g].rule = r;
+	pt->nodes_no = next;
+
+	shm_free(pfx);
+
+	/* give back the unused nodes */
+	pt->size = size + (next + 1) * sizeof(cptree_node_t);
+	if (next + 1 < max_nodes) {
+		npt = shm_realloc(pt, pt->size);
+		if (npt) {
+			pt = npt;
+			cptree_set_ptrs(pt, digits_len);
+		}
+	}
+
+	/* the tree took over the rule references */
+	shm_free(ptb->recs);
+	shm_free(ptb->digits);
+	memset(ptb, 0, sizeof *ptb);
+
+	tree_size += pt->size;
+	inode += pt->nodes_no;
+
+	LM_DBG("built prefix tree: %u prefixes, %u nodes, %u rules, %lu bytes\n",
+		pt->prefixes_no, pt->nodes_no, pt->rules_no, pt->size);
+
+	return pt;
+}
+
+
+/* a copy of the tree, sharing (referencing) the rules */
+cptree_t*
+cptree_dup(
+	cptree_t *pt
+	)
+{
+	cptree_t *npt;
+	unsigned int i;
+
+	npt = (cptree_t*)shm_malloc(pt->size);
+	if (npt == NULL) {
+		LM_ERR("no more shm mem for the prefix tree copy\n");
+		return NULL;
+	}
+	memcpy(npt, pt, pt->size);
+	cptree_set_ptrs(npt, (char*)pt->nodes - pt->digits);
+
+	for (i = 0; i < npt->rules_no; i++)
+		dr_ref(npt->rules[i]);
+
+	return npt;
+}
+
+
+void
+cptree_free(
+	cptree_t *pt
+	)
+{
+	unsigned int i;
+
+	if (pt == NULL)
+		return;
+
+	for (i = 0; i < pt->rules_no; i++)
+		if ( dr_unref(pt->rules[i]) )
+			free_rt_info(pt->rules[i]);
+
+	shm_free(pt);
+}
+
+
+/* finds the deepest node having rules, not deeper than "limit", which
+ * matches the beginning of the number; as the old prefix tree, it fails
+ * (returns -1) on non-digits in the visited part of the number */
+static inline int
+cptree_match(
+	cptree_t *pt,
+	str *prefix,
+	unsigned int limit,
+	cptree_node_t **hit
+	)
+{
+	cptree_node_t *n = pt->nodes, *c;
+	unsigned int k, d;
+	char *s = prefix->s;
+
+	*hit = NULL;
+
+	while (n->mask && n->depth < limit) {
+		if ( !IS_DECIMAL_DIGIT(s[n->depth]) )
+			return -1;
+		d = s[n->depth] - '0';
+		if ( !(n->mask & (1<<d)) )
+			break;
+
+		c = CPTREE_CHILD(pt, n, d);
+		/* the compressed part of the path */
+		for (k = n->depth + 1; k < c->depth; k++) {
+			if (k >= prefix->len)
+				return 0;
+			if ( !IS_DECIMAL_DIGIT(s[k]) )
+				return -1;
+			if (s[k] != pt->digits[c->key + k])
+				return 0;
+		}
+
+		if (c->depth > limit)
+			break;
+		n = c;
+		if (CPTREE_HAS_RULES(n))
+			*hit = n;
+	}
+
+	return 0;
+}
+
+
+static inline rt_info_t*
+cptree_check_rt(
+	cptree_t *pt,
+	cptree_node_t *n,
+	unsigned int rgid,
+	unsigned int *rgidx
+	)
+{
+	cptree_rg_t *rg;
+	rt_info_t *rt;
+	unsigned int i, j;
+
+	for (rg = pt->rgs + n->rg; rg < pt->rgs + (n+1)->rg; rg++) {
+		if (rg->rgid != rgid)
+			continue;
+
+		for (i = rg->rule, j = 0; i < (rg+1)->rule; i++) {
+			if ( j++ >= *rgidx) {
+				rt = pt->rules[i];
+				if (rt->time_rec == NULL || check_time(rt->time_rec)) {
+					/* if rules are still in this node, point to the
+					 * next index */
+					*rgidx = (i + 1 < (rg+1)->rule) ? j : 0;
+					return rt;
+				}
+			}
+		}
+		break;
+	}
+
+	return NULL;
+}
+
+
+rt_info_t*
+cptree_get_prefix(
+	cptree_t *pt,
+	str* prefix,
+	unsigned int rgid,
+	unsigned int *matched_len,
+	unsigned int *rgidx
+	)
+{
+	cptree_node_t *n;
+	unsigned int limit;
+	rt_info_t *rt;
+
+	if (pt == NULL || prefix == NULL || prefix->len <= 0)
+		return NULL;
+
+	/* go for the longest matching prefix and, if its rules do not
+	 * qualify, for the shorter ones */
+	limit = prefix->len;
+	while (1) {
+		if (cptree_match(pt, prefix, limit, &n) < 0)
+			return NULL;
+		if (n == NULL)
+			break;
+
+		if ( (rt = cptree_check_rt(pt, n, rgid, rgidx)) != NULL) {
+			if (matched_len) *matched_len = n->depth;
+			return rt;
+		}
+		limit = n->depth - 1;
+	}
+
+	if (matched_len) *matched_len = 0;
+	return NULL;
+}
@@ -83,6 +83,8 @@ typedef struct pgw_ {
 	unsigned short protos[DR_MAX_IPS];
 	unsigned short ips_no;
 	int flags;
+	/* how many generations of the routing data link this element */
+	unsigned int ref_cnt;
 }pgw_t;
 
 typedef struct pcr_ pcr_t;
@@ -114,8 +116,13 @@ struct pcr_ {
 	unsigned short pgwa_len;
 	/* attributes string */
 	str attrs;
+	/* the gateways list, as provisioned (null terminated), to resolve it
+	 * again when a missing gateway is added */
+	str gwlist;
 	/* linker in list */
 	pcr_t *next;
+	/* how many generations of the routing data link this element */
+	unsigned int ref_cnt;
 };
 
 
@@ -135,10 +142,21 @@ typedef struct rt_info_ {
 	pgw_list_t *pgwl;
 	/* length of the PSTN gw array */
 	unsigned short pgwa_len;
-	/* how many lists link this element */
-	unsigned short ref_cnt;
+	/* the destinations list, as provisioned (null terminated), to resolve
+	 * it again when a missing gateway or carrier is added */
+	str dstlist;
+	/* how many lists (of all the generations) link this element */
+	unsigned int ref_cnt;
 } rt_info_t;
 
+/* the gateways, carriers and rules may be shared by several generations of
+ * the routing data (see dr_delta.c), released by different processes, so
+ * their references are atomically counted */
+#define dr_ref(_e) \
+	__sync_add_and_fetch(&(_e)->ref_cnt, 1)
+#define dr_unref(_e) \
+	(__sync_sub_and_fetch(&(_e)->ref_cnt, 1)==0)
+
 typedef struct rt_info_wrp_ {
 	rt_info_t     *rtl;
 	struct rt_info_wrp_  *next;
@@ -162,6 +180,105 @@ typedef struct ptree_ {
 	ptree_node_t ptnode[PTREE_CHILDREN];
 } ptree_t;
 
+/* compressed prefix tree - a path compressed trie, built in bulk (at load
+ * time) out of all the prefix rules and kept in a single shm block. The
+ * nodes are laid out in BFS order, so the children of a node are
+ * contiguous (and mostly share the same cache line) */
+typedef struct cptree_node_ {
+	/* index of the first child, the others follow it; 0 if no children */
+	unsigned int child;
+	/* offset in the digits pool of a prefix starting with this node */
+	unsigned int key;
+	/* index of the first routing group of the node; its groups end where
+	 * the groups of the next node start */
+	unsigned int rg;
+	/* bitmask of the digits having a child */
+	unsigned short mask;
+	/* length of the prefix represented by the node */
+	unsigned short depth;
+} cptree_node_t;
+
+typedef struct cptree_rg_ {
+	unsigned int rgid;
+	/* index of the first rule of the group; its rules end where the rules
+	 * of the next group start */
+	unsigned int rule;
+} cptree_rg_t;
+
+typedef struct cptree_ {
+	unsigned int nodes_no;
+	unsigned int rgs_no;
+	unsigned int rules_no;
+	unsigned int prefixes_no;
+	/* size of the whole shm block */
+	unsigned long size;
+	/* all the arrays below have an extra terminating element */
+	cptree_node_t *nodes;
+	cptree_rg_t *rgs;
+	/* the rules of each group, sorted by priority */
+	rt_info_t **rules;
+	char *digits;
+} cptree_t;
+
+#define CPTREE_MAX_DEPTH 0xFFFF
+
+/* a prefix rule, as loaded, waiting to be compiled into the tree */
+typedef struct cptree_rec_ {
+	rt_info_t *rule;
+	unsigned int rgid;
+	/* offset of the prefix in the digits buffer */
+	unsigned int pos;
+	unsigned int len;
+	/* loading order, to keep the order of the same priority rules */
+	unsigned int seq;
+} cptree_rec_t;
+
+typedef struct cptree_builder_ {
+	cptree_rec_t *recs;
+	unsigned int recs_no;
+	unsigned int recs_size;
+	char *digits;
+	unsigned int digits_len;
+	unsigned int digits_size;
+} cptree_builder_t;
+
+int
+cptree_add_prefix(
+	cptree_builder_t *ptb,
+	str *prefix,
+	rt_info_t *r,
+	unsigned int rgid
+	);
+
+cptree_t*
+cptree_build(
+	cptree_builder_t *ptb
+	);
+
+cptree_t*
+cptree_dup(
+	cptree_t *pt
+	);
+
+void
+cptree_builder_free(
+	cptree_builder_t *ptb
+	);
+
+void
+cptree_free(
+	cptree_t *pt
+	);
+
+rt_info_t*
+cptree_get_prefix(
+	cptree_t *pt,
+	str* prefix,
+	unsigned int rgid,
+	unsigned int *matched_len,
+	unsigned int *rgidx
+	);
+
 void
 print_interim(
 		int,
@@ -34,6 +34,7 @@
 #include <ctype.h>
 
 #include "../../str.h"
+#include "../../ut.h"
 #include "../../resolve.h"
 #include "../../mem/mem.h"
 #include "../../mem/shm_mem.h"
@@ -57,8 +58,6 @@ build_rt_data( void )
 	}
 	memset(rdata, 0, sizeof(rt_data_t));
 
-	INIT_PTREE_NODE(NULL, rdata->pt);
-
 	rdata->pgw_tree = map_create( AVLMAP_SHARED );
 	rdata->carriers_tree = map_create( AVLMAP_SHARED );
 
@@ -223,6 +222,42 @@ error:
 }
 
 
+/* checks if a (gateway or carrier) ID is part of a destination list, as
+ * accepted by parse_destination_list() */
+int dst_list_has_id(char *dstlist, str *id, int is_carrier)
+{
+	char *tmp = dstlist;
+	int carrier;
+	str s;
+
+	while (tmp && *tmp!=0) {
+		EAT_SPACE(tmp);
+
+		carrier = 0;
+		if (*tmp==CARRIER_MARKER) {
+			carrier = 1;
+			tmp++;
+		}
+
+		s.s = tmp;
+		while( *tmp && (isalpha(*tmp) || isdigit(*tmp) || (*tmp)=='_' || (*tmp)=='-') )
+			tmp++;
+		s.len = tmp - s.s;
+
+		if (carrier==is_carrier && str_match(&s, id))
+			return 1;
+
+		/* skip the weight, up to the next destination */
+		while (*tmp!=0 && *tmp!=SEP && *tmp!=SEP1)
+			tmp++;
+		if (*tmp!=0)
+			tmp++;
+	}
+
+	return 0;
+}
+
+
 int add_carrier(char *id, int flags, char *gwlist, char *attrs,
 													int state, rt_data_t *rd)
 {
@@ -232,7 +267,8 @@ int add_carrier(char *id, int flags, char *gwlist, char *attrs,
 	str key;
 
 	/* allocate a new carrier structure */
-	cr = (pcr_t*)shm_malloc(sizeof(pcr_t)+strlen(id)+(attrs?strlen(attrs):0));
+	cr = (pcr_t*)shm_malloc(sizeof(pcr_t)+strlen(id)+(attrs?strlen(attrs):0)+
+		(gwlist?strlen(gwlist)+1:0));
 	if (cr==NULL) {
 		LM_ERR("no more shm mem for a new carrier\n");
 		goto error;
@@ -259,6 +295,7 @@ int add_carrier(char *id, int flags, char *gwlist, char *attrs,
 
 	/* copy integer fields */
 	cr->flags = flags;
+	cr->ref_cnt = 1;
 
 	/* set state */
 	if (state!=0)
@@ -278,6 +315,12 @@ int add_carrier(char *id, int flags, char *gwlist, char *attrs,
 		cr->attrs.len = strlen(attrs);
 		memcpy(cr->attrs.s,attrs,cr->attrs.len);
 	}
+	/* keep the gateways list */
+	if (gwlist && gwlist[0]!=0) {
+		cr->gwlist.s = cr->id.s + cr->id.len + cr->attrs.len;
+		cr->gwlist.len = strlen(gwlist);
+		memcpy(cr->gwlist.s,gwlist,cr->gwlist.len+1);
+	}
 
 	/* link it */
 	key.s = id;
@@ -288,9 +331,9 @@ int add_carrier(char *id, int flags, char *gwlist, char *attrs,
 	return 0;
 error:
 	if (cr) {
-		shm_free(cr);
 		if (cr->pgwl)
 			shm_free(cr->pgwl);
+		shm_free(cr);
 	}
 	return -1;
 }
@@ -311,7 +354,8 @@ build_rt_info(
 {
 	rt_info_t* rt = NULL;;
 
-	rt = (rt_info_t*)shm_malloc(sizeof(rt_info_t)+(attrs?strlen(attrs):0));
+	rt = (rt_info_t*)shm_malloc(sizeof(rt_info_t)+(attrs?strlen(attrs):0)+
+		(dstlst?strlen(dstlst)+1:0));
 	if (rt==NULL) {
 		LM_ERR("no more shm mem(1)\n");
 		goto err_exit;
@@ -329,6 +373,10 @@ build_rt_info(
 	}
 
 	if ( dstlst && dstlst[0]!=0 ) {
+		/* keep the destinations list */
+		rt->dstlist.s = (char*)(rt+1) + rt->attrs.len;
+		rt->dstlist.len = strlen(dstlst);
+		memcpy(rt->dstlist.s,dstlst,rt->dstlist.len+1);
 		if (parse_destination_list(rd, dstlst, &rt->pgwl,&rt->pgwa_len,0)!=0){
 			LM_ERR("failed to parse the destinations\n");
 			goto err_exit;
@@ -396,7 +444,7 @@ int add_rt_info(
 		shm_free( trg );
 	}
 	/* insert into list */
-	r->ref_cnt++;
+	dr_ref(r);
 	if(NULL==pn->rg[i].rtlw){
 		pn->rg[i].rtlw = rtl_wrp;
 		pn->rg[i].rgid = rgid;
@@ -572,6 +620,7 @@ add_dst(
 	}
 	pgw->strip = strip;
 	pgw->type = type;
+	pgw->ref_cnt = 1;
 
 	/* add address in the global list of destinations/GWs */
 	proxy = mk_proxy(&uri.host,uri.port_no,uri.proto,(uri.type==SIPS_URI_T));
@@ -625,12 +674,15 @@ err_exit:
 
 void destroy_pgw(void *pgw_p)
 {
-	shm_free((pgw_t *)pgw_p);
+	if ( dr_unref((pgw_t *)pgw_p) )
+		shm_free((pgw_t *)pgw_p);
 }
 
 void destroy_pcr(void *pcr_p)
 {
 	pcr_t* pcr = pcr_p;
+	if ( !dr_unref(pcr) )
+		return;
 	if (pcr->pgwl) shm_free(pcr->pgwl);
 	shm_free(pcr);
 }
@@ -665,7 +717,8 @@ free_rt_data(
 		del_pgw_list(rt_data->pgw_tree);
 		rt_data->pgw_tree = 0 ;
 		/* del prefix tree */
-		del_tree(rt_data->pt);
+		cptree_builder_free(&rt_data->ptb);
+		cptree_free(rt_data->pt);
 		rt_data->pt = 0 ;
 		/* del prefixless rules */
 		if(NULL!=rt_data->noprefix.rg) {
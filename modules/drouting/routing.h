@@ -61,8 +61,10 @@ typedef struct rt_data_ {
 
 	/* default routing list for prefixless rules */
 	ptree_node_t noprefix;
-	/* tree with routing prefixes */
-	ptree_t *pt;
+	/* prefix rules being loaded, to be compiled into the tree */
+	cptree_builder_t ptb;
+	/* compressed tree with routing prefixes */
+	cptree_t *pt;
 }rt_data_t;
 
 
@@ -128,6 +130,13 @@ parse_destination_list(
 	int no_resize
 	);
 
+int
+dst_list_has_id(
+	char *dstlist,
+	str *id,
+	int is_carrier
+	);
+
 void
 del_pgw_list(
 		map_t pgw_tree
@@ -32,6 +32,7 @@
 #include <sys/types.h>
 #include <regex.h>
 #include <math.h>
+#include <time.h>
 
 #include "../../sr_module.h"
 #include "../../mem/mem.h"
@@ -556,6 +557,195 @@ void hist_set_count(rl_pipe_t *pipe, long int value)
 }
 
 
+/*
+ * GCRA and SLIDING pipes keep their whole state in a few words, changed
+ * with compare-and-swap, so they are checked without holding the pipe's lock
+ * and the timer never has to visit them. Only the admitted requests count.
+ */
+#define RL_WIN_NO(_w)		((unsigned int)((_w) >> 32))
+#define RL_WIN_COUNT(_w)	((unsigned int)(_w))
+#define RL_WIN(_no, _count) \
+	(((unsigned long long)(_no) << 32) | (unsigned int)(_count))
+
+static inline unsigned long long rl_lazy_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* the period the limit applies to, in microseconds */
+static inline unsigned long long rl_lazy_period(void)
+{
+	return (rl_limit_per_interval ? rl_timer_interval : 1) * 1000000ULL;
+}
+
+/* the spacing between two requests, when the pipe is at its limit */
+static inline unsigned long long gcra_interval(int limit)
+{
+	unsigned long long inc;
+
+	if (limit <= 0)
+		return rl_lazy_period();
+
+	inc = rl_lazy_period() / limit;
+	return inc ? inc : 1;
+}
+
+/* the requests seen by the other nodes use up part of the burst */
+static int gcra_check(rl_pipe_t *pipe, int limit, int remote)
+{
+	unsigned long long now, tat, new_tat, inc, tolerance;
+
+	if (limit <= 0 || remote >= limit)
+		return -1;
+
+	inc = gcra_interval(limit);
+	tolerance = rl_lazy_period() - remote * inc;
+	now = rl_lazy_now();
+
+	do {
+		tat = pipe->lazy.tat;
+		new_tat = (tat > now ? tat : now) + inc;
+		if (new_tat - now > tolerance)
+			return -1;
+	} while (!__sync_bool_compare_and_swap(&pipe->lazy.tat, tat, new_tat));
+
+	return 1;
+}
+
+static int gcra_get_count(rl_pipe_t *pipe)
+{
+	unsigned long long now = rl_lazy_now(), tat = pipe->lazy.tat;
+	unsigned long long inc = gcra_interval(pipe->limit);
+
+	return tat > now ? (tat - now + inc - 1) / inc : 0;
+}
+
+static void gcra_set_count(rl_pipe_t *pipe, int value)
+{
+	unsigned long long now, tat, from, new_tat, inc;
+
+	if (value == 0) {
+		pipe->lazy.tat = 0;
+		return;
+	}
+
+	inc = gcra_interval(pipe->limit);
+	now = rl_lazy_now();
+
+	do {
+		tat = pipe->lazy.tat;
+		from = tat > now ? tat : now;
+		if (value < 0 && from - now < -value * inc)
+			new_tat = now;
+		else
+			new_tat = from + value * inc;
+	} while (!__sync_bool_compare_and_swap(&pipe->lazy.tat, tat, new_tat));
+}
+
+/* the previous window is considered to have been evenly loaded */
+static inline unsigned int sliding_prev(rl_pipe_t *pipe, unsigned int no,
+		unsigned long long elapsed, unsigned long long period)
+{
+	unsigned long long w = pipe->lazy.win[(no - 1) & 1];
+
+	if (RL_WIN_NO(w) != no - 1)
+		return 0;
+
+	return RL_WIN_COUNT(w) * (period - elapsed) / period;
+}
+
+static int sliding_check(rl_pipe_t *pipe, int limit, int remote)
+{
+	unsigned long long now, period, w;
+	unsigned int no, count, prev;
+
+	period = rl_lazy_period();
+	now = rl_lazy_now();
+	no = now / period;
+	prev = sliding_prev(pipe, no, now % period, period);
+
+	do {
+		w = pipe->lazy.win[no & 1];
+		/* the slot still holds the window before the previous one */
+		count = RL_WIN_NO(w) == no ? RL_WIN_COUNT(w) : 0;
+		if ((long long)count + prev + remote >= limit)
+			return -1;
+	} while (!__sync_bool_compare_and_swap(&pipe->lazy.win[no & 1], w,
+			RL_WIN(no, count + 1)));
+
+	return 1;
+}
+
+static int sliding_get_count(rl_pipe_t *pipe)
+{
+	unsigned long long now, period, w;
+	unsigned int no;
+
+	period = rl_lazy_period();
+	now = rl_lazy_now();
+	no = now / period;
+	w = pipe->lazy.win[no & 1];
+
+	return (RL_WIN_NO(w) == no ? RL_WIN_COUNT(w) : 0) +
+		sliding_prev(pipe, no, now % period, period);
+}
+
+/* only the current window is changed, its count never dropping under 0 */
+static void sliding_set_count(rl_pipe_t *pipe, int value)
+{
+	unsigned long long w;
+	unsigned int no;
+	long long count;
+
+	if (value == 0) {
+		pipe->lazy.win[0] = pipe->lazy.win[1] = 0;
+		return;
+	}
+
+	no = rl_lazy_now() / rl_lazy_period();
+
+	do {
+		w = pipe->lazy.win[no & 1];
+		count = (RL_WIN_NO(w) == no ? RL_WIN_COUNT(w) : 0) + (long long)value;
+		if (count < 0)
+			count = 0;
+	} while (!__sync_bool_compare_and_swap(&pipe->lazy.win[no & 1], w,
+			RL_WIN(no, count)));
+}
+
+/**
+ * checks a GCRA or SLIDING pipe; does not need the pipe's lock
+ * \param remote	the requests reported by the other nodes in the cluster
+ * \return	-1 if drop needed, 1 if allowed
+ */
+int rl_lazy_check(rl_pipe_t *pipe, int limit, int remote)
+{
+	if (pipe->algo == PIPE_ALGO_GCRA)
+		return gcra_check(pipe, limit, remote);
+
+	return sliding_check(pipe, limit, remote);
+}
+
+int rl_lazy_get_count(rl_pipe_t *pipe)
+{
+	if (pipe->algo == PIPE_ALGO_GCRA)
+		return gcra_get_count(pipe);
+
+	return sliding_get_count(pipe);
+}
+
+void rl_lazy_set_count(rl_pipe_t *pipe, int value)
+{
+	if (pipe->algo == PIPE_ALGO_GCRA)
+		gcra_set_count(pipe, value);
+	else
+		sliding_set_count(pipe, value);
+}
+
+
 /**
  * runs the pipe's algorithm
  * (expects rl_lock to be taken)
@@ -568,6 +758,9 @@ int rl_pipe_check(rl_pipe_t *pipe)
 	if (pipe->algo == PIPE_ALGO_HISTORY)
 		return (hist_update(pipe, 1) > pipe->limit ? -1 : 1);
 
+	if (RL_ALGO_LAZY(pipe->algo))
+		return rl_lazy_check(pipe, pipe->limit, rl_get_all_counters(pipe));
+
 	counter = rl_get_all_counters(pipe);
 
 	switch (pipe->algo) {
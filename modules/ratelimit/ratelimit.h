@@ -44,9 +44,15 @@ typedef enum {
 	PIPE_ALGO_RED,
 	PIPE_ALGO_FEEDBACK,
 	PIPE_ALGO_NETWORK,
-	PIPE_ALGO_HISTORY
+	PIPE_ALGO_HISTORY,
+	PIPE_ALGO_GCRA,
+	PIPE_ALGO_SLIDING
 } rl_algo_t;
 
+/* algorithms evaluated on each check, without any timer work */
+#define RL_ALGO_LAZY(_a) \
+	((_a) == PIPE_ALGO_GCRA || (_a) == PIPE_ALGO_SLIDING)
+
 typedef struct rl_repl_counter {
 	int counter;
 	time_t update;
@@ -76,6 +82,12 @@ typedef struct rl_pipe {
 	unsigned long last_used;	/* timestamp when the pipe was last accessed */
 	rl_repl_counter_t *dsts;	/* counters per destination */
 	rl_window_t rwin;			/* window of requests */
+	union {
+		/* GCRA: theoretical arrival time, in microseconds */
+		unsigned long long tat;
+		/* SLIDING: current and previous windows, as number << 32 | count */
+		unsigned long long win[2];
+	} lazy;						/* atomically updated, outside the lock */
 } rl_pipe_t;
 
 typedef struct rl_repl_dst {
@@ -147,6 +159,10 @@ int rl_bin_status(struct mi_node *root, int cluster_id, char *type, int type_len
 void hist_set_count(rl_pipe_t *pipe, long int value);
 int hist_get_count(rl_pipe_t *pipe);
 
+int rl_lazy_check(rl_pipe_t *pipe, int limit, int remote);
+int rl_lazy_get_count(rl_pipe_t *pipe);
+void rl_lazy_set_count(rl_pipe_t *pipe, int value);
+
 #define RL_PIPE_COUNTER		0
 #define RL_EXPIRE_TIMER		10
 #define RL_BUF_THRESHOLD	1400
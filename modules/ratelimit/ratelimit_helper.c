@@ -82,7 +82,8 @@ static str pipe_repl_cap = str_init("ratelimit-pipe-repl");
 
 /* returns true if the pipe should use cachedb interface */
 #define RL_USE_CDB(_p) \
-	(cdbc && (_p)->algo!=PIPE_ALGO_NETWORK && (_p)->algo!=PIPE_ALGO_FEEDBACK)
+	(cdbc && (_p)->algo!=PIPE_ALGO_NETWORK && (_p)->algo!=PIPE_ALGO_FEEDBACK \
+		&& !RL_ALGO_LAZY((_p)->algo))
 
 
 
@@ -278,6 +279,8 @@ struct {
 	{ str_init("FEEDBACK"), PIPE_ALGO_FEEDBACK},
 	{ str_init("NETWORK"), PIPE_ALGO_NETWORK},
 	{ str_init("SBT"), PIPE_ALGO_HISTORY},
+	{ str_init("GCRA"), PIPE_ALGO_GCRA},
+	{ str_init("SLIDING"), PIPE_ALGO_SLIDING},
 	{
 		{ 0, 0}, 0
 	},
@@ -343,10 +346,10 @@ rl_pipe_t *rl_create_pipe(int limit, rl_algo_t algo)
 int w_rl_check_3(struct sip_msg *_m, char *_n, char *_l, char *_a)
 {
 	str name;
-	int limit = 0, ret = 1, should_update = 0;
+	int limit = 0, ret = 1, should_update = 0, remote;
 	str algorithm;
 	unsigned int hash_idx;
-	rl_pipe_t **pipe;
+	rl_pipe_t **pipe, *lazy_pipe;
 
 	rl_algo_t algo = -1;
 
@@ -424,6 +427,19 @@ int w_rl_check_3(struct sip_msg *_m, char *_n, char *_l, char *_a)
 
 	/* set the last used time */
 	(*pipe)->last_used = time(0);
+	if (RL_ALGO_LAZY((*pipe)->algo)) {
+		/* just used, so the pipe is not freed by the timer for the next
+		 * expire_time seconds - its state is changed without the lock */
+		lazy_pipe = *pipe;
+		remote = lazy_pipe->dsts ? rl_get_all_counters(lazy_pipe) : 0;
+		RL_RELEASE_LOCK(hash_idx);
+
+		ret = rl_lazy_check(lazy_pipe, limit, remote);
+		LM_DBG("Pipe %.*s limit:%d should %sbe blocked (%p)\n",
+			name.len, name.s, limit, ret == 1 ? "NOT " : "", lazy_pipe);
+		goto end;
+	}
+
 	if (RL_USE_CDB(*pipe)) {
 		/* release the counter for a while */
 		if (rl_change_counter(&name, *pipe, 1) < 0) {
@@ -515,7 +531,8 @@ void rl_timer(unsigned int ticks, void *param)
 				if (value)
 					shm_free(value);
 				continue;
-			} else {
+			} else if (!RL_ALGO_LAZY((*pipe)->algo)) {
+				/* GCRA and SLIDING pipes are updated on each check */
 				/* leave the lock if a cachedb query should be done*/
 				if (RL_USE_CDB(*pipe)) {
 					if (rl_get_counter(key, *pipe) < 0) {
@@ -615,7 +632,9 @@ static int rl_map_print(void *param, str key, void *value)
 	if (!(attr = add_mi_attr(node, MI_DUP_VALUE, "limit", 5, p, len)))
 		return -1;
 
-	p = int2str((unsigned long)(pipe->last_counter), &len);
+	p = int2str((unsigned long)(RL_ALGO_LAZY(pipe->algo) ?
+		rl_lazy_get_count(pipe) + rl_get_all_counters(pipe) :
+		pipe->last_counter), &len);
 	if (!(attr = add_mi_attr(node, MI_DUP_VALUE, "counter", 7, p, len)))
 		return -1;
 
@@ -736,6 +755,8 @@ int w_rl_set_count(str key, int val)
 		}
 	} else if ((*pipe)->algo == PIPE_ALGO_HISTORY) {
 		hist_set_count(*pipe, val);
+	} else if (RL_ALGO_LAZY((*pipe)->algo)) {
+		rl_lazy_set_count(*pipe, val);
 	} else {
 		if (val && (val + (*pipe)->counter >= 0)) {
 			(*pipe)->counter += val;
@@ -994,7 +1015,7 @@ void rl_timer_repl(utime_t ticks, void *param)
 	rl_pipe_t **pipe;
 	str *key;
 	int nr = 0;
-	int ret;
+	int ret, counter;
 	bin_packet_t packet;
 
 	if (bin_init(&packet, &pipe_repl_cap, RL_PIPE_COUNTER, BIN_VERSION, 0) < 0) {
@@ -1037,11 +1058,17 @@ void rl_timer_repl(utime_t ticks, void *param)
 
 			/*
 			 * for the SBT algorithm it is safe to replicate the current
-			 * counter, since it is always updating according to the window
+			 * counter, since it is always updating according to the window;
+			 * GCRA and SLIDING only share what this instance admitted
 			 */
-			if ((ret = bin_push_int(&packet,
-						((*pipe)->algo == PIPE_ALGO_HISTORY ?
-						 (*pipe)->counter : (*pipe)->my_last_counter))) < 0)
+			if ((*pipe)->algo == PIPE_ALGO_HISTORY)
+				counter = (*pipe)->counter;
+			else if (RL_ALGO_LAZY((*pipe)->algo))
+				counter = rl_lazy_get_count(*pipe);
+			else
+				counter = (*pipe)->my_last_counter;
+
+			if ((ret = bin_push_int(&packet, counter)) < 0)
 				goto error;
 			nr++;
 
@@ -1112,6 +1139,8 @@ int rl_get_counter_value(str *key)
 		}
 	} else if ((*pipe)->algo == PIPE_ALGO_HISTORY)
 		ret = hist_get_count(*pipe);
+	else if (RL_ALGO_LAZY((*pipe)->algo))
+		ret = rl_lazy_get_count(*pipe) + rl_get_all_counters(*pipe);
 	else
 		ret = rl_get_all_counters(*pipe);
 
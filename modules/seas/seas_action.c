@@ -877,6 +877,8 @@ static inline void free_sip_msg_lite(struct sip_msg *my_msg)
       if (my_msg->headers)     free_hdr_field_lst(my_msg->headers);
       if (my_msg->add_rm)      free_lump_list(my_msg->add_rm);
       if (my_msg->body_lumps)  free_lump_list(my_msg->body_lumps);
+      free_hdr_scan(my_msg);
+      if (my_msg->hdr_index)   pkg_free(my_msg->hdr_index);
       /* this is not in lump_struct.h, and anyhow it's not supposed to be any lumps
        * in our messages... or is it?
       if (my_msg->reply_lump)   free_reply_lump(my_msg->reply_lump);
@@ -1121,6 +1123,7 @@ exit:
    if(my_msg){
       if(my_msg->headers)
 	 free_hdr_field_lst(my_msg->headers);
+      free_hdr_scan(my_msg);
       pkg_free(my_msg);
    }
    return retval;
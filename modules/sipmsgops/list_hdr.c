@@ -23,13 +23,14 @@
 #include "../../data_lump.h"
 #include "../../mem/mem.h"
 #include "../../parser/msg_parser.h"
+#include "../../parser/hdr_index.h"
 #include "../../parser/parse_list_hdr.h"
 
 
 static struct hdr_field * _get_first_header(struct sip_msg *msg,
 															gparam_t *gp_hdr)
 {
-	struct hdr_field *hdr;
+	struct hdr_iter it;
 	str sval;
 
 	/* be sure all SIP headers are parsed in the message */
@@ -38,30 +39,16 @@ static struct hdr_field * _get_first_header(struct sip_msg *msg,
 		return NULL;
 	}
 
-	if (gp_hdr->type == GPARAM_TYPE_INT) {
-
+	if (gp_hdr->type == GPARAM_TYPE_INT)
 		/* header given by ID*/
-		for (hdr=msg->headers; hdr; hdr=hdr->next)
-			if (gp_hdr->v.ival==hdr->type)
-				return hdr;
-
-	} else {
-
-		/* header given by string/variable */
-		if (fixup_get_svalue(msg, gp_hdr, &sval) != 0) {
-			LM_ERR("failed to get the string value from variable\n");
-			return NULL;
-		}
-		for (hdr=msg->headers; hdr; hdr=hdr->next)
-			if (hdr->type == HDR_OTHER_T &&
-			hdr->name.len == sval.len &&
-			strncasecmp(hdr->name.s, sval.s, hdr->name.len)==0)
-				return hdr;
+		return hdr_index_first(msg, gp_hdr->v.ival, NULL, &it);
 
+	/* header given by string/variable */
+	if (fixup_get_svalue(msg, gp_hdr, &sval) != 0) {
+		LM_ERR("failed to get the string value from variable\n");
+		return NULL;
 	}
-
-	/* header not found */
-	return NULL;
+	return hdr_index_first(msg, HDR_OTHER_T, &sval, &it);
 }
 
 
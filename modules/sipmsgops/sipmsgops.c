@@ -66,6 +66,7 @@
 #include "../../parser/parse_expires.h"
 #include "../../parser/parse_event.h"
 #include "../../parser/parse_hname2.h"
+#include "../../parser/hdr_index.h"
 #include "../../parser/parse_methods.h"
 #include "../../parser/parse_content.h"
 #include "../../parser/parse_privacy.h"
@@ -376,6 +377,7 @@ static int hf_already_removed(struct sip_msg* msg, unsigned int offset,
 static int remove_hf_f(struct sip_msg* msg, char* str_hf, char* foo)
 {
 	struct hdr_field *hf;
+	struct hdr_iter it;
 	struct lump* l;
 	int cnt;
 	pv_value_t pval;
@@ -398,22 +400,13 @@ static int remove_hf_f(struct sip_msg* msg, char* str_hf, char* foo)
 		return -1;
 	}
 
-	for (hf=msg->headers; hf; hf=hf->next) {
-		/* for well known header names str_hf->s will be set to NULL
-		   during parsing of opensips.cfg and str_hf->len contains
-		   the header type */
-		if (pval.flags & PV_VAL_INT)
-		{
-			if (pval.ri != hf->type)
-				continue;
-		} else {
-			if (hf->type != HDR_OTHER_T)
-				continue;
-			if (hf->name.len != pval.rs.len)
-				continue;
-			if (strncasecmp(hf->name.s, pval.rs.s, hf->name.len) != 0)
-				continue;
-		}
+	/* well known header names are looked up by type, the others
+	 * by name */
+	if (!(pval.flags & PV_VAL_INT))
+		pval.ri = HDR_OTHER_T;
+
+	for (hf=hdr_index_first(msg, pval.ri, &pval.rs, &it); hf;
+	hf=hdr_index_next(&it)) {
 		/* check to see if the header was already removed */
 		if (hf_already_removed(msg, hf->name.s-msg->buf, hf->len,
 					hf->type))
@@ -488,6 +481,7 @@ static int remove_hf_match_f(struct sip_msg* msg, char* pattern, char* regex_or_
 static int is_present_hf_f(struct sip_msg* msg, char* str_hf, char* foo)
 {
 	struct hdr_field *hf;
+	struct hdr_iter it;
 	pv_value_t pval;
 
 	memset(&pval, '\0', sizeof pval);
@@ -506,17 +500,12 @@ static int is_present_hf_f(struct sip_msg* msg, char* str_hf, char* foo)
 		return -1;
 	}
 
-	if (pval.flags & PV_VAL_INT) {
-		for (hf=msg->headers; hf; hf=hf->next)
-			if (pval.ri == hf->type)
-				return 1;
-	} else {
-		for (hf=msg->headers; hf; hf=hf->next)
-			if (hf->type == HDR_OTHER_T &&
-				hf->name.len == pval.rs.len &&
-				strncasecmp(hf->name.s, pval.rs.s, hf->name.len) == 0)
-				return 1;
-	}
+	if (pval.flags & PV_VAL_INT)
+		hf = hdr_index_first(msg, pval.ri, NULL, &it);
+	else
+		hf = hdr_index_first(msg, HDR_OTHER_T, &pval.rs, &it);
+	if (hf)
+		return 1;
 
 	LM_DBG("header '%.*s'(%d) not found\n", pval.rs.len, pval.rs.s, pval.ri);
 
@@ -594,6 +583,7 @@ static int add_hf_helper(struct sip_msg* msg, str *str1, str *str2,
 {
 	struct lump* anchor;
 	struct hdr_field *hf;
+	struct hdr_iter it;
 	char *s;
 	int len;
 	str s0;
@@ -605,21 +595,10 @@ static int add_hf_helper(struct sip_msg* msg, str *str1, str *str2,
 
 	hf = 0;
 	if(hfanc!=NULL) {
-		for (hf=msg->headers; hf; hf=hf->next) {
-			if(hfanc->type==GPARAM_TYPE_INT)
-			{
-				if (hfanc->v.ival!=hf->type)
-					continue;
-			} else {
-				if (hf->type!=HDR_OTHER_T)
-					continue;
-				if (hf->name.len!=hfanc->v.sval.len)
-					continue;
-				if (strncasecmp(hf->name.s,hfanc->v.sval.s,hf->name.len)!=0)
-					continue;
-			}
-			break;
-		}
+		if(hfanc->type==GPARAM_TYPE_INT)
+			hf = hdr_index_first(msg, hfanc->v.ival, NULL, &it);
+		else
+			hf = hdr_index_first(msg, HDR_OTHER_T, &hfanc->v.sval, &it);
 	}
 
 	if(mode == 0) { /* append */
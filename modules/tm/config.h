@@ -28,11 +28,75 @@
 #include "../../config.h"
 
 
-/* size of TM hash table */
+/* default size of TM hash table (the "hash_size" parameter) */
 #define TM_TABLE_ENTRIES     (1<<16)
 
-/* always use a power of 2 for hash table size */
-#define tm_hash( s1, s2 )     core_hash( &s1, &s2, TM_TABLE_ENTRIES)
+/* default number of locks striped over the TM hash table */
+#define TM_TABLE_LOCKS       (1<<12)
+
+/* average number of transactions per entry which makes the TM hash table
+   double its size, if allowed to (the "hash_max_size" parameter) */
+#define TM_TABLE_GROW_LOAD   4
+
+/* while growing, how many entries are moved to the new table at once,
+   and how often (in microseconds) */
+#define TM_TABLE_MOVE_CHUNK  4096
+#define TM_TABLE_MOVE_INTERVAL  (100*1000)
+
+/* the 32 bits hash of a transaction, whatever the table size - its entry
+   is picked out of the lower bits, so the table may grow */
+#define tm_hash( s1, s2 )     tm_hash_str( &(s1), &(s2) )
+
+#define tm_hash_rotl(_x, _r)  (((_x) << (_r)) | ((_x) >> (32 - (_r))))
+
+#define tm_hash_block(_h, _k) \
+	do { \
+		(_k) *= 0xcc9e2d51; \
+		(_k) = tm_hash_rotl(_k, 15); \
+		(_h) ^= (_k) * 0x1b873593; \
+	} while (0)
+
+/* murmur3 rounds over a string */
+static inline unsigned int tm_hash_mix(unsigned int h, const str *s)
+{
+	const unsigned char *p = (const unsigned char *)s->s;
+	const unsigned char *end = p + (s->len & ~3);
+	unsigned int k;
+	int i;
+
+	for (; p < end; p += 4) {
+		k = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+		tm_hash_block(h, k);
+		h = tm_hash_rotl(h, 13);
+		h = h * 5 + 0xe6546b64;
+	}
+
+	if (s->len & 3) {
+		for (k = 0, i = (s->len & 3) - 1; i >= 0; i--)
+			k = (k << 8) | p[i];
+		tm_hash_block(h, k);
+	}
+
+	return h;
+}
+
+static inline unsigned int tm_hash_str(const str *s1, const str *s2)
+{
+	unsigned int h;
+
+	h = tm_hash_mix(0, s1);
+	h = tm_hash_mix(h, s2);
+
+	/* spread all the bits into the lower ones */
+	h ^= s1->len + s2->len;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
 
 /* maximum length of localy generated acknowledgment */
 #define MAX_ACK_LEN   1024
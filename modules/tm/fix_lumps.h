@@ -35,6 +35,8 @@
 #ifndef _FIX_LUMPS_H
 #define _FIX_LUMPS_H
 
+#include "../../mem/msg_arena.h"
+
 /* used to delete attached via lumps from msg; msg can
    be either an original pkg msg, whose Via lump I want
    to delete before generating next branch, or a shmem-stored
@@ -68,7 +70,7 @@ inline static void free_via_clen_lump( struct lump **list )
 				if (!(foo->flags&LUMPFLAG_SHMEM))
 					free_lump(foo);
 				if (!(foo->flags&LUMPFLAG_SHMEM))
-					pkg_free(foo);
+					msg_free(foo);
 			}
 			a=lump->after;
 			while(a) {
@@ -76,7 +78,7 @@ inline static void free_via_clen_lump( struct lump **list )
 				if (!(foo->flags&LUMPFLAG_SHMEM))
 					free_lump(foo);
 				if (!(foo->flags&LUMPFLAG_SHMEM))
-					pkg_free(foo);
+					msg_free(foo);
 			}
 			if (prev_lump) prev_lump->next = lump->next;
 			else *list = lump->next;
@@ -84,7 +86,7 @@ inline static void free_via_clen_lump( struct lump **list )
 			if (!(lump->flags&LUMPFLAG_SHMEM))
 				free_lump(lump);
 			if (!(lump->flags&LUMPFLAG_SHMEM))
-				pkg_free(lump);
+				msg_free(lump);
 		} else {
 			/* store previous position */
 			prev_lump=lump;
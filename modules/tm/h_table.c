@@ -66,6 +66,16 @@ static struct s_table*  tm_table;
 
 int syn_branch = 1;
 
+/* bytes to allocate together with each cell, for its cloned request and
+ * branch buffers (0 - disabled) */
+int tm_cell_arena = 0;
+
+/* entries of the hash table at startup, its max size (if it may grow) and
+ * the number of locks striped over them */
+int tm_hash_size = TM_TABLE_ENTRIES;
+int tm_hash_max_size = 0;
+int tm_hash_locks = TM_TABLE_LOCKS;
+
 
 void reset_kr(void)
 {
@@ -83,15 +93,33 @@ enum kill_reason get_kr(void) {
 }
 
 
-void lock_hash(int i)
+void lock_hash(unsigned int hash)
+{
+	lock(&tm_table->locks[hash & (tm_table->locks_no - 1)]);
+}
+
+
+void unlock_hash(unsigned int hash)
+{
+	unlock(&tm_table->locks[hash & (tm_table->locks_no - 1)]);
+}
+
+
+static void lock_all_hash(void)
 {
-	lock(&tm_table->entrys[i].mutex);
+	unsigned int i;
+
+	for (i = 0; i < tm_table->locks_no; i++)
+		lock(&tm_table->locks[i]);
 }
 
 
-void unlock_hash(int i)
+static void unlock_all_hash(void)
 {
-	unlock(&tm_table->entrys[i].mutex);
+	unsigned int i;
+
+	for (i = 0; i < tm_table->locks_no; i++)
+		unlock(&tm_table->locks[i]);
 }
 
 
@@ -101,15 +129,54 @@ struct s_table* get_tm_table(void)
 }
 
 
-unsigned int transaction_count( void )
+/* the entry holding the transactions of a hash; to be called under the
+ * lock of the hash */
+struct entry* get_hash_entry(unsigned int hash)
 {
+	struct entry *p_entry;
+
+	if (tm_table->old_entrys) {
+		p_entry = &tm_table->old_entrys[hash & (tm_table->old_size - 1)];
+		if (!p_entry->moved)
+			return p_entry;
+	}
+
+	return &tm_table->entrys[hash & (tm_table->size - 1)];
+}
+
+
+/* calls @f for each entry holding transactions, by its index in the
+ * table; the entries are not locked, but the table does not change */
+int for_each_hash_entry(int (*f)(unsigned int, struct entry*, void*),
+		void *param)
+{
+	struct entry *p_entry;
 	unsigned int i;
-	unsigned int count;
+	int rc = 0;
+
+	lock_get(tm_table->resize_lock);
+
+	for (i = 0; i < tm_table->size; i++) {
+		p_entry = get_hash_entry(i);
+
+		/* not moved yet, so already listed under its old index */
+		if (i >= tm_table->old_size && p_entry != &tm_table->entrys[i])
+			continue;
+
+		if (f(i, p_entry, param) < 0) {
+			rc = -1;
+			break;
+		}
+	}
 
-	count=0;
-	for (i=0; i<TM_TABLE_ENTRIES; i++)
-		count+=tm_table->entrys[i].cur_entries;
-	return count;
+	lock_release(tm_table->resize_lock);
+	return rc;
+}
+
+
+unsigned int transaction_count( void )
+{
+	return tm_table->cells;
 }
 
 
@@ -133,8 +200,12 @@ void free_cell( struct cell* dead_cell )
 	tm_shm_lock();
 
 	/* UA Server */
-	if ( dead_cell->uas.request )
-		free_cloned_msg_unsafe( dead_cell->uas.request );
+	if ( dead_cell->uas.request ) {
+		if ( tm_in_arena( &dead_cell->arena, dead_cell->uas.request) )
+			free_cloned_msg_data_unsafe( dead_cell->uas.request );
+		else
+			free_cloned_msg_unsafe( dead_cell->uas.request );
+	}
 
 	if ( dead_cell->uas.response.buffer.s )
 		tm_shm_free_unsafe( dead_cell->uas.response.buffer.s );
@@ -143,7 +214,8 @@ void free_cell( struct cell* dead_cell )
 	for ( i =0 ; i<dead_cell->nr_of_outgoings;  i++ )
 	{
 		/* retransmission buffer */
-		if ( (b=dead_cell->uac[i].request.buffer.s) )
+		if ( (b=dead_cell->uac[i].request.buffer.s) &&
+		!tm_in_arena( &dead_cell->arena, b) )
 			tm_shm_free_unsafe( b );
 		b=dead_cell->uac[i].local_cancel.buffer.s;
 		if (b!=0 && b!=BUSY_BUFFER)
@@ -184,7 +256,7 @@ void free_cell( struct cell* dead_cell )
 	if ( dead_cell->extra_hdrs.s )
 		tm_shm_free_unsafe( dead_cell->extra_hdrs.s );
 
-	/* the cell's body */
+	/* the cell's body (and its arena) */
 	tm_shm_free_unsafe( dead_cell );
 
 	tm_shm_unlock();
@@ -239,16 +311,24 @@ struct cell*  build_cell( struct sip_msg* p_msg, int full_uas)
 	struct usr_avp **old;
 	struct tm_callback *cbs, *cbs_tmp;
 	unsigned short set;
+	unsigned int len;
+
+	len = TM_ARENA_ALIGN(sizeof(struct cell) + context_size(CONTEXT_TRAN));
 
 	/* allocs a new cell */
-	new_cell = (struct cell*)shm_malloc(sizeof(struct cell) + context_size(CONTEXT_TRAN));
+	new_cell = (struct cell*)shm_malloc(len + tm_cell_arena);
 	if  ( !new_cell ) {
 		ser_error=E_OUT_OF_MEM;
 		return NULL;
 	}
 
-	/* filling with 0 */
-	memset( new_cell, 0, sizeof( struct cell ) + context_size(CONTEXT_TRAN));
+	/* filling with 0 (the arena itself needs no init) */
+	memset( new_cell, 0, len);
+
+	if (tm_cell_arena) {
+		new_cell->arena.start = new_cell->arena.pos = (char*)new_cell + len;
+		new_cell->arena.end = new_cell->arena.start + tm_cell_arena;
+	}
 
 	/* get timer set id based on the transaction pointer, but
 	 * devide by 64 to avoid issues because pointer are 64 bits
@@ -275,7 +355,7 @@ struct cell*  build_cell( struct sip_msg* p_msg, int full_uas)
 		/* set now the hash index & label, in case begin callbacks need them
 		 * we are now under hash lock, so it's safe - vlad */
 		new_cell->hash_index = p_msg->hash_index;
-		new_cell->label = tm_table->entrys[ new_cell->hash_index].next_label;
+		new_cell->label = get_hash_entry(new_cell->hash_index)->next_label;
 
 		/* move the pending callbacks to transaction -bogdan */
 		if (p_msg->id==tmcb_pending_id) {
@@ -292,7 +372,8 @@ struct cell*  build_cell( struct sip_msg* p_msg, int full_uas)
 		/* clean possible previous added vias/clen header or else they would
 		 * get propagated in the failure routes */
 		free_via_clen_lump(&p_msg->add_rm);
-		new_cell->uas.request = sip_msg_cloner(p_msg,&sip_msg_len,full_uas?1:2);
+		new_cell->uas.request = sip_msg_cloner(p_msg, &sip_msg_len,
+			full_uas?1:2, &new_cell->arena);
 		if (!new_cell->uas.request)
 			goto error;
 		new_cell->uas.end_request=((char*)new_cell->uas.request)+sip_msg_len;
@@ -335,38 +416,73 @@ error:
 
 
 
-/* Release all the data contained by the hash table. All the aux. structures
- *  as sems, lists, etc, are also released */
-void free_hash_table(void)
+static void free_hash_entries(struct entry *entrys, unsigned int size)
 {
 	struct cell* p_cell;
 	struct cell* tmp_cell;
-	int    i;
+	unsigned int i;
 
+	/* delete all synonyms at hash-collision-slot i */
+	for( i = 0 ; i<size; i++)
+		for( p_cell = entrys[i].first_cell; p_cell; p_cell = tmp_cell )
+		{
+			tmp_cell = p_cell->next_cell;
+			free_cell( p_cell );
+		}
+
+	shm_free(entrys);
+}
+
+
+/* Release all the data contained by the hash table. All the aux. structures
+ *  as sems, lists, etc, are also released */
+void free_hash_table(void)
+{
 	if (tm_table)
 	{
-		/* remove the data contained by each entry */
-		for( i = 0 ; i<TM_TABLE_ENTRIES; i++)
-		{
-			release_entry_lock( (tm_table->entrys)+i );
-			/* delete all synonyms at hash-collision-slot i */
-			p_cell=tm_table->entrys[i].first_cell;
-			for( ; p_cell; p_cell = tmp_cell )
-			{
-				tmp_cell = p_cell->next_cell;
-				free_cell( p_cell );
-			}
+		if (tm_table->old_entrys)
+			free_hash_entries(tm_table->old_entrys, tm_table->old_size);
+		if (tm_table->entrys)
+			free_hash_entries(tm_table->entrys, tm_table->size);
+
+		release_hash_locks(tm_table);
+
+		if (tm_table->resize_lock) {
+			lock_destroy(tm_table->resize_lock);
+			lock_dealloc(tm_table->resize_lock);
 		}
 		shm_free(tm_table);
 	}
 }
 
 
+static inline int is_power_of_2(int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+
 /*
  */
 struct s_table* init_hash_table( unsigned int timer_sets )
 {
-	int              i;
+	unsigned int     i;
+
+	if (!is_power_of_2(tm_hash_size)) {
+		LM_ERR("hash_size %d must be a power of 2\n", tm_hash_size);
+		return 0;
+	}
+
+	if (tm_hash_max_size && tm_hash_max_size < tm_hash_size) {
+		LM_ERR("hash_max_size %d is lower than hash_size %d\n",
+			tm_hash_max_size, tm_hash_size);
+		return 0;
+	}
+
+	if (!is_power_of_2(tm_hash_locks)) {
+		LM_ERR("hash_locks %d must be a power of 2\n", tm_hash_locks);
+		return 0;
+	}
 
 	/*allocs the table*/
 	tm_table= (struct s_table*)shm_malloc( sizeof( struct s_table ) );
@@ -379,20 +495,162 @@ struct s_table* init_hash_table( unsigned int timer_sets )
 
 	tm_table->timer_sets = timer_sets;
 
+	tm_table->size = tm_hash_size;
+	tm_table->entrys = shm_malloc(tm_table->size * sizeof(struct entry));
+	if (!tm_table->entrys) {
+		LM_ERR("no more share memory for %u entries\n", tm_table->size);
+		goto error;
+	}
+	memset(tm_table->entrys, 0, tm_table->size * sizeof(struct entry));
+
+	/* an entry and the ones it grows into must share their lock */
+	tm_table->locks_no = tm_hash_locks < tm_hash_size ?
+		tm_hash_locks : tm_hash_size;
+	if (init_hash_locks(tm_table) < 0) {
+		LM_ERR("failed to init the hash locks\n");
+		goto error;
+	}
+
+	tm_table->resize_lock = lock_alloc();
+	if (!tm_table->resize_lock || !lock_init(tm_table->resize_lock)) {
+		LM_ERR("failed to init the resize lock\n");
+		goto error;
+	}
+
 	/* inits the entrys */
-	for(  i=0 ; i<TM_TABLE_ENTRIES; i++ )
-	{
-		init_entry_lock( tm_table, (tm_table->entrys)+i );
+	for(  i=0 ; i<tm_table->size; i++ )
 		tm_table->entrys[i].next_label = rand();
-	}
+
+	LM_DBG("hash table of %u entries, with %u locks\n",
+		tm_table->size, tm_table->locks_no);
 
 	return  tm_table;
 
 error:
+	if (tm_table) {
+		if (tm_table->resize_lock)
+			lock_dealloc(tm_table->resize_lock);
+		release_hash_locks(tm_table);
+		if (tm_table->entrys)
+			shm_free(tm_table->entrys);
+		shm_free(tm_table);
+		tm_table = 0;
+	}
+	return 0;
+}
+
+
+/* starts moving the transactions to a table twice as large */
+static int grow_hash_table(void)
+{
+	struct entry *entrys;
+	unsigned int size;
+
+	size = tm_table->size << 1;
+	entrys = shm_malloc(size * sizeof(struct entry));
+	if (!entrys) {
+		LM_ERR("no more share memory to grow the hash table to %u "
+			"entries\n", size);
+		return -1;
+	}
+	memset(entrys, 0, size * sizeof(struct entry));
+
+	lock_all_hash();
+
+	tm_table->old_entrys = tm_table->entrys;
+	tm_table->old_size = tm_table->size;
+	tm_table->moved = 0;
+	tm_table->entrys = entrys;
+	tm_table->size = size;
+
+	unlock_all_hash();
+
+	LM_INFO("growing the hash table to %u entries, for %lu transactions\n",
+		size, tm_table->cells);
 	return 0;
 }
 
 
+/* splits an entry of the old table into the two ones of the new table,
+ * keeping the order of the cells */
+static void move_hash_entry(unsigned int i)
+{
+	struct entry *old_entry, *p_entry;
+	struct cell *p_cell, *next_cell;
+
+	/* the old entry shares the lock of the new ones */
+	lock_hash(i);
+
+	old_entry = &tm_table->old_entrys[i];
+
+	/* keep the labels unique within the new entries */
+	tm_table->entrys[i].next_label = old_entry->next_label;
+	tm_table->entrys[i + tm_table->old_size].next_label =
+		old_entry->next_label;
+
+	for (p_cell = old_entry->first_cell; p_cell; p_cell = next_cell) {
+		next_cell = p_cell->next_cell;
+		p_entry = &tm_table->entrys[p_cell->hash_index & (tm_table->size-1)];
+
+		p_cell->next_cell = 0;
+		p_cell->prev_cell = p_entry->last_cell;
+		if (p_entry->last_cell)
+			p_entry->last_cell->next_cell = p_cell;
+		else
+			p_entry->first_cell = p_cell;
+		p_entry->last_cell = p_cell;
+
+		p_entry->cur_entries++;
+		p_entry->acc_entries++;
+	}
+
+	old_entry->first_cell = old_entry->last_cell = 0;
+	old_entry->cur_entries = 0;
+	old_entry->moved = 1;
+
+	unlock_hash(i);
+}
+
+
+/* grows the table when too loaded, moving a chunk of entries at a time */
+void hash_resize_routine(utime_t uticks, void *param)
+{
+	struct entry *old_entrys;
+	unsigned int i, end;
+
+	lock_get(tm_table->resize_lock);
+
+	if (!tm_table->old_entrys &&
+	(tm_table->size >= tm_hash_max_size ||
+	tm_table->cells <= (unsigned long)tm_table->size * TM_TABLE_GROW_LOAD ||
+	grow_hash_table() < 0))
+		goto done;
+
+	end = tm_table->moved + TM_TABLE_MOVE_CHUNK;
+	if (end > tm_table->old_size)
+		end = tm_table->old_size;
+
+	for (i = tm_table->moved; i < end; i++)
+		move_hash_entry(i);
+	tm_table->moved = end;
+
+	if (tm_table->moved == tm_table->old_size) {
+		/* nobody may still be looking into the old table */
+		lock_all_hash();
+		old_entrys = tm_table->old_entrys;
+		tm_table->old_entrys = 0;
+		tm_table->old_size = 0;
+		unlock_all_hash();
+
+		shm_free(old_entrys);
+		LM_INFO("hash table grown to %u entries\n", tm_table->size);
+	}
+
+done:
+	lock_release(tm_table->resize_lock);
+}
+
+
 /*  Takes an already created cell and links it into hash table on the
  *  appropriate entry. */
 void insert_into_hash_table_unsafe( struct cell * p_cell, unsigned int _hash )
@@ -402,7 +660,7 @@ void insert_into_hash_table_unsafe( struct cell * p_cell, unsigned int _hash )
 	p_cell->hash_index=_hash;
 
 	/* locates the appropriate entry */
-	p_entry = &tm_table->entrys[ _hash ];
+	p_entry = get_hash_entry( _hash );
 
 	p_cell->label = p_entry->next_label++;
 	if ( p_entry->last_cell )
@@ -416,6 +674,7 @@ void insert_into_hash_table_unsafe( struct cell * p_cell, unsigned int _hash )
 	/* update stats */
 	p_entry->cur_entries++;
 	p_entry->acc_entries++;
+	__sync_add_and_fetch(&tm_table->cells, 1);
 	stats_trans_new( is_local(p_cell) );
 }
 
@@ -423,7 +682,7 @@ void insert_into_hash_table_unsafe( struct cell * p_cell, unsigned int _hash )
 /*  Un-link a  cell from hash_table, but the cell itself is not released */
 void remove_from_hash_table_unsafe( struct cell * p_cell)
 {
-	struct entry*  p_entry  = &(tm_table->entrys[p_cell->hash_index]);
+	struct entry*  p_entry  = get_hash_entry(p_cell->hash_index);
 
 	if ( p_cell->prev_cell )
 		p_cell->prev_cell->next_cell = p_cell->next_cell;
@@ -442,5 +701,6 @@ void remove_from_hash_table_unsafe( struct cell * p_cell)
 # endif
 	/* update stats */
 	p_entry->cur_entries--;
+	__sync_sub_and_fetch(&tm_table->cells, 1);
 	if_update_stat(tm_enable_stats, tm_trans_inuse , -1 );
 }
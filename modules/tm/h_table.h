@@ -62,8 +62,8 @@ struct retr_buf;
 #define LOCK_HASH(_h) lock_hash((_h))
 #define UNLOCK_HASH(_h) unlock_hash((_h))
 
-void lock_hash(int i);
-void unlock_hash(int i);
+void lock_hash(unsigned int hash);
+void unlock_hash(unsigned int hash);
 
 
 #define NO_CANCEL       ( (char*) 0 )
@@ -302,6 +302,10 @@ typedef struct cell
 
 	/* extra T headers */
 	str extra_hdrs;
+
+	/* room left after the cell (and its context) for the cloned request
+	 * and the branch buffers; empty if "cell_arena_size" is not set */
+	struct tm_arena arena;
 }cell_type;
 
 
@@ -313,8 +317,8 @@ typedef struct entry
 	struct cell*    last_cell;
 	/* currently highest sequence number in a synonym list */
 	unsigned int    next_label;
-	/* sync mutex */
-	ser_lock_t      mutex;
+	/* set once its cells were moved to the grown table */
+	unsigned int    moved;
 	unsigned long acc_entries;
 	unsigned long cur_entries;
 }entry_type;
@@ -325,7 +329,22 @@ typedef struct entry
 struct s_table
 {
 	/* table of hash entries; each of them is a list of synonyms  */
-	struct entry   entrys[ TM_TABLE_ENTRIES ];
+	struct entry   *entrys;
+	unsigned int   size;
+	/* while growing, the previous table; its entries are moved one by
+	 * one to the new one, and a transaction stays in the old entry until
+	 * this entry is moved */
+	struct entry   *old_entrys;
+	unsigned int   old_size;
+	unsigned int   moved;
+	/* locks striped over the entries by the lower bits of the hash, so an
+	 * entry and the two ones it is moved to share the same lock */
+	ser_lock_t     *locks;
+	unsigned int   locks_no;
+	/* transactions in the table */
+	unsigned long  cells;
+	/* taken while growing or walking the table */
+	gen_lock_t     *resize_lock;
 	/* we keep it here just as a shortcut, we need it for assigning
 	 * a transaction to a specific timer set */
 	unsigned short timer_sets;
@@ -361,6 +380,10 @@ struct s_table
 
 
 extern int syn_branch;
+extern int tm_cell_arena;
+extern int tm_hash_size;
+extern int tm_hash_max_size;
+extern int tm_hash_locks;
 extern int fr_timeout;
 extern int fr_inv_timeout;
 extern int tm_timer_shift;
@@ -373,6 +396,10 @@ enum kill_reason get_kr();
 struct s_table* get_tm_table( void );
 struct s_table* init_hash_table(unsigned int timer_sets);
 void   free_hash_table( void );
+struct entry* get_hash_entry( unsigned int hash );
+int    for_each_hash_entry( int (*f)(unsigned int, struct entry*, void*),
+		void *param );
+void   hash_resize_routine( utime_t uticks, void *param );
 void   free_cell( struct cell* dead_cell );
 struct cell*  build_cell( struct sip_msg* p_msg, int full_uas );
 void   remove_from_hash_table_unsafe( struct cell * p_cell);
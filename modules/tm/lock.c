@@ -235,19 +235,31 @@ int init_cell_lock( struct cell *cell )
 	return 0;
 }
 
-int init_entry_lock( struct s_table* ht, struct entry *entry )
+int init_hash_locks( struct s_table* ht )
 {
+	unsigned int i;
+
+#ifndef GEN_LOCK_T_PREFERED
+	/* all the locks may be taken at once, so they cannot share semaphores */
+	while (ht->locks_no > (unsigned int)sem_nr)
+		ht->locks_no >>= 1;
+#endif
+
+	ht->locks = shm_malloc(ht->locks_no * sizeof(ser_lock_t));
+	if (!ht->locks) {
+		LM_ERR("no more share memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < ht->locks_no; i++) {
 #ifdef GEN_LOCK_T_PREFERED
-	lock_init(&entry->mutex);
+		lock_init(&ht->locks[i]);
 #else
-	/* just advice which of the available semaphores to use;
-	   specifically, all entries are partitioned into as
-	   many partitions as number of available semaphores allows
-        */
-	entry->mutex.semaphore_set=entry_semaphore;
-	entry->mutex.semaphore_index = ( ((char *)entry - (char *)(ht->entrys ) )
-               / sizeof(struct entry) ) % sem_nr;
+		ht->locks[i].semaphore_set = entry_semaphore;
+		ht->locks[i].semaphore_index = i;
 #endif
+	}
+
 	return 0;
 }
 
@@ -266,10 +278,12 @@ int release_cell_lock( struct cell *cell )
 
 
 
-int release_entry_lock( struct entry *entry )
+void release_hash_locks( struct s_table* ht )
 {
-	/* the same as above */
-	return 0;
+	if (ht->locks) {
+		shm_free((void *)ht->locks);
+		ht->locks = 0;
+	}
 }
 
 
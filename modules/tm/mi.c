@@ -465,8 +465,11 @@ struct mi_root*  mi_tm_uac_dlg(struct mi_root* cmd_tree, void* param)
 		memset( &tmp_msg, 0, sizeof(struct sip_msg));
 		tmp_msg.len = hdrs->len;
 		tmp_msg.buf = tmp_msg.unparsed = hdrs->s;
-		if (parse_headers( &tmp_msg, HDR_EOH_F, 0) == -1 )
+		if (parse_headers( &tmp_msg, HDR_EOH_F, 0) == -1 ) {
+			if (tmp_msg.headers) free_hdr_field_lst(tmp_msg.headers);
+			free_hdr_scan(&tmp_msg);
 			return init_mi_tree( 400, MI_SSTR("Bad headers"));
+		}
 	}
 
 	/* body (param 5 - optional) */
@@ -481,6 +484,7 @@ struct mi_root*  mi_tm_uac_dlg(struct mi_root* cmd_tree, void* param)
 	rpl_tree = mi_check_msg( &tmp_msg, method, body, &cseq, &callid);
 	if (rpl_tree) {
 		if (tmp_msg.headers) free_hdr_field_lst(tmp_msg.headers);
+		free_hdr_scan(&tmp_msg);
 		return rpl_tree;
 	}
 
@@ -488,6 +492,7 @@ struct mi_root*  mi_tm_uac_dlg(struct mi_root* cmd_tree, void* param)
 			tmp_msg.headers, &s.len, &sock);
 	if (s.s==0) {
 		if (tmp_msg.headers) free_hdr_field_lst(tmp_msg.headers);
+		free_hdr_scan(&tmp_msg);
 		return 0;
 	}
 
@@ -533,6 +538,7 @@ struct mi_root*  mi_tm_uac_dlg(struct mi_root* cmd_tree, void* param)
 
 	pkg_free(s.s);
 	if (tmp_msg.headers) free_hdr_field_lst(tmp_msg.headers);
+	free_hdr_scan(&tmp_msg);
 
 	if (n<=0) {
 		/* error */
@@ -587,20 +593,102 @@ struct mi_root* mi_tm_cancel(struct mi_root* cmd_tree, void* param)
 }
 
 
+static int mi_print_hash_entry(unsigned int i, struct entry *p_entry,
+		void *param)
+{
+	struct mi_node* rpl = (struct mi_node*)param;
+	struct mi_node* node;
+	struct mi_attr* attr;
+	char *p;
+	int len;
+
+	p = int2str((unsigned long)i, &len );
+	node = add_mi_node_child(rpl, MI_DUP_VALUE , 0, 0, p, len);
+	if(node == NULL)
+		return -1;
+
+	p = int2str((unsigned long)p_entry->cur_entries, &len );
+	attr = add_mi_attr(node, MI_DUP_VALUE, "Current", 7, p, len );
+	if(attr == NULL)
+		return -1;
+
+	p = int2str((unsigned long)p_entry->acc_entries, &len );
+	attr = add_mi_attr(node, MI_DUP_VALUE, "Total", 5, p, len );
+	if(attr == NULL)
+		return -1;
+
+	return 0;
+}
+
+
 /*
   Syntax of "t_hash" :
     no nodes
 */
 struct mi_root* mi_tm_hash(struct mi_root* cmd_tree, void* param)
+{
+	struct mi_root* rpl_tree= NULL;
+
+	rpl_tree = init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
+	if (rpl_tree==0)
+		return 0;
+
+	if (for_each_hash_entry(mi_print_hash_entry, &rpl_tree->node) < 0)
+		goto error;
+
+	return rpl_tree;
+error:
+	free_mi_tree(rpl_tree);
+	return init_mi_tree( 500, MI_INTERNAL_ERR_S, MI_INTERNAL_ERR_LEN);
+}
+
+
+/* chains of 0, 1, 2, 3-4, 5-8, ... transactions */
+#define TM_HASH_HIST_SLOTS 12
+
+struct tm_hash_hist {
+	unsigned long slots[TM_HASH_HIST_SLOTS];
+	unsigned long max_chain;
+	unsigned long entries;
+};
+
+static int tm_hash_hist_entry(unsigned int i, struct entry *p_entry,
+		void *param)
+{
+	struct tm_hash_hist *hist = (struct tm_hash_hist*)param;
+	unsigned long n = p_entry->cur_entries;
+	int slot;
+
+	for (slot = 0; n > (1UL << slot >> 1) && slot < TM_HASH_HIST_SLOTS - 1;
+	slot++);
+
+	hist->slots[slot]++;
+	if (n > hist->max_chain)
+		hist->max_chain = n;
+	hist->entries++;
+
+	return 0;
+}
+
+
+/*
+  Syntax of "t_hash_stats" :
+    no nodes
+*/
+struct mi_root* mi_tm_hash_stats(struct mi_root* cmd_tree, void* param)
 {
 	struct mi_root* rpl_tree= NULL;
 	struct mi_node* rpl;
 	struct mi_node* node;
-	struct mi_attr* attr;
 	struct s_table* tm_t;
-	char *p;
-	int i;
-	int len;
+	struct tm_hash_hist hist;
+	unsigned long low, high;
+	char name[32];
+	int i, len;
+
+	memset(&hist, 0, sizeof hist);
+	if (for_each_hash_entry(tm_hash_hist_entry, &hist) < 0)
+		return init_mi_tree( 500, MI_INTERNAL_ERR_S, MI_INTERNAL_ERR_LEN);
 
 	rpl_tree = init_mi_tree( 200, MI_OK_S, MI_OK_LEN);
 	if (rpl_tree==0)
@@ -608,20 +696,39 @@ struct mi_root* mi_tm_hash(struct mi_root* cmd_tree, void* param)
 	rpl = &rpl_tree->node;
 	tm_t = get_tm_table();
 
-	for (i=0; i<TM_TABLE_ENTRIES; i++) {
-		p = int2str((unsigned long)i, &len );
-		node = add_mi_node_child(rpl, MI_DUP_VALUE , 0, 0, p, len);
-		if(node == NULL)
-			goto error;
+	if (!addf_mi_node_child(rpl, 0, MI_SSTR("Size"), "%u", tm_t->size))
+		goto error;
+	if (tm_t->old_size &&
+	!addf_mi_node_child(rpl, 0, MI_SSTR("Growing_from"), "%u",
+	tm_t->old_size))
+		goto error;
+	if (!addf_mi_node_child(rpl, 0, MI_SSTR("Locks"), "%u", tm_t->locks_no))
+		goto error;
+	if (!addf_mi_node_child(rpl, 0, MI_SSTR("Transactions"), "%u",
+	transaction_count()))
+		goto error;
+	if (!addf_mi_node_child(rpl, 0, MI_SSTR("Max_chain"), "%lu",
+	hist.max_chain))
+		goto error;
 
-		p = int2str((unsigned long)tm_t->entrys[i].cur_entries, &len );
-		attr = add_mi_attr(node, MI_DUP_VALUE, "Current", 7, p, len );
-		if(attr == NULL)
-			goto error;
+	node = add_mi_node_child(rpl, 0, MI_SSTR("Chains"), 0, 0);
+	if (node == NULL)
+		goto error;
+
+	/* the number of entries having chains of each length range */
+	for (i = 0; i < TM_HASH_HIST_SLOTS; i++) {
+		low = i ? (1UL << (i - 1) >> 1) + 1 : 0;
+		high = 1UL << i >> 1;
+
+		if (i == TM_HASH_HIST_SLOTS - 1)
+			len = snprintf(name, sizeof name, "%lu+", low);
+		else if (low == high)
+			len = snprintf(name, sizeof name, "%lu", low);
+		else
+			len = snprintf(name, sizeof name, "%lu-%lu", low, high);
 
-		p = int2str((unsigned long)tm_t->entrys[i].acc_entries, &len );
-		attr = add_mi_attr(node, MI_DUP_VALUE, "Total", 5, p, len );
-		if(attr == NULL)
+		if (!addf_mi_node_child(node, MI_DUP_NAME, name, len, "%lu",
+		hist.slots[i]))
 			goto error;
 	}
 
@@ -33,6 +33,7 @@
 #define MI_TM_UAC      "t_uac_dlg"
 #define MI_TM_CANCEL   "t_uac_cancel"
 #define MI_TM_HASH     "t_hash"
+#define MI_TM_HASH_STATS "t_hash_stats"
 #define MI_TM_REPLY    "t_reply"
 
 struct mi_root* mi_tm_uac_dlg(struct mi_root* cmd_tree, void* param);
@@ -41,6 +42,8 @@ struct mi_root* mi_tm_cancel(struct mi_root* cmd_tree, void* param);
 
 struct mi_root* mi_tm_hash(struct mi_root* cmd_tree, void* param);
 
+struct mi_root* mi_tm_hash_stats(struct mi_root* cmd_tree, void* param);
+
 struct mi_root* mi_tm_reply(struct mi_root* cmd_tree, void* param);
 
 #endif
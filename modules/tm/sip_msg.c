@@ -393,6 +393,19 @@ do { \
 
 
 
+static inline void free_failed_clone(struct sip_msg *msg,
+													struct tm_arena *arena)
+{
+	if (arena && tm_in_arena(arena, msg)) {
+		free_cloned_msg_data(msg);
+		/* it was the last chunk taken from the arena, give it back */
+		arena->pos = (char*)msg;
+	} else {
+		free_cloned_msg(msg);
+	}
+}
+
+
 /* Takes a SIP msg and makes of a clone on it in shared memory; the clone
  * is in a single memory chunks (all headers, lumps, etc).
  * Param "updatable" can be :
@@ -400,9 +413,11 @@ do { \
  *    1 - msg can be updated -> new/dst URI, PATH, lumps are in separate
  *                              mem chunks, so they can be updated later
  *    2 - msg can be updated, but do not copy updatable part at cloning
+ * If an "arena" is given, the single chunk is taken from it, if there is
+ * enough room left - otherwise it falls back to a regular shm chunk.
  */
 struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
-																int updatable)
+									int updatable, struct tm_arena *arena)
 {
 	unsigned int      len, l1_len, l2_len, l3_len;
 	struct hdr_field  *hdr,*new_hdr,*last_hdr;
@@ -531,7 +546,8 @@ struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
 	}
 
 	/* do all mallocs */
-	p=(char *)shm_malloc(len);
+	if ( (p=(char *)tm_arena_alloc(arena, len))==NULL )
+		p=(char *)shm_malloc(len);
 	if (!p) {
 		LM_ERR("no more share memory\n" );
 		return 0;
@@ -547,6 +563,8 @@ struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
 	/* avoid copying pointer to un-clonned structures */
 	new_msg->body = NULL;
 	new_msg->msg_cb = NULL;
+	new_msg->hdr_scan = NULL;
+	new_msg->hdr_index = NULL;
 
 	new_msg->msg_flags |= FL_SHM_CLONE;
 	p += ROUND4(sizeof(struct sip_msg));
@@ -954,7 +972,7 @@ struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
 	}
 
 	if (clone_authorized_hooks(new_msg, org_msg) < 0) {
-		free_cloned_msg(new_msg);
+		free_failed_clone(new_msg, arena);
 		return 0;
 	}
 
@@ -1031,7 +1049,7 @@ struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
 		  || (l2_len && new_msg->body_lumps==NULL)
 		  || (l3_len && new_msg->reply_lump==NULL) ) {
 			LM_ERR("failed to sh allocate the updatable part of the msg\n");
-			free_cloned_msg(new_msg);
+			free_failed_clone(new_msg, arena);
 			return 0;
 		}
 		/* copy data */
@@ -1061,7 +1079,7 @@ struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
 		/* clone the body parts also */
 		if ( clone_sip_msg_body( org_msg, new_msg, &new_msg->body, 1)!=0 ) {
 			LM_ERR("failed to clone the body parts\n");
-			free_cloned_msg(new_msg);
+			free_failed_clone(new_msg, arena);
 			return 0;
 		}
 
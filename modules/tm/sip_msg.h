@@ -25,6 +25,7 @@
 
 #include "../../parser/msg_parser.h"
 #include "../../mem/shm_mem.h"
+#include "t_stats.h"
 
 /* TODO: replace these macros with a more generic approach --liviu */
 #ifdef HP_MALLOC
@@ -42,7 +43,55 @@
 #endif
 
 
-#define free_cloned_msg_unsafe( _msg ) \
+/* bump-pointer arena carved at the end of a transaction's cell - the
+ * cloned request and the branch buffers placed here are released
+ * together with the cell, by a single shm_free() */
+struct tm_arena {
+	char *start;
+	char *pos;
+	char *end;
+};
+
+#define TM_ARENA_ALIGN(_s) \
+	(((_s)+(sizeof(long)-1))&(~(sizeof(long)-1)))
+
+#define tm_in_arena( _a, _p) \
+	((char*)(_p)>=(_a)->start && (char*)(_p)<(_a)->end)
+
+#define tm_arena_left( _a) \
+	((unsigned long)((_a)->end - (_a)->pos))
+
+/* frees a chunk, unless it lives in the arena (it goes with the cell) */
+#define tm_arena_shm_free( _a, _p) \
+	do { \
+		if (!tm_in_arena(_a, _p)) \
+			shm_free(_p); \
+	}while(0)
+
+/* returns NULL if the arena is disabled or has no room left; only the
+ * latter is accounted as an arena fallback */
+static inline void *tm_arena_alloc(struct tm_arena *a, unsigned long len)
+{
+	char *p;
+
+	if (a==NULL || a->pos==NULL)
+		return NULL;
+
+	len = TM_ARENA_ALIGN(len);
+	if (len > tm_arena_left(a)) {
+		stats_arena_alloc(0);
+		return NULL;
+	}
+
+	p = a->pos;
+	a->pos += len;
+	stats_arena_alloc(1);
+	return p;
+}
+
+
+/* frees everything a cloned msg holds, except for its main chunk */
+#define free_cloned_msg_data_unsafe( _msg ) \
 	do { \
 		if ((_msg)->msg_flags & FL_SHM_UPDATABLE) { \
 			if ((_msg)->new_uri.s) \
@@ -69,11 +118,17 @@
 			free_sip_body((_msg)->body);\
 			tm_shm_lock(); \
 		}\
+	}while(0)
+
+
+#define free_cloned_msg_unsafe( _msg ) \
+	do { \
+		free_cloned_msg_data_unsafe(_msg); \
 		tm_shm_free_unsafe((_msg));\
 	}while(0)
 
 
-#define free_cloned_msg( _msg ) \
+#define free_cloned_msg_data( _msg ) \
 	do { \
 		if ((_msg)->msg_flags & FL_SHM_UPDATABLE) { \
 			if ((_msg)->new_uri.s) \
@@ -94,12 +149,18 @@
 				shm_free((_msg)->reply_lump);\
 		}\
 		free_sip_body((_msg)->body);\
+	}while(0)
+
+
+#define free_cloned_msg( _msg ) \
+	do { \
+		free_cloned_msg_data(_msg); \
 		shm_free((_msg));\
 	}while(0)
 
 
 struct sip_msg*  sip_msg_cloner( struct sip_msg *org_msg, int *sip_msg_len,
-		int updatable );
+		int updatable, struct tm_arena *arena );
 
 
 static inline void clean_msg_clone(struct sip_msg *msg,void *min, void *max)
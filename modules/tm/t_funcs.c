@@ -57,6 +57,10 @@
 #include "../../context.h"
 
 
+/* if the UDP retransmissions and the branches of a fork should be sent
+ * out in batches (via the UDP net layer send queue) */
+int tm_udp_batch = 0;
+
 /* ----------------------------------------------------- */
 int send_pr_buffer( struct retr_buf *rb, void *buf, int len,
 #ifdef EXTRA_DEBUG
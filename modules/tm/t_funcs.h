@@ -46,6 +46,7 @@
 #include "../../mem/mem.h"
 #include "../../md5utils.h"
 #include "../../ip_addr.h"
+#include "../../net/net_udp.h"
 #include "../../parser/parse_uri.h"
 #include "../../usr_avp.h"
 
@@ -64,6 +65,7 @@ struct retr_buf;
 #include "ut.h"
 
 extern int noisy_ctimer;
+extern int tm_udp_batch;
 
 
 /* t_relay_to flags */
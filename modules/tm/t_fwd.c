@@ -223,9 +223,21 @@ error:
 	return -1;
 }
 
+/* gives the room for a branch buffer from the transaction's arena, or
+ * from shm if the arena has no room left */
+static char *tm_arena_buf_alloc(unsigned int len, void *arena)
+{
+	char *buf;
+
+	if ( (buf=(char*)tm_arena_alloc((struct tm_arena*)arena, len))==NULL )
+		buf=(char*)shm_malloc(len);
+	return buf;
+}
+
 /* be aware and use it *all* the time between pre_* and post_* functions! */
 static inline char *print_uac_request(struct sip_msg *i_req, unsigned int *len,
-		struct socket_info *send_sock, enum sip_protos proto )
+		struct socket_info *send_sock, enum sip_protos proto,
+		struct tm_arena *arena)
 {
 	char *buf;
 	str *cid = NULL;
@@ -233,9 +245,10 @@ static inline char *print_uac_request(struct sip_msg *i_req, unsigned int *len,
 	if (1/* TODO: check if the cid should be used */)
 		cid = tm_via_cid();
 
-	/* build the shm buffer now */
-	buf=build_req_buf_from_sip_req( i_req, len, send_sock, proto,
-			cid, MSG_TRANS_SHM_FLAG);
+	/* build the shm buffer now, straight in the arena if it has room */
+	buf=build_req_buf_from_sip_req_alloc( i_req, len, send_sock, proto,
+			cid, MSG_TRANS_SHM_FLAG, arena ? tm_arena_buf_alloc : NULL,
+			arena);
 	if (!buf) {
 		LM_ERR("no more shm_mem\n");
 		ser_error=E_OUT_OF_MEM;
@@ -330,16 +343,19 @@ static inline int update_uac_dst( struct sip_msg *request,
 	}
 
 	if (send_sock!=uac->request.dst.send_sock) {
-		/* rebuild */
+		/* rebuild; only the first build of a branch may use the
+		 * transaction's arena */
 		shbuf = print_uac_request( request, &len, send_sock,
-			uac->request.dst.proto);
+			uac->request.dst.proto,
+			uac->request.buffer.s ? NULL : &uac->request.my_T->arena);
 		if (!shbuf) {
 			ser_error=E_OUT_OF_MEM;
 			return -1;
 		}
 
 		if (uac->request.buffer.s)
-			shm_free(uac->request.buffer.s);
+			tm_arena_shm_free( &uac->request.my_T->arena,
+				uac->request.buffer.s);
 
 		/* things went well, move ahead and install new buffer! */
 		uac->request.dst.send_sock = send_sock;
@@ -673,6 +689,67 @@ void cancel_invite(struct sip_msg *cancel_msg,
 
 
 
+/* sends out the request of branch @i, going on with the next DNS
+ * destinations of the branch if the sending fails; with @failed set, the
+ * first (batched) attempt is already known to have failed. If the request
+ * is only queued in an UDP batch, @queued is set and @id gets the id of the
+ * datagram. Returns the ser_error of the branch (0 if sent out) */
+static int send_uac_request(struct cell *t, int i, struct sip_msg *p_msg,
+							int failed, char *queued, unsigned int *id)
+{
+	unsigned int seq;
+
+	if (queued)
+		*queued = 0;
+
+	if (t->uac[i].br_flags & tcp_no_new_conn_bflag)
+		tcp_no_new_conn = 1;
+
+	ser_error = failed ? E_SEND : 0;
+	do {
+		if (failed) {
+			failed = 0;
+		} else if (check_blacklists( t->uac[i].request.dst.proto,
+		&t->uac[i].request.dst.to,
+		t->uac[i].request.buffer.s,
+		t->uac[i].request.buffer.len)) {
+			LM_DBG("blocked by blacklists\n");
+			ser_error=E_IP_BLOCKED;
+		} else {
+			set_extra_tmcb_params( &t->uac[i].request.buffer,
+					&t->uac[i].request.dst);
+			run_trans_callbacks(TMCB_PRE_SEND_BUFFER, t, p_msg, 0, i);
+
+			seq = udp_batch_seq;
+			if (SEND_BUFFER( &t->uac[i].request)==0) {
+				if (queued && udp_batch_seq!=seq) {
+					*queued = 1;
+					*id = seq;
+				}
+				ser_error = 0;
+				break;
+			}
+
+			LM_ERR("sending request failed\n");
+			ser_error=E_SEND;
+		}
+		/* get next dns entry */
+		if ( t->uac[i].proxy==0 ||
+		get_next_su( t->uac[i].proxy, &t->uac[i].request.dst.to,
+		(ser_error==E_IP_BLOCKED)?0:1)!=0 )
+			break;
+		t->uac[i].request.dst.proto = t->uac[i].proxy->proto;
+		/* update branch */
+		if ( update_uac_dst( p_msg, &t->uac[i] )!=0)
+			break;
+	}while(1);
+
+	tcp_no_new_conn = 0;
+
+	return ser_error;
+}
+
+
 /* function returns:
  *       1 - forward successful
  *      -1 - error during forward
@@ -695,6 +772,10 @@ int t_forward_nonack( struct cell *t, struct sip_msg* p_msg ,
 	int idx;
 	str path;
 	str bk_path;
+	int batch;
+	int br_err[MAX_BRANCHES];
+	char queued[MAX_BRANCHES];
+	unsigned int dgram_id[MAX_BRANCHES];
 
 	/* make -Wall happy */
 	current_uri.s=0;
@@ -809,14 +890,16 @@ int t_forward_nonack( struct cell *t, struct sip_msg* p_msg ,
 		return lowest_ret;
 	}
 
-	/* send them out now */
-	success_branch=0;
+	/* send them out now; the UDP branches are queued and pushed out
+	 * together once all of them are built (unless already inside an outer
+	 * batch, which would not send them by the end of this function) */
+	batch = tm_udp_batch && !udp_batch_active();
+	if (batch)
+		udp_batch_start();
+
 	for (i=t->first_branch; i<t->nr_of_outgoings; i++) {
 		if (added_branches & (1<<i)) {
 
-			if (t->uac[i].br_flags & tcp_no_new_conn_bflag)
-				tcp_no_new_conn = 1;
-
 			/* successfully sent out -> run callbacks */
 			if ( has_tran_tmcbs( t, TMCB_REQUEST_BUILT) ) {
 				set_extra_tmcb_params( &t->uac[i].request.buffer,
@@ -825,41 +908,31 @@ int t_forward_nonack( struct cell *t, struct sip_msg* p_msg ,
 					p_msg, 0, 0);
 			}
 
-			do {
-				if (check_blacklists( t->uac[i].request.dst.proto,
-				&t->uac[i].request.dst.to,
-				t->uac[i].request.buffer.s,
-				t->uac[i].request.buffer.len)) {
-					LM_DBG("blocked by blacklists\n");
-					ser_error=E_IP_BLOCKED;
-				} else {
-					set_extra_tmcb_params( &t->uac[i].request.buffer,
-							&t->uac[i].request.dst);
-					run_trans_callbacks(TMCB_PRE_SEND_BUFFER, t, p_msg, 0, i);
+			br_err[i] = send_uac_request( t, i, p_msg, 0,
+				&queued[i], &dgram_id[i]);
+		}
+	}
 
-					if (SEND_BUFFER( &t->uac[i].request)==0) {
-						ser_error = 0;
-						break;
-					}
+	if (batch) {
+		udp_batch_flush();
 
-					LM_ERR("sending request failed\n");
-					ser_error=E_SEND;
-				}
-				/* get next dns entry */
-				if ( t->uac[i].proxy==0 ||
-				get_next_su( t->uac[i].proxy, &t->uac[i].request.dst.to,
-				(ser_error==E_IP_BLOCKED)?0:1)!=0 )
-					break;
-				t->uac[i].request.dst.proto = t->uac[i].proxy->proto;
-				/* update branch */
-				if ( update_uac_dst( p_msg, &t->uac[i] )!=0)
-					break;
-			}while(1);
-
-			tcp_no_new_conn = 0;
+		/* the branches whose datagram failed go on with the next
+		 * destination, as if the sending failed right away */
+		for (i=t->first_branch; i<t->nr_of_outgoings; i++)
+			if ((added_branches & (1<<i)) && br_err[i]==0 && queued[i]
+			&& udp_batch_status(dgram_id[i])<0) {
+				LM_ERR("sending request failed\n");
+				br_err[i] = send_uac_request( t, i, p_msg, 1, NULL, NULL);
+			}
+	}
+
+	success_branch=0;
+	for (i=t->first_branch; i<t->nr_of_outgoings; i++) {
+		if (added_branches & (1<<i)) {
 
+			ser_error = br_err[i];
 			if (ser_error) {
-				shm_free(t->uac[i].request.buffer.s);
+				tm_arena_shm_free( &t->arena, t->uac[i].request.buffer.s);
 				t->uac[i].request.buffer.s = NULL;
 				t->uac[i].request.buffer.len = 0;
 				continue;
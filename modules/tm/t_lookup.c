@@ -316,7 +316,7 @@ static int matching_3261( struct sip_msg *p_msg, struct cell **trans,
 	via1->tid.s=via1->branch->value.s+MCOOKIE_LEN;
 	via1->tid.len=via1->branch->value.len-MCOOKIE_LEN;
 
-	for ( p_cell = get_tm_table()->entrys[p_msg->hash_index].first_cell;
+	for ( p_cell = get_hash_entry(p_msg->hash_index)->first_cell;
 		p_cell; p_cell = p_cell->next_cell )
 	{
 		t_msg=p_cell->uas.request;
@@ -454,7 +454,7 @@ int t_lookup_request( struct sip_msg* p_msg , int leave_new_locked )
 	LOCK_HASH(p_msg->hash_index);
 
 	/* all the transactions from the entry are compared */
-	for ( p_cell = get_tm_table()->entrys[p_msg->hash_index].first_cell;
+	for ( p_cell = get_hash_entry(p_msg->hash_index)->first_cell;
 		  p_cell; p_cell = p_cell->next_cell )
 	{
 		t_msg = p_cell->uas.request;
@@ -608,7 +608,7 @@ struct cell* t_lookupOriginalT(  struct sip_msg* p_msg )
 	LOCK_HASH(hash_index);
 
 	/* all the transactions from the entry are compared */
-	for (p_cell=get_tm_table()->entrys[hash_index].first_cell;
+	for (p_cell=get_hash_entry(hash_index)->first_cell;
 		p_cell; p_cell = p_cell->next_cell )
 	{
 		t_msg = p_cell->uas.request;
@@ -767,7 +767,6 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 
 	/* sanity check */
 	if (reverse_hex2int(hashi, hashl, &hash_index)<0
-		||hash_index>=TM_TABLE_ENTRIES
 		|| reverse_hex2int(branchi, branchl, &branch_id)<0
 		||branch_id>=MAX_BRANCHES
 		|| (syn_branch ? reverse_hex2int(syni, synl, &entry_label)<0
@@ -786,7 +785,7 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 	   entry first */
 	LOCK_HASH(hash_index);
 
-	for (p_cell = get_tm_table()->entrys[hash_index].first_cell; p_cell;
+	for (p_cell = get_hash_entry(hash_index)->first_cell; p_cell;
 		p_cell=p_cell->next_cell) {
 
 		/* first look if branch matches */
@@ -1200,15 +1199,10 @@ int t_lookup_ident(struct cell ** trans, unsigned int hash_index,
 {
 	struct cell* p_cell;
 
-	if(hash_index >= TM_TABLE_ENTRIES){
-		LM_ERR("invalid hash_index=%u\n",hash_index);
-		return -1;
-	}
-
 	LOCK_HASH(hash_index);
 
 	/* all the transactions from the entry are compared */
-	for ( p_cell = get_tm_table()->entrys[hash_index].first_cell;
+	for ( p_cell = get_hash_entry(hash_index)->first_cell;
 		p_cell; p_cell = p_cell->next_cell )
 	{
 		if(p_cell->label == label){
@@ -1274,11 +1268,6 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 	/* lookup the hash index where the transaction is stored */
 	hash_index=tm_hash(callid, cseq);
 
-	if(hash_index >= TM_TABLE_ENTRIES){
-		LM_ERR("invalid hash_index=%u\n",hash_index);
-		return -1;
-	}
-
 	/* create header fields the same way tm does itself, then compare headers */
 	endpos = print_callid_mini(callid_header, callid);
 	LM_DBG("created comparable call_id header field: >%.*s<\n",
@@ -1291,7 +1280,7 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 	LOCK_HASH(hash_index);
 
 	/* all the transactions from the entry are compared */
-	p_cell = get_tm_table()->entrys[hash_index].first_cell;
+	p_cell = get_hash_entry(hash_index)->first_cell;
 	for ( ; p_cell; p_cell = p_cell->next_cell ) {
 
 		/* compare complete header fields, casecmp to make sure invite=INVITE */
@@ -404,6 +404,11 @@ inline static void free_faked_req(struct sip_msg *faked_req, struct cell *t)
 
 	clean_msg_clone( faked_req, t->uas.request, t->uas.end_request);
 
+	if (faked_req->hdr_index) {
+		pkg_free(faked_req->hdr_index);
+		faked_req->hdr_index = NULL;
+	}
+
 	/* remove the headers' list */
 	if (faked_req->headers) {
 		pkg_free(faked_req->headers);
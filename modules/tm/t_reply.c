@@ -669,7 +669,7 @@ static inline int do_dns_failover(struct cell *t)
 			return -1;
 		}
 		/* now do the actual cloning of the SIP message */
-		t->uas.request = sip_msg_cloner( req, &sip_msg_len, 1);
+		t->uas.request = sip_msg_cloner( req, &sip_msg_len, 1, &t->arena);
 		if (t->uas.request==NULL) {
 			LM_ERR("cloning failed\n");
 			free_sip_msg(req);
@@ -1167,7 +1167,7 @@ static int store_reply( struct cell *trans, int branch, struct sip_msg *rpl)
 		if (rpl==FAKED_REPLY)
 			trans->uac[branch].reply=FAKED_REPLY;
 		else
-			trans->uac[branch].reply = sip_msg_cloner( rpl, 0, 0 );
+			trans->uac[branch].reply = sip_msg_cloner( rpl, 0, 0, NULL );
 
 		if (! trans->uac[branch].reply ) {
 			LM_ERR("failed to alloc' clone memory\n");
@@ -45,6 +45,8 @@ extern stat_var *tm_trans_4xx;
 extern stat_var *tm_trans_5xx;
 extern stat_var *tm_trans_6xx;
 extern stat_var *tm_trans_inuse;
+extern stat_var *tm_arena_hits;
+extern stat_var *tm_arena_fallbacks;
 
 
 #ifdef STATISTICS
@@ -105,10 +107,21 @@ inline static void stats_trans_new( int local ) {
 			update_stat( tm_uas_trans, 1 );
 	}
 }
+
+/* accounts an allocation served (or not) from a transaction's arena */
+inline static void stats_arena_alloc( int hit ) {
+	if (tm_enable_stats) {
+		if (hit)
+			update_stat( tm_arena_hits, 1 );
+		else
+			update_stat( tm_arena_fallbacks, 1 );
+	}
+}
 #else
 	#define stats_trans_code( _code )
 	#define stats_trans_rpl( _code , _local )
 	#define stats_trans_new( _local )
+	#define stats_arena_alloc( _hit )
 #endif
 
 #endif
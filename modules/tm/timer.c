@@ -34,13 +34,13 @@
   for high performance using some techniques of which timer users
   need to be aware.
 
-	One technique is "fixed-timer-length". We maintain separate
-	timer lists, all of them include elements of the same time
-	to fire. That allows *appending* new events to the list as
-	opposed to inserting them by time, which is costly due to
-	searching time spent in a mutex. The performance benefit is
-	noticeable. The limitation is you need a new timer list for
-	each new timer length.
+	One technique is the hashed hierarchical timing wheel. Each
+	timer list is a wheel (see lib/timer_wheel.h) where the timers
+	are hashed by their time to fire, so adding, removing and expiring
+	a timer costs the same no matter how many transactions are alive
+	(there is no searching by time in a mutex). The wheels of the
+	retransmission lists have the resolution of the utimer, the others
+	of one tick.
 
 	Another technique is the timer process slices off expired elements
 	from the list in a mutex, but executes the timer after the mutex
@@ -499,7 +499,7 @@ struct timer_table *get_timertable(void)
 
 void unlink_timer_lists(void)
 {
-	struct timer_link  *tl, *end, *tmp;
+	struct list_head dl, *it, *tmp;
 	enum lists i;
 	unsigned int set;
 
@@ -508,19 +508,17 @@ void unlink_timer_lists(void)
 
 	for ( set=0 ; set<timer_sets ; set++) {
 		/* remember the DELETE LIST */
-		tl = timertable[set].timers[DELETE_LIST].first_tl.next_tl;
-		end = & timertable[set].timers[DELETE_LIST].last_tl;
+		INIT_LIST_HEAD(&dl);
+		tw_flush( &timertable[set].timers[DELETE_LIST].wheel, &dl);
 		/* unlink the timer lists */
 		for( i=0; i<NR_OF_TIMER_LISTS ; i++ )
 			reset_timer_list( set, i );
 		LM_DBG("emptying DELETE list for set %d\n",set);
 		/* deletes all cells from DELETE_LIST list 
 		   (they are no more accessible from entries) */
-		while (tl!=end) {
-			tmp=tl->next_tl;
-			free_cell( get_dele_timer_payload(tl) );
-			tl=tmp;
-		}
+		list_for_each_safe( it, tmp, &dl)
+			free_cell( get_dele_timer_payload(
+				list_entry(it, struct timer_link, tw.list)) );
 	}
 
 }
@@ -634,13 +632,11 @@ void free_timer_table(void)
 
 void reset_timer_list(unsigned int set, enum lists list_id)
 {
-	timertable[set].timers[list_id].first_tl.next_tl =
-		&(timertable[set].timers[list_id].last_tl );
-	timertable[set].timers[list_id].last_tl.prev_tl =
-		&(timertable[set].timers[list_id].first_tl );
-	timertable[set].timers[list_id].first_tl.prev_tl =
-		timertable[set].timers[list_id].last_tl.next_tl = NULL;
-	timertable[set].timers[list_id].last_tl.time_out = -1;
+	if (timer_id2type[list_id]==UTIME_TYPE)
+		tw_init( &timertable[set].timers[list_id].wheel,
+			TM_UTIMER_INTERVAL, get_uticks());
+	else
+		tw_init( &timertable[set].timers[list_id].wheel, 1, get_ticks());
 }
 
 
@@ -657,14 +653,16 @@ void print_timer_list(unsigned int set, enum lists list_id)
 {
 	struct timer* timer_list=&(timertable[set].timers[ list_id ]);
 	struct timer_link *tl ;
-
-	tl = timer_list->first_tl.next_tl;
-	while (tl!=& timer_list->last_tl)
-	{
-		LM_DBG("[%d]: %p, next=%p \n",
-			list_id, tl, tl->next_tl);
-		tl = tl->next_tl;
-	}
+	struct list_head *it;
+	int l, i;
+
+	for( l=0 ; l<TW_LEVELS ; l++ )
+		for( i=0 ; i<TW_SLOTS ; i++ )
+			list_for_each( it, &timer_list->wheel.slots[l][i]) {
+				tl = list_entry(it, struct timer_link, tw.list);
+				LM_DBG("[%d]: %p, level=%d, slot=%d, timeout=%lld\n",
+					list_id, tl, l, i, tl->time_out);
+			}
 }
 
 
@@ -672,58 +670,37 @@ void print_timer_list(unsigned int set, enum lists list_id)
 #ifdef TM_TIMER_DEBUG
 static void check_timer_list( struct timer* timer_list, char *txt)
 {
-	struct timer_link *tl ;
-	struct timer_link *tl1 ;
+	struct list_head *head, *it;
+	unsigned int count = 0;
+	int l, i;
 
-	if (list_id<0 || list_id>=NR_OF_TIMER_LISTS) {
+	if (timer_list->id<0 || timer_list->id>=NR_OF_TIMER_LISTS) {
 			LM_CRIT("TM TIMER list [%d] bug [%s]\n",timer_list->id, txt);
 			abort();
 	}
 
-	tl = timer_list->last_tl.prev_tl;
-	while (tl!=&timer_list->first_tl) {
-		if (tl->prev_tl==0) {
-			LM_CRIT("TM TIMER list [%d] prev_tl==0 [%s]\n",timer_list->id, txt);
-			abort();
-		}
-		tl = tl->prev_tl;
-	}
-
-	tl = timer_list->first_tl.next_tl;
-	while (tl!=&timer_list->last_tl) {
-		if (tl->next_tl==0) {
-			LM_CRIT("TM TIMER list [%d] next_tl==0 [%s]\n",timer_list->id, txt);
-			abort();
-		}
-		tl = tl->next_tl;
-	}
-
-	tl = timer_list->first_tl.next_tl;
-	while (tl!=&timer_list->last_tl) {
-		if (tl->ld_tl==0) {
-			LM_CRIT("TM TIMER list [%d] corrupted - ld=0 [%s]\n",
-				timer_list->id, txt);
-			abort();
-		}
-		if (tl->ld_tl->ld_tl!=tl) {
-			LM_CRIT("TM TIMER list [%d] corrupted - ld cycle broken [%s]\n",
-				timer_list->id, txt);
-			abort();
-		}
-
-		if (tl->ld_tl!=tl) {
-			tl1 = tl->next_tl;
-			while(tl1!=tl->ld_tl) {
-				if (tl1->ld_tl) {
-					LM_CRIT("TM TIMER list [%d] corrupted - ld!=0 inside "
-						"cycle [%s]\n", timer_list->id, txt);
+	for( l=0 ; l<TW_LEVELS ; l++ )
+		for( i=0 ; i<TW_SLOTS ; i++ ) {
+			head = &timer_list->wheel.slots[l][i];
+			for( it=head->next ; it!=head ; it=it->next, count++ ) {
+				if (it->next->prev!=it || it->prev->next!=it) {
+					LM_CRIT("TM TIMER list [%d] corrupted - broken links in "
+						"slot %d/%d [%s]\n", timer_list->id, l, i, txt);
+					abort();
+				}
+				if (list_entry(it, struct timer_link, tw.list)->timer_list
+				!= timer_list) {
+					LM_CRIT("TM TIMER list [%d] corrupted - foreign timer in "
+						"slot %d/%d [%s]\n", timer_list->id, l, i, txt);
 					abort();
 				}
-				tl1 = tl1->next_tl;
 			}
 		}
 
-		tl = tl->ld_tl->next_tl;
+	if (count!=timer_list->wheel.count) {
+		LM_CRIT("TM TIMER list [%d] corrupted - %u timers, %u counted "
+			"[%s]\n", timer_list->id, count, timer_list->wheel.count, txt);
+		abort();
 	}
 }
 #endif
@@ -731,13 +708,6 @@ static void check_timer_list( struct timer* timer_list, char *txt)
 
 static void remove_timer_unsafe(  struct timer_link* tl )
 {
-#ifdef EXTRA_DEBUG
-	if (tl && is_in_timer_list2(tl) &&
-		tl->timer_list->last_tl.prev_tl==0) {
-		LM_CRIT("Oh no, zero link in trailing timer element\n");
-		abort();
-	};
-#endif
 	if (is_in_timer_list2( tl )) {
 #ifdef EXTRA_DEBUG
 		LM_DBG("unlinking timer: tl=%p, timeout=%lld, group=%d\n",
@@ -746,23 +716,10 @@ static void remove_timer_unsafe(  struct timer_link* tl )
 #ifdef TM_TIMER_DEBUG
 		check_timer_list( tl->timer_list, "before remove" );
 #endif
-		if (tl->ld_tl && tl->ld_tl!=tl) {
-			if (tl->time_out==tl->prev_tl->time_out) {
-				tl->prev_tl->ld_tl = tl->ld_tl;
-				tl->ld_tl->ld_tl = tl->prev_tl;
-			} else {
-				tl->next_tl->ld_tl = tl->ld_tl;
-				tl->ld_tl->ld_tl = tl->next_tl;
-			}
-		}
-		tl->prev_tl->next_tl = tl->next_tl;
-		tl->next_tl->prev_tl = tl->prev_tl;
+		tw_del( &tl->timer_list->wheel, &tl->tw);
 #ifdef TM_TIMER_DEBUG
 		check_timer_list( tl->timer_list, "after remove" );
 #endif
-		tl->next_tl = 0;
-		tl->prev_tl = 0;
-		tl->ld_tl = 0;
 		tl->timer_list = NULL;
 	}
 }
@@ -770,10 +727,8 @@ static void remove_timer_unsafe(  struct timer_link* tl )
 
 /* put a new linker into a timer_list */
 static void insert_timer_unsafe( struct timer *timer_list,
-									struct timer_link *tl, utime_t time_out )
+						struct timer_link *tl, utime_t time_out, utime_t now )
 {
-	struct timer_link* ptr;
-
 	tl->time_out = time_out;
 	tl->timer_list = timer_list;
 	tl->deleted = 0;
@@ -781,25 +736,7 @@ static void insert_timer_unsafe( struct timer *timer_list,
 #ifdef TM_TIMER_DEBUG
 	check_timer_list( timer_list, "before insert" );
 #endif
-	ptr = timer_list->last_tl.prev_tl;
-	for( ; ptr != &timer_list->first_tl ; ptr = ptr->ld_tl->prev_tl) {
-		if ( ptr->time_out<=time_out )
-			break;
-	}
-
-	/* insert "tl" after "ptr" */
-	tl->prev_tl = ptr;
-	tl->next_tl = ptr->next_tl;
-	tl->prev_tl->next_tl = tl;
-	tl->next_tl->prev_tl = tl;
-
-	if (tl->time_out==ptr->time_out) {
-		tl->ld_tl = ptr->ld_tl;
-		ptr->ld_tl = 0;
-		tl->ld_tl->ld_tl = tl;
-	} else {
-		tl->ld_tl = tl;
-	}
+	tw_add( &timer_list->wheel, &tl->tw, time_out, now);
 #ifdef TM_TIMER_DEBUG
 	check_timer_list( timer_list, "after insert" );
 #endif
@@ -814,13 +751,11 @@ static void insert_timer_unsafe( struct timer *timer_list,
 static struct timer_link  *check_and_split_time_list( struct timer *timer_list,
 		utime_t time )
 {
-	struct timer_link *tl , *end, *ret;
-
+	struct timer_link *tl, *ret, **last;
+	struct list_head expired, *it;
 
 	/* quick check whether it is worth entering the lock */
-	if (timer_list->first_tl.next_tl==&timer_list->last_tl
-			|| ( /* timer_list->first_tl.next_tl
-				&& */ timer_list->first_tl.next_tl->time_out > time) )
+	if (timer_list->wheel.count==0)
 		return NULL;
 
 	/* the entire timer list is locked now -- no one else can manipulate it */
@@ -829,37 +764,23 @@ static struct timer_link  *check_and_split_time_list( struct timer *timer_list,
 #ifdef TM_TIMER_DEBUG
 	check_timer_list( timer_list, "before split" );
 #endif
-	end = &timer_list->last_tl;
-	tl = timer_list->first_tl.next_tl;
-	while( tl!=end && tl->time_out <= time)
-		tl=tl->ld_tl->next_tl;
-
-	/* nothing to delete found */
-	if (tl->prev_tl==&(timer_list->first_tl)) {
-		ret = NULL;
-	} else { /* we did find timers to be fired! */
-		/* the detached list begins with current beginning */
-		ret = timer_list->first_tl.next_tl;
-		/* and we mark the end of the split list */
-		tl->prev_tl->next_tl = NULL;
-		/* the shortened list starts from where we suspended */
-		timer_list->first_tl.next_tl = tl;
-		tl->prev_tl = & timer_list->first_tl;
-
-		for( tl=ret ; tl ; tl=tl->next_tl )
-			tl->timer_list = DETACHED_LIST;
+	INIT_LIST_HEAD( &expired );
+	tw_expire( &timer_list->wheel, time, &expired);
+
+	/* chain the fired timers into the detached list */
+	ret = NULL;
+	last = &ret;
+	list_for_each( it, &expired) {
+		tl = list_entry(it, struct timer_link, tw.list);
+		tl->timer_list = DETACHED_LIST;
+		*last = tl;
+		last = &tl->next_tl;
 	}
+	*last = NULL;
 #ifdef TM_TIMER_DEBUG
 	check_timer_list( timer_list, "after split" );
 #endif
 
-#ifdef EXTRA_DEBUG
-	if (timer_list->last_tl.prev_tl==0) {
-		LM_CRIT("Oh no, zero link in trailing timer element\n");
-		abort();
-	};
-#endif
-
 	/* give the list lock away */
 	unlock(timer_list->mutex);
 
@@ -901,7 +822,7 @@ void reset_timer( struct timer_link* tl )
 void set_timer( struct timer_link *new_tl, enum lists list_id,
 												utime_t* ext_timeout )
 {
-	utime_t timeout;
+	utime_t timeout, now;
 	struct timer* list;
 
 	if (list_id>=NR_OF_TIMER_LISTS) {
@@ -934,8 +855,8 @@ void set_timer( struct timer_link *new_tl, enum lists list_id,
 	/* make sure I'm not already on a list */
 	remove_timer_unsafe( new_tl );
 
-	insert_timer_unsafe( list, new_tl, timeout +
-			((timer_id2type[list_id]==UTIME_TYPE)?get_uticks():get_ticks()));
+	now = (timer_id2type[list_id]==UTIME_TYPE)?get_uticks():get_ticks();
+	insert_timer_unsafe( list, new_tl, timeout + now, now);
 end:
 	unlock(list->mutex);
 }
@@ -952,7 +873,7 @@ end:
 int set_1timer( struct timer_link *new_tl, enum lists list_id,
 												utime_t* ext_timeout )
 {
-	utime_t timeout;
+	utime_t timeout, now;
 	struct timer* list;
 	int ret = -1;
 
@@ -975,8 +896,8 @@ int set_1timer( struct timer_link *new_tl, enum lists list_id,
 
 	lock(list->mutex);
 	if (!new_tl->time_out) {
-		insert_timer_unsafe( list, new_tl, timeout +
-			((timer_id2type[list_id]==UTIME_TYPE)?get_uticks():get_ticks()));
+		now = (timer_id2type[list_id]==UTIME_TYPE)?get_uticks():get_ticks();
+		insert_timer_unsafe( list, new_tl, timeout + now, now);
 		ret = 0;
 	}
 	unlock(list->mutex);
@@ -1057,7 +978,7 @@ static void unlink_timers( struct cell *t )
 	{\
 		/* reset the timer list linkage */\
 		tmp_tl = (_tl)->next_tl;\
-		(_tl)->next_tl = (_tl)->prev_tl = 0;\
+		(_tl)->next_tl = 0;\
 		LM_DBG("timer routine:%d,tl=%p next=%p, timeout=%lld\n",\
 			id,(_tl),tmp_tl,(_tl)->time_out);\
 		if ( !(_tl)->deleted ) \
@@ -1105,6 +1026,10 @@ void utimer_routine(utime_t uticks , void *set)
 	struct timer_link *tl, *tmp_tl;
 	int                id;
 
+	/* all the retransmissions of this tick go out in one UDP batch */
+	if (tm_udp_batch)
+		udp_batch_start();
+
 	lock_start_write( timertable[(long)set].ex_lock );
 
 	for( id=RT_T1_TO_1 ; id<NR_OF_TIMER_LISTS ; id++ )
@@ -1124,5 +1049,8 @@ void utimer_routine(utime_t uticks , void *set)
 		}
 	}
 	lock_stop_write( timertable[(long)set].ex_lock );
+
+	if (tm_udp_batch)
+		udp_batch_flush();
 }
 
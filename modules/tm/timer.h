@@ -30,10 +30,15 @@
 
 #include "../../timer.h"
 #include "../../rw_locking.h"
+#include "../../lib/timer_wheel.h"
 #include "lock.h"
 
 #define MIN_TIMER_VALUE  2
 
+/* period of the retransmission timer (usec) - also the resolution of
+ * the wheels of the retransmission lists */
+#define TM_UTIMER_INTERVAL  (100*1000)
+
 /* identifiers of timer lists;*/
 /* fixed-timer retransmission lists (benefit: fixed timer$
    length allows for appending new items to the list as$
@@ -53,9 +58,10 @@ enum lists
    links to neighbors and timer value */
 typedef struct timer_link
 {
+	/* linkage into the timing wheel of the timer list */
+	struct tw_link        tw;
+	/* linkage into the list of expired timers, once detached */
 	struct timer_link     *next_tl;
-	struct timer_link     *prev_tl;
-	struct timer_link     *ld_tl;
 	volatile utime_t      time_out;
 	struct timer          *timer_list;
 	unsigned short        deleted;
@@ -66,11 +72,10 @@ typedef struct timer_link
 }timer_link_type ;
 
 
-/* timer list: includes head, tail and protection semaphore */
+/* timer list: a timing wheel and its protection semaphore */
 typedef struct  timer
 {
-	struct timer_link  first_tl;
-	struct timer_link  last_tl;
+	struct timer_wheel wheel;
 	ser_lock_t*        mutex;
 	enum lists         id;
 } timer_type;
@@ -179,6 +179,10 @@ stat_var *tm_trans_4xx;
 stat_var *tm_trans_5xx;
 stat_var *tm_trans_6xx;
 stat_var *tm_trans_inuse;
+stat_var *tm_arena_hits;
+stat_var *tm_arena_fallbacks;
+
+static unsigned long get_arena_hit_ratio(void *foo);
 
 static dep_export_t deps = {
 	{ /* OpenSIPS module dependencies */
@@ -306,6 +310,16 @@ static param_export_t params[]={
 		&tm_cluster_param.s },
 	{ "cluster_auto_cancel",      INT_PARAM,
 		&tm_repl_auto_cancel },
+	{ "udp_batch_send",           INT_PARAM,
+		&tm_udp_batch },
+	{ "cell_arena_size",          INT_PARAM,
+		&tm_cell_arena },
+	{ "hash_size",                INT_PARAM,
+		&tm_hash_size },
+	{ "hash_max_size",            INT_PARAM,
+		&tm_hash_max_size },
+	{ "hash_locks",               INT_PARAM,
+		&tm_hash_locks },
 	{0,0,0}
 };
 
@@ -322,6 +336,10 @@ static stat_export_t mod_stats[] = {
 	{"5xx_transactions" ,    0,              &tm_trans_5xx   },
 	{"6xx_transactions" ,    0,              &tm_trans_6xx   },
 	{"inuse_transactions" ,  STAT_NO_RESET,  &tm_trans_inuse },
+	{"arena_hits" ,          0,              &tm_arena_hits  },
+	{"arena_fallbacks" ,     0,              &tm_arena_fallbacks },
+	{"arena_hit_ratio" ,     STAT_IS_FUNC,
+		(stat_var**)get_arena_hit_ratio },
 	{0,0,0}
 };
 
@@ -355,6 +373,7 @@ static mi_export_t mi_cmds [] = {
 	{MI_TM_UAC,     0, mi_tm_uac_dlg,   MI_ASYNC_RPL_FLAG,  0,  0 },
 	{MI_TM_CANCEL,  0, mi_tm_cancel,    0,                  0,  0 },
 	{MI_TM_HASH,    0, mi_tm_hash,      MI_NO_INPUT_FLAG,   0,  0 },
+	{MI_TM_HASH_STATS, 0, mi_tm_hash_stats, MI_NO_INPUT_FLAG, 0,  0 },
 	{MI_TM_REPLY,   0, mi_tm_reply,     0,                  0,  0 },
 	{0,0,0,0,0,0}
 };
@@ -855,6 +874,12 @@ static int mod_init(void)
 		exports.stats = 0;
 #endif
 
+	if (tm_cell_arena<0) {
+		LM_ERR("invalid cell_arena_size %d\n", tm_cell_arena);
+		return -1;
+	}
+	tm_cell_arena = TM_ARENA_ALIGN(tm_cell_arena);
+
 	if (init_callid() < 0) {
 		LM_CRIT("Error while initializing Call-ID generator\n");
 		return -1;
@@ -903,12 +928,19 @@ static int mod_init(void)
 			return -1;
 		}
 		if (register_utimer( "tm-utimer", utimer_routine,
-		(void*)(long)set, 100*1000, TIMER_FLAG_DELAY_ON_DELAY)<0) {
+		(void*)(long)set, TM_UTIMER_INTERVAL, TIMER_FLAG_DELAY_ON_DELAY)<0) {
 			LM_ERR("failed to register utimer for set %d\n",set);
 			return -1;
 		}
 	}
 
+	if (tm_hash_max_size > tm_hash_size &&
+	register_utimer( "tm-hash-resize", hash_resize_routine, NULL,
+	TM_TABLE_MOVE_INTERVAL, TIMER_FLAG_SKIP_ON_DELAY) < 0) {
+		LM_ERR("failed to register the hash resize timer\n");
+		return -1;
+	}
+
 	if (uac_init()==-1) {
 		LM_ERR("uac_init failed\n");
 		return -1;
@@ -965,6 +997,21 @@ static int mod_init(void)
 }
 
 
+/* percentage of the arena allocations served without falling back
+ * to a regular shm chunk */
+static unsigned long get_arena_hit_ratio(void *foo)
+{
+	unsigned long hits, total;
+
+	hits = get_stat_val(tm_arena_hits);
+	total = hits + get_stat_val(tm_arena_fallbacks);
+	if (total==0)
+		return 0;
+
+	return hits * 100 / total;
+}
+
+
 static int child_init(int rank)
 {
 	if (child_init_callid(rank) < 0) {
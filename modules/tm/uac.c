@@ -84,9 +84,6 @@ int uac_init(void)
 	str src[3];
 	struct socket_info *si;
 
-	if (RAND_MAX < TM_TABLE_ENTRIES) {
-		LM_WARN("uac does not spread across the whole hash table\n");
-	}
 	/* on tcp/tls bind_address is 0 so try to get the first address we listen
 	 * on no matter the protocol */
 	si=bind_address?bind_address:get_first_socket();
@@ -443,7 +440,8 @@ int t_uac(str* method, str* headers, str* body, dlg_t* dialog,
 			}
 abort_update:
 			/* save the SIP message into transaction */
-			new_cell->uas.request = sip_msg_cloner( req, &sip_msg_len, 1);
+			new_cell->uas.request = sip_msg_cloner( req, &sip_msg_len, 1,
+				&new_cell->arena);
 			if (new_cell->uas.request==NULL) {
 				/* reset any T triggering */
 				new_cell->on_negative = 0;
@@ -25,6 +25,7 @@
 */
 
 #include "topo_hiding_logic.h"
+#include "../../mem/msg_arena.h"
 
 extern int force_dialog;
 extern struct tm_binds tm_api;
@@ -219,7 +220,7 @@ static int topo_delete_record_routes(struct sip_msg *req)
 				if (!(foo->flags&LUMPFLAG_SHMEM))
 					free_lump(foo);
 				if (!(foo->flags&LUMPFLAG_SHMEM))
-					pkg_free(foo);
+					msg_free(foo);
 			}
 
 			a=lump->after;
@@ -228,7 +229,7 @@ static int topo_delete_record_routes(struct sip_msg *req)
 				if (!(foo->flags&LUMPFLAG_SHMEM))
 					free_lump(foo);
 				if (!(foo->flags&LUMPFLAG_SHMEM))
-					pkg_free(foo);
+					msg_free(foo);
 			}
 			if (lump == req->add_rm) {
 				if (lump->flags&LUMPFLAG_SHMEM) {
@@ -250,7 +251,7 @@ static int topo_delete_record_routes(struct sip_msg *req)
 			if (!(lump->flags&LUMPFLAG_SHMEM))
 				free_lump(lump);
 			if (!(lump->flags&LUMPFLAG_SHMEM))
-				pkg_free(lump);
+				msg_free(lump);
 			continue;
 		}
 		prev_crt = crt;
@@ -647,8 +647,7 @@ get_domain_mem_ucontacts(udomain_t *d,void *buf, int *len, unsigned int flags,
 	urecord_t *r;
 	ucontact_t *c;
 	void *cp;
-	void **dest;
-	map_iterator_t it;
+	slot_iterator_t it;
 	int shortage;
 	int needed;
 	int count;
@@ -677,7 +676,7 @@ get_domain_mem_ucontacts(udomain_t *d,void *buf, int *len, unsigned int flags,
 			continue;
 
 		lock_ulslot( d, i);
-		count = map_size(d->table[i].records);
+		count = slot_size(&d->table[i]);
 
 		if( count <= 0 )
 		{
@@ -685,16 +684,15 @@ get_domain_mem_ucontacts(udomain_t *d,void *buf, int *len, unsigned int flags,
 			continue;
 		}
 
-		for ( map_first( d->table[i].records, &it);
-			iterator_is_valid(&it);
-			iterator_next(&it) ) {
+		for ( slot_first( &d->table[i], &it);
+			slot_it_valid(&it);
+			slot_it_next(&it) ) {
 
-			dest = iterator_val(&it);
-			if( dest == NULL ) {
+			r = slot_it_val(&it);
+			if( r == NULL ) {
 				unlock_ulslot(d, i);
 				return -1;
 			}
-			r =( urecord_t * ) *dest;
 
 			/* distribute ping workload across cluster nodes */
 			if (nr_nodes && r->aorhash % nr_nodes != cur_node_idx)
@@ -1095,7 +1093,6 @@ int find_domain(str* _d, udomain_t** _p)
 ucontact_t* get_ucontact_from_id(udomain_t *d, uint64_t contact_id, urecord_t **_r)
 {
 	int count;
-	void **dest;
 	unsigned int sl;
 	unsigned int rlabel;
 	unsigned short aorhash, clabel;
@@ -1103,30 +1100,29 @@ ucontact_t* get_ucontact_from_id(udomain_t *d, uint64_t contact_id, urecord_t **
 	urecord_t *r;
 	ucontact_t *c;
 
-	map_iterator_t it;
+	slot_iterator_t it;
 
 	unpack_indexes(contact_id, &aorhash, &rlabel, &clabel);
 
 	sl = aorhash&(d->size-1);
 	lock_ulslot(d, sl);
 
-	count = map_size(d->table[sl].records);
+	count = slot_size(&d->table[sl]);
 	if (count <= 0) {
 		unlock_ulslot(d, sl);
 		return NULL;
 	}
 
-	for (map_first( d->table[sl].records, &it);
-			iterator_is_valid(&it);
-			iterator_next(&it) ) {
+	for (slot_first( &d->table[sl], &it);
+			slot_it_valid(&it);
+			slot_it_next(&it) ) {
 
-		dest = iterator_val(&it);
-		if (dest == NULL) {
+		r = slot_it_val(&it);
+		if (r == NULL) {
 			unlock_ulslot(d, sl);
 			return NULL;
 		}
 
-		r = (urecord_t *)*dest;
 		if (r->label != rlabel)
 			continue;
 
@@ -1217,7 +1213,7 @@ int delete_ucontact_from_coords(udomain_t *d, ucontact_coords ct_coords,
 		return 0;
 	}
 
-	if (!is_replicated && location_cluster)
+	if (!is_replicated && (location_cluster || have_file_persistency()))
 		replicate_ucontact_delete(r, c);
 
 	if (exists_ulcb_type(UL_CONTACT_DELETE)) {
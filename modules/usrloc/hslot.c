@@ -27,8 +27,22 @@
 
 
 
+#include <string.h>
+
+#include "../../mem/shm_mem.h"
 #include "hslot.h"
 
+/* initial size of an open addressing table, grown x2 when 3/4 full */
+#define SLOT_MIN_BITS 4
+
+#define slot_entries_no(_s) ((_s)->entries ? 1U << (_s)->entries_bits : 0)
+
+/* Fibonacci hashing - the low bits of aorhash are the same for
+ * all the records of a slot, so all the bits must be mixed in */
+#define slot_pos(_h, _bits) (((unsigned int)(_h) * 2654435761U) >> (32 - (_bits)))
+
+enum ul_aor_index ul_aor_index = UL_AOR_INDEX_AVL;
+
 int ul_locks_no=4;
 gen_lock_set_t* ul_locks=0;
 
@@ -104,11 +118,13 @@ void ul_release_idx(int idx)
  */
 int init_slot(struct udomain* _d, hslot_t* _s, int n)
 {
-	_s->records = map_create( AVLMAP_SHARED | AVLMAP_NO_DUPLICATE);
-	_s->next_label = 0;
+	memset(_s, 0, sizeof *_s);
 
-	if( _s->records == NULL )
-		return -1;
+	if (ul_aor_index == UL_AOR_INDEX_AVL) {
+		_s->records = map_create( AVLMAP_SHARED | AVLMAP_NO_DUPLICATE);
+		if( _s->records == NULL )
+			return -1;
+	}
 
 	_s->d = _d;
 
@@ -132,29 +148,175 @@ void free_value_urecord( void * val )
  */
 void deinit_slot(hslot_t* _s)
 {
-	map_destroy(_s->records , free_value_urecord);
+	unsigned int i;
+
+	if (_s->records) {
+		map_destroy(_s->records , free_value_urecord);
+		_s->records = NULL;
+	}
+
+	if (_s->entries) {
+		for (i = 0; i < slot_entries_no(_s); i++)
+			if (_s->entries[i].r && _s->entries[i].r != SLOT_ENTRY_DELETED)
+				free_urecord(_s->entries[i].r);
+		shm_free(_s->entries);
+		_s->entries = NULL;
+	}
+
 	_s->d = 0;
 }
 
 
+static inline int slot_entry_match(struct slot_entry *e, const str *aor,
+                                   unsigned int aorhash)
+{
+	if (e->aorhash != aorhash || e->len != aor->len ||
+	memcmp(e->key, aor->s, aor->len<SLOT_KEY_LEN ? aor->len : SLOT_KEY_LEN))
+		return 0;
+
+	/* only long AORs need to look into the record */
+	return aor->len <= SLOT_KEY_LEN || memcmp(e->r->aor.s + SLOT_KEY_LEN,
+		aor->s + SLOT_KEY_LEN, aor->len - SLOT_KEY_LEN) == 0;
+}
+
+
+static inline void slot_entry_set(struct slot_entry *e, struct urecord *r)
+{
+	e->r = r;
+	e->aorhash = r->aorhash;
+	e->len = r->aor.len;
+	memcpy(e->key, r->aor.s,
+		r->aor.len < SLOT_KEY_LEN ? r->aor.len : SLOT_KEY_LEN);
+}
+
+
+static struct slot_entry* slot_lookup(hslot_t* _s, const str* _aor,
+                                      unsigned int _aorhash)
+{
+	struct slot_entry *e;
+	unsigned int pos, mask;
+
+	if (!_s->entries)
+		return NULL;
+
+	mask = slot_entries_no(_s) - 1;
+	for (pos = slot_pos(_aorhash, _s->entries_bits); ; pos = (pos + 1) & mask) {
+		e = &_s->entries[pos];
+		if (!e->r)
+			return NULL;
+		if (e->r != SLOT_ENTRY_DELETED && slot_entry_match(e, _aor, _aorhash))
+			return e;
+	}
+}
+
+
+/*! \brief
+ * (Re)build the open addressing table with 2^bits entries, dropping
+ * the deleted ones
+ */
+static int slot_rehash(hslot_t* _s, unsigned int bits)
+{
+	struct slot_entry *entries, *e;
+	unsigned int i, pos, mask;
+
+	entries = shm_malloc((1U << bits) * sizeof *entries);
+	if (!entries) {
+		LM_ERR("no more shm memory\n");
+		return -1;
+	}
+	memset(entries, 0, (1U << bits) * sizeof *entries);
+
+	mask = (1U << bits) - 1;
+	for (i = 0; i < slot_entries_no(_s); i++) {
+		e = &_s->entries[i];
+		if (!e->r || e->r == SLOT_ENTRY_DELETED)
+			continue;
+
+		for (pos = slot_pos(e->aorhash, bits); entries[pos].r;
+		pos = (pos + 1) & mask);
+		entries[pos] = *e;
+	}
+
+	if (_s->entries)
+		shm_free(_s->entries);
+	_s->entries = entries;
+	_s->entries_bits = bits;
+	_s->entries_deleted = 0;
+
+	return 0;
+}
+
+
 /*! \brief
  * Add an element to an slot's linked list
  */
 int slot_add(hslot_t* _s, struct urecord* _r)
 {
-
+	struct slot_entry *e, *free_e;
+	unsigned int pos, mask, bits;
 	void ** dest;
 
-	dest = map_get( _s->records, _r->aor );
+	if (_s->records) {
+		dest = map_get( _s->records, _r->aor );
+
+		if( dest == NULL )
+		{
+			LM_ERR("inserting into map\n");
+			return -1;
+		}
 
-	if( dest == NULL )
-	{
-		LM_ERR("inserting into map\n");
+		*dest = _r;
+
+		_r->slot = _s;
+
+		return 0;
+	}
+
+	if (_r->aor.len > 0xffff) {
+		LM_ERR("AOR too long (%d)\n", _r->aor.len);
 		return -1;
 	}
 
+	/* keep at least 1/4 of the entries free, so the lookups stay short */
+	if ((_s->entries_used + _s->entries_deleted + 1) * 4 >
+	slot_entries_no(_s) * 3) {
+		if (!_s->entries)
+			bits = SLOT_MIN_BITS;
+		else if ((_s->entries_used + 1) * 2 > slot_entries_no(_s))
+			bits = _s->entries_bits + 1;
+		else
+			bits = _s->entries_bits;
+
+		if (slot_rehash(_s, bits) < 0)
+			return -1;
+	}
+
+	free_e = NULL;
+	mask = slot_entries_no(_s) - 1;
+	for (pos = slot_pos(_r->aorhash, _s->entries_bits); ;
+	pos = (pos + 1) & mask) {
+		e = &_s->entries[pos];
+		if (!e->r)
+			break;
+
+		if (e->r == SLOT_ENTRY_DELETED) {
+			if (!free_e)
+				free_e = e;
+		} else if (slot_entry_match(e, &_r->aor, _r->aorhash)) {
+			/* same AOR, replace it */
+			e->r = _r;
+			_r->slot = _s;
+			return 0;
+		}
+	}
 
-	*dest = _r;
+	if (free_e)
+		_s->entries_deleted--;
+	else
+		free_e = e;
+
+	slot_entry_set(free_e, _r);
+	_s->entries_used++;
 
 	_r->slot = _s;
 
@@ -162,12 +324,121 @@ int slot_add(hslot_t* _s, struct urecord* _r)
 }
 
 
+static inline void slot_entry_del(hslot_t* _s, struct slot_entry *e)
+{
+	unsigned int mask = slot_entries_no(_s) - 1;
+
+	/* the end of a probe sequence may be freed for good */
+	if (!_s->entries[(e - _s->entries + 1) & mask].r) {
+		e->r = NULL;
+	} else {
+		e->r = SLOT_ENTRY_DELETED;
+		_s->entries_deleted++;
+	}
+	_s->entries_used--;
+}
+
+
 /*! \brief
  * Remove an element from slot linked list
  */
 void slot_rem(hslot_t* _s, struct urecord* _r)
 {
+	struct slot_entry *e;
+
+	if (_s->records) {
+		map_remove( _s->records, _r->aor );
+	} else {
+		e = slot_lookup(_s, &_r->aor, _r->aorhash);
+		if (e && e->r == _r)
+			slot_entry_del(_s, e);
+	}
 
-	map_remove( _s->records, _r->aor );
 	_r->slot = 0;
 }
+
+
+struct urecord* slot_find(hslot_t* _s, const str* _aor, unsigned int _aorhash)
+{
+	struct slot_entry *e;
+	void **dest;
+
+	if (_s->records) {
+		dest = map_find(_s->records, *_aor);
+		return dest ? (struct urecord *)*dest : NULL;
+	}
+
+	e = slot_lookup(_s, _aor, _aorhash);
+	return e ? e->r : NULL;
+}
+
+
+int slot_size(hslot_t* _s)
+{
+	return _s->records ? map_size(_s->records) : _s->entries_used;
+}
+
+
+static inline void slot_it_skip(slot_iterator_t* _it)
+{
+	unsigned int n = slot_entries_no(_it->s);
+
+	while (_it->pos < n && (!_it->s->entries[_it->pos].r ||
+	_it->s->entries[_it->pos].r == SLOT_ENTRY_DELETED))
+		_it->pos++;
+}
+
+
+void slot_first(hslot_t* _s, slot_iterator_t* _it)
+{
+	_it->s = _s;
+
+	if (_s->records) {
+		map_first(_s->records, &_it->it);
+	} else {
+		_it->pos = 0;
+		slot_it_skip(_it);
+	}
+}
+
+
+int slot_it_valid(slot_iterator_t* _it)
+{
+	if (_it->s->records)
+		return iterator_is_valid(&_it->it);
+
+	return _it->pos < slot_entries_no(_it->s);
+}
+
+
+struct urecord* slot_it_val(slot_iterator_t* _it)
+{
+	void **dest;
+
+	if (_it->s->records) {
+		dest = iterator_val(&_it->it);
+		return dest ? (struct urecord *)*dest : NULL;
+	}
+
+	return _it->s->entries[_it->pos].r;
+}
+
+
+void slot_it_next(slot_iterator_t* _it)
+{
+	if (_it->s->records) {
+		iterator_next(&_it->it);
+	} else {
+		_it->pos++;
+		slot_it_skip(_it);
+	}
+}
+
+
+void slot_it_delete(slot_iterator_t* _it)
+{
+	if (_it->s->records)
+		iterator_delete(&_it->it);
+	else
+		slot_entry_del(_it->s, &_it->s->entries[_it->pos]);
+}
@@ -40,9 +40,37 @@ struct udomain;
 struct urecord;
 
 
+/*! \brief how the records of a slot are indexed by AOR */
+enum ul_aor_index {
+	UL_AOR_INDEX_AVL,     /*!< AVL tree (map_t) */
+	UL_AOR_INDEX_OPEN,    /*!< open addressing hash table */
+};
+
+extern enum ul_aor_index ul_aor_index;
+
+/*! \brief bytes of the AOR kept in the open addressing table itself */
+#define SLOT_KEY_LEN 50
+
+/*! \brief open addressing table entry, one cache line */
+struct slot_entry {
+	struct urecord *r;             /*!< NULL if free */
+	unsigned int aorhash;
+	unsigned short len;            /*!< AOR length */
+	char key[SLOT_KEY_LEN];        /*!< AOR head */
+};
+
+#define SLOT_ENTRY_DELETED ((struct urecord *)1)
+
+
 typedef struct hslot {
 
-	map_t records;
+	map_t records;                 /*!< UL_AOR_INDEX_AVL */
+
+	struct slot_entry *entries;    /*!< UL_AOR_INDEX_OPEN */
+	unsigned int entries_bits;     /*!< the table has 2^bits entries */
+	unsigned int entries_used;
+	unsigned int entries_deleted;
+
 	unsigned int next_label;
 
 	struct udomain* d;      /*!< Domain we belong to */
@@ -53,6 +81,13 @@ typedef struct hslot {
 #endif
 } hslot_t;
 
+/*! \brief walks the records of a slot, with the slot locked */
+typedef struct slot_iterator {
+	hslot_t *s;
+	map_iterator_t it;
+	unsigned int pos;
+} slot_iterator_t;
+
 /*! \brief
  * Initialize slot structure
  */
@@ -76,6 +111,33 @@ int slot_add(hslot_t* _s, struct urecord* _r);
  */
 void slot_rem(hslot_t* _s, struct urecord* _r);
 
+
+/*! \brief
+ * Find the record of an AOR, NULL if not found
+ */
+struct urecord* slot_find(hslot_t* _s, const str* _aor, unsigned int _aorhash);
+
+
+/*! \brief
+ * Number of records in the slot
+ */
+int slot_size(hslot_t* _s);
+
+
+void slot_first(hslot_t* _s, slot_iterator_t* _it);
+
+int slot_it_valid(slot_iterator_t* _it);
+
+struct urecord* slot_it_val(slot_iterator_t* _it);
+
+void slot_it_next(slot_iterator_t* _it);
+
+/*! \brief
+ * Remove the record the iterator points to; the iterator must be
+ * a copy taken before moving to the next record
+ */
+void slot_it_delete(slot_iterator_t* _it);
+
 int ul_init_locks();
 void ul_unlock_locks();
 void ul_destroy_locks();
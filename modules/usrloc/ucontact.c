@@ -42,6 +42,7 @@
 #include "../../dprint.h"
 #include "../../db/db.h"
 #include "../../db/db_insertq.h"
+#include "../../timer.h"
 #include "ul_mod.h"
 #include "ul_callback.h"
 #include "urecord.h"
@@ -455,28 +456,12 @@ int st_flush_ucontact(ucontact_t* _c)
 /* ============== Database related functions ================ */
 
 /*! \brief
- * Insert contact into the database
+ * Fills in the location columns of a contact
+ * Returns the number of columns; the kv_store value must be freed
  */
-int db_insert_ucontact(ucontact_t* _c,query_list_t **ins_list, int update)
+static int ucontact_db_row(ucontact_t* _c, db_key_t* keys, db_val_t* vals)
 {
-	int nr_vals = UL_COLS - 1;
-	int start = 0;
-
-	static db_ps_t myI_ps = NULL;
-	static db_ps_t myR_ps = NULL;
 	char* dom;
-	db_key_t keys[UL_COLS];
-	db_val_t vals[UL_COLS];
-
-	if (_c->flags & FL_MEM) {
-		return 0;
-	}
-
-	/* in CM_SQL_ONLY, we let the SQL engine auto-generate the ucontact_id */
-	if (cluster_mode == CM_SQL_ONLY) {
-		start++;
-		nr_vals--;
-	}
 
 	keys[0] = &contactid_col;
 	keys[1] = &user_col;
@@ -498,7 +483,7 @@ int db_insert_ucontact(ucontact_t* _c,query_list_t **ins_list, int update)
 	keys[17] = &attr_col;
 	keys[UL_COLS - 1] = &domain_col; /* "domain" always stays last */
 
-	memset(vals, 0, sizeof vals);
+	memset(vals, 0, UL_COLS * sizeof *vals);
 
 	vals[0].type = DB_BIGINT;
 	vals[0].val.bigint_val = _c->contact_id;
@@ -608,9 +593,39 @@ int db_insert_ucontact(ucontact_t* _c,query_list_t **ins_list, int update)
 			         _c->aor->s + _c->aor->len - dom - 1;
 		}
 
-		nr_vals++;
+		return UL_COLS;
 	}
 
+	return UL_COLS - 1;
+}
+
+
+/*! \brief
+ * Insert contact into the database
+ */
+int db_insert_ucontact(ucontact_t* _c,query_list_t **ins_list, int update)
+{
+	int nr_vals = UL_COLS - 1;
+	int start = 0;
+
+	static db_ps_t myI_ps = NULL;
+	static db_ps_t myR_ps = NULL;
+	db_key_t keys[UL_COLS];
+	db_val_t vals[UL_COLS];
+
+	if (_c->flags & FL_MEM) {
+		return 0;
+	}
+
+	/* in CM_SQL_ONLY, we let the SQL engine auto-generate the ucontact_id */
+	if (cluster_mode == CM_SQL_ONLY) {
+		start++;
+		nr_vals--;
+	}
+
+	if (ucontact_db_row(_c, keys, vals) == UL_COLS)
+		nr_vals++;
+
 	if (ul_dbf.use_table(ul_dbh, _c->domain) < 0) {
 		LM_ERR("sql use_table failed\n");
 		goto out_err;
@@ -839,11 +854,209 @@ int db_multiple_ucontact_delete(str *domain, db_key_t *keys,
 		return -1;
 	}
 
+	update_stat(sql_flush_statements, 1);
+	update_stat(sql_flush_rows, clen);
+
 	return 0;
 }
 
 
 
+/* ============== Write-back batch ================ */
+
+/* contacts written to the DB by a single write-back statement */
+int sql_batch_size = 100;
+
+stat_var *sql_flush_statements;
+stat_var *sql_flush_rows;
+utime_t *sql_flush_latency;
+
+struct wb_entry {
+	uint64_t contact_id;
+	int op;         /* as returned by st_flush_ucontact() */
+};
+
+static udomain_t *wb_domain;
+static struct wb_entry *wb_entries;
+static db_val_t **wb_rows;
+static int wb_rows_no;
+static int wb_rows_size;
+static db_key_t wb_keys[UL_COLS];
+static int wb_cols;
+
+
+/*! \brief
+ * Copies a row, along with its strings, into a single pkg chunk
+ */
+static db_val_t *wb_row_dup(const db_val_t *row, int n)
+{
+	db_val_t *dup;
+	char *p;
+	int i, size;
+
+	size = n * sizeof *row;
+	for (i = 0; i < n; i++)
+		if (VAL_TYPE(row + i) == DB_STR && !VAL_NULL(row + i))
+			size += VAL_STR(row + i).len;
+
+	dup = pkg_malloc(size);
+	if (!dup) {
+		LM_ERR("no more pkg memory\n");
+		return NULL;
+	}
+
+	memcpy(dup, row, n * sizeof *row);
+	p = (char *)(dup + n);
+	for (i = 0; i < n; i++) {
+		if (VAL_TYPE(row + i) != DB_STR || VAL_NULL(row + i))
+			continue;
+
+		memcpy(p, VAL_STR(row + i).s, VAL_STR(row + i).len);
+		VAL_STR(dup + i).s = p;
+		p += VAL_STR(row + i).len;
+	}
+
+	return dup;
+}
+
+
+/*! \brief
+ * Queues a contact for the next write-back flush (see db_wb_flush())
+ * Returns 0 if queued, -1 if it must be written right away
+ */
+int db_wb_add_ucontact(udomain_t* _d, ucontact_t* _c, int op)
+{
+	db_val_t vals[UL_COLS];
+	struct wb_entry *e;
+	db_val_t **r;
+	int size, n;
+
+	if (sql_batch_size <= 1 ||
+	    !DB_CAPABILITY(ul_dbf, DB_CAP_MULTIPLE_INSERT_UPDATE))
+		return -1;
+
+	if (_c->flags & FL_MEM)
+		return 0;
+
+	/* a batch holds the contacts of a single domain */
+	if (wb_domain && wb_domain != _d)
+		return -1;
+
+	if (wb_rows_no == wb_rows_size) {
+		size = wb_rows_size ? 2 * wb_rows_size : sql_batch_size;
+
+		e = pkg_realloc(wb_entries, size * sizeof *e);
+		if (!e) {
+			LM_ERR("no more pkg memory\n");
+			return -1;
+		}
+		wb_entries = e;
+
+		r = pkg_realloc(wb_rows, size * sizeof *r);
+		if (!r) {
+			LM_ERR("no more pkg memory\n");
+			return -1;
+		}
+		wb_rows = r;
+		wb_rows_size = size;
+	}
+
+	n = ucontact_db_row(_c, wb_keys, vals);
+	wb_rows[wb_rows_no] = wb_row_dup(vals, n);
+	store_free_buffer(&vals[16].val.str_val);
+	if (!wb_rows[wb_rows_no])
+		return -1;
+
+	wb_entries[wb_rows_no].contact_id = _c->contact_id;
+	wb_entries[wb_rows_no].op = op;
+	wb_rows_no++;
+	wb_cols = n;
+	wb_domain = _d;
+
+	return 0;
+}
+
+
+/*! \brief
+ * Whether the write-back batch is to be flushed
+ */
+int db_wb_full(void)
+{
+	return wb_rows_no >= sql_batch_size;
+}
+
+
+/*! \brief
+ * Puts the contacts of a failed flush back into their previous state,
+ * so the next timer run writes them again
+ */
+static void db_wb_restore(void)
+{
+	unsigned short aorhash, clabel;
+	unsigned int rlabel;
+	ucontact_t *c;
+	urecord_t *r;
+	int i;
+
+	for (i = 0; i < wb_rows_no; i++) {
+		c = get_ucontact_from_id(wb_domain, wb_entries[i].contact_id, &r);
+		if (!c)
+			continue;
+
+		if (c->state == CS_SYNC)
+			c->state = wb_entries[i].op == 1 ? CS_NEW : CS_DIRTY;
+
+		unpack_indexes(wb_entries[i].contact_id, &aorhash, &rlabel, &clabel);
+		unlock_ulslot(wb_domain, aorhash & (wb_domain->size - 1));
+	}
+}
+
+
+/*! \brief
+ * Writes the queued contacts with multi-row upserts
+ * No slot lock may be held by the caller
+ */
+int db_wb_flush(void)
+{
+	utime_t start;
+	int i, n, rc = 0;
+
+	if (wb_rows_no == 0)
+		return 0;
+
+	if (ul_dbf.use_table(ul_dbh, wb_domain->name) < 0) {
+		LM_ERR("sql use_table failed\n");
+		rc = -1;
+		goto out;
+	}
+
+	start = get_uticks();
+	n = ul_dbf.insert_update_rows(ul_dbh, wb_keys, wb_rows, wb_cols,
+	                              wb_rows_no);
+	if (n < 0) {
+		LM_ERR("failed to write %d contacts into database\n", wb_rows_no);
+		rc = -1;
+		goto out;
+	}
+
+	if (sql_flush_latency)
+		*sql_flush_latency = get_uticks() - start;
+	update_stat(sql_flush_statements, n);
+	update_stat(sql_flush_rows, wb_rows_no);
+
+out:
+	if (rc < 0)
+		db_wb_restore();
+
+	for (i = 0; i < wb_rows_no; i++)
+		pkg_free(wb_rows[i]);
+	wb_rows_no = 0;
+	wb_domain = NULL;
+
+	return rc;
+}
+
+
 static inline void unlink_contact(struct urecord* _r, ucontact_t* _c)
 {
 	if (_c->prev) {
@@ -923,7 +1136,8 @@ int update_ucontact(struct urecord* _r, ucontact_t* _c, ucontact_info_t* _ci,
 	if (is_replicated && _c->kv_storage)
 		restore_urecord_kv_store(_r, _c);
 
-	if (!is_replicated && have_data_replication()) {
+	if (!is_replicated &&
+	    (have_data_replication() || have_file_persistency())) {
 		if (persist_urecord_kv_store(_r) != 0)
 			LM_ERR("failed to persist latest urecord K/V storage\n");
 		else
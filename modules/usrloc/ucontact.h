@@ -44,6 +44,8 @@
 #include "../../proxy.h"
 #include "../../socket_info.h"
 #include "../../db/db_insertq.h"
+#include "../../statistics.h"
+#include "../../timer.h"
 
 
 
@@ -262,6 +264,32 @@ int db_multiple_ucontact_delete(str *domain, db_key_t *keys,
 										db_val_t *vals, int clen);
 
 
+/* ====== Write-back batch ====== */
+
+struct udomain;
+
+extern int sql_batch_size;
+extern stat_var *sql_flush_statements;
+extern stat_var *sql_flush_rows;
+extern utime_t *sql_flush_latency;
+
+/*! \brief
+ * Queue a contact for a multi-row write-back upsert
+ * Returns 0 if queued, -1 if it must be written right away
+ */
+int db_wb_add_ucontact(struct udomain* _d, ucontact_t* _c, int op);
+
+/*! \brief
+ * Whether the write-back batch is full
+ */
+int db_wb_full(void);
+
+/*! \brief
+ * Write the queued contacts; no slot lock may be held
+ */
+int db_wb_flush(void);
+
+
 /* ====== Module interface ====== */
 
 struct urecord;
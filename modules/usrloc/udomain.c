@@ -50,6 +50,7 @@
 #include "ureplication.h"
 #include "ul_callback.h"
 #include "usrloc.h"
+#include "ul_preload.h"
 
 
 extern int max_contact_delete;
@@ -720,32 +721,299 @@ static inline ucontact_info_t* dbrow2info(db_val_t *vals, str *contact)
 }
 
 
-int preload_udomain(db_con_t* _c, udomain_t* _d)
+/*! \brief
+ * Builds the AOR of a location row into "uri"
+ * Returns -1 if the row must be skipped
+ */
+static inline int preload_row_aor(udomain_t* _d, db_row_t* row, char* uri,
+																str* aor)
+{
+	char* domain;
+
+	aor->s = (char*)VAL_STRING(ROW_VALUES(row));
+	if (VAL_NULL(ROW_VALUES(row)) || aor->s==0 || aor->s[0]==0) {
+		LM_CRIT("empty username record in table %s...skipping\n",
+				_d->name->s);
+		return -1;
+	}
+	aor->len = strlen(aor->s);
+
+	if (use_domain) {
+		domain = (char*)VAL_STRING(ROW_VALUES(row) + UL_COLS - 1);
+		if (VAL_NULL(ROW_VALUES(row) + UL_COLS - 1) || !domain ||
+		     domain[0] == '\0'){
+			LM_CRIT("empty domain record for user %.*s...skipping\n",
+					aor->len, aor->s);
+			return -1;
+		}
+		/* aor->s cannot be NULL - checked previosly */
+		aor->len = snprintf(uri, MAX_URI_SIZE, "%.*s@%s",
+			aor->len, aor->s, domain);
+		aor->s = uri;
+		if (aor->s[aor->len]!=0) {
+			LM_CRIT("URI '%.*s@%s' longer than %d\n", aor->len, aor->s,
+					domain,	MAX_URI_SIZE);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+/*! \brief
+ * Loads a location row into the domain; the slot of "user" must be locked
+ * Returns 1 if a contact was loaded, 0 if the row was skipped, -1 on error
+ */
+static int preload_row(udomain_t* _d, db_row_t* row, str* user,
+															char* suggest_regen)
 {
-	/* no use to try prepared statements here as this query is performed
-	   once at startup -bogdan */
 	int sl;
-	char uri[MAX_URI_SIZE];
 	ucontact_info_t *ci;
-	db_row_t *row;
-	db_key_t columns[UL_COLS];
-	db_res_t* res = NULL;
-	str user, contact;
-	char* domain;
-	int i;
-	int n;
+	str contact;
 	int ret;
-	int no_rows = 10;
 	unsigned short aorhash, clabel;
 	unsigned int   rlabel;
-	UNUSED(n);
-
 	time_t old_expires=0;
-	char suggest_regen=0;
-
 	urecord_t* r;
 	ucontact_t* c;
 
+	ci = dbrow2info( ROW_VALUES(row)+1, &contact);
+	if (ci==0) {
+		LM_ERR("sipping record for %.*s in table %s\n",
+				user->len, user->s, _d->name->s);
+		return 0;
+	}
+
+	unpack_indexes(ci->contact_id, &aorhash, &rlabel, &clabel);
+
+	if ((ret=get_urecord(_d, user, &r)) > 0) {
+		if (mem_insert_urecord(_d, user, &r) < 0) {
+			LM_ERR("failed to create a record\n");
+			return -1;
+		}
+
+		/* set the record label */
+		sl = r->aorhash&(_d->size-1);
+
+		if ((unsigned short)r->aorhash == aorhash) {
+			r->label = rlabel;
+		}/* else we'll get in trouble below */
+
+	} else if (ret < 0) {
+		return -1;
+	} else {
+		/* record found */
+		sl = r->aorhash&(_d->size-1);
+	}
+
+	if ((unsigned short)r->aorhash != aorhash) {
+		/* we've got an invalid contact;
+		 * if regeneration not set we throw error else we will try generate
+		 * new indexes for record and contact labels */
+		if ( !cid_regen ) {
+			*suggest_regen=1;
+			LM_ERR("failed to match aorhashes for user %.*s,"
+					"db aorhash [%u] new aorhash [%u],"
+					"db contactid [%" PRIu64 "]\n",
+					user->len, user->s, aorhash,
+					(unsigned short)(r->aorhash&(_d->size-1)),
+					ci->contact_id);
+			if (ret > 0) {
+				LM_DBG("release bogus urecord\n");
+				release_urecord(r, 0);
+			}
+			return 0;
+		} else {
+			/* invalid contact
+			 * regenerate aor label and contact label if they're not */
+			if ( r->label == 0 ) {
+				if (_d->table[sl].next_label == 0)
+					_d->table[sl].next_label = rand();
+
+				r->label = CID_NEXT_RLABEL(_d, sl);
+			} else {
+				if (_d->table[sl].next_label == 0)
+					_d->table[sl].next_label = r->label;
+			}
+
+			if (r->next_clabel == 0)
+				r->next_clabel = rand();
+
+			old_expires = ci->expires;
+
+			/* mark contact with broken contact id as expired for deletion */
+			ci->expires = 1;
+		}
+	} else {
+		/* we've got a valid contact */
+		/* update indexes accordingly */
+		sl = r->aorhash&(_d->size-1);
+
+		if (_d->table[sl].next_label <= rlabel)
+			_d->table[sl].next_label = rlabel + 1;
+
+		if (r->next_clabel <= clabel || r->next_clabel == 0)
+			r->next_clabel = CLABEL_INC_AND_TEST(clabel);
+
+		r->label = rlabel;
+	}
+
+
+	if ( (c=mem_insert_ucontact(r, &contact, ci)) == 0) {
+		LM_ERR("inserting contact failed\n"
+				"Found a bad contact with id:[%" PRIu64 "] "
+				"aor:[%.*s] contact:[%.*s] received:[%.*s]!\n"
+				"Will continue but that contact needs to be REMOVED!!\n",
+				ci->contact_id,
+				r->aor.len, r->aor.s,
+				contact.len, contact.s,
+				ci->received.len, ci->received.s);
+		free_ucontact(c);
+		return 0;
+	}
+
+
+	/* We have to do this, because insert_ucontact sets state to CS_NEW
+	 * and we have the contact in the database already */
+	/* if contact id regeneration requested then we need to update the
+	 * database so we set the state to CS_DIRTY */
+	if ( !cid_regen )
+		c->state = CS_SYNC;
+	else {
+		/* mark for removal if we've it has an invalid aorhash */
+		if (old_expires)
+			c->state = CS_DIRTY;
+		else
+			c->state = CS_SYNC;
+	}
+
+	/* if we've found a broken contact id and regeneration set
+	 * reinsert the newly created contact that will have a valid contact id */
+	if (cid_regen && old_expires) {
+		/* rebuild the contact id for this contact */
+		ci->contact_id = pack_indexes(r->aorhash, r->label, r->next_clabel);
+		r->next_clabel = CLABEL_INC_AND_TEST(r->next_clabel);
+
+		ci->expires = old_expires;
+
+		if ( (c=mem_insert_ucontact(r, &contact, ci)) == 0) {
+			LM_ERR("inserting contact failed\n"
+					"Found a bad contact with id:[%" PRIu64 "] "
+					"aor:[%.*s] contact:[%.*s] received:[%.*s]!\n"
+					"Will continue but that contact needs to be REMOVED!!\n",
+					ci->contact_id,
+					r->aor.len, r->aor.s,
+					contact.len, contact.s,
+					ci->received.len, ci->received.s);
+			free_ucontact(c);
+			return 0;
+		}
+
+		/* mark for database insertion */
+		c->state = CS_NEW;
+
+		LM_DBG("regenerated contact id to %"PRIu64"\n", ci->contact_id);
+	}
+
+	return 1;
+}
+
+
+struct preload_slot_row {
+	unsigned int slot;
+	int row;
+};
+
+static int preload_slot_row_cmp(const void *a, const void *b)
+{
+	const struct preload_slot_row *ra = a, *rb = b;
+
+	if (ra->slot != rb->slot)
+		return ra->slot < rb->slot ? -1 : 1;
+
+	return ra->row - rb->row;
+}
+
+
+/*! \brief
+ * Loads a page of location rows, slot by slot: the rows of a slot are
+ * inserted while holding its lock only once
+ * Returns the number of loaded contacts or -1 on error
+ */
+static int preload_rows(udomain_t* _d, db_res_t* res,
+		struct preload_slot_row **rows, int *rows_no, char* suggest_regen)
+{
+	static char uri[MAX_URI_SIZE];
+	struct preload_slot_row *sr;
+	str user;
+	int i, j, n, ret, loaded = 0;
+
+	if (RES_ROW_N(res) > *rows_no) {
+		sr = pkg_realloc(*rows, RES_ROW_N(res) * sizeof *sr);
+		if (!sr) {
+			LM_ERR("no more pkg memory\n");
+			return -1;
+		}
+		*rows = sr;
+		*rows_no = RES_ROW_N(res);
+	}
+	sr = *rows;
+
+	for (i = 0, n = 0; i < RES_ROW_N(res); i++) {
+		if (preload_row_aor(_d, RES_ROWS(res) + i, uri, &user) < 0)
+			continue;
+
+		sr[n].slot = core_hash(&user, 0, _d->size);
+		sr[n++].row = i;
+	}
+
+	qsort(sr, n, sizeof *sr, preload_slot_row_cmp);
+
+	for (i = 0; i < n; i = j) {
+		lock_ulslot(_d, sr[i].slot);
+
+		for (j = i; j < n && sr[j].slot == sr[i].slot; j++) {
+			preload_row_aor(_d, RES_ROWS(res) + sr[j].row, uri, &user);
+
+			ret = preload_row(_d, RES_ROWS(res) + sr[j].row, &user,
+			                  suggest_regen);
+			if (ret < 0) {
+				unlock_ulslot(_d, sr[i].slot);
+				return -1;
+			}
+
+			loaded += ret;
+		}
+
+		unlock_ulslot(_d, sr[i].slot);
+	}
+
+	return loaded;
+}
+
+
+/*! \brief
+ * Loads the "part"-th of the "parts" contact_id ranges of the domain
+ * table; rows are streamed in pages if the DB backend can fetch them
+ */
+int preload_udomain(db_con_t* _c, udomain_t* _d, int part, int parts)
+{
+	/* no use to try prepared statements here as this query is performed
+	   once at startup -bogdan */
+	db_key_t columns[UL_COLS];
+	db_key_t keys[2];
+	db_op_t  ops[2];
+	db_val_t vals[2];
+	db_res_t* res = NULL;
+	struct preload_slot_row *rows = NULL;
+	uint64_t range;
+	int rows_no = 0;
+	int n, nk = 0;
+	int loaded;
+	int no_rows = 10;
+	char suggest_regen=0;
+
 	/* user column first in order to check if null */
 	columns[0] = &user_col;
 	columns[1] = &contactid_col;
@@ -767,6 +1035,30 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 	columns[17] = &attr_col;
 	columns[UL_COLS - 1] = &domain_col; /* "domain" always stays last */
 
+	/* the AOR hash is kept in the top bits (46-61) of the contact_id, so
+	 * each range holds all the contacts of its AORs (if their ids are valid) */
+	if (parts > 1) {
+		range = ((uint64_t)1 << 62) / parts;
+
+		if (part > 0) {
+			keys[nk] = &contactid_col;
+			ops[nk] = OP_GEQ;
+			VAL_TYPE(vals + nk) = DB_BIGINT;
+			VAL_NULL(vals + nk) = 0;
+			VAL_BIGINT(vals + nk) = range * part;
+			nk++;
+		}
+
+		if (part < parts - 1) {
+			keys[nk] = &contactid_col;
+			ops[nk] = OP_LT;
+			VAL_TYPE(vals + nk) = DB_BIGINT;
+			VAL_NULL(vals + nk) = 0;
+			VAL_BIGINT(vals + nk) = range * (part + 1);
+			nk++;
+		}
+	}
+
 	if (ul_dbf.use_table(_c, _d->name) < 0) {
 		LM_ERR("sql use_table failed\n");
 		return -1;
@@ -777,8 +1069,9 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 #endif
 
 	if (DB_CAPABILITY(ul_dbf, DB_CAP_FETCH)) {
-		if (ul_dbf.query(_c, 0, 0, 0, columns, 0,
-		                 use_domain ? UL_COLS : UL_COLS - 1, 0, 0) < 0) {
+		if (ul_dbf.query(_c, nk ? keys : 0, nk ? ops : 0, nk ? vals : 0,
+		                 columns, nk, use_domain ? UL_COLS : UL_COLS - 1,
+		                 nk ? &contactid_col : 0, 0) < 0) {
 			LM_ERR("db_query (1) failed\n");
 			return -1;
 		}
@@ -790,8 +1083,9 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 			return -1;
 		}
 	} else {
-		if (ul_dbf.query(_c, 0, 0, 0, columns, 0,
-		                 use_domain ? UL_COLS : UL_COLS - 1, 0, &res) < 0) {
+		if (ul_dbf.query(_c, nk ? keys : 0, nk ? ops : 0, nk ? vals : 0,
+		                 columns, nk, use_domain ? UL_COLS : UL_COLS - 1,
+		                 0, &res) < 0) {
 			LM_ERR("db_query failed\n");
 			return -1;
 		}
@@ -807,189 +1101,17 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 	n = 0;
 	do {
 		LM_DBG("loading records - cycle [%d]\n", ++n);
-		for(i = 0; i < RES_ROW_N(res); i++) {
-			row = RES_ROWS(res) + i;
-
-			user.s = (char*)VAL_STRING(ROW_VALUES(row));
-			if (VAL_NULL(ROW_VALUES(row)) || user.s==0 || user.s[0]==0) {
-				LM_CRIT("empty username record in table %s...skipping\n",
-						_d->name->s);
-				continue;
-			}
-			user.len = strlen(user.s);
 
-			ci = dbrow2info( ROW_VALUES(row)+1, &contact);
-			if (ci==0) {
-				LM_ERR("sipping record for %.*s in table %s\n",
-						user.len, user.s, _d->name->s);
-				continue;
-			}
-
-			if (use_domain) {
-				domain = (char*)VAL_STRING(ROW_VALUES(row) + UL_COLS - 1);
-				if (VAL_NULL(ROW_VALUES(row) + UL_COLS - 1) || !domain ||
-				     domain[0] == '\0'){
-					LM_CRIT("empty domain record for user %.*s...skipping\n",
-							user.len, user.s);
-					continue;
-				}
-				/* user.s cannot be NULL - checked previosly */
-				user.len = snprintf(uri, MAX_URI_SIZE, "%.*s@%s",
-					user.len, user.s, domain);
-				user.s = uri;
-				if (user.s[user.len]!=0) {
-					LM_CRIT("URI '%.*s@%s' longer than %d\n", user.len, user.s,
-							domain,	MAX_URI_SIZE);
-					continue;
-				}
-			}
-
-			unpack_indexes(ci->contact_id, &aorhash, &rlabel, &clabel);
-
-			lock_udomain(_d, &user);
-
-			if ((ret=get_urecord(_d, &user, &r)) > 0) {
-				if (mem_insert_urecord(_d, &user, &r) < 0) {
-					LM_ERR("failed to create a record\n");
-					unlock_udomain(_d, &user);
-					goto error;
-				}
+		loaded = preload_rows(_d, res, &rows, &rows_no, &suggest_regen);
+		if (loaded < 0)
+			goto error;
 
-				/* set the record label */
-				sl = r->aorhash&(_d->size-1);
-
-				if ((unsigned short)r->aorhash == aorhash) {
-					r->label = rlabel;
-				}/* else we'll get in trouble below */
-
-			} else if (ret < 0) {
-				unlock_udomain(_d, &user);
-				goto error;
-			} else {
-				/* record found */
-				sl = r->aorhash&(_d->size-1);
-			}
-
-			if ((unsigned short)r->aorhash != aorhash) {
-				/* we've got an invalid contact;
-				 * if regeneration not set we throw error else we will try generate
-				 * new indexes for record and contact labels */
-				if ( !cid_regen ) {
-					suggest_regen=1;
-					LM_ERR("failed to match aorhashes for user %.*s,"
-							"db aorhash [%u] new aorhash [%u],"
-							"db contactid [%" PRIu64 "]\n",
-							user.len, user.s, aorhash,
-							(unsigned short)(r->aorhash&(_d->size-1)),
-							ci->contact_id);
-					if (ret > 0) {
-						LM_DBG("release bogus urecord\n");
-						release_urecord(r, 0);
-					}
-					unlock_udomain(_d, &user);
-					continue;
-				} else {
-					/* invalid contact
-					 * regenerate aor label and contact label if they're not */
-					if ( r->label == 0 ) {
-						if (_d->table[sl].next_label == 0)
-							_d->table[sl].next_label = rand();
-
-						r->label = CID_NEXT_RLABEL(_d, sl);
-					} else {
-						if (_d->table[sl].next_label == 0)
-							_d->table[sl].next_label = r->label;
-					}
-
-					if (r->next_clabel == 0)
-						r->next_clabel = rand();
-
-					old_expires = ci->expires;
-
-					/* mark contact with broken contact id as expired for deletion */
-					ci->expires = 1;
-				}
-			} else {
-				/* we've got a valid contact */
-				/* update indexes accordingly */
-				sl = r->aorhash&(_d->size-1);
-
-				if (_d->table[sl].next_label <= rlabel)
-					_d->table[sl].next_label = rlabel + 1;
-
-				if (r->next_clabel <= clabel || r->next_clabel == 0)
-					r->next_clabel = CLABEL_INC_AND_TEST(clabel);
-
-				r->label = rlabel;
-			}
-
-
-			if ( (c=mem_insert_ucontact(r, &contact, ci)) == 0) {
-				LM_ERR("inserting contact failed\n"
-						"Found a bad contact with id:[%" PRIu64 "] "
-						"aor:[%.*s] contact:[%.*s] received:[%.*s]!\n"
-						"Will continue but that contact needs to be REMOVED!!\n",
-						ci->contact_id,
-						r->aor.len, r->aor.s,
-						contact.len, contact.s,
-						ci->received.len, ci->received.s);
-				unlock_udomain(_d, &user);
-				free_ucontact(c);
-				continue;
-			}
-
-
-			/* We have to do this, because insert_ucontact sets state to CS_NEW
-			 * and we have the contact in the database already */
-			/* if contact id regeneration requested then we need to update the
-			 * database so we set the state to CS_DIRTY */
-			if ( !cid_regen )
-				c->state = CS_SYNC;
-			else {
-				/* mark for removal if we've it has an invalid aorhash */
-				if (old_expires)
-					c->state = CS_DIRTY;
-				else
-					c->state = CS_SYNC;
-			}
-
-			/* if we've found a broken contact id and regeneration set
-			 * reinsert the newly created contact that will have a valid contact id */
-			if (cid_regen && old_expires) {
-				/* rebuild the contact id for this contact */
-				ci->contact_id = pack_indexes(r->aorhash, r->label, r->next_clabel);
-				r->next_clabel = CLABEL_INC_AND_TEST(r->next_clabel);
-
-				ci->expires = old_expires;
-
-				if ( (c=mem_insert_ucontact(r, &contact, ci)) == 0) {
-					LM_ERR("inserting contact failed\n"
-							"Found a bad contact with id:[%" PRIu64 "] "
-							"aor:[%.*s] contact:[%.*s] received:[%.*s]!\n"
-							"Will continue but that contact needs to be REMOVED!!\n",
-							ci->contact_id,
-							r->aor.len, r->aor.s,
-							contact.len, contact.s,
-							ci->received.len, ci->received.s);
-					unlock_udomain(_d, &user);
-					free_ucontact(c);
-					continue;
-				}
-
-				/* mark for database insertion */
-				c->state = CS_NEW;
-
-				LM_DBG("regenerated contact id to %"PRIu64"\n", ci->contact_id);
-			}
-
-			unlock_udomain(_d, &user);
-		}
+		ul_preload_progress(RES_ROW_N(res), loaded, suggest_regen);
 
 		if (DB_CAPABILITY(ul_dbf, DB_CAP_FETCH)) {
 			if(ul_dbf.fetch_result(_c, &res, no_rows)<0) {
 				LM_ERR("fetching rows (1) failed\n");
-				ul_dbf.free_result(_c, res);
-				return -1;
+				goto error;
 			}
 		} else {
 			break;
@@ -997,6 +1119,28 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 	} while(RES_ROW_N(res)>0);
 
 	ul_dbf.free_result(_c, res);
+	if (rows)
+		pkg_free(rows);
+
+#ifdef EXTRA_DEBUG
+	LM_NOTICE("load end time [%d]\n", (int)time(NULL));
+#endif
+
+	return 0;
+error:
+	ul_dbf.free_result(_c, res);
+	if (rows)
+		pkg_free(rows);
+	return -1;
+}
+
+
+/*! \brief
+ * Completes the preload of a domain, once all its ranges are loaded
+ */
+void preload_udomain_done(udomain_t* _d, int suggest_regen)
+{
+	int sl;
 
 	if ( suggest_regen ) {
 		LM_NOTICE("At least 1 contact(s) from the database has invalid contact_id!\n"
@@ -1014,15 +1158,6 @@ int preload_udomain(db_con_t* _c, udomain_t* _d)
 		if (_d->table[sl].next_label == 0)
 			_d->table[sl].next_label = rand();
 	}
-
-#ifdef EXTRA_DEBUG
-	LM_NOTICE("load end time [%d]\n", (int)time(NULL));
-#endif
-
-	return 0;
-error:
-	ul_dbf.free_result(_c, res);
-	return -1;
 }
 
 
@@ -1431,34 +1566,33 @@ void mem_delete_urecord(udomain_t* _d, struct urecord* _r)
 int mem_timer_udomain(udomain_t* _d)
 {
 	struct urecord* ptr;
-	void ** dest;
 	int i,ret=0,flush=0;
-	map_iterator_t it,prev;
+	slot_iterator_t it,prev;
 
 	cid_len = 0;
 	for(i=0; i<_d->size; i++)
 	{
 		lock_ulslot(_d, i);
 
-		map_first(_d->table[i].records,&it);
+		slot_first(&_d->table[i], &it);
 
-		while(iterator_is_valid(&it))
+		while(slot_it_valid(&it))
 		{
 
-			dest = iterator_val(&it);
-			if( dest == NULL ) {
+			ptr = slot_it_val(&it);
+			if( ptr == NULL ) {
 				unlock_ulslot(_d, i);
+				db_wb_flush();
 				return -1;
 			}
 
-			ptr = (struct urecord *)*dest;
-
 			prev = it;
-			iterator_next(&it);
+			slot_it_next(&it);
 
 			if ((ret =timer_urecord(ptr,&_d->ins_list)) < 0) {
 				LM_ERR("timer_urecord failed\n");
 				unlock_ulslot(_d, i);
+				db_wb_flush();
 				return -1;
 			}
 
@@ -1478,14 +1612,20 @@ int mem_timer_udomain(udomain_t* _d)
 						       ptr->aor.len, ptr->aor.s);
 				}
 
-				iterator_delete(&prev);
+				slot_it_delete(&prev);
 				mem_delete_urecord(_d, ptr);
 			}
 		}
 
 		unlock_ulslot(_d, i);
+
+		if (db_wb_full() && db_wb_flush() < 0)
+			LM_ERR("failed to flush contacts to DB\n");
 	}
 
+	if (db_wb_flush() < 0)
+		LM_ERR("failed to flush contacts to DB\n");
+
 	/* delete all the contacts left pending in the "to-be-delete" buffer */
 	if (cid_len &&
 	db_multiple_ucontact_delete(_d->name, cid_keys, cid_vals, cid_len) < 0) {
@@ -1666,7 +1806,7 @@ int insert_urecord(udomain_t* _d, str* _aor, struct urecord** _r,
 				       _aor->len, _aor->s);
 			}
 
-			if (location_cluster)
+			if (location_cluster || have_file_persistency())
 				replicate_urecord_insert(*_r);
 		}
 	} else {
@@ -1682,13 +1822,11 @@ int insert_urecord(udomain_t* _d, str* _aor, struct urecord** _r,
 static inline urecord_t *find_mem_urecord(udomain_t *_d, const str *_aor)
 {
 	unsigned int sl, aorhash;
-	urecord_t **r;
 
 	aorhash = core_hash(_aor, 0, 0);
 	sl = aorhash & (_d->size - 1);
 
-	r = (urecord_t **)map_find(_d->table[sl].records, *_aor);
-	return r ? *r : NULL;
+	return slot_find(&_d->table[sl], _aor, aorhash);
 }
 
 /*! \brief
@@ -1828,7 +1966,7 @@ int delete_urecord(udomain_t* _d, str* _aor, struct urecord* _r,
 	if (_r->no_clear_ref > 0)
 		return 0;
 
-	if (!is_replicated && location_cluster)
+	if (!is_replicated && (location_cluster || have_file_persistency()))
 		replicate_urecord_delete(_r);
 
 	release_urecord(_r, is_replicated);
@@ -83,9 +83,15 @@ void free_udomain(udomain_t* _d);
 
 
 /*! \brief
- * Load data from a database
+ * Load data from a database: the "part"-th of "parts" contact_id ranges
  */
-int preload_udomain(db_con_t* _c, udomain_t* _d);
+int preload_udomain(db_con_t* _c, udomain_t* _d, int part, int parts);
+
+
+/*! \brief
+ * Complete the load of a domain, after all its ranges were loaded
+ */
+void preload_udomain_done(udomain_t* _d, int suggest_regen);
 
 
 /*! \brief
@@ -113,7 +113,7 @@ static inline void print_udomain(udomain_t* _d)
 {
 	int i;
 	int max=0, slot=0, n=0,count;
-	map_iterator_t it;
+	slot_iterator_t it;
 	LM_GEN1(L_DBG, "---Domain---\n");
 	LM_GEN1(L_DBG, "name : '%.*s'\n", _d->name->len, ZSW(_d->name->s));
 	LM_GEN1(L_DBG, "size : %d\n", _d->size);
@@ -122,17 +122,17 @@ static inline void print_udomain(udomain_t* _d)
 	LM_GEN1(L_DBG, "\n");
 	for(i=0; i<_d->size; i++)
 	{
-		count = map_size( _d->table[i].records);
+		count = slot_size(&_d->table[i]);
 		n += count;
 		if(max<count){
 			max= count;
 			slot = i;
 		}
 
-		for ( map_first( _d->table[i].records, &it);
-			iterator_is_valid(&it);
-			iterator_next(&it) )
-			print_urecord((struct urecord *)*iterator_val(&it));
+		for ( slot_first( &_d->table[i], &it);
+			slot_it_valid(&it);
+			slot_it_next(&it) )
+			print_urecord(slot_it_val(&it));
 	}
 
 	LM_GEN1(L_DBG, "\nMax slot: %d (%d/%d)\n", max, slot, n);
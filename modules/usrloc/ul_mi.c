@@ -46,6 +46,7 @@
 #include "usrloc.h"
 #include "ureplication.h"
 #include "kv_store.h"
+#include "ul_preload.h"
 
 
 #define MI_UL_CSEQ 1
@@ -384,8 +385,7 @@ struct mi_root* mi_usrloc_dump(struct mi_root *cmd, void *param)
 	int n;
 	int i;
 	int short_dump;
-	map_iterator_t it;
-	void ** dest;
+	slot_iterator_t it;
 
 	node = cmd->node.kids;
 	if (node && node->next)
@@ -424,14 +424,13 @@ struct mi_root* mi_usrloc_dump(struct mi_root *cmd, void *param)
 		for(i=0,n=0; i<dom->size; i++) {
 			lock_ulslot( dom, i);
 
-			for ( map_first( dom->table[i].records, &it);
-				iterator_is_valid(&it);
-				iterator_next(&it) ) {
+			for ( slot_first( &dom->table[i], &it);
+				slot_it_valid(&it);
+				slot_it_next(&it) ) {
 
-				dest = iterator_val(&it);
-				if( dest == NULL )
+				r = slot_it_val(&it);
+				if( r == NULL )
 					goto error_unlock;
-				r =( urecord_t * ) *dest;
 
 
 				/* add entry */
@@ -659,13 +658,12 @@ error:
 	return 0;
 }
 
-static int mi_process_sync(void *param, str key, void *value)
+static int mi_process_sync(struct urecord* rec)
 {
 	struct ucontact* c;
-	struct urecord* rec = (struct urecord *)value;
 
 	if (!rec) {
-		LM_ERR("invalid record value for key '%.*s'\n", key.len, key.s);
+		LM_ERR("invalid record value\n");
 		return -1;
 	}
 
@@ -678,6 +676,7 @@ static int mi_process_sync(void *param, str key, void *value)
 static struct mi_root * mi_sync_domain(udomain_t *dom)
 {
 	int i;
+	slot_iterator_t it;
 	static db_ps_t my_ps = NULL;
 
 	/* delete whole table */
@@ -696,9 +695,12 @@ static struct mi_root * mi_sync_domain(udomain_t *dom)
 	for(i=0; i < dom->size; i++) {
 		lock_ulslot(dom, i);
 
-		if (map_for_each(dom->table[i].records, mi_process_sync, 0)) {
-			LM_ERR("cannot process sync\n");
-			goto error;
+		for (slot_first(&dom->table[i], &it); slot_it_valid(&it);
+		slot_it_next(&it)) {
+			if (mi_process_sync(slot_it_val(&it))) {
+				LM_ERR("cannot process sync\n");
+				goto error;
+			}
 		}
 
 		unlock_ulslot(dom, i);
@@ -724,7 +726,7 @@ static struct mi_root* mi_sync_aor(udomain_t *dom, str *aor)
 		goto error;
 	}
 
-	if (mi_process_sync(dom, *aor, rec))
+	if (mi_process_sync(rec))
 		goto error;
 
 	unlock_udomain( dom, aor);
@@ -780,3 +782,58 @@ struct mi_root* mi_usrloc_cl_sync(struct mi_root *cmd, void *param)
 	else
 		return init_mi_tree(200, MI_SSTR(MI_OK));
 }
+
+
+/*! \brief
+ * Progress of the preload from SQL
+ */
+struct mi_root* mi_usrloc_preload(struct mi_root *cmd, void *param)
+{
+	static const str states[] = {
+		str_init("none"), str_init("pending"), str_init("running"),
+		str_init("done"),
+	};
+	struct ul_preload p;
+	struct mi_root *rpl_tree;
+	struct mi_node *rpl;
+
+	if (!ul_preload) {
+		memset(&p, 0, sizeof p);
+	} else {
+		lock_get(&ul_preload->lock);
+		p = *ul_preload;
+		lock_release(&ul_preload->lock);
+
+		if (p.state == UL_PRELOAD_RUNNING)
+			p.duration = get_uticks() - p.start;
+	}
+
+	rpl_tree = init_mi_tree( 200, MI_SSTR(MI_OK));
+	if (rpl_tree==NULL)
+		return NULL;
+	rpl = &rpl_tree->node;
+
+	if (!add_mi_node_child( rpl, 0, "State", 5, states[p.state].s,
+	states[p.state].len))
+		goto error;
+	if (!add_mi_node_child( rpl, 0, "Ready", 5,
+	ul_preload_ready() ? "yes" : "no", ul_preload_ready() ? 3 : 2))
+		goto error;
+	if (!addf_mi_node_child( rpl, 0, "Jobs", 4, "%d/%d",
+	p.jobs_done, p.jobs))
+		goto error;
+	if (!addf_mi_node_child( rpl, 0, "Failed", 6, "%d", p.jobs_failed))
+		goto error;
+	if (!addf_mi_node_child( rpl, 0, "Rows", 4, "%lu", p.rows))
+		goto error;
+	if (!addf_mi_node_child( rpl, 0, "Contacts", 8, "%lu", p.contacts))
+		goto error;
+	if (!addf_mi_node_child( rpl, 0, "Duration", 8, "%llu ms",
+	(unsigned long long)p.duration / 1000))
+		goto error;
+
+	return rpl_tree;
+error:
+	free_mi_tree(rpl_tree);
+	return NULL;
+}
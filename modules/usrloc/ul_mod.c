@@ -58,6 +58,8 @@
 #include "ureplication.h"
 #include "ul_mi.h"
 #include "ul_callback.h"
+#include "ul_preload.h"
+#include "ul_persist.h"
 #include "usrloc.h"
 
 
@@ -152,6 +154,7 @@ int use_domain      = 0;   /*!< Whether usrloc should use domain part of aor */
 int desc_time_order = 0;   /*!< By default do not enable timestamp ordering */
 
 int ul_hash_size = 9;
+static char *aor_index_str;
 
 /* flag */
 unsigned int nat_bflag = (unsigned int)-1;
@@ -233,6 +236,7 @@ static param_export_t params[] = {
 	{"matching_mode",      INT_PARAM, &matching_mode     },
 	{"cseq_delay",         INT_PARAM, &cseq_delay        },
 	{"hash_size",          INT_PARAM, &ul_hash_size      },
+	{"aor_index",          STR_PARAM, &aor_index_str     },
 	{"nat_bflag",          STR_PARAM, &nat_bflag_str     },
 	{"nat_bflag",          INT_PARAM, &nat_bflag         },
     /* data replication through clusterer using TCP binary packets */
@@ -240,12 +244,33 @@ static param_export_t params[] = {
 	{ "skip_replicated_db_ops", INT_PARAM, &skip_replicated_db_ops   },
 	{ "max_contact_delete", INT_PARAM, &max_contact_delete },
 	{ "regen_broken_contactid", INT_PARAM, &cid_regen},
+	{ "preload_workers",    INT_PARAM, &preload_workers },
+	{ "sql_batch_size",     INT_PARAM, &sql_batch_size },
+	{ "persist_file",       STR_PARAM, &persist_file },
+	{ "persist_interval",   INT_PARAM, &persist_interval },
 	{0, 0, 0}
 };
 
 
+static unsigned long get_sql_rows_per_statement(void *unused)
+{
+	unsigned long statements = get_stat_val(sql_flush_statements);
+
+	return statements ? get_stat_val(sql_flush_rows) / statements : 0;
+}
+
+static unsigned long get_sql_flush_latency(void *unused)
+{
+	return sql_flush_latency ? (unsigned long)*sql_flush_latency : 0;
+}
+
 static stat_export_t mod_stats[] = {
 	{"registered_users" ,  STAT_IS_FUNC, (stat_var**)get_number_of_users  },
+	{"sql_flush_statements", 0,        &sql_flush_statements           },
+	{"sql_flush_rows",       0,        &sql_flush_rows                 },
+	{"sql_rows_per_statement", STAT_IS_FUNC,
+		(stat_var**)get_sql_rows_per_statement },
+	{"sql_flush_latency",  STAT_IS_FUNC, (stat_var**)get_sql_flush_latency },
 	{0,0,0}
 };
 
@@ -267,6 +292,8 @@ static mi_export_t mi_cmds[] = {
 				mi_child_init },
 	{ MI_USRLOC_CL_SYNC,      0, mi_usrloc_cl_sync,      MI_NO_INPUT_FLAG,  0,
 				mi_child_init },
+	{ MI_USRLOC_PRELOAD,      0, mi_usrloc_preload,      MI_NO_INPUT_FLAG,  0,
+				0             },
 	{ 0, 0, 0, 0, 0, 0}
 };
 
@@ -380,6 +407,17 @@ static int mod_init(void)
 		ul_hash_size = 1<<ul_hash_size;
 	ul_locks_no = ul_hash_size;
 
+	if (aor_index_str) {
+		if (!strcasecmp(aor_index_str, "avl")) {
+			ul_aor_index = UL_AOR_INDEX_AVL;
+		} else if (!strcasecmp(aor_index_str, "open-addressing")) {
+			ul_aor_index = UL_AOR_INDEX_OPEN;
+		} else {
+			LM_ERR("invalid aor_index: '%s'\n", aor_index_str);
+			return -1;
+		}
+	}
+
 	if (check_runtime_config() != 0) {
 		LM_ERR("bad runtime config - exiting...\n");
 		return -1;
@@ -465,9 +503,28 @@ static int mod_init(void)
 				LM_ERR("cannot init rw lock\n");
 				return -1;
 			}
+
+			if (ul_preload_init() < 0) {
+				LM_ERR("failed to init the preload\n");
+				return -1;
+			}
+
+			if (sql_wmode == SQL_WRITE_BACK) {
+				sql_flush_latency = shm_malloc(sizeof *sql_flush_latency);
+				if (!sql_flush_latency) {
+					LM_ERR("no more shm memory\n");
+					return -1;
+				}
+				*sql_flush_latency = 0;
+			}
 		}
 	}
 
+	if (have_file_persistency() && ul_persist_init() < 0) {
+		LM_ERR("failed to init the file persistency\n");
+		return -1;
+	}
+
 	fix_flag_name(nat_bflag_str, nat_bflag);
 
 	nat_bflag = get_flag_id_by_name(FLAG_TYPE_BRANCH, nat_bflag_str);
@@ -522,15 +579,12 @@ static int mod_init(void)
 
 static void ul_rpc_data_load(int sender_id, void *unsused)
 {
-	dlist_t* ptr;
+	ul_preload_start();
+}
 
-	for( ptr=root ; ptr ; ptr=ptr->next) {
-		if (preload_udomain(ul_dbh, ptr->d) < 0) {
-			LM_ERR("failed to preload domain '%.*s'\n",
-				ptr->name.len, ZSW(ptr->name.s));
-			/* continue with the other ul domains */;
-		}
-	}
+static void ul_rpc_file_load(int sender_id, void *unsused)
+{
+	ul_persist_load();
 }
 
 int init_cachedb(void)
@@ -557,6 +611,13 @@ static int child_init(int _rank)
 	    return -1;
 	}
 
+	/* _rank==1 is used even when fork is disabled */
+	if (_rank==1 && have_file_persistency() &&
+	    ipc_send_rpc(process_no, ul_rpc_file_load, NULL) < 0) {
+		LM_ERR("failed to fire RPC for file load\n");
+		return -1;
+	}
+
 	if (!have_db_conns())
 		return 0;
 
@@ -635,6 +696,8 @@ static void destroy(void)
 
 	free_all_udomains();
 	ul_destroy_locks();
+	ul_preload_destroy();
+	ul_persist_destroy();
 
 	/* free callbacks list */
 	destroy_ulcb_list();
@@ -751,6 +814,8 @@ int check_runtime_config(void)
 				rr_persist = RRP_LOAD_FROM_SQL;
 			} else if (!strcasecmp(rr_persist_str, "sync-from-cluster")) {
 				rr_persist = RRP_SYNC_FROM_CLUSTER;
+			} else if (!strcasecmp(rr_persist_str, "load-from-file")) {
+				rr_persist = RRP_LOAD_FROM_FILE;
 			} else {
 				LM_ERR("invalid restart_persistency: '%s'\n", rr_persist_str);
 				return -1;
@@ -47,8 +47,9 @@ typedef enum ul_rr_persist {
 	RRP_NONE,
 	RRP_LOAD_FROM_SQL,
 	RRP_SYNC_FROM_CLUSTER,
+	RRP_LOAD_FROM_FILE,
 } ul_rr_persist_t;
-#define bad_rr_persist(rrp) ((rrp) < RRP_NONE || (rrp) > RRP_SYNC_FROM_CLUSTER)
+#define bad_rr_persist(rrp) ((rrp) < RRP_NONE || (rrp) > RRP_LOAD_FROM_FILE)
 
 /* if using SQL for restart persistency,
  * should runtime SQL blocking writes be performed eagerly or lazily? */
@@ -82,6 +83,8 @@ static inline int have_mem_storage(void)
 	 cluster_mode == CM_FEDERATION || \
 	 cluster_mode == CM_FULL_SHARING)
 
+#define have_file_persistency() (rr_persist == RRP_LOAD_FROM_FILE)
+
 /*
  * Module parameters
  */
@@ -0,0 +1,188 @@
+/*
+ * Usrloc persistence to a local snapshot file
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - persistence to a local snapshot file
+ *  \ingroup usrloc
+ */
+
+#include "../../bin_persist.h"
+#include "../../dprint.h"
+#include "../../timer.h"
+#include "ul_persist.h"
+#include "ul_mod.h"
+#include "ureplication.h"
+#include "dlist.h"
+#include "udomain.h"
+
+char *persist_file;
+int persist_interval = 60;
+
+static bin_persist_t *ul_bp;
+
+
+static int ul_persist_apply(bin_packet_t *packet, void *param)
+{
+	str cap;
+
+	bin_get_capability(packet, &cap);
+	if (str_strcmp(&cap, &contact_repl_cap) != 0 ||
+	    get_bin_pkg_version(packet) != UL_BIN_VERSION) {
+		LM_INFO("discarding packet type %d, ver %d: need ver %d\n",
+		        packet->type, get_bin_pkg_version(packet), UL_BIN_VERSION);
+		return -1;
+	}
+
+	return receive_ul_packet(packet);
+}
+
+
+/* one packet per record, then one per contact, all slots locked in turn */
+static int ul_persist_dump(bin_persist_t *bp, void *param)
+{
+	bin_packet_t r_packet, c_packet;
+	dlist_t *dl;
+	udomain_t *dom;
+	slot_iterator_t it;
+	urecord_t *r;
+	ucontact_t *c;
+	unsigned long records = 0, contacts = 0;
+	int i, rc = -1;
+
+	if (bin_init(&r_packet, &contact_repl_cap, REPL_URECORD_INSERT,
+	             UL_BIN_VERSION, 0) != 0)
+		return -1;
+
+	if (bin_init(&c_packet, &contact_repl_cap, REPL_UCONTACT_UPDATE,
+	             UL_BIN_VERSION, 0) != 0) {
+		bin_free_packet(&r_packet);
+		return -1;
+	}
+
+	for (dl = root; dl; dl = dl->next) {
+		dom = dl->d;
+		for (i = 0; i < dom->size; i++) {
+			lock_ulslot(dom, i);
+			for (slot_first(&dom->table[i], &it);
+				slot_it_valid(&it);
+				slot_it_next(&it)) {
+
+				r = slot_it_val(&it);
+				if (r == NULL)
+					goto error_unlock;
+
+				bin_reset_back_pointer(&r_packet);
+				bin_push_urecord(&r_packet, r);
+				if (bin_persist_write(bp, &r_packet) < 0)
+					goto error_unlock;
+				records++;
+
+				for (c = r->contacts; c; c = c->next) {
+					bin_reset_back_pointer(&c_packet);
+					bin_push_ucontact_update(&c_packet, r, c);
+					if (bin_persist_write(bp, &c_packet) < 0)
+						goto error_unlock;
+					contacts++;
+				}
+			}
+			unlock_ulslot(dom, i);
+		}
+	}
+
+	LM_DBG("dumped %lu records, %lu contacts\n", records, contacts);
+	rc = 0;
+	goto out;
+
+error_unlock:
+	unlock_ulslot(dom, i);
+out:
+	bin_free_packet(&r_packet);
+	bin_free_packet(&c_packet);
+	return rc;
+}
+
+
+static void ul_persist_timer(unsigned int ticks, void *param)
+{
+	if (bin_persist_snapshot(ul_bp, ul_persist_dump, NULL) < 0)
+		LM_ERR("failed to write the usrloc snapshot\n");
+}
+
+
+int ul_persist_init(void)
+{
+	if (!persist_file || !*persist_file) {
+		LM_ERR("the 'load-from-file' restart persistency requires "
+		       "a 'persist_file'\n");
+		return -1;
+	}
+
+	if (persist_interval <= 0) {
+		LM_ERR("invalid persist_interval %d, must be positive\n",
+		       persist_interval);
+		return -1;
+	}
+
+	ul_bp = bin_persist_init(persist_file);
+	if (!ul_bp) {
+		LM_ERR("failed to init the persistence to %s\n", persist_file);
+		return -1;
+	}
+
+	if (register_timer("ul-persist", ul_persist_timer, NULL,
+	    persist_interval, TIMER_FLAG_SKIP_ON_DELAY) < 0) {
+		LM_ERR("failed to register the snapshot timer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void ul_persist_destroy(void)
+{
+	bin_persist_destroy(ul_bp);
+	ul_bp = NULL;
+}
+
+
+void ul_persist_load(void)
+{
+	utime_t start = get_uticks();
+	int n;
+
+	n = bin_persist_load(ul_bp, ul_persist_apply, NULL);
+	if (n < 0) {
+		LM_ERR("failed to load the location data from %s\n", persist_file);
+		return;
+	}
+
+	LM_INFO("loaded %d records/contacts changes from %s in %llu ms\n", n,
+		persist_file, (unsigned long long)(get_uticks() - start) / 1000);
+}
+
+
+void ul_persist_journal(bin_packet_t *packet)
+{
+	if (ul_bp && bin_persist_journal(ul_bp, packet) < 0)
+		LM_ERR("failed to journal a location change\n");
+}
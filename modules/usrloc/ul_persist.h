@@ -0,0 +1,50 @@
+/*
+ * Usrloc persistence to a local snapshot file
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - persistence to a local snapshot file
+ *  \ingroup usrloc
+ *
+ * With the "load-from-file" restart persistency, the records and contacts
+ * are periodically dumped into "persist_file", while each change done in
+ * between is journaled in the format it is replicated in. At startup, the
+ * first SIP worker loads the snapshot and replays the journal.
+ */
+
+#ifndef _USRLOC_PERSIST_H_
+#define _USRLOC_PERSIST_H_
+
+#include "../../bin_interface.h"
+
+extern char *persist_file;
+extern int persist_interval;
+
+int ul_persist_init(void);
+void ul_persist_destroy(void);
+
+/* loads the snapshot and the journal (SIP worker only) */
+void ul_persist_load(void);
+
+/* journals a change, if the file persistency is on */
+void ul_persist_journal(bin_packet_t *packet);
+
+#endif /* _USRLOC_PERSIST_H_ */
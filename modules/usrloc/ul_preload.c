@@ -0,0 +1,245 @@
+/*
+ * Usrloc parallel preload from SQL
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - parallel preload from SQL
+ *  \ingroup usrloc
+ */
+
+#include <string.h>
+
+#include "../../mem/shm_mem.h"
+#include "../../dprint.h"
+#include "../../ipc.h"
+#include "../../pt.h"
+#include "../../evi/evi_modules.h"
+#include "../../evi/evi_params.h"
+#include "ul_preload.h"
+#include "ul_mod.h"
+#include "dlist.h"
+#include "udomain.h"
+
+struct ul_preload *ul_preload;
+
+/* number of contact_id ranges each domain table is loaded in */
+int preload_workers = 1;
+
+struct preload_job {
+	udomain_t *d;
+	int part;
+};
+
+static event_id_t ei_preload_id = EVI_ERROR;
+static str ei_preload_name = str_init("E_UL_PRELOAD");
+static str ei_state_name = str_init("state");
+static str ei_jobs_name = str_init("jobs");
+static str ei_jobs_done_name = str_init("jobs_done");
+static str ei_rows_name = str_init("rows");
+static str ei_contacts_name = str_init("contacts");
+static str ei_running = str_init("running");
+static str ei_done = str_init("done");
+
+
+int ul_preload_init(void)
+{
+	if (preload_workers < 1) {
+		LM_ERR("invalid preload_workers %d, must be at least 1\n",
+		       preload_workers);
+		return -1;
+	}
+
+	ul_preload = shm_malloc(sizeof *ul_preload);
+	if (!ul_preload) {
+		LM_ERR("no more shm memory\n");
+		return -1;
+	}
+	memset(ul_preload, 0, sizeof *ul_preload);
+
+	if (!lock_init(&ul_preload->lock)) {
+		LM_ERR("failed to init preload lock\n");
+		shm_free(ul_preload);
+		ul_preload = NULL;
+		return -1;
+	}
+	ul_preload->state = UL_PRELOAD_PENDING;
+
+	ei_preload_id = evi_publish_event(ei_preload_name);
+	if (ei_preload_id == EVI_ERROR) {
+		LM_ERR("cannot register preload event\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void ul_preload_destroy(void)
+{
+	if (!ul_preload)
+		return;
+
+	lock_destroy(&ul_preload->lock);
+	shm_free(ul_preload);
+	ul_preload = NULL;
+}
+
+
+static void ul_raise_preload_event(int done, int jobs, int jobs_done,
+		int rows, int contacts)
+{
+	evi_params_p list;
+
+	if (ei_preload_id == EVI_ERROR || !evi_probe_event(ei_preload_id))
+		return;
+
+	if (!(list = evi_get_params()))
+		return;
+
+	if (evi_param_add_str(list, &ei_state_name,
+	        done ? &ei_done : &ei_running) ||
+	    evi_param_add_int(list, &ei_jobs_name, &jobs) ||
+	    evi_param_add_int(list, &ei_jobs_done_name, &jobs_done) ||
+	    evi_param_add_int(list, &ei_rows_name, &rows) ||
+	    evi_param_add_int(list, &ei_contacts_name, &contacts)) {
+		LM_ERR("cannot add preload event parameters\n");
+		evi_free_params(list);
+		return;
+	}
+
+	if (evi_raise_event(ei_preload_id, list) < 0)
+		LM_ERR("cannot raise preload event\n");
+}
+
+
+/* accounts a finished job; the last one completes the preload */
+static void ul_preload_job_end(int failed)
+{
+	int jobs, jobs_done, jobs_failed, rows, contacts, suggest_regen;
+	dlist_t *ptr;
+
+	lock_get(&ul_preload->lock);
+	if (failed)
+		ul_preload->jobs_failed++;
+	jobs = ul_preload->jobs;
+	jobs_done = ++ul_preload->jobs_done;
+	jobs_failed = ul_preload->jobs_failed;
+	rows = (int)ul_preload->rows;
+	contacts = (int)ul_preload->contacts;
+	suggest_regen = ul_preload->suggest_regen;
+	lock_release(&ul_preload->lock);
+
+	LM_DBG("preload job %d/%d done (%d rows, %d contacts)\n",
+		jobs_done, jobs, rows, contacts);
+
+	if (jobs_done != jobs) {
+		ul_raise_preload_event(0, jobs, jobs_done, rows, contacts);
+		return;
+	}
+
+	for (ptr = root; ptr; ptr = ptr->next)
+		preload_udomain_done(ptr->d, suggest_regen);
+
+	lock_get(&ul_preload->lock);
+	ul_preload->duration = get_uticks() - ul_preload->start;
+	ul_preload->state = UL_PRELOAD_DONE;
+	lock_release(&ul_preload->lock);
+
+	LM_INFO("loaded %d contacts from %d rows in %llu ms (%d jobs, "
+		"%d failed)\n", contacts, rows,
+		(unsigned long long)ul_preload->duration / 1000, jobs, jobs_failed);
+
+	ul_raise_preload_event(1, jobs, jobs_done, rows, contacts);
+}
+
+
+static void ul_preload_job(int sender, void *param)
+{
+	struct preload_job *job = (struct preload_job *)param;
+	int failed = 0;
+
+	if (preload_udomain(ul_dbh, job->d, job->part, preload_workers) < 0) {
+		LM_ERR("failed to preload part %d/%d of domain '%.*s'\n",
+			job->part + 1, preload_workers,
+			job->d->name->len, ZSW(job->d->name->s));
+		/* continue with the other ranges and domains */
+		failed = 1;
+	}
+	shm_free(job);
+
+	ul_preload_job_end(failed);
+}
+
+
+void ul_preload_start(void)
+{
+	struct preload_job *job;
+	dlist_t *ptr;
+	int jobs = 0, part;
+
+	for (ptr = root; ptr; ptr = ptr->next)
+		jobs += preload_workers;
+
+	lock_get(&ul_preload->lock);
+	ul_preload->jobs = jobs;
+	ul_preload->start = get_uticks();
+	ul_preload->state = jobs ? UL_PRELOAD_RUNNING : UL_PRELOAD_DONE;
+	lock_release(&ul_preload->lock);
+
+	for (ptr = root; ptr; ptr = ptr->next) {
+		for (part = 0; part < preload_workers; part++) {
+			job = shm_malloc(sizeof *job);
+			if (!job) {
+				LM_ERR("no more shm memory\n");
+				ul_preload_job_end(1);
+				continue;
+			}
+			job->d = ptr->d;
+			job->part = part;
+
+			/* a single range is loaded by the current worker */
+			if (preload_workers == 1 ||
+			    ipc_dispatch_rpc(ul_preload_job, job) < 0)
+				ul_preload_job(process_no, job);
+		}
+	}
+}
+
+
+void ul_preload_progress(unsigned long rows, unsigned long contacts,
+		int suggest_regen)
+{
+	if (!ul_preload)
+		return;
+
+	lock_get(&ul_preload->lock);
+	ul_preload->rows += rows;
+	ul_preload->contacts += contacts;
+	if (suggest_regen)
+		ul_preload->suggest_regen = 1;
+	lock_release(&ul_preload->lock);
+}
+
+
+int ul_preload_ready(void)
+{
+	return !ul_preload || ul_preload->state == UL_PRELOAD_DONE;
+}
@@ -0,0 +1,75 @@
+/*
+ * Usrloc parallel preload from SQL
+ *
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - parallel preload from SQL
+ *  \ingroup usrloc
+ *
+ * Each domain table is split into "preload_workers" contact_id ranges.
+ * The ranges are dispatched as IPC jobs to the SIP workers, which stream
+ * their rows in pages and load them into memory; the last finished job
+ * declares the location data ready.
+ */
+
+#ifndef _USRLOC_PRELOAD_H_
+#define _USRLOC_PRELOAD_H_
+
+#include "../../locking.h"
+#include "../../timer.h"
+
+enum ul_preload_state {
+	UL_PRELOAD_NONE,     /* nothing to load, the data is ready */
+	UL_PRELOAD_PENDING,  /* waiting for the SIP workers to start */
+	UL_PRELOAD_RUNNING,
+	UL_PRELOAD_DONE,
+};
+
+struct ul_preload {
+	gen_lock_t lock;
+	enum ul_preload_state state;
+	int jobs;
+	int jobs_done;
+	int jobs_failed;
+	unsigned long rows;
+	unsigned long contacts;
+	int suggest_regen;
+	utime_t start;
+	utime_t duration;
+};
+
+extern struct ul_preload *ul_preload;
+extern int preload_workers;
+
+int ul_preload_init(void);
+void ul_preload_destroy(void);
+
+/* splits the preload into jobs and dispatches them (SIP worker only) */
+void ul_preload_start(void);
+
+/* accounts a loaded page of rows */
+void ul_preload_progress(unsigned long rows, unsigned long contacts,
+		int suggest_regen);
+
+/* whether the location data may be served (the preload is over) */
+int ul_preload_ready(void);
+
+#endif /* _USRLOC_PRELOAD_H_ */
@@ -368,6 +368,9 @@ static inline int wb_timer(urecord_t* _r,query_list_t **ins_list)
 				break;
 
 			case 1: /* insert */
+				if (ins_list && db_wb_add_ucontact(_r->slot->d, ptr, op) == 0)
+					break;
+
 				if (db_insert_ucontact(ptr,ins_list,0) < 0) {
 					LM_ERR("inserting contact into database failed\n");
 					ptr->state = old_state;
@@ -377,6 +380,9 @@ static inline int wb_timer(urecord_t* _r,query_list_t **ins_list)
 				break;
 
 			case 2: /* update */
+				if (ins_list && db_wb_add_ucontact(_r->slot->d, ptr, op) == 0)
+					break;
+
 				if (db_update_ucontact(ptr) < 0) {
 					LM_ERR("updating contact in db failed\n");
 					ptr->state = old_state;
@@ -764,7 +770,8 @@ void release_urecord(urecord_t* _r, char is_replicated)
 		if (exists_ulcb_type(UL_AOR_DELETE))
 			run_ul_callbacks(UL_AOR_DELETE, _r);
 
-		if (!is_replicated && location_cluster) {
+		if (!is_replicated &&
+		    (location_cluster || have_file_persistency())) {
 			if (cluster_mode == CM_FEDERATION_CACHEDB &&
 			    cdb_update_urecord_metadata(&_r->aor, 1) != 0)
 				LM_ERR("failed to delete metadata, aor: %.*s\n",
@@ -801,7 +808,8 @@ int insert_ucontact(urecord_t* _r, str* _contact, ucontact_info_t* _ci,
 		return -1;
 	}
 
-	if (!is_replicated && have_data_replication())
+	if (!is_replicated &&
+	    (have_data_replication() || have_file_persistency()))
 		replicate_ucontact_insert(_r, _contact, *_c);
 
 	if (exists_ulcb_type(UL_CONTACT_INSERT))
@@ -830,7 +838,8 @@ int insert_ucontact(urecord_t* _r, str* _contact, ucontact_info_t* _ci,
  */
 int delete_ucontact(urecord_t* _r, struct ucontact* _c, char is_replicated)
 {
-	if (!is_replicated && have_data_replication())
+	if (!is_replicated &&
+	    (have_data_replication() || have_file_persistency()))
 		replicate_ucontact_delete(_r, _c);
 
 	if (exists_ulcb_type(UL_CONTACT_DELETE))
@@ -30,6 +30,7 @@
 #include "ul_mod.h"
 #include "dlist.h"
 #include "kv_store.h"
+#include "ul_persist.h"
 
 str contact_repl_cap = str_init("usrloc-contact-repl");
 
@@ -37,7 +38,38 @@ struct clusterer_binds clusterer_api;
 
 /* packet sending */
 
-static inline void bin_push_urecord(bin_packet_t *packet, urecord_t *r)
+/* journals a local change and sends it to the cluster */
+static int ul_replicate_packet(bin_packet_t *packet)
+{
+	int rc;
+
+	ul_persist_journal(packet);
+
+	if (!location_cluster)
+		return 0;
+
+	if (cluster_mode == CM_FEDERATION_CACHEDB)
+		rc = clusterer_api.send_all_having(packet, location_cluster,
+		                                   NODE_CMP_EQ_SIP_ADDR);
+	else
+		rc = clusterer_api.send_all(packet, location_cluster);
+	switch (rc) {
+	case CLUSTERER_CURR_DISABLED:
+		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
+		return -1;
+	case CLUSTERER_DEST_DOWN:
+		LM_INFO("All destinations in cluster: %d are down or probing\n",
+			location_cluster);
+		return -1;
+	case CLUSTERER_SEND_ERR:
+		LM_ERR("Error sending in cluster: %d\n", location_cluster);
+		return -1;
+	}
+
+	return 0;
+}
+
+void bin_push_urecord(bin_packet_t *packet, urecord_t *r)
 {
 	bin_push_str(packet, r->domain);
 	bin_push_str(packet, &r->aor);
@@ -47,7 +79,6 @@ static inline void bin_push_urecord(bin_packet_t *packet, urecord_t *r)
 
 void replicate_urecord_insert(urecord_t *r)
 {
-	int rc;
 	bin_packet_t packet;
 
 	if (bin_init(&packet, &contact_repl_cap, REPL_URECORD_INSERT,
@@ -58,23 +89,8 @@ void replicate_urecord_insert(urecord_t *r)
 
 	bin_push_urecord(&packet, r);
 
-	if (cluster_mode == CM_FEDERATION_CACHEDB)
-		rc = clusterer_api.send_all_having(&packet, location_cluster,
-		                                   NODE_CMP_EQ_SIP_ADDR);
-	else
-		rc = clusterer_api.send_all(&packet, location_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
-		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			location_cluster);
-		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", location_cluster);
+	if (ul_replicate_packet(&packet) != 0)
 		goto error;
-	}
 
 	bin_free_packet(&packet);
 	return;
@@ -86,7 +102,6 @@ error:
 
 void replicate_urecord_delete(urecord_t *r)
 {
-	int rc;
 	bin_packet_t packet;
 
 	if (bin_init(&packet, &contact_repl_cap, REPL_URECORD_DELETE,
@@ -98,23 +113,8 @@ void replicate_urecord_delete(urecord_t *r)
 	bin_push_str(&packet, r->domain);
 	bin_push_str(&packet, &r->aor);
 
-	if (cluster_mode == CM_FEDERATION_CACHEDB)
-		rc = clusterer_api.send_all_having(&packet, location_cluster,
-		                                   NODE_CMP_EQ_SIP_ADDR);
-	else
-		rc = clusterer_api.send_all(&packet, location_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
-		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			location_cluster);
+	if (ul_replicate_packet(&packet) != 0)
 		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", location_cluster);
-		goto error;
-	}
 
 	bin_free_packet(&packet);
 	return;
@@ -164,7 +164,6 @@ void bin_push_contact(bin_packet_t *packet, urecord_t *r, ucontact_t *c)
 
 void replicate_ucontact_insert(urecord_t *r, str *contact, ucontact_t *c)
 {
-	int rc;
 	bin_packet_t packet;
 
 	if (bin_init(&packet, &contact_repl_cap, REPL_UCONTACT_INSERT,
@@ -175,23 +174,8 @@ void replicate_ucontact_insert(urecord_t *r, str *contact, ucontact_t *c)
 
 	bin_push_contact(&packet, r, c);
 
-	if (cluster_mode == CM_FEDERATION_CACHEDB)
-		rc = clusterer_api.send_all_having(&packet, location_cluster,
-		                                   NODE_CMP_EQ_SIP_ADDR);
-	else
-		rc = clusterer_api.send_all(&packet, location_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
-		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			location_cluster);
+	if (ul_replicate_packet(&packet) != 0)
 		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", location_cluster);
-		goto error;
-	}
 
 	bin_free_packet(&packet);
 	return;
@@ -201,72 +185,63 @@ error:
 	bin_free_packet(&packet);
 }
 
-void replicate_ucontact_update(urecord_t *r, ucontact_t *ct)
+void bin_push_ucontact_update(bin_packet_t *packet, urecord_t *r,
+		ucontact_t *ct)
 {
 	str st;
-	int rc;
-	bin_packet_t packet;
 
-	if (bin_init(&packet, &contact_repl_cap, REPL_UCONTACT_UPDATE,
-	             UL_BIN_VERSION, 0) != 0) {
-		LM_ERR("failed to replicate this event\n");
-		return;
-	}
-
-	bin_push_str(&packet, r->domain);
-	bin_push_str(&packet, &r->aor);
-	bin_push_str(&packet, &ct->c);
-	bin_push_str(&packet, &ct->callid);
-	bin_push_str(&packet, &ct->user_agent);
-	bin_push_str(&packet, &ct->path);
-	bin_push_str(&packet, &ct->attr);
-	bin_push_str(&packet, &ct->received);
-	bin_push_str(&packet, &ct->instance);
+	bin_push_str(packet, r->domain);
+	bin_push_str(packet, &r->aor);
+	bin_push_str(packet, &ct->c);
+	bin_push_str(packet, &ct->callid);
+	bin_push_str(packet, &ct->user_agent);
+	bin_push_str(packet, &ct->path);
+	bin_push_str(packet, &ct->attr);
+	bin_push_str(packet, &ct->received);
+	bin_push_str(packet, &ct->instance);
 
 	st.s = (char *) &ct->expires;
 	st.len = sizeof ct->expires;
-	bin_push_str(&packet, &st);
+	bin_push_str(packet, &st);
 
 	st.s = (char *) &ct->q;
 	st.len = sizeof ct->q;
-	bin_push_str(&packet, &st);
+	bin_push_str(packet, &st);
 
-	bin_push_str(&packet, ct->sock?&ct->sock->sock_str:NULL);
-	bin_push_int(&packet, ct->cseq);
-	bin_push_int(&packet, ct->flags);
-	bin_push_int(&packet, ct->cflags);
-	bin_push_int(&packet, ct->methods);
+	bin_push_str(packet, ct->sock?&ct->sock->sock_str:NULL);
+	bin_push_int(packet, ct->cseq);
+	bin_push_int(packet, ct->flags);
+	bin_push_int(packet, ct->cflags);
+	bin_push_int(packet, ct->methods);
 
 	st.s   = (char *)&ct->last_modified;
 	st.len = sizeof ct->last_modified;
-	bin_push_str(&packet, &st);
+	bin_push_str(packet, &st);
 
 	st = store_serialize(ct->kv_storage);
-	bin_push_str(&packet, &st);
+	bin_push_str(packet, &st);
 	store_free_buffer(&st);
 
 	st.s = (char *)&ct->contact_id;
 	st.len = sizeof ct->contact_id;
-	bin_push_str(&packet, &st);
+	bin_push_str(packet, &st);
+}
 
-	if (cluster_mode == CM_FEDERATION_CACHEDB)
-		rc = clusterer_api.send_all_having(&packet, location_cluster,
-		                                   NODE_CMP_EQ_SIP_ADDR);
-	else
-		rc = clusterer_api.send_all(&packet, location_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
-		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			location_cluster);
-		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", location_cluster);
-		goto error;
+void replicate_ucontact_update(urecord_t *r, ucontact_t *ct)
+{
+	bin_packet_t packet;
+
+	if (bin_init(&packet, &contact_repl_cap, REPL_UCONTACT_UPDATE,
+	             UL_BIN_VERSION, 0) != 0) {
+		LM_ERR("failed to replicate this event\n");
+		return;
 	}
 
+	bin_push_ucontact_update(&packet, r, ct);
+
+	if (ul_replicate_packet(&packet) != 0)
+		goto error;
+
 	bin_free_packet(&packet);
 	return;
 
@@ -277,7 +252,6 @@ error:
 
 void replicate_ucontact_delete(urecord_t *r, ucontact_t *c)
 {
-	int rc;
 	bin_packet_t packet;
 
 	if (bin_init(&packet, &contact_repl_cap, REPL_UCONTACT_DELETE,
@@ -292,23 +266,8 @@ void replicate_ucontact_delete(urecord_t *r, ucontact_t *c)
 	bin_push_str(&packet, &c->callid);
 	bin_push_int(&packet, c->cseq);
 
-	if (cluster_mode == CM_FEDERATION_CACHEDB)
-		rc = clusterer_api.send_all_having(&packet, location_cluster,
-		                                   NODE_CMP_EQ_SIP_ADDR);
-	else
-		rc = clusterer_api.send_all(&packet, location_cluster);
-	switch (rc) {
-	case CLUSTERER_CURR_DISABLED:
-		LM_INFO("Current node is disabled in cluster: %d\n", location_cluster);
+	if (ul_replicate_packet(&packet) != 0)
 		goto error;
-	case CLUSTERER_DEST_DOWN:
-		LM_INFO("All destinations in cluster: %d are down or probing\n",
-			location_cluster);
-		goto error;
-	case CLUSTERER_SEND_ERR:
-		LM_ERR("Error sending in cluster: %d\n", location_cluster);
-		goto error;
-	}
 
 	bin_free_packet(&packet);
 	return;
@@ -772,6 +731,25 @@ static int receive_sync_packet(bin_packet_t *packet)
 	return rc;
 }
 
+int receive_ul_packet(bin_packet_t *packet)
+{
+	switch (packet->type) {
+	case REPL_URECORD_INSERT:
+		return receive_urecord_insert(packet);
+	case REPL_URECORD_DELETE:
+		return receive_urecord_delete(packet);
+	case REPL_UCONTACT_INSERT:
+		return receive_ucontact_insert(packet);
+	case REPL_UCONTACT_UPDATE:
+		return receive_ucontact_update(packet);
+	case REPL_UCONTACT_DELETE:
+		return receive_ucontact_delete(packet);
+	}
+
+	LM_ERR("invalid usrloc binary packet type: %d\n", packet->type);
+	return -1;
+}
+
 void receive_binary_packets(bin_packet_t *packet)
 {
 	int rc;
@@ -780,40 +758,16 @@ void receive_binary_packets(bin_packet_t *packet)
 	for (pkt = packet; pkt; pkt = pkt->next) {
 		LM_DBG("received a binary packet [%d]!\n", pkt->type);
 
-		switch (pkt->type) {
-		case REPL_URECORD_INSERT:
-			ensure_bin_version(pkt, UL_BIN_VERSION);
-			rc = receive_urecord_insert(pkt);
-			break;
-
-		case REPL_URECORD_DELETE:
-			ensure_bin_version(pkt, UL_BIN_VERSION);
-			rc = receive_urecord_delete(pkt);
-			break;
-
-		case REPL_UCONTACT_INSERT:
-			ensure_bin_version(pkt, UL_BIN_VERSION);
-			rc = receive_ucontact_insert(pkt);
-			break;
-
-		case REPL_UCONTACT_UPDATE:
-			ensure_bin_version(pkt, UL_BIN_VERSION);
-			rc = receive_ucontact_update(pkt);
-			break;
-
-		case REPL_UCONTACT_DELETE:
-			ensure_bin_version(pkt, UL_BIN_VERSION);
-			rc = receive_ucontact_delete(pkt);
-			break;
-
-		case SYNC_PACKET_TYPE:
+		if (pkt->type == SYNC_PACKET_TYPE) {
 			_ensure_bin_version(pkt, UL_BIN_VERSION, "usrloc sync packet");
 			rc = receive_sync_packet(pkt);
-			break;
+		} else {
+			ensure_bin_version(pkt, UL_BIN_VERSION);
+			rc = receive_ul_packet(pkt);
 
-		default:
-			rc = -1;
-			LM_ERR("invalid usrloc binary packet type: %d\n", pkt->type);
+			/* the synced data only gets to the next snapshot */
+			if (rc == 0)
+				ul_persist_journal(pkt);
 		}
 
 		if (rc != 0)
@@ -826,24 +780,22 @@ static int receive_sync_request(int node_id)
 	bin_packet_t *sync_packet;
 	dlist_t *dl;
 	udomain_t *dom;
-	map_iterator_t it;
+	slot_iterator_t it;
 	struct urecord *r;
 	ucontact_t* c;
-	void **p;
 	int i;
 
 	for (dl = root; dl; dl = dl->next) {
 		dom = dl->d;
 		for(i = 0; i < dom->size; i++) {
 			lock_ulslot(dom, i);
-			for (map_first(dom->table[i].records, &it);
-				iterator_is_valid(&it);
-				iterator_next(&it)) {
+			for (slot_first(&dom->table[i], &it);
+				slot_it_valid(&it);
+				slot_it_next(&it)) {
 
-				p = iterator_val(&it);
-				if (p == NULL)
+				r = slot_it_val(&it);
+				if (r == NULL)
 					goto error_unlock;
-				r = (urecord_t *)*p;
 
 				sync_packet = clusterer_api.sync_chunk_start(&contact_repl_cap,
 									location_cluster, node_id, UL_BIN_VERSION);
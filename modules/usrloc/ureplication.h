@@ -55,6 +55,14 @@ void replicate_ucontact_insert(urecord_t *r, str *contact, ucontact_t *c);
 void replicate_ucontact_update(urecord_t *r, ucontact_t *ct);
 void replicate_ucontact_delete(urecord_t *r, ucontact_t *c);
 
+/* the packet formats, also used by the snapshots */
+void bin_push_urecord(bin_packet_t *packet, urecord_t *r);
+void bin_push_ucontact_update(bin_packet_t *packet, urecord_t *r,
+		ucontact_t *ct);
+
+/* applies a replicated (or journaled) change */
+int receive_ul_packet(bin_packet_t *packet);
+
 void receive_binary_packets(bin_packet_t *packet);
 void receive_cluster_event(enum clusterer_event ev, int node_id);
 
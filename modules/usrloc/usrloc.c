@@ -34,6 +34,7 @@
 #include "usrloc.h"
 #include "../../sr_module.h"
 #include "ul_mod.h"
+#include "ul_preload.h"
 
 extern unsigned int nat_bflag;
 extern unsigned int init_flag;
@@ -86,6 +87,7 @@ int bind_usrloc(usrloc_api_t* api)
 	api->cluster_mode    = cluster_mode;
 	api->nat_flag   = nat_bflag;
 	api->have_mem_storage = have_mem_storage;
+	api->is_ready = ul_preload_ready;
 
 	return 0;
 }
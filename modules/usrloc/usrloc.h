@@ -59,6 +59,8 @@ typedef struct usrloc_api {
 	int use_domain;
 	enum ul_cluster_mode cluster_mode;
 	int (*have_mem_storage) (void);
+	/* Return: 1 once the location data was preloaded, 0 otherwise */
+	int (*is_ready) (void);
 	unsigned int nat_flag;
 
 	register_udomain_t     register_udomain;
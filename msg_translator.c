@@ -2101,16 +2101,17 @@ int is_del_via1_lump(struct sip_msg* msg)
 	return 0;
 }
 
-char * build_req_buf_from_sip_req( struct sip_msg* msg,
-								unsigned int *returned_len,
+/* adds all the lumps (Via, received, rport, Content-Length, Path routes)
+ * the request needs in order to be forwarded */
+static int prepare_req_lumps( struct sip_msg* msg,
 								struct socket_info* send_sock, int proto,
-								str *via_params, unsigned int flags)
+								str *via_params, unsigned int flags,
+								unsigned int *body_delta)
 {
-	unsigned int len, new_len, received_len, rport_len, uri_len, via_len, body_delta;
-	char *line_buf, *received_buf, *rport_buf, *new_buf, *buf, *id_buf;
-	unsigned int offset, s_offset, size, id_len;
+	unsigned int received_len, rport_len, via_len, size, id_len;
+	char *line_buf, *received_buf, *rport_buf, *buf, *id_buf;
 	struct lump *anchor, *via_insert_param;
-	str branch, extra_params, body;
+	str branch, extra_params;
 	struct hostport hp;
 
 	id_buf=0;
@@ -2118,12 +2119,9 @@ char * build_req_buf_from_sip_req( struct sip_msg* msg,
 	via_insert_param=0;
 	extra_params.len=0;
 	extra_params.s=0;
-	uri_len=0;
 	buf=msg->buf;
-	len=msg->len;
 	received_len=0;
 	rport_len=0;
-	new_buf=0;
 	received_buf=0;
 	rport_buf=0;
 	line_buf=0;
@@ -2139,14 +2137,14 @@ char * build_req_buf_from_sip_req( struct sip_msg* msg,
 	/* Calculate message body difference and adjust
 	 * Content-Length
 	 */
-	body_delta = calculate_body_diff( msg, send_sock);
-	if (adjust_clen(msg, body_delta, proto) < 0) {
+	*body_delta = calculate_body_diff( msg, send_sock);
+	if (adjust_clen(msg, *body_delta, proto) < 0) {
 		LM_ERR("failed to adjust Content-Length\n");
 		goto error;
 	}
 
 	if (flags&MSG_TRANS_NOVIA_FLAG)
-		goto build_msg;
+		return 0;
 
 	/* add id if tcp-based protocol  */
 	if (is_tcp_based_proto(msg->rcv.proto)) {
@@ -2291,10 +2289,46 @@ char * build_req_buf_from_sip_req( struct sip_msg* msg,
 			goto error03; /* free rport_buf */
 	}
 
-build_msg:
-	/* adjust len to the useful part of the message */
+	/* the params were copied into the Via line */
+	if (extra_params.s) pkg_free(extra_params.s);
+	return 0;
+
+error01:
+	if (line_buf) pkg_free(line_buf);
+error02:
+	if (received_buf) pkg_free(received_buf);
+error03:
+	if (rport_buf) pkg_free(rport_buf);
+error00:
+	if (extra_params.s) pkg_free(extra_params.s);
+error:
+	return -1;
+}
+
+
+/* the length of the request, without whatever garbage follows the body */
+static inline unsigned int req_useful_len(struct sip_msg *msg)
+{
+	str body;
+
 	if (get_body(msg, &body) == 0 && body.len)
-		len -= (msg->buf + msg->len - body.s - body.len);
+		return body.s + body.len - msg->buf;
+	return msg->len;
+}
+
+
+/* builds the request out of the original buffer and of its lumps, in a
+ * buffer given by @alloc (if set) or else in pkg/shm, as per the flags */
+static char *build_req_buf( struct sip_msg* msg, unsigned int *returned_len,
+								struct socket_info* send_sock, unsigned int len,
+								unsigned int body_delta, unsigned int flags,
+								msg_buf_alloc_f alloc, void *alloc_param)
+{
+	unsigned int new_len, uri_len, offset, s_offset, size;
+	char *new_buf, *buf;
+
+	buf=msg->buf;
+	uri_len=0;
 
 	/* compute new msg len and fix overlapping zones*/
 	new_len=len+body_delta+lumps_len(msg, msg->add_rm, send_sock,-1);
@@ -2306,14 +2340,17 @@ build_msg:
 		uri_len=msg->new_uri.len;
 		new_len=new_len-msg->first_line.u.request.uri.len+uri_len;
 	}
-	if (flags&MSG_TRANS_SHM_FLAG)
+	if (alloc)
+		new_buf=alloc(new_len+1, alloc_param);
+	else if (flags&MSG_TRANS_SHM_FLAG)
 		new_buf=(char*)shm_malloc(new_len+1);
 	else
 		new_buf=(char*)pkg_malloc(new_len+1);
 	if (new_buf==0){
 		ser_error=E_OUT_OF_MEM;
-		LM_ERR("out of pkg memory\n");
-		goto error00;
+		LM_ERR("out of memory\n");
+		*returned_len=0;
+		return 0;
 	}
 
 	offset=s_offset=0;
@@ -2339,20 +2376,174 @@ build_msg:
 	new_buf[new_len]=0;
 
 	*returned_len=new_len;
-	/* cleanup */
-	if (extra_params.s) pkg_free(extra_params.s);
 	return new_buf;
+}
 
-error01:
-	if (line_buf) pkg_free(line_buf);
-error02:
-	if (received_buf) pkg_free(received_buf);
-error03:
-	if (rport_buf) pkg_free(rport_buf);
-error00:
-	if (extra_params.s) pkg_free(extra_params.s);
-error:
-	*returned_len=0;
+
+char * build_req_buf_from_sip_req( struct sip_msg* msg,
+								unsigned int *returned_len,
+								struct socket_info* send_sock, int proto,
+								str *via_params, unsigned int flags)
+{
+	return build_req_buf_from_sip_req_alloc(msg, returned_len, send_sock,
+		proto, via_params, flags, NULL, NULL);
+}
+
+
+char * build_req_buf_from_sip_req_alloc( struct sip_msg* msg,
+								unsigned int *returned_len,
+								struct socket_info* send_sock, int proto,
+								str *via_params, unsigned int flags,
+								msg_buf_alloc_f alloc, void *alloc_param)
+{
+	unsigned int body_delta;
+
+	if (prepare_req_lumps(msg, send_sock, proto, via_params, flags,
+	&body_delta) < 0) {
+		*returned_len=0;
+		return 0;
+	}
+
+	return build_req_buf(msg, returned_len, send_sock, req_useful_len(msg),
+		body_delta, flags, alloc, alloc_param);
+}
+
+
+/* appends a piece of the request to the iovec, merging it with the
+ * previous one if they are contiguous */
+static inline int msg_iov_add(struct msg_iov *mi, char *s, unsigned int len)
+{
+	struct iovec *v;
+
+	if (len==0)
+		return 0;
+
+	if (mi->cnt) {
+		v = &mi->v[mi->cnt-1];
+		if ((char *)v->iov_base + v->iov_len == s) {
+			v->iov_len += len;
+			mi->len += len;
+			return 0;
+		}
+	}
+
+	if (mi->cnt==MSG_IOV_MAX)
+		return -1;
+
+	mi->v[mi->cnt].iov_base = s;
+	mi->v[mi->cnt].iov_len = len;
+	mi->cnt++;
+	mi->len += len;
+	return 0;
+}
+
+
+/* same walk as process_lumps(), but the pieces are only referred from the
+ * iovec; only the plain lumps (NOP/DEL anchors with ADD lumps before and
+ * after them) are handled, -1 is returned for anything else */
+static int lumps_to_iov(struct sip_msg *msg, struct lump *lumps,
+								unsigned int *orig_offs, struct msg_iov *mi)
+{
+	struct lump *t, *r;
+	unsigned int s_offset, last_del;
+
+	s_offset=*orig_offs;
+	last_del=0;
+
+	for (t = lumps; t; t = t->next) {
+		/* skip this lump if the "offset" is still in a "deleted" area */
+		if (t->u.offset < s_offset && t->u.offset != last_del)
+			continue;
+
+		if (t->op!=LUMP_NOP && t->op!=LUMP_DEL)
+			return -1;
+
+		if (s_offset < t->u.offset) {
+			if (msg_iov_add(mi, msg->buf+s_offset, t->u.offset-s_offset)<0)
+				return -1;
+			s_offset = t->u.offset;
+		}
+
+		if (t->op == LUMP_DEL)
+			last_del = t->u.offset;
+
+		for (r = t->before; r; r = r->before)
+			if (r->op!=LUMP_ADD || msg_iov_add(mi, r->u.value, r->len)<0)
+				return -1;
+
+		if (t->op == LUMP_DEL && t->u.offset + t->len > s_offset)
+			s_offset += t->len - (s_offset - t->u.offset);
+
+		for (r = t->after; r; r = r->after)
+			if (r->op!=LUMP_ADD || msg_iov_add(mi, r->u.value, r->len)<0)
+				return -1;
+	}
+
+	*orig_offs=s_offset;
+	return 0;
+}
+
+
+/* Same as build_req_buf_from_sip_req(), but the request is gathered from
+ * the received buffer and from the lumps, with no copying, as long as the
+ * body is not changed and there are only plain lumps to apply (usually the
+ * case for the stateless forwarding). Otherwise, the request is built as
+ * usual, in mi->buf (to be freed by the caller). */
+int build_req_iov_from_sip_req( struct sip_msg* msg, struct msg_iov *mi,
+								struct socket_info* send_sock, int proto)
+{
+	unsigned int body_delta, len, new_len, s_offset;
+	str *uri;
+
+	mi->cnt=0;
+	mi->len=0;
+	mi->buf=0;
+
+	if (prepare_req_lumps(msg, send_sock, proto, NULL, 0, &body_delta)<0)
+		return -1;
+
+	len=req_useful_len(msg);
+	if (body_delta || msg->body || msg->body_lumps)
+		goto copy;
+
+	s_offset=0;
+	if (msg->new_uri.s) {
+		uri = &msg->first_line.u.request.uri;
+		s_offset=uri->s-msg->buf;
+		if (msg_iov_add(mi, msg->buf, s_offset)<0 ||
+		msg_iov_add(mi, msg->new_uri.s, msg->new_uri.len)<0)
+			goto copy;
+		s_offset+=uri->len;
+	}
+
+	if (lumps_to_iov(msg, msg->add_rm, &s_offset, mi)<0)
+		goto copy;
+	if (s_offset<len && msg_iov_add(mi, msg->buf+s_offset, len-s_offset)<0)
+		goto copy;
+
+	new_len=len+lumps_len(msg, msg->add_rm, send_sock, -1);
+	if (msg->new_uri.s)
+		new_len=new_len-msg->first_line.u.request.uri.len+msg->new_uri.len;
+	if (mi->len!=new_len) {
+		LM_BUG("len mismatch : calculated %d, gathered %d\n",
+			new_len, mi->len);
+		goto copy;
+	}
+
+	return 0;
+
+copy:
+	mi->cnt=0;
+	mi->len=0;
+	mi->buf=build_req_buf(msg, &new_len, send_sock, len, body_delta, 0,
+		NULL, NULL);
+	if (!mi->buf)
+		return -1;
+
+	mi->v[0].iov_base=mi->buf;
+	mi->v[0].iov_len=new_len;
+	mi->cnt=1;
+	mi->len=new_len;
 	return 0;
 }
 
@@ -50,6 +50,8 @@
 
 //#define MAX_CONTENT_LEN_BUF INT2STR_MAX_LEN /* see ut.h/int2str() */
 
+#include <sys/uio.h>
+
 #include "parser/msg_parser.h"
 #include "ip_addr.h"
 #include "socket_info.h"
@@ -61,6 +63,19 @@ struct bookmark {
 	str to_tag_val;
 };
 
+/*! \brief max number of pieces a request may be gathered from */
+#define MSG_IOV_MAX 32
+
+/*! \brief outgoing request, as a list of pieces of the received buffer and
+ * of the data added by the lumps (nothing is copied), or as a single pkg
+ * buffer (in "buf") if the request had to be built by copying */
+struct msg_iov {
+	struct iovec v[MSG_IOV_MAX];
+	int cnt;
+	unsigned int len;
+	char *buf;
+};
+
 /*! \brief used by via_builder() */
 struct hostport {
 	str* host;
@@ -138,6 +153,19 @@ char * build_req_buf_from_sip_req (	struct sip_msg* msg,
 				unsigned int *returned_len, struct socket_info* send_sock,
 				int proto, str *via_params, unsigned int flags);
 
+/* gives the buffer (of "len" bytes) to build a message into */
+typedef char *(*msg_buf_alloc_f)(unsigned int len, void *param);
+
+/* same as build_req_buf_from_sip_req(), but the request is printed straight
+ * into the buffer returned by "alloc" (called once the length is known) */
+char * build_req_buf_from_sip_req_alloc( struct sip_msg* msg,
+				unsigned int *returned_len, struct socket_info* send_sock,
+				int proto, str *via_params, unsigned int flags,
+				msg_buf_alloc_f alloc, void *alloc_param);
+
+int build_req_iov_from_sip_req( struct sip_msg* msg, struct msg_iov *mi,
+				struct socket_info* send_sock, int proto);
+
 char * build_res_buf_from_sip_res(	struct sip_msg* msg,
 				unsigned int *returned_len, struct socket_info *sock,int flags);
 
@@ -26,6 +26,8 @@
 #ifndef _API_PROTO_TI_H_
 #define _API_PROTO_TI_H_
 
+#include <sys/uio.h>
+
 #include "../ip_addr.h"
 
 #define PROTO_PREFIX "proto_"
@@ -33,12 +35,16 @@
 typedef int (*proto_init_listener_f)(struct socket_info *si);
 typedef int (*proto_send_f)(struct socket_info *si, char* buf,unsigned int len,
 		union sockaddr_union* to, int id);
+/* optional, sends a message gathered from several pieces */
+typedef int (*proto_sendv_f)(struct socket_info *si, const struct iovec *iov,
+		int iovcnt, unsigned int len, union sockaddr_union* to, int id);
 typedef int (*proto_dst_attr_f)(struct receive_info *rcv,
 		int attr, void *value);
 
 struct api_proto {
 	proto_init_listener_f	init_listener;
 	proto_send_f			send;
+	proto_sendv_f			sendv;
 	proto_dst_attr_f		dst_attr;
 };
 
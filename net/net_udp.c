@@ -24,6 +24,10 @@
  *  2015-02-09  first version (bogdan)
  */
 
+#ifdef __OS_linux
+#define _GNU_SOURCE /* sendmmsg(), sched_setaffinity() */
+#include <sched.h>
+#endif
 
 #include <unistd.h>
 
@@ -40,6 +44,9 @@
 /* if the UDP network layer is used or not by some protos */
 static int udp_disabled = 1;
 
+/* pin the workers of SO_REUSEPORT listeners on CPUs */
+int udp_workers_cpu_affinity = 0;
+
 extern void handle_sigs(void);
 
 /* initializes the UDP network layer */
@@ -130,7 +137,7 @@ static int setup_mcast_rcvr(int sock, union sockaddr_union* addr)
  *
  * @status_flags - extra status flags to be set for the socket fd
  */
-int udp_init_listener(struct socket_info *si, int status_flags)
+static int udp_init_socket(struct socket_info *si, int status_flags)
 {
 	union sockaddr_union* addr;
 	int optval;
@@ -171,6 +178,16 @@ int udp_init_listener(struct socket_info *si, int status_flags)
 		LM_ERR("setsockopt: %s\n", strerror(errno));
 		goto error;
 	}
+#ifdef SO_REUSEPORT
+	if (si->flags & SI_REUSEPORT) {
+		optval=1;
+		if (setsockopt(si->socket, SOL_SOCKET, SO_REUSEPORT,
+						(void*)&optval, sizeof(optval)) ==-1){
+			LM_ERR("setsockopt(SO_REUSEPORT): %s\n", strerror(errno));
+			goto error;
+		}
+	}
+#endif
 	/* tos */
 	optval=tos;
 	if (setsockopt(si->socket, IPPROTO_IP, IP_TOS, (void*)&optval,
@@ -250,6 +267,93 @@ error:
 }
 
 
+/**
+ * Initialize an UDP listener. In SO_REUSEPORT mode, a separate socket is
+ * bound for each of the workers of the listener, so the kernel will spread
+ * the incoming flows over the workers' sockets.
+ * \param si socket that should be bind
+ * \return zero on success, -1 otherwise
+ *
+ * @status_flags - extra status flags to be set for the socket fd
+ */
+int udp_init_listener(struct socket_info *si, int status_flags)
+{
+	int i;
+
+	if (!(si->flags & SI_REUSEPORT) || si->children<=1)
+		return udp_init_socket(si, status_flags);
+
+#ifndef SO_REUSEPORT
+	LM_ERR("SO_REUSEPORT not supported, cannot shard listener %.*s\n",
+		si->sock_str.len, si->sock_str.s);
+	return -1;
+#else
+	si->workers_sockets = (int*)pkg_malloc(si->children * sizeof(int));
+	if (si->workers_sockets==NULL) {
+		LM_ERR("no more pkg memory\n");
+		return -1;
+	}
+
+	for (i=0 ; i<si->children ; i++) {
+		if (udp_init_socket(si, status_flags)<0) {
+			LM_ERR("failed to init socket %d of %.*s\n", i,
+				si->sock_str.len, si->sock_str.s);
+			for ( i-- ; i>=0 ; i--)
+				close(si->workers_sockets[i]);
+			pkg_free(si->workers_sockets);
+			si->workers_sockets = NULL;
+			return -1;
+		}
+		si->workers_sockets[i] = si->socket;
+	}
+
+	/* the first socket is the default one of the listener */
+	si->socket = si->workers_sockets[0];
+
+	LM_DBG("%.*s sharded over %d SO_REUSEPORT sockets\n",
+		si->sock_str.len, si->sock_str.s, si->children);
+	return 0;
+#endif
+}
+
+
+/* binds the current UDP worker to its own socket of a SO_REUSEPORT
+ * listener and, if required, pins it on a CPU; @ord is the ordinal of the
+ * worker among the ones of all the SO_REUSEPORT listeners, so the workers
+ * of several such listeners are spread over all the CPUs */
+static void udp_set_worker_socket(struct socket_info *si, int idx, int ord)
+{
+#ifdef __OS_linux
+	cpu_set_t mask;
+	long cpus;
+#endif
+
+	if (si->workers_sockets==NULL)
+		return;
+
+	si->socket = si->workers_sockets[idx];
+
+	if (!udp_workers_cpu_affinity)
+		return;
+
+#ifdef __OS_linux
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus<=0)
+		return;
+
+	CPU_ZERO(&mask);
+	CPU_SET(ord % cpus, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask)<0)
+		LM_WARN("failed to pin UDP worker %d on CPU %ld: %s\n",
+			idx, ord % cpus, strerror(errno));
+	else
+		LM_DBG("UDP worker %d pinned on CPU %ld\n", idx, ord % cpus);
+#else
+	LM_WARN("CPU affinity not supported on this OS\n");
+#endif
+}
+
+
 inline static int handle_io(struct fd_map* fm, int idx,int event_type)
 {
 	int n = 0;
@@ -332,6 +436,7 @@ int udp_start_processes(int *chd_rank, int *startup_done)
 	struct socket_info *si;
 	pid_t pid;
 	int i,p;
+	int ord = 0;
 
 	if (udp_disabled)
 		return 0;
@@ -353,6 +458,7 @@ int udp_start_processes(int *chd_rank, int *startup_done)
 					set_proc_attrs("SIP receiver %.*s ",
 						si->sock_str.len, si->sock_str.s);
 					bind_address=si; /* shortcut */
+					udp_set_worker_socket(si, i, ord);
 					/* we first need to init the reactor to be able to add fd
 					 * into it in child_init routines */
 					if (udp_proc_reactor_init(si) < 0 ||
@@ -397,6 +503,10 @@ int udp_start_processes(int *chd_rank, int *startup_done)
 							usleep(5);
 							handle_sigs();
 						}
+					/* the next worker of a SO_REUSEPORT listener goes on
+					 * the next CPU */
+					if (si->workers_sockets)
+						ord++;
 				}
 			} /* procs per listener */
 		} /* looping through the listeners per proto */
@@ -407,3 +517,192 @@ error:
 	return -1;
 }
 
+
+
+/* per-process queue of datagrams waiting to be sent in batch */
+struct udp_batch_dgram {
+	int fd;
+	union sockaddr_union to;
+	char *buf;
+	unsigned int len;
+	unsigned int seq;
+	int failed;
+};
+
+/* outcome of a sent datagram, looked up by its id */
+struct udp_batch_res {
+	unsigned int seq;
+	int failed;
+};
+
+int udp_batch_level = 0;
+unsigned int udp_batch_seq = 0;
+
+static struct udp_batch_res batch_res[UDP_SND_BATCH_MAX];
+
+static struct udp_batch_dgram batch_q[UDP_SND_BATCH_MAX];
+static char batch_buf[UDP_SND_BATCH_BUF];
+static int batch_q_no = 0;
+static unsigned int batch_buf_used = 0;
+
+
+static void udp_batch_report(struct udp_batch_dgram *d)
+{
+	unsigned short port;
+	char *ip;
+	int err = errno;
+
+	get_su_info(&d->to.s, ip, port);
+	LM_ERR("sendmmsg(sock,%p,%d,0,%s:%hu): %s(%d)\n", d->buf, d->len,
+		ip, port, strerror(err), err);
+	if (err==EINVAL) {
+		LM_CRIT("invalid sendtoparameters\n"
+		"one possible reason is the server is bound to localhost and\n"
+		"attempts to send to the net\n");
+	}
+}
+
+
+static int udp_batch_send_all(void)
+{
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[UDP_SND_BATCH_MAX];
+	struct iovec iov[UDP_SND_BATCH_MAX];
+	struct udp_batch_dgram *grp[UDP_SND_BATCH_MAX];
+	char done[UDP_SND_BATCH_MAX];
+	int i, j, n, off, fd;
+#else
+	int i, n;
+#endif
+	int failed = 0;
+
+#ifdef HAVE_SENDMMSG
+	memset(done, 0, batch_q_no);
+
+	/* send the datagrams grouped per socket, keeping their order */
+	for (i=0 ; i<batch_q_no ; i++) {
+		if (done[i])
+			continue;
+
+		fd = batch_q[i].fd;
+		for (j=i,n=0 ; j<batch_q_no ; j++) {
+			if (done[j] || batch_q[j].fd!=fd)
+				continue;
+			done[j] = 1;
+			grp[n] = &batch_q[j];
+			iov[n].iov_base = batch_q[j].buf;
+			iov[n].iov_len = batch_q[j].len;
+			memset(&msgs[n], 0, sizeof msgs[n]);
+			msgs[n].msg_hdr.msg_name = &batch_q[j].to.s;
+			msgs[n].msg_hdr.msg_namelen = sockaddru_len(batch_q[j].to);
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			n++;
+		}
+
+		for (off=0 ; off<n ; ) {
+			j = sendmmsg(fd, msgs+off, n-off, 0);
+			if (j==-1) {
+				if (errno==EINTR || errno==EAGAIN)
+					continue;
+				/* the first datagram of the remaining ones failed */
+				udp_batch_report(grp[off]);
+				grp[off]->failed = 1;
+				failed++;
+				off++;
+			} else {
+				off += j;
+			}
+		}
+	}
+#else
+	for (i=0 ; i<batch_q_no ; i++) {
+again:
+		n = sendto(batch_q[i].fd, batch_q[i].buf, batch_q[i].len, 0,
+			&batch_q[i].to.s, sockaddru_len(batch_q[i].to));
+		if (n==-1) {
+			if (errno==EINTR || errno==EAGAIN) goto again;
+			udp_batch_report(&batch_q[i]);
+			batch_q[i].failed = 1;
+			failed++;
+		}
+	}
+#endif
+
+	for (i=0 ; i<batch_q_no ; i++) {
+		batch_res[batch_q[i].seq % UDP_SND_BATCH_MAX].seq = batch_q[i].seq;
+		batch_res[batch_q[i].seq % UDP_SND_BATCH_MAX].failed =
+			batch_q[i].failed;
+	}
+
+	batch_q_no = 0;
+	batch_buf_used = 0;
+
+	return failed;
+}
+
+
+void udp_batch_start(void)
+{
+	udp_batch_level++;
+}
+
+
+int udp_batch_flush(void)
+{
+	if (udp_batch_level==0) {
+		LM_BUG("flushing an UDP batch which was not started\n");
+		return 0;
+	}
+
+	if (--udp_batch_level>0 || batch_q_no==0)
+		return 0;
+
+	return udp_batch_send_all();
+}
+
+
+int udp_batch_status(unsigned int id)
+{
+	struct udp_batch_res *r;
+
+	if (batch_q_no && (int)(id - batch_q[0].seq)>=0)
+		return 1;
+
+	r = &batch_res[id % UDP_SND_BATCH_MAX];
+	if (r->seq!=id)
+		return 0;
+
+	return r->failed ? -1 : 0;
+}
+
+
+int udp_batch_addv(struct socket_info *source, const struct iovec *iov,
+						int iovcnt, unsigned int len, union sockaddr_union *to)
+{
+	struct udp_batch_dgram *d;
+	char *p;
+	int i;
+
+	if (len>UDP_SND_BATCH_BUF) {
+		LM_ERR("datagram too big (%u) to be batched\n", len);
+		return -1;
+	}
+
+	/* no more room in the queue -> push out what we have so far */
+	if (batch_q_no==UDP_SND_BATCH_MAX || batch_buf_used+len>UDP_SND_BATCH_BUF)
+		udp_batch_send_all();
+
+	d = &batch_q[batch_q_no++];
+	d->fd = source->socket;
+	memcpy(&d->to, to, sockaddru_len(*to));
+	d->buf = batch_buf + batch_buf_used;
+	d->len = len;
+	d->seq = udp_batch_seq++;
+	d->failed = 0;
+	for (i=0,p=d->buf ; i<iovcnt ; p+=iov[i].iov_len,i++)
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+	batch_buf_used += len;
+
+	return len;
+}
@@ -26,6 +26,8 @@
 #ifndef _NET_UDP_H_
 #define _NET_UDP_H_
 
+#include <sys/uio.h>
+
 #include "../socket_info.h"
 
 
@@ -50,4 +52,53 @@ struct socket_info* udp_find_listener(union sockaddr_union* to, int proto);
 /* initializes an already defined TCP listener */
 int udp_init_listener(struct socket_info *si, int status_flags);
 
+/* pin the workers of the SO_REUSEPORT listeners on CPUs */
+extern int udp_workers_cpu_affinity;
+
+/**************************** Batched sending ********************************/
+
+/* max number of datagrams / bytes held by the per-process send queue */
+#define UDP_SND_BATCH_MAX      64
+#define UDP_SND_BATCH_BUF      (256*1024)
+
+extern int udp_batch_level;
+
+/* id of the next datagram to be queued; a sender may note it before sending
+ * and look up the outcome of its datagram after the flush */
+extern unsigned int udp_batch_seq;
+
+/* opens a send batching window - until the matching udp_batch_flush(), all
+ * the UDP datagrams sent by this process are queued and pushed later with
+ * as few sendmmsg() calls as possible. The windows may be nested. */
+void udp_batch_start(void);
+
+/* closes a send batching window; when the outermost window is closed, all
+ * the queued datagrams are sent out. Send errors are logged per datagram.
+ * Returns the number of datagrams which failed to be sent */
+int udp_batch_flush(void);
+
+/* the outcome of the queued datagram with the given id: 1 if still queued,
+ * 0 if sent, -1 if its sending failed. The outcomes of the last
+ * UDP_SND_BATCH_MAX sent datagrams are kept; for an older one, 0 is
+ * returned, as its failure (if any) was already logged */
+int udp_batch_status(unsigned int id);
+
+/* queues a datagram (gathered from "iovcnt" pieces, "len" bytes in total)
+ * for sending, copying its content;
+ * returns the length of the datagram on success, -1 on error */
+int udp_batch_addv(struct socket_info *source, const struct iovec *iov,
+					int iovcnt, unsigned int len, union sockaddr_union *to);
+
+static inline int udp_batch_add(struct socket_info *source, char *buf,
+								unsigned int len, union sockaddr_union *to)
+{
+	struct iovec v;
+
+	v.iov_base = buf;
+	v.iov_len = len;
+	return udp_batch_addv(source, &v, 1, len, to);
+}
+
+#define udp_batch_active() (udp_batch_level>0)
+
 #endif /* _NET_UDP_H_ */
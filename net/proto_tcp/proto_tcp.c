@@ -52,6 +52,9 @@ static int proto_tcp_init(struct proto_info *pi);
 static int proto_tcp_init_listener(struct socket_info *si);
 static int proto_tcp_send(struct socket_info* send_sock,
 		char* buf, unsigned int len, union sockaddr_union* to, int id);
+static int proto_tcp_sendv(struct socket_info* send_sock,
+		const struct iovec *iov, int iovcnt, unsigned int len,
+		union sockaddr_union* to, int id);
 inline static int _tcp_write_on_socket(struct tcp_connection *c, int fd,
 		char *buf, int len);
 
@@ -208,6 +211,7 @@ static int proto_tcp_init(struct proto_info *pi)
 
 	pi->tran.init_listener	= proto_tcp_init_listener;
 	pi->tran.send			= proto_tcp_send;
+	pi->tran.sendv			= proto_tcp_sendv;
 	pi->tran.dst_attr		= tcp_conn_fcntl;
 
 	pi->net.flags			= PROTO_NET_USE_TCP;
@@ -397,11 +401,13 @@ static void tcp_report(int type, unsigned long long conn_id, int conn_flags,
  * -2 - in case our chunks buffer is full
  *		and we need to let the connection go
  */
-static inline int add_write_chunk(struct tcp_connection *con,char *buf,int len,
-					int lock)
+static inline int add_write_chunkv(struct tcp_connection *con,
+				const struct iovec *iov, int iovcnt, int len, int lock)
 {
 	struct tcp_send_chunk *c;
 	struct tcp_data *d = (struct tcp_data*)con->proto_data;
+	char *p;
+	int i;
 
 	c = shm_malloc(sizeof(struct tcp_send_chunk) + len);
 	if (!c) {
@@ -412,7 +418,8 @@ static inline int add_write_chunk(struct tcp_connection *con,char *buf,int len,
 	c->len = len;
 	c->ticks = get_ticks();
 	c->buf = (char *)(c+1);
-	memcpy(c->buf,buf,len);
+	for (i=0,p=c->buf ; i<iovcnt ; p+=iov[i].iov_len,i++)
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
 	c->pos = c->buf;
 
 	if (lock)
@@ -436,6 +443,16 @@ static inline int add_write_chunk(struct tcp_connection *con,char *buf,int len,
 	return 0;
 }
 
+static inline int add_write_chunk(struct tcp_connection *con,char *buf,int len,
+					int lock)
+{
+	struct iovec v;
+
+	v.iov_base = buf;
+	v.iov_len = len;
+	return add_write_chunkv(con, &v, 1, len, lock);
+}
+
 
 /* Attempts do a connect to the given destination. It returns:
  *   1 - connect was done local (completed)
@@ -443,7 +460,8 @@ static inline int add_write_chunk(struct tcp_connection *con,char *buf,int len,
  *  -1 - error
  */
 static int tcpconn_async_connect(struct socket_info* send_sock,
-					union sockaddr_union* server, char *buf, unsigned len,
+					union sockaddr_union* server, const struct iovec *iov,
+					int iovcnt, unsigned len,
 					struct tcp_connection** c, int *ret_fd)
 {
 	int fd, n;
@@ -574,7 +592,7 @@ async_connect:
 	}
 	/* attach the write buffer to it */
 	lock_get(&con->write_lock);
-	if (add_write_chunk(con,buf,len,0) < 0) {
+	if (add_write_chunkv(con,iov,iovcnt,len,0) < 0) {
 		LM_ERR("Failed to add the initial write chunk\n");
 		/* FIXME - seems no more SHM now ...
 		 * continue the async connect process ? */
@@ -726,10 +744,75 @@ poll_loop:
 }
 
 
-/* This is just a wrapper around the writing function, so we can use them
- * internally, but also export them to the "tcp_common" funcs */
-inline static int _tcp_write_on_socket(struct tcp_connection *c, int fd,
-															char *buf, int len)
+/**
+ * called under the TCP connection write lock; the pieces of the message
+ * are written with a single sendmsg() attempt, whatever could not be
+ * written right away is put together and left to the regular writing
+ *
+ * @return: -1 or bytes written (same as async_tsend_stream / tsend_stream)
+ */
+static int tcp_writev_stream(struct tcp_connection *c, int fd,
+						const struct iovec *iov, int iovcnt, unsigned int len)
+{
+	struct msghdr mh;
+	char *rest, *p;
+	unsigned int skip;
+	int n, m, i;
+
+	memset(&mh, 0, sizeof mh);
+	mh.msg_iov = (struct iovec *)iov;
+	mh.msg_iovlen = iovcnt;
+
+again:
+	n=sendmsg(fd, &mh,
+#ifdef HAVE_MSG_NOSIGNAL
+			MSG_NOSIGNAL
+#else
+			0
+#endif
+		);
+	if (n<0) {
+		if (errno==EINTR) goto again;
+		if (errno!=EAGAIN && errno!=EWOULDBLOCK) {
+			LM_ERR("Failed TCP gathered send : (%d) %s\n",
+				errno, strerror(errno));
+			return -1;
+		}
+		n=0;
+	}
+
+	if (n==len)
+		return n;
+
+	/* partial write - the rest is sent (or queued) as a single buffer */
+	rest = pkg_malloc(len-n);
+	if (!rest) {
+		LM_ERR("no more pkg mem\n");
+		return -1;
+	}
+	for (i=0,p=rest,skip=n ; i<iovcnt ; i++) {
+		if (skip>=iov[i].iov_len) {
+			skip -= iov[i].iov_len;
+			continue;
+		}
+		memcpy(p, (char *)iov[i].iov_base+skip, iov[i].iov_len-skip);
+		p += iov[i].iov_len-skip;
+		skip = 0;
+	}
+
+	if (tcp_async)
+		m = async_tsend_stream(c, fd, rest, len-n,
+			tcp_async_local_write_timeout);
+	else
+		m = tsend_stream(fd, rest, len-n, tcp_send_timeout);
+	pkg_free(rest);
+
+	return m<0 ? -1 : n+m;
+}
+
+
+inline static int _tcp_writev_on_socket(struct tcp_connection *c, int fd,
+						const struct iovec *iov, int iovcnt, unsigned int len)
 {
 	int n;
 
@@ -740,11 +823,16 @@ inline static int _tcp_write_on_socket(struct tcp_connection *c, int fd,
 		 * to be sent, otherwise we will completely break the messages' order
 		 */
 		if (((struct tcp_data*)c->proto_data)->async_chunks_no)
-			n = add_write_chunk(c, buf, len, 0);
+			n = add_write_chunkv(c, iov, iovcnt, len, 0);
+		else if (iovcnt==1)
+			n = async_tsend_stream(c,fd,iov[0].iov_base,len,
+				tcp_async_local_write_timeout);
 		else
-			n = async_tsend_stream(c,fd,buf,len,tcp_async_local_write_timeout);
+			n = tcp_writev_stream(c, fd, iov, iovcnt, len);
+	} else if (iovcnt==1) {
+		n=tsend_stream(fd, iov[0].iov_base, len, tcp_send_timeout);
 	} else {
-		n=tsend_stream(fd, buf, len, tcp_send_timeout);
+		n=tcp_writev_stream(c, fd, iov, iovcnt, len);
 	}
 	lock_release(&c->write_lock);
 
@@ -752,10 +840,23 @@ inline static int _tcp_write_on_socket(struct tcp_connection *c, int fd,
 }
 
 
+/* This is just a wrapper around the writing function, so we can use them
+ * internally, but also export them to the "tcp_common" funcs */
+inline static int _tcp_write_on_socket(struct tcp_connection *c, int fd,
+															char *buf, int len)
+{
+	struct iovec v;
+
+	v.iov_base = buf;
+	v.iov_len = len;
+	return _tcp_writev_on_socket(c, fd, &v, 1, len);
+}
+
+
 /*! \brief Finds a tcpconn & sends on it */
-static int proto_tcp_send(struct socket_info* send_sock,
-											char* buf, unsigned int len,
-											union sockaddr_union* to, int id)
+static int __proto_tcp_send(struct socket_info* send_sock,
+						const struct iovec *iov, int iovcnt, unsigned int len,
+						union sockaddr_union* to, int id)
 {
 	struct tcp_connection *c;
 	struct ip_addr ip;
@@ -802,7 +903,8 @@ static int proto_tcp_send(struct socket_info* send_sock,
 			tcp_async);
 		/* create tcp connection */
 		if (tcp_async) {
-			n = tcpconn_async_connect(send_sock, to, buf, len, &c, &fd);
+			n = tcpconn_async_connect(send_sock, to, iov, iovcnt, len,
+				&c, &fd);
 			if ( n<0 ) {
 				LM_ERR("async TCP connect failed\n");
 				get_time_difference(get,tcpthreshold,tcp_timeout_con_get);
@@ -907,7 +1009,7 @@ static int proto_tcp_send(struct socket_info* send_sock,
 			 * case we ever manage to get through */
 			LM_DBG("We have acquired a TCP connection which is still "
 				"pending to connect - delaying write \n");
-			n = add_write_chunk(c,buf,len,1);
+			n = add_write_chunkv(c,iov,iovcnt,len,1);
 			if (n < 0) {
 				LM_ERR("Failed to add another write chunk to %p\n",c);
 				/* we failed due to internal errors - put the
@@ -940,10 +1042,11 @@ send_it:
 
 	start_expire_timer(snd,tcpthreshold);
 
-	n = _tcp_write_on_socket(c, fd, buf, len);
+	n = _tcp_writev_on_socket(c, fd, iov, iovcnt, len);
 
 	get_time_difference(snd,tcpthreshold,tcp_timeout_send);
-	stop_expire_timer(get,tcpthreshold,"tcp ops",buf,(int)len,1);
+	stop_expire_timer(get,tcpthreshold,"tcp ops",
+		(char *)iov[0].iov_base,(int)iov[0].iov_len,1);
 
 	tcp_conn_set_lifetime( c, tcp_con_lifetime);
 
@@ -976,6 +1079,26 @@ send_it:
 }
 
 
+static int proto_tcp_send(struct socket_info* send_sock,
+											char* buf, unsigned int len,
+											union sockaddr_union* to, int id)
+{
+	struct iovec v;
+
+	v.iov_base = buf;
+	v.iov_len = len;
+	return __proto_tcp_send(send_sock, &v, 1, len, to, id);
+}
+
+
+static int proto_tcp_sendv(struct socket_info* send_sock,
+						const struct iovec *iov, int iovcnt, unsigned int len,
+						union sockaddr_union* to, int id)
+{
+	return __proto_tcp_send(send_sock, iov, iovcnt, len, to, id);
+}
+
+
 /* Responsible for writing the TCP send chunks - called under con write lock
  *	* if returns = 1 : the connection will be released for more writting
  *	* if returns = 0 : the connection will be released
@@ -24,6 +24,10 @@
  *  2015-02-11  first version (bogdan)
  */
 
+#ifdef HAVE_RECVMMSG
+#define _GNU_SOURCE /* recvmmsg() */
+#endif
+
 #include <errno.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
@@ -34,6 +38,8 @@
 #include "../../timer.h"
 #include "../../socket_info.h"
 #include "../../receive.h"
+#include "../../statistics.h"
+#include "../../ut.h"
 #include "../api_proto.h"
 #include "../api_proto_net.h"
 #include "../net_udp.h"
@@ -45,13 +51,39 @@ static int proto_udp_init(struct proto_info *pi);
 static int proto_udp_init_listener(struct socket_info *si);
 static int proto_udp_send(struct socket_info* send_sock,
 		char* buf, unsigned int len, union sockaddr_union* to, int id);
+static int proto_udp_sendv(struct socket_info* send_sock,
+		const struct iovec *iov, int iovcnt, unsigned int len,
+		union sockaddr_union* to, int id);
 
 static int udp_read_req(struct socket_info *src, int* bytes_read);
+static int set_socket_batch(modparam_t type, void *val);
 
 static callback_list* cb_list = NULL;
 
 static int udp_port = SIP_PORT;
 
+/* one SO_REUSEPORT socket per UDP worker */
+static int reuseport_workers = 0;
+
+/* how many datagrams to drain per wakeup (1 - classic recvfrom() mode) */
+static int recv_batch_size = 1;
+
+/* per listener overrides of the receive batch size */
+struct udp_socket_batch {
+	str host;
+	int port;
+	int proto;
+	int size;
+	struct socket_info *si;
+	struct udp_socket_batch *next;
+};
+static struct udp_socket_batch *socket_batches = NULL;
+
+static stat_var *batch_reads;
+static stat_var *batch_dgrams;
+static stat_var *batch_slots;
+static unsigned long get_batch_fill_ratio(void *foo);
+
 
 static cmd_export_t cmds[] = {
 	{"proto_init", (cmd_function)proto_udp_init, 0, 0, 0, 0},
@@ -60,7 +92,21 @@ static cmd_export_t cmds[] = {
 
 
 static param_export_t params[] = {
-	{ "udp_port",    INT_PARAM,   &udp_port   },
+	{ "udp_port",          INT_PARAM,   &udp_port   },
+	{ "recv_batch_size",   INT_PARAM,   &recv_batch_size },
+	{ "recv_batch_socket", STR_PARAM|USE_FUNC_PARAM, set_socket_batch },
+	{ "reuseport_workers", INT_PARAM,   &reuseport_workers },
+	{ "workers_cpu_affinity", INT_PARAM, &udp_workers_cpu_affinity },
+	{0, 0, 0}
+};
+
+
+static stat_export_t mod_stats[] = {
+	{"udp_batch_reads",      0,            &batch_reads  },
+	{"udp_batch_datagrams",  0,            &batch_dgrams },
+	{"udp_batch_slots",      0,            &batch_slots  },
+	{"udp_batch_fill_ratio", STAT_IS_FUNC,
+		(stat_var**)get_batch_fill_ratio },
 	{0, 0, 0}
 };
 
@@ -75,7 +121,7 @@ struct module_exports proto_udp_exports = {
 	cmds,       /* exported functions */
 	0,          /* exported async functions */
 	params,     /* module parameters */
-	0,          /* exported statistics */
+	mod_stats,  /* exported statistics */
 	0,          /* exported MI functions */
 	0,          /* exported pseudo-variables */
 	0,			/* exported transformations */
@@ -88,13 +134,144 @@ struct module_exports proto_udp_exports = {
 };
 
 
+static int fix_batch_size(int size)
+{
+	if (size<1) {
+		LM_WARN("invalid receive batch size %d, using 1\n", size);
+		return 1;
+	}
+	if (size>UDP_RCV_BATCH_MAX) {
+		LM_WARN("receive batch size %d too big, using %d\n",
+			size, UDP_RCV_BATCH_MAX);
+		return UDP_RCV_BATCH_MAX;
+	}
+	return size;
+}
+
+
 static int mod_init(void)
 {
 	LM_INFO("initializing UDP-plain protocol\n");
+
+	recv_batch_size = fix_batch_size(recv_batch_size);
+#ifndef HAVE_RECVMMSG
+	if (recv_batch_size>1 || socket_batches) {
+		LM_WARN("recvmmsg() not available, batched receiving disabled\n");
+		recv_batch_size = 1;
+	}
+#endif
+
 	return 0;
 }
 
 
+/* parses a "[proto:]host[:port]/size" receive batch definition */
+static int set_socket_batch(modparam_t type, void *val)
+{
+	struct udp_socket_batch *sb;
+	char *s, *p;
+	char *host;
+	int hlen, port, proto;
+	str size_s;
+	unsigned int size;
+
+	s = (char*)val;
+	p = strrchr(s, '/');
+	if (p==NULL || p==s) {
+		LM_ERR("bad batch definition <%s>, expected socket/size\n", s);
+		return -1;
+	}
+
+	size_s.s = p+1;
+	size_s.len = strlen(size_s.s);
+	if (str2int(&size_s, &size)<0) {
+		LM_ERR("bad batch size in <%s>\n", s);
+		return -1;
+	}
+
+	if (parse_phostport(s, p-s, &host, &hlen, &port, &proto)<0) {
+		LM_ERR("bad socket in <%s>\n", s);
+		return -1;
+	}
+	if (proto!=PROTO_NONE && proto!=PROTO_UDP) {
+		LM_ERR("socket <%s> is not an UDP one\n", s);
+		return -1;
+	}
+
+	sb = (struct udp_socket_batch*)pkg_malloc(sizeof *sb);
+	if (sb==NULL) {
+		LM_ERR("no more pkg memory\n");
+		return -1;
+	}
+	memset(sb, 0, sizeof *sb);
+
+	sb->host.s = host;
+	sb->host.len = hlen;
+	sb->port = port;
+	sb->proto = proto;
+	sb->size = fix_batch_size((int)size);
+
+	sb->next = socket_batches;
+	socket_batches = sb;
+
+	return 0;
+}
+
+
+static inline int match_socket_batch(struct udp_socket_batch *sb,
+													struct socket_info *si)
+{
+	if ((sb->port ? sb->port : udp_port) != si->port_no)
+		return 0;
+
+	if (sb->host.len==si->name.len &&
+	strncasecmp(sb->host.s, si->name.s, si->name.len)==0)
+		return 1;
+
+	if (sb->host.len==si->address_str.len &&
+	strncasecmp(sb->host.s, si->address_str.s, si->address_str.len)==0)
+		return 1;
+
+	return 0;
+}
+
+
+#ifdef HAVE_RECVMMSG
+/* returns the receive batch size to be used for a listener */
+static inline int get_socket_batch(struct socket_info *si)
+{
+	static struct socket_info *last_si = NULL;
+	static int last_size = 1;
+	struct udp_socket_batch *sb;
+
+	if (si==last_si)
+		return last_size;
+
+	last_si = si;
+	last_size = recv_batch_size;
+	for (sb=socket_batches ; sb ; sb=sb->next)
+		if (sb->si==si) {
+			last_size = sb->size;
+			break;
+		}
+
+	return last_size;
+}
+#endif
+
+
+static unsigned long get_batch_fill_ratio(void *foo)
+{
+	unsigned long slots;
+
+	slots = get_stat_val(batch_slots);
+	if (slots==0)
+		return 0;
+
+	return get_stat_val(batch_dgrams)*100/slots;
+}
+
+
 static int proto_udp_init(struct proto_info *pi)
 {
 	pi->id					= PROTO_UDP;
@@ -103,6 +280,7 @@ static int proto_udp_init(struct proto_info *pi)
 
 	pi->tran.init_listener	= proto_udp_init_listener;
 	pi->tran.send			= proto_udp_send;
+	pi->tran.sendv			= proto_udp_sendv;
 
 	pi->net.flags			= PROTO_NET_USE_UDP;
 	pi->net.read			= (proto_net_read_f)udp_read_req;
@@ -113,22 +291,138 @@ static int proto_udp_init(struct proto_info *pi)
 
 static int proto_udp_init_listener(struct socket_info *si)
 {
+	struct udp_socket_batch *sb;
+
+	for (sb=socket_batches ; sb ; sb=sb->next)
+		if (sb->si==NULL && match_socket_batch(sb, si)) {
+			LM_DBG("using receive batch of %d on %.*s\n",
+				sb->size, si->sock_str.len, si->sock_str.s);
+			sb->si = si;
+		}
+
+	if (reuseport_workers && !(si->flags & SI_IS_MCAST))
+		si->flags |= SI_REUSEPORT;
+
 	/* we do not do anything particular to UDP plain here, so
 	 * transparently use the generic listener init from net UDP layer */
 	return udp_init_listener(si, O_NONBLOCK);
 }
 
 
+/* runs the network callbacks and pushes one received datagram (which must
+ * be already 0-terminated) to the SIP layer */
+static inline void udp_handle_dgram(struct socket_info *si,
+										struct receive_info *ri, str *msg)
+{
+	callback_list* p;
+	char *tmp;
+
+	ri->bind_address = si;
+	ri->dst_port = si->port_no;
+	ri->dst_ip = si->address;
+	ri->proto = si->proto;
+	ri->proto_reserved1 = ri->proto_reserved2 = 0;
+
+	su2ip_addr(&ri->src_ip, &ri->src_su);
+	ri->src_port=su_getport(&ri->src_su);
+
+	/* run callbacks if looks like non-SIP message*/
+	if( !isalpha(msg->s[0]) ){    /* not-SIP related */
+		for(p = cb_list; p; p = p->next){
+			if(p->b == msg->s[1]){
+				if (p->func(bind_address->socket, ri, msg, p->param)==0){
+					/* buffer consumed by callback */
+					break;
+				}
+			}
+		}
+		if (p) return;
+	}
+
+	if (ri->src_port==0){
+		tmp=ip_addr2a(&ri->src_ip);
+		LM_INFO("dropping 0 port packet from %s\n", tmp);
+		return;
+	}
+
+	/* receive_msg must free buf too!*/
+	receive_msg( msg->s, msg->len, ri, NULL, 0);
+}
+
+
+#ifdef HAVE_RECVMMSG
+/* drains up to @batch datagrams from the listener with a single syscall;
+ * the buffers are static (BSS), so the pages of the unused slots are never
+ * touched if the batch is small */
+static int udp_read_batch(struct socket_info *si, int batch)
+{
+	static char bufs[UDP_RCV_BATCH_MAX][BUF_SIZE+1];
+	static struct mmsghdr msgs[UDP_RCV_BATCH_MAX];
+	static struct iovec iov[UDP_RCV_BATCH_MAX];
+	static union sockaddr_union src_su[UDP_RCV_BATCH_MAX];
+	struct receive_info ri;
+	str msg;
+	int i, n;
+
+	for (i=0 ; i<batch ; i++) {
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = BUF_SIZE;
+		memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+		msgs[i].msg_hdr.msg_name = &src_su[i].s;
+		msgs[i].msg_hdr.msg_namelen = sockaddru_len(si->su);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	n=recvmmsg(bind_address->socket, msgs, batch, MSG_DONTWAIT, NULL);
+	if (n==-1){
+		if (errno==EAGAIN)
+			return 0;
+		if ((errno==EINTR)||(errno==EWOULDBLOCK)|| (errno==ECONNREFUSED))
+			return -1;
+		LM_ERR("recvmmsg:[%d] %s\n", errno, strerror(errno));
+		return -2;
+	}
+
+	update_stat(batch_reads, 1);
+	update_stat(batch_dgrams, n);
+	update_stat(batch_slots, batch);
+
+	for (i=0 ; i<n ; i++) {
+		if (msgs[i].msg_len<MIN_UDP_PACKET) {
+			LM_DBG("probing packet received len = %d\n", msgs[i].msg_len);
+			continue;
+		}
+
+		/* we must 0-term the messages, receive_msg expects it */
+		bufs[i][msgs[i].msg_len]=0;
+
+		memcpy(&ri.src_su, &src_su[i], sizeof(union sockaddr_union));
+		msg.s = bufs[i];
+		msg.len = msgs[i].msg_len;
+
+		udp_handle_dgram(si, &ri, &msg);
+	}
+
+	return 0;
+}
+#endif
+
+
 static int udp_read_req(struct socket_info *si, int* bytes_read)
 {
 	struct receive_info ri;
 	int len;
 	static char buf [BUF_SIZE+1];
-	char *tmp;
 	unsigned int fromlen;
-	callback_list* p;
 	str msg;
 
+#ifdef HAVE_RECVMMSG
+	len = get_socket_batch(si);
+	if (len>1)
+		return udp_read_batch(si, len);
+#endif
+
 	fromlen=sockaddru_len(si->su);
 	len=recvfrom(bind_address->socket, buf, BUF_SIZE,0,&ri.src_su.s,&fromlen);
 	if (len==-1){
@@ -148,39 +442,10 @@ static int udp_read_req(struct socket_info *si, int* bytes_read)
 	/* we must 0-term the messages, receive_msg expects it */
 	buf[len]=0; /* no need to save the previous char */
 
-	ri.bind_address = si;
-	ri.dst_port = si->port_no;
-	ri.dst_ip = si->address;
-	ri.proto = si->proto;
-	ri.proto_reserved1 = ri.proto_reserved2 = 0;
-
-	su2ip_addr(&ri.src_ip, &ri.src_su);
-	ri.src_port=su_getport(&ri.src_su);
-
 	msg.s = buf;
 	msg.len = len;
 
-	/* run callbacks if looks like non-SIP message*/
-	if( !isalpha(msg.s[0]) ){    /* not-SIP related */
-		for(p = cb_list; p; p = p->next){
-			if(p->b == msg.s[1]){
-				if (p->func(bind_address->socket, &ri, &msg, p->param)==0){
-					/* buffer consumed by callback */
-					break;
-				}
-			}
-		}
-		if (p) return 0;
-	}
-
-	if (ri.src_port==0){
-		tmp=ip_addr2a(&ri.src_ip);
-		LM_INFO("dropping 0 port packet from %s\n", tmp);
-		return 0;
-	}
-
-	/* receive_msg must free buf too!*/
-	receive_msg( msg.s, msg.len, &ri, NULL, 0);
+	udp_handle_dgram(si, &ri, &msg);
 
 	return 0;
 }
@@ -200,6 +465,10 @@ static int proto_udp_send(struct socket_info* source,
 {
 	int n, tolen;
 
+	/* inside a batching window, the datagram is only queued */
+	if (udp_batch_active())
+		return udp_batch_add(source, buf, len, to);
+
 	tolen=sockaddru_len(*to);
 again:
 	n=sendto(source->socket, buf, len, 0, &to->s, tolen);
@@ -218,6 +487,43 @@ again:
 }
 
 
+/**
+ * UDP send function for the messages gathered from several pieces, the
+ * datagram is put together by the kernel (sendmsg).
+ * \see proto_udp_send
+ */
+static int proto_udp_sendv(struct socket_info* source,
+		const struct iovec *iov, int iovcnt, unsigned int len,
+		union sockaddr_union* to, int id)
+{
+	struct msghdr mh;
+	int n;
+
+	if (udp_batch_active())
+		return udp_batch_addv(source, iov, iovcnt, len, to);
+
+	memset(&mh, 0, sizeof mh);
+	mh.msg_name = &to->s;
+	mh.msg_namelen = sockaddru_len(*to);
+	mh.msg_iov = (struct iovec *)iov;
+	mh.msg_iovlen = iovcnt;
+again:
+	n=sendmsg(source->socket, &mh, 0);
+	if (n==-1){
+		if (errno==EINTR || errno==EAGAIN) goto again;
+		LM_ERR("sendmsg(sock,%d,%u,0,%p,%d): %s(%d) [%s:%hu]\n", iovcnt,len,
+				to,mh.msg_namelen,strerror(errno),errno,
+				inet_ntoa(to->sin.sin_addr),ntohs(to->sin.sin_port));
+		if (errno==EINVAL) {
+			LM_CRIT("invalid sendtoparameters\n"
+			"one possible reason is the server is bound to localhost and\n"
+			"attempts to send to the net\n");
+		}
+	}
+	return n;
+}
+
+
 int register_udprecv_cb(udp_rcv_cb_f* func, void* param, char a, char b)
 {
 	callback_list* new;
@@ -24,6 +24,9 @@
 #ifndef _NET_proto_udp_h
 #define _NET_proto_udp_h
 
+/* upper limit for the number of datagrams read with one recvmmsg() */
+#define UDP_RCV_BATCH_MAX 32
+
 typedef int (udp_rcv_cb_f)(int sockfd, struct receive_info *ri,
 													str* msg, void* param);
 
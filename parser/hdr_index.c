@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include "../mem/mem.h"
+#include "../hash_func.h"
+#include "../dprint.h"
+#include "hdr_index.h"
+
+#define HI_MIN_SIZE 16
+
+struct hdr_index_entry {
+	int type;
+	/* for HDR_OTHER_T only */
+	str name;
+	/* the matching headers, in hfs[first .. first+no-1] */
+	unsigned int first;
+	unsigned int no;
+	/* next entry in the same bucket, -1 if none */
+	int next;
+};
+
+struct hdr_index {
+	/* the header list the table was built for */
+	char *buf;
+	struct hdr_field *headers;
+	struct hdr_field *last_header;
+
+	unsigned int size;
+	int *buckets;
+	struct hdr_index_entry *entries;
+	struct hdr_field **hfs;
+};
+
+#define hi_hash(_type, _name, _size) \
+	((_type)!=HDR_OTHER_T ? (unsigned int)(_type)&((_size)-1) : \
+		core_case_hash(_name, NULL, _size))
+
+
+static inline int hi_can_index(struct sip_msg *msg)
+{
+	/* the index is kept in pkg, next to the message */
+	return !(msg->msg_flags&FL_SHM_CLONE) || (msg->msg_flags&FL_TM_FAKE_REQ);
+}
+
+
+static inline int hi_entry(struct hdr_index *hi, int type, str *name)
+{
+	int e;
+
+	for (e = hi->buckets[hi_hash(type, name, hi->size)]; e >= 0;
+	e = hi->entries[e].next)
+		if (hi->entries[e].type == type && (type != HDR_OTHER_T ||
+		(hi->entries[e].name.len == name->len &&
+		strncasecmp(hi->entries[e].name.s, name->s, name->len) == 0)))
+			return e;
+
+	return -1;
+}
+
+
+static struct hdr_index* hi_build(struct sip_msg *msg)
+{
+	struct hdr_index *hi;
+	struct hdr_index_entry *en;
+	struct hdr_field *hf;
+	unsigned int n, size, entries_no, i, h;
+	int *hdr_entry, e;
+
+	for (n = 0, hf = msg->headers; hf; hf = hf->next)
+		n++;
+	for (size = HI_MIN_SIZE; size < n; size <<= 1);
+
+	hi = pkg_malloc(sizeof *hi + size * sizeof *hi->buckets +
+		n * (sizeof *hi->entries + sizeof *hi->hfs + sizeof *hdr_entry));
+	if (!hi) {
+		LM_ERR("oom\n");
+		return NULL;
+	}
+
+	hi->buf = msg->buf;
+	hi->headers = msg->headers;
+	hi->last_header = msg->last_header;
+	hi->size = size;
+	hi->buckets = (int *)(hi + 1);
+	hi->entries = (struct hdr_index_entry *)(hi->buckets + size);
+	hi->hfs = (struct hdr_field **)(hi->entries + n);
+	hdr_entry = (int *)(hi->hfs + n);
+
+	for (i = 0; i < size; i++)
+		hi->buckets[i] = -1;
+
+	/* group the headers by type / name */
+	entries_no = 0;
+	for (i = 0, hf = msg->headers; hf; hf = hf->next, i++) {
+		e = hi_entry(hi, hf->type, &hf->name);
+		if (e < 0) {
+			e = entries_no++;
+			en = &hi->entries[e];
+			en->type = hf->type;
+			en->name = hf->name;
+			en->no = 0;
+
+			h = hi_hash(hf->type, &hf->name, size);
+			en->next = hi->buckets[h];
+			hi->buckets[h] = e;
+		}
+
+		hi->entries[e].no++;
+		hdr_entry[i] = e;
+	}
+
+	for (i = 0, h = 0; i < entries_no; i++) {
+		hi->entries[i].first = h;
+		h += hi->entries[i].no;
+		hi->entries[i].no = 0;
+	}
+
+	/* keep the order of the list within each group */
+	for (i = 0, hf = msg->headers; hf; hf = hf->next, i++) {
+		en = &hi->entries[hdr_entry[i]];
+		hi->hfs[en->first + en->no++] = hf;
+	}
+
+	return hi;
+}
+
+
+static struct hdr_index* hi_get(struct sip_msg *msg)
+{
+	struct hdr_index *hi = msg->hdr_index;
+
+	if (hi) {
+		if (hi->buf == msg->buf && hi->headers == msg->headers &&
+		hi->last_header == msg->last_header &&
+		(!hi->last_header || hi->last_header->next == NULL))
+			return hi;
+
+		/* more headers parsed since, or a brand new header list */
+		pkg_free(hi);
+		msg->hdr_index = NULL;
+	}
+
+	if (!msg->headers || !hi_can_index(msg))
+		return NULL;
+
+	return msg->hdr_index = hi_build(msg);
+}
+
+
+struct hdr_field* hdr_index_first(struct sip_msg *msg, int type, str *name,
+                                  struct hdr_iter *it)
+{
+	struct hdr_index *hi;
+	int e;
+
+	it->type = type;
+	if (type == HDR_OTHER_T)
+		it->name = *name;
+
+	hi = hi_get(msg);
+	if (!hi) {
+		it->hfs = NULL;
+		it->hf = msg->headers;
+		return hdr_index_next(it);
+	}
+
+	e = hi_entry(hi, type, name);
+	if (e < 0) {
+		it->hfs = hi->hfs;
+		it->no = it->i = 0;
+		return NULL;
+	}
+
+	it->hfs = hi->hfs + hi->entries[e].first;
+	it->no = hi->entries[e].no;
+	it->i = 0;
+	return hdr_index_next(it);
+}
+
+
+unsigned int hdr_index_count(struct sip_msg *msg, int type, str *name)
+{
+	struct hdr_iter it;
+	unsigned int n;
+
+	if (!hdr_index_first(msg, type, name, &it))
+		return 0;
+	if (it.hfs)
+		return it.no;
+
+	for (n = 1; hdr_index_next(&it); n++);
+	return n;
+}
+
+
+struct hdr_field* hdr_index_get(struct sip_msg *msg, int type, str *name,
+                                int idx)
+{
+	struct hdr_iter it;
+	struct hdr_field *hf;
+	int n;
+
+	hf = hdr_index_first(msg, type, name, &it);
+	if (!hf)
+		return NULL;
+
+	if (it.hfs) {
+		n = it.no;
+	} else if (idx < 0) {
+		n = hdr_index_count(msg, type, name);
+	} else {
+		for (; hf && idx > 0; idx--)
+			hf = hdr_index_next(&it);
+		return hf;
+	}
+
+	if (idx < 0)
+		idx += n;
+	if (idx < 0 || idx >= n)
+		return NULL;
+
+	if (it.hfs)
+		return it.hfs[idx];
+
+	for (; idx > 0; idx--)
+		hf = hdr_index_next(&it);
+	return hf;
+}
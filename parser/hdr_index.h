@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Header lookup table
+ *
+ * The parsed headers of a message are hashed by type (or by their
+ * lowercase name, for the HDR_OTHER_T ones) at the first lookup, so the
+ * following lookups do not walk and compare the whole header list. The
+ * table is rebuilt whenever the header list of the message changes (more
+ * headers parsed, message re-parsed after applying its lumps, etc.).
+ *
+ * SHM cloned messages (other than the TM faked requests) are not indexed,
+ * their lookups simply walk the header list.
+ */
+
+#ifndef _PARSER_HDR_INDEX_H
+#define _PARSER_HDR_INDEX_H
+
+#include <strings.h>
+
+#include "msg_parser.h"
+
+struct hdr_iter {
+	/* the matching headers, if the message is indexed */
+	struct hdr_field **hfs;
+	unsigned int no;
+	unsigned int i;
+	/* otherwise, where the list walking goes on from */
+	struct hdr_field *hf;
+	int type;
+	str name;
+};
+
+#define hdr_name_match(_hf, _type, _name) \
+	((_type)!=HDR_OTHER_T ? (_hf)->type==(_type) : \
+		((_hf)->type==HDR_OTHER_T && (_hf)->name.len==(_name)->len && \
+		strncasecmp((_hf)->name.s, (_name)->s, (_name)->len)==0))
+
+/* returns the first parsed header of the given type or, for HDR_OTHER_T,
+ * with the given name (case insensitive); NULL if there is none */
+struct hdr_field* hdr_index_first(struct sip_msg *msg, int type, str *name,
+                                  struct hdr_iter *it);
+
+/* returns the next matching header, NULL if there are no more */
+static inline struct hdr_field* hdr_index_next(struct hdr_iter *it)
+{
+	struct hdr_field *hf;
+
+	if (it->hfs)
+		return it->i < it->no ? it->hfs[it->i++] : NULL;
+
+	for (hf = it->hf; hf; hf = hf->next)
+		if (hdr_name_match(hf, it->type, &it->name)) {
+			it->hf = hf->next;
+			return hf;
+		}
+
+	it->hf = NULL;
+	return NULL;
+}
+
+/* returns the number of matching parsed headers */
+unsigned int hdr_index_count(struct sip_msg *msg, int type, str *name);
+
+/* returns the "idx"-th matching header (negative indexes count from
+ * the last one), NULL if out of range */
+struct hdr_field* hdr_index_get(struct sip_msg *msg, int type, str *name,
+                                int idx);
+
+#endif /* _PARSER_HDR_INDEX_H */
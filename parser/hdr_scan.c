@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "../mem/mem.h"
+#include "../dprint.h"
+#include "hdr_scan.h"
+
+#define HS_BLOCK       64
+#define HS_LINES_CHUNK 32
+
+int hdr_scan_enabled = 1;
+
+/* per-process scratch space for the lines of the message being scanned */
+static struct hdr_line *hs_lines;
+static unsigned int hs_lines_size;
+
+
+/* sets the bits of the LF and of the ':', SP, HT bytes of a 64 byte block */
+static inline void hs_block_masks(const char *p, uint64_t *lf, uint64_t *dl)
+{
+#if defined(__AVX2__)
+	const __m256i v_lf = _mm256_set1_epi8('\n');
+	const __m256i v_col = _mm256_set1_epi8(':');
+	const __m256i v_sp = _mm256_set1_epi8(' ');
+	const __m256i v_ht = _mm256_set1_epi8('\t');
+	__m256i b0, b1;
+	uint32_t l0, l1, d0, d1;
+
+	b0 = _mm256_loadu_si256((const __m256i *)p);
+	b1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+
+	l0 = _mm256_movemask_epi8(_mm256_cmpeq_epi8(b0, v_lf));
+	l1 = _mm256_movemask_epi8(_mm256_cmpeq_epi8(b1, v_lf));
+	d0 = _mm256_movemask_epi8(_mm256_or_si256(
+		_mm256_cmpeq_epi8(b0, v_col), _mm256_or_si256(
+		_mm256_cmpeq_epi8(b0, v_sp), _mm256_cmpeq_epi8(b0, v_ht))));
+	d1 = _mm256_movemask_epi8(_mm256_or_si256(
+		_mm256_cmpeq_epi8(b1, v_col), _mm256_or_si256(
+		_mm256_cmpeq_epi8(b1, v_sp), _mm256_cmpeq_epi8(b1, v_ht))));
+
+	*lf = (uint64_t)l0 | ((uint64_t)l1 << 32);
+	*dl = (uint64_t)d0 | ((uint64_t)d1 << 32);
+#elif defined(__SSE2__)
+	const __m128i v_lf = _mm_set1_epi8('\n');
+	const __m128i v_col = _mm_set1_epi8(':');
+	const __m128i v_sp = _mm_set1_epi8(' ');
+	const __m128i v_ht = _mm_set1_epi8('\t');
+	__m128i b;
+	uint64_t l = 0, d = 0;
+	int i;
+
+	for (i = 0; i < HS_BLOCK; i += 16) {
+		b = _mm_loadu_si128((const __m128i *)(p + i));
+		l |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(b, v_lf)) << i;
+		d |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(b, v_col), _mm_or_si128(
+			_mm_cmpeq_epi8(b, v_sp), _mm_cmpeq_epi8(b, v_ht)))) << i;
+	}
+
+	*lf = l;
+	*dl = d;
+#else
+	uint64_t l = 0, d = 0;
+	int i;
+
+	for (i = 0; i < HS_BLOCK; i++) {
+		if (p[i] == '\n')
+			l |= 1ULL << i;
+		else if (p[i] == ':' || p[i] == ' ' || p[i] == '\t')
+			d |= 1ULL << i;
+	}
+
+	*lf = l;
+	*dl = d;
+#endif
+}
+
+
+static inline int hs_add_line(unsigned int n, unsigned int end,
+                              unsigned int delim)
+{
+	struct hdr_line *lines;
+
+	if (n == hs_lines_size) {
+		lines = pkg_realloc(hs_lines,
+			(hs_lines_size + HS_LINES_CHUNK) * sizeof *hs_lines);
+		if (!lines) {
+			LM_ERR("oom\n");
+			return -1;
+		}
+
+		hs_lines = lines;
+		hs_lines_size += HS_LINES_CHUNK;
+	}
+
+	hs_lines[n].end = end;
+	hs_lines[n].delim = delim;
+	return 0;
+}
+
+
+struct hdr_scan* hdr_scan_build(char *buf, unsigned int len, char *start)
+{
+	struct hdr_scan *hs;
+	char tail[HS_BLOCK];
+	unsigned int off, line, e, delim = 0, n = 0;
+	uint64_t lf, dl;
+	int have_delim = 0;
+
+	line = start - buf;
+	if (line >= len || buf[line] == '\r' || buf[line] == '\n')
+		goto done;
+
+	for (off = line; off < len; off += HS_BLOCK) {
+		if (len - off >= HS_BLOCK) {
+			hs_block_masks(buf + off, &lf, &dl);
+		} else {
+			/* the NUL padding matches nothing */
+			memset(tail, 0, HS_BLOCK);
+			memcpy(tail, buf + off, len - off);
+			hs_block_masks(tail, &lf, &dl);
+		}
+
+		for (; lf; lf &= lf - 1) {
+			e = __builtin_ctzll(lf);
+
+			if (!have_delim && (dl & ((1ULL << e) - 1))) {
+				delim = off + __builtin_ctzll(dl) - line;
+				have_delim = 1;
+			}
+
+			/* folded line, the header goes on */
+			if (off + e + 1 < len &&
+			(buf[off + e + 1] == ' ' || buf[off + e + 1] == '\t'))
+				continue;
+
+			if (hs_add_line(n, off + e + 1, have_delim ? delim : 0) < 0)
+				return NULL;
+			n++;
+
+			line = off + e + 1;
+			have_delim = 0;
+			/* the delimiters of the previous lines are of no use anymore */
+			dl &= e == HS_BLOCK - 1 ? 0 : ~((2ULL << e) - 1);
+
+			if (line >= len || buf[line] == '\r' || buf[line] == '\n')
+				goto done;
+		}
+
+		if (!have_delim && dl) {
+			delim = off + __builtin_ctzll(dl) - line;
+			have_delim = 1;
+		}
+	}
+
+	/* a last line with no LF is not indexed, the parser will reject it */
+
+done:
+	hs = pkg_malloc(sizeof *hs + n * sizeof *hs->lines);
+	if (!hs) {
+		LM_ERR("oom\n");
+		return NULL;
+	}
+
+	hs->buf = buf;
+	hs->len = len;
+	hs->start = start - buf;
+	hs->lines_no = n;
+	hs->cur = 0;
+	if (n)
+		memcpy(hs->lines, hs_lines, n * sizeof *hs->lines);
+
+	return hs;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Header boundary index
+ *
+ * The header section of a message is scanned once, 64 bytes at a time
+ * (SSE2 / AVX2 when available at compile time, plain C otherwise), and
+ * the end of each header line (including its folded lines) and the
+ * position of its first ':', SP or HT are indexed. The header parser
+ * uses the index only as a hint, for the lines starting exactly where it
+ * expects the next header, so its results are the same with or without it.
+ */
+
+#ifndef _PARSER_HDR_SCAN_H
+#define _PARSER_HDR_SCAN_H
+
+struct hdr_line {
+	/* offset (in the message buffer) right after the LF ending the line */
+	unsigned int end;
+	/* offset of the first ':', SP or HT, relative to the line start;
+	 * 0 if there is none */
+	unsigned int delim;
+};
+
+struct hdr_scan {
+	char *buf;
+	unsigned int len;
+	/* offset of the first indexed line */
+	unsigned int start;
+	unsigned int lines_no;
+	/* the line most likely to be looked up next */
+	unsigned int cur;
+	struct hdr_line lines[0];
+};
+
+extern int hdr_scan_enabled;
+
+/* indexes the header lines of "buf", starting with the one at "start";
+ * the index is a single pkg chunk, to be released with pkg_free() */
+struct hdr_scan* hdr_scan_build(char *buf, unsigned int len, char *start);
+
+#define hdr_line_start(_hs, _k) \
+	((_k) ? (_hs)->lines[(_k)-1].end : (_hs)->start)
+
+/* returns the indexed line starting at "p", NULL if there is no such line */
+static inline struct hdr_line* hdr_scan_line(struct hdr_scan *hs, char *p)
+{
+	unsigned int off, lo, hi, k;
+
+	if (p < hs->buf || p >= hs->buf + hs->len)
+		return NULL;
+	off = p - hs->buf;
+
+	/* headers are mostly parsed in order */
+	k = hs->cur;
+	if (k >= hs->lines_no || hdr_line_start(hs, k) != off) {
+		lo = 0;
+		hi = hs->lines_no;
+		while (lo < hi) {
+			k = (lo + hi) / 2;
+			if (hdr_line_start(hs, k) < off)
+				lo = k + 1;
+			else
+				hi = k;
+		}
+		k = lo;
+		if (k >= hs->lines_no || hdr_line_start(hs, k) != off)
+			return NULL;
+	}
+
+	hs->cur = k + 1;
+	return &hs->lines[k];
+}
+
+#endif /* _PARSER_HDR_SCAN_H */
@@ -36,6 +36,7 @@
 #include "parse_cseq.h"
 #include "../dprint.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 #include "parse_def.h"
 #include "digest/digest.h" /* free_credentials */
 #include "parse_event.h"
@@ -238,7 +239,7 @@ void free_hdr_field_lst(struct hdr_field* hf)
 		foo=hf;
 		hf=hf->next;
 		clean_hdr_field(foo);
-		pkg_free(foo);
+		msg_free(foo);
 	}
 }
 
@@ -46,12 +46,14 @@
 #include "../dprint.h"
 #include "../data_lump_rpl.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 #include "../error.h"
 #include "../globals.h"
 #include "../core_stats.h"
 #include "../errinfo.h"
 #include "../dset.h"
 #include "parse_hname2.h"
+#include "hdr_scan.h"
 #include "parse_uri.h"
 #include "parse_content.h"
 #include "../msg_callbacks.h"
@@ -61,14 +63,15 @@
 #endif
 
 
-#define parse_hname(_b,_e,_h) parse_hname2((_b),(_e),(_h))
+#define parse_hname(_b,_e,_h,_d) parse_hname2_scan((_b),(_e),(_h),(_d))
 
 /* number of via's encountered */
 int via_cnt;
 
-/* returns pointer to next header line, and fill hdr_f ;
- * if at end of header returns pointer to the last crlf  (always buf)*/
-char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
+/* "delim" and "line_end", if known from the header index, point to the
+ * first ':', SP or HT of the header line and right after its last LF */
+static inline char* __get_hdr_field(char* buf, char* end,
+                        struct hdr_field* hdr, char* delim, char* line_end)
 {
 
 	char* tmp;
@@ -85,7 +88,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 		return buf;
 	}
 
-	tmp=parse_hname(buf, end, hdr);
+	tmp=parse_hname(buf, end, hdr, delim);
 	if (hdr->type==HDR_ERROR_T){
 		LM_ERR("bad header\n");
 		goto error_bad_hdr;
@@ -107,7 +110,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 			/* keep number of vias parsed -- we want to report it in
 			   replies for diagnostic purposes */
 			via_cnt++;
-			vb=pkg_malloc(sizeof(struct via_body));
+			vb=msg_malloc_near(hdr, sizeof(struct via_body));
 			if (vb==0){
 				LM_ERR("out of pkg memory\n");
 				goto error;
@@ -129,7 +132,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 			hdr->body.len=tmp-hdr->body.s;
 			break;
 		case HDR_CSEQ_T:
-			cseq_b=pkg_malloc(sizeof(struct cseq_body));
+			cseq_b=msg_malloc_near(hdr, sizeof(struct cseq_body));
 			if (cseq_b==0){
 				LM_ERR("out of pkg memory\n");
 				goto error;
@@ -139,7 +142,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 			tmp=parse_cseq(tmp, end, cseq_b);
 			if (cseq_b->error==PARSE_ERROR){
 				LM_ERR("bad cseq\n");
-				pkg_free(cseq_b);
+				msg_free(cseq_b);
 				set_err_info(OSER_EC_PARSER, OSER_EL_MEDIUM,
 					"error parsing CSeq`");
 				set_err_reply(400, "bad CSeq header");
@@ -153,7 +156,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 					cseq_b->method.len, cseq_b->method.s);
 			break;
 		case HDR_TO_T:
-			to_b=pkg_malloc(sizeof(struct to_body));
+			to_b=msg_malloc_near(hdr, sizeof(struct to_body));
 			if (to_b==0){
 				LM_ERR("out of pkg memory\n");
 				goto error;
@@ -163,7 +166,7 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 			tmp=parse_to(tmp, end,to_b);
 			if (to_b->error==PARSE_ERROR){
 				LM_ERR("bad to header\n");
-				pkg_free(to_b);
+				msg_free(to_b);
 				set_err_info(OSER_EC_PARSER, OSER_EL_MEDIUM,
 					"error parsing To header");
 				set_err_reply(400, "bad header");
@@ -231,6 +234,12 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
 			/* just skip over it */
 			hdr->body.s=tmp;
 			/* find end of header */
+			if (line_end && tmp<line_end) {
+				match=line_end;
+				tmp=match;
+				hdr->body.len=match-hdr->body.s;
+				break;
+			}
 			/* find lf */
 			do{
 				match=q_memchr(tmp, '\n', end-tmp);
@@ -268,6 +277,14 @@ error:
 }
 
 
+/* returns pointer to next header line, and fill hdr_f ;
+ * if at end of header returns pointer to the last crlf  (always buf)*/
+char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr)
+{
+	return __get_hdr_field(buf, end, hdr, NULL, NULL);
+}
+
+
 
 /* parse the headers and adds them to msg->headers and msg->to, from etc.
  * It stops when all the headers requested in flags were parsed, on error
@@ -285,6 +302,8 @@ int parse_headers(struct sip_msg* msg, hdr_flags_t flags, int next)
 {
 	struct hdr_field *hf;
 	struct hdr_field *itr;
+	struct hdr_scan *hs;
+	struct hdr_line *hl;
 	char* tmp;
 	char* rest;
 	char* end;
@@ -302,6 +321,20 @@ int parse_headers(struct sip_msg* msg, hdr_flags_t flags, int next)
 	end=msg->buf+msg->len;
 	tmp=msg->unparsed;
 
+	/* index the header lines at the first parsing, so the next
+	 * headers are found without walking them byte by byte */
+	hs = NULL;
+	if (hdr_scan_enabled && !(msg->msg_flags&FL_SHM_CLONE)) {
+		if (msg->hdr_scan && (msg->hdr_scan->buf!=msg->buf ||
+		msg->hdr_scan->len!=msg->len)) {
+			pkg_free(msg->hdr_scan);
+			msg->hdr_scan = NULL;
+		}
+		if (msg->hdr_scan==NULL && tmp<end)
+			msg->hdr_scan = hdr_scan_build(msg->buf, msg->len, tmp);
+		hs = msg->hdr_scan;
+	}
+
 	if (next) {
 		orig_flag = msg->parsed_flag;
 		msg->parsed_flag &= ~flags;
@@ -310,7 +343,7 @@ int parse_headers(struct sip_msg* msg, hdr_flags_t flags, int next)
 
 	LM_DBG("flags=%llx\n", (unsigned long long)flags);
 	while( tmp<end && (flags & msg->parsed_flag) != flags){
-		hf=pkg_malloc(sizeof(struct hdr_field));
+		hf=msg_malloc(msg, sizeof(struct hdr_field));
 		if (hf==0){
 			ser_error=E_OUT_OF_MEM;
 			LM_ERR("pkg memory allocation failed\n");
@@ -318,7 +351,11 @@ int parse_headers(struct sip_msg* msg, hdr_flags_t flags, int next)
 		}
 		memset(hf,0, sizeof(struct hdr_field));
 		hf->type=HDR_ERROR_T;
-		rest=get_hdr_field(tmp, msg->buf+msg->len, hf);
+		if (hs && (hl=hdr_scan_line(hs, tmp))!=NULL)
+			rest=__get_hdr_field(tmp, end, hf,
+				hl->delim ? tmp+hl->delim : NULL, msg->buf+hl->end);
+		else
+			rest=get_hdr_field(tmp, end, hf);
 		switch (hf->type){
 			case HDR_ERROR_T:
 				LM_INFO("bad header field\n");
@@ -326,7 +363,7 @@ int parse_headers(struct sip_msg* msg, hdr_flags_t flags, int next)
 			case HDR_EOH_T:
 				msg->eoh=tmp; /* or rest?*/
 				msg->parsed_flag|=HDR_EOH_F;
-				pkg_free(hf);
+				msg_free(hf);
 				goto skip;
 			case HDR_OTHER_T: /*do nothing*/
 				break;
@@ -533,7 +570,7 @@ skip:
 
 error:
 	ser_error=E_BAD_REQ;
-	if (hf) pkg_free(hf);
+	if (hf) msg_free(hf);
 	if (next) msg->parsed_flag |= orig_flag;
 	return -1;
 }
@@ -833,10 +870,22 @@ void free_sip_msg(struct sip_msg* msg)
 		free_reply_lump(msg->reply_lump);
 	if (msg->body )
 		free_sip_body(msg->body);
+	free_hdr_scan(msg);
+	if (msg->hdr_index)
+		pkg_free(msg->hdr_index);
 	/* don't free anymore -- now a pointer to a static buffer */
 }
 
 
+void free_hdr_scan(struct sip_msg* msg)
+{
+	if (msg->hdr_scan) {
+		pkg_free(msg->hdr_scan);
+		msg->hdr_scan = NULL;
+	}
+}
+
+
 /* make sure all HFs needed for transaction identification have been
    parsed; return 0 if those HFs can't be found
 */
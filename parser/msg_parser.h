@@ -201,6 +201,8 @@ struct sip_uri {
 
 /* Forward declaration */
 struct msg_callback;
+struct hdr_scan;
+struct hdr_index;
 
 struct sip_msg {
 	unsigned int id;               /* message id, unique/process*/
@@ -262,6 +264,8 @@ struct sip_msg {
 
 	char* eoh;        /* pointer to the end of header (if found) or null */
 	char* unparsed;   /* here we stopped parsing*/
+	struct hdr_scan *hdr_scan; /* index of the header lines (pkg) */
+	struct hdr_index *hdr_index; /* header lookup table (pkg) */
 
 	struct receive_info rcv; /* source & dest ip, ports, proto a.s.o*/
 
@@ -338,6 +342,10 @@ char* get_hdr_field(char* buf, char* end, struct hdr_field* hdr);
 
 void free_sip_msg(struct sip_msg* msg);
 
+/* releases the header index of a message parsed with parse_headers(), but
+ * not released with free_sip_msg() */
+void free_hdr_scan(struct sip_msg* msg);
+
 int clone_headers(struct sip_msg *from_msg, struct sip_msg *to_msg);
 
 /* make sure all HFs needed for transaction identification have been
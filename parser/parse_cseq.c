@@ -30,6 +30,7 @@
 #include "parse_def.h"
 #include "parse_methods.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 
 /*
  * Parse CSeq header field
@@ -97,5 +98,5 @@ error:
 
 void free_cseq(struct cseq_body* cb)
 {
-	pkg_free(cb);
+	msg_free(cb);
 }
@@ -32,6 +32,7 @@
 #include "../dprint.h"
 #include "../ut.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 #include "msg_parser.h"
 
 /*
@@ -58,7 +59,7 @@ int parse_from_header( struct sip_msg *msg)
 
 	/* bad luck! :-( - we have to parse it */
 	/* first, get some memory */
-	from_b = pkg_malloc(sizeof(struct to_body));
+	from_b = msg_malloc(msg, sizeof(struct to_body));
 	if (from_b == 0) {
 		LM_ERR("out of pkg_memory\n");
 		goto error;
@@ -69,7 +70,7 @@ int parse_from_header( struct sip_msg *msg)
 	parse_to(msg->from->body.s,msg->from->body.s+msg->from->body.len+1,from_b);
 	if (from_b->error == PARSE_ERROR) {
 		LM_ERR("bad from header\n");
-		pkg_free(from_b);
+		msg_free(from_b);
 		set_err_info(OSER_EC_PARSER, OSER_EL_MEDIUM,
 			"error parsing From header");
 		set_err_reply(400, "bad header");
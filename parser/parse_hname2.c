@@ -141,7 +141,8 @@ static inline char* skip_ws(char* p, char *end)
 	}
 
 
-char* parse_hname2(char* begin, char* end, struct hdr_field* hdr)
+static inline char* __parse_hname2(char* begin, char* end,
+                                   struct hdr_field* hdr, char* delim)
 {
 	register char* p;
 	register unsigned int val;
@@ -232,6 +233,9 @@ char* parse_hname2(char* begin, char* end, struct hdr_field* hdr)
  other:
 	/* Unknown header type */
 	hdr->type = HDR_OTHER_T;
+	/* nothing but name chars up to the known delimiter */
+	if (delim && delim >= p)
+		p = delim;
 	/* if overflow during the "switch-case" parsing, the "while" will
 	 * exit and we will fall in the "error" section */
 	while ( p < end ) {
@@ -257,3 +261,16 @@ char* parse_hname2(char* begin, char* end, struct hdr_field* hdr)
 	hdr->name.len = 0;
 	return 0;
 }
+
+
+char* parse_hname2(char* begin, char* end, struct hdr_field* hdr)
+{
+	return __parse_hname2(begin, end, hdr, NULL);
+}
+
+
+char* parse_hname2_scan(char* begin, char* end, struct hdr_field* hdr,
+                        char* delim)
+{
+	return __parse_hname2(begin, end, hdr, delim);
+}
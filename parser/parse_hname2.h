@@ -32,4 +32,11 @@
  */
 char* parse_hname2(char* begin, char* end, struct hdr_field* hdr);
 
+/*
+ * Same as above, with "delim" pointing to the first ':', SP or HT
+ * of the header line (as known from the header index)
+ */
+char* parse_hname2_scan(char* begin, char* end, struct hdr_field* hdr,
+                        char* delim);
+
 #endif /* PARSE_HNAME2_H */
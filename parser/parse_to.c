@@ -34,6 +34,7 @@
 #include "parse_uri.h"
 #include "../ut.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 #include "../errinfo.h"
 
 
@@ -71,7 +72,7 @@ void free_to_params(struct to_body* tb)
 	struct to_param *foo;
 	while (tp){
 		foo = tp->next;
-		pkg_free(tp);
+		msg_free(tp);
 		tp=foo;
 	}
 
@@ -84,7 +85,7 @@ void free_to(struct to_body* tb)
 	if (tb) {
 		free_to( tb->next );
 		free_to_params(tb);
-		pkg_free(tb);
+		msg_free(tb);
 	}
 }
 
@@ -284,7 +285,7 @@ static inline char* parse_to_param(char *buffer, char *end,
 						add_param(param,to_b);
 					case E_PARA_VALUE:
 						param = (struct to_param*)
-							pkg_malloc(sizeof(struct to_param));
+							msg_malloc_near(to_b,sizeof(struct to_param));
 						if (!param){
 							LM_ERR("out of pkg memory\n" );
 							goto error;
@@ -464,7 +465,7 @@ endofheader:
 				goto parse_error;
 			add_param(param, to_b);
 		} else {
-			pkg_free(param);
+			msg_free(param);
 		}
 	}
 	*returned_status=saved_status;
@@ -474,7 +475,7 @@ parse_error:
 	LM_ERR("unexpected char [%c] in status %d: <<%.*s>> .\n",
 		*tmp,status, (int)(tmp-buffer), ZSW(buffer));
 error:
-	if (param) pkg_free(param);
+	if (param) msg_free(param);
 	free_to_params(to_b);
 	to_b->error=PARSE_ERROR;
 	*returned_status = status;
@@ -613,7 +614,7 @@ static inline char* _parse_to(char* buffer, char *end, struct to_body *to_b,
 						if (multi==0)
 							goto parse_error;
 						to_b->next = (struct to_body*)
-							pkg_malloc(sizeof(struct to_body));
+							msg_malloc_near(to_b,sizeof(struct to_body));
 						if (to_b->next==NULL) {
 							LM_ERR("failed to allocate new TO body\n");
 							goto error;
@@ -726,7 +727,8 @@ static inline char* _parse_to(char* buffer, char *end, struct to_body *to_b,
 						if (to_b->error!=PARSE_ERROR && multi && *tmp==',') {
 							/* continue with a new body instance */
 							to_b->next = (struct to_body*)
-								pkg_malloc(sizeof(struct to_body));
+								msg_malloc_near(to_b,
+									sizeof(struct to_body));
 							if (to_b->next==NULL) {
 								LM_ERR("failed to allocate new TO body\n");
 								goto error;
@@ -869,7 +871,7 @@ int parse_to_header( struct sip_msg *msg)
 
 	/* bad luck! :-( - we have to parse it */
 	/* first, get some memory */
-	to_b = pkg_malloc(sizeof(struct to_body));
+	to_b = msg_malloc(msg, sizeof(struct to_body));
 	if (to_b == 0) {
 		LM_ERR("out of pkg_memory\n");
 		goto error;
@@ -880,7 +882,7 @@ int parse_to_header( struct sip_msg *msg)
 	parse_to(msg->to->body.s,msg->to->body.s+msg->to->body.len+1,to_b);
 	if (to_b->error == PARSE_ERROR) {
 		LM_ERR("bad to header\n");
-		pkg_free(to_b);
+		msg_free(to_b);
 		set_err_info(OSER_EC_PARSER, OSER_EL_MEDIUM,
 			"error parsing too header");
 		set_err_reply(400, "bad header");
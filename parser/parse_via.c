@@ -51,6 +51,7 @@
 #include "../ut.h"
 #include "../ip_addr.h"
 #include "../mem/mem.h"
+#include "../mem/msg_arena.h"
 #include "parse_via.h"
 #include "parse_def.h"
 
@@ -2109,7 +2110,8 @@ parse_again:
 					case F_PARAM:
 						/*state=P_PARAM*/;
 						if(vb->params.s==0) vb->params.s=param_start;
-						param=pkg_malloc(sizeof(struct via_param));
+						param=msg_malloc_near(vb,
+							sizeof(struct via_param));
 						if (param==0){
 							LM_ERR("no pkg memory left\n");
 							goto error;
@@ -2136,10 +2138,10 @@ parse_again:
 												-vb->params.s;
 								break;
 							case PARAM_ERROR:
-								pkg_free(param);
+								msg_free(param);
 								goto parse_error;
 							default:
-								pkg_free(param);
+								msg_free(param);
 								LM_ERR(" after parse_via_param: invalid "
 										"char <%c> on state %d\n",*tmp, state);
 								goto parse_error;
@@ -2272,7 +2274,7 @@ nextvia:
 					goto parse_error;
 		}
 	}
-	vb->next=pkg_malloc(sizeof(struct via_body));
+	vb->next=msg_malloc_near(vb, sizeof(struct via_body));
 	if (vb->next==0){
 		LM_ERR(" out of pkg memory\n");
 		goto error;
@@ -2306,7 +2308,7 @@ static inline void free_via_param_list(struct via_param* vp)
 	while(vp){
 		foo=vp;
 		vp=vp->next;
-		pkg_free(foo);
+		msg_free(foo);
 	}
 }
 
@@ -2318,6 +2320,6 @@ void free_via_list(struct via_body* vb)
 		foo=vb;
 		vb=vb->next;
 		if (foo->param_lst) free_via_param_list(foo->param_lst);
-		pkg_free(foo);
+		msg_free(foo);
 	}
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <tap.h>
+#include <string.h>
+
+#include "../../dprint.h"
+#include "../../mem/mem.h"
+
+#include "../msg_parser.h"
+#include "../hdr_index.h"
+
+static char msg_buf[] =
+	"INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds\r\n"
+	"Max-Forwards: 70\r\n"
+	"X-Foo: 1\r\n"
+	"To: Bob <sip:bob@biloxi.example.com>\r\n"
+	"x-foo: 2\r\n"
+	"From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+	"Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+	"X-Bar: a\r\n"
+	"CSeq: 314159 INVITE\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bK776asdhdt\r\n"
+	"X-FOO: 3\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n";
+
+static void test_hdr_index_lookup(void)
+{
+	struct sip_msg msg;
+	struct hdr_iter it;
+	struct hdr_field *hf;
+	str foo = str_init("x-Foo"), bar = str_init("X-BAR"),
+		none = str_init("X-None");
+	char *p;
+	int i;
+
+	memset(&msg, 0, sizeof msg);
+	msg.buf = msg_buf;
+	msg.len = strlen(msg_buf);
+	msg.unparsed = strstr(msg_buf, "\r\n") + 2;
+
+	/* stop after the first To header */
+	if (!ok(parse_headers(&msg, HDR_TO_F, 0) == 0, "headers parsed"))
+		return;
+	ok(hdr_index_count(&msg, HDR_OTHER_T, &foo) == 1, "first X-Foo indexed");
+	ok(hdr_index_first(&msg, HDR_CONTENTLENGTH_T, NULL, &it) == NULL,
+	   "Content-Length not parsed yet");
+
+	/* the index must see the headers parsed since */
+	parse_headers(&msg, HDR_EOH_F, 0);
+	ok(hdr_index_count(&msg, HDR_CONTENTLENGTH_T, NULL) == 1,
+	   "Content-Length indexed");
+	ok(hdr_index_count(&msg, HDR_VIA_T, NULL) == 2, "both Vias indexed");
+	ok(hdr_index_count(&msg, HDR_OTHER_T, &foo) == 3, "X-Foo, any case");
+	ok(hdr_index_count(&msg, HDR_OTHER_T, &bar) == 1, "X-Bar");
+	ok(hdr_index_count(&msg, HDR_OTHER_T, &none) == 0, "no X-None");
+	ok(hdr_index_count(&msg, HDR_CALLID_T, NULL) == 1, "Call-ID");
+
+	for (i = 0, hf = hdr_index_first(&msg, HDR_OTHER_T, &foo, &it); hf;
+	hf = hdr_index_next(&it))
+		i = i * 10 + (hf->body.s[0] - '0');
+	ok(i == 123, "X-Foo headers in message order");
+
+	hf = hdr_index_get(&msg, HDR_OTHER_T, &foo, -1);
+	ok(hf && hf->body.s[0] == '3', "last X-Foo");
+	hf = hdr_index_get(&msg, HDR_OTHER_T, &foo, 1);
+	ok(hf && hf->body.s[0] == '2', "second X-Foo");
+	ok(hdr_index_get(&msg, HDR_OTHER_T, &foo, 3) == NULL &&
+	   hdr_index_get(&msg, HDR_OTHER_T, &foo, -4) == NULL, "out of range");
+
+	hf = hdr_index_get(&msg, HDR_VIA_T, NULL, -1);
+	p = strstr(msg_buf, "Via: SIP/2.0/UDP 10.0.0.1");
+	ok(hf && hf->name.s == p, "last Via");
+
+	/* same results when walking the list (SHM clones) */
+	pkg_free(msg.hdr_index);
+	msg.hdr_index = NULL;
+	msg.msg_flags |= FL_SHM_CLONE;
+	ok(hdr_index_count(&msg, HDR_OTHER_T, &foo) == 3 &&
+	   hdr_index_get(&msg, HDR_OTHER_T, &foo, -2)->body.s[0] == '2' &&
+	   hdr_index_get(&msg, HDR_VIA_T, NULL, 1)->name.s == p,
+	   "same lookups without the index");
+	msg.msg_flags &= ~FL_SHM_CLONE;
+
+	free_sip_msg(&msg);
+}
+
+void test_parser_hdr_index(void)
+{
+	test_hdr_index_lookup();
+}
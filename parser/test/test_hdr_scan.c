@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <tap.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../dprint.h"
+#include "../../mem/mem.h"
+
+#include "../msg_parser.h"
+#include "../hdr_scan.h"
+
+/* mutated copies of each message of the corpus */
+#define HSF_MUTATIONS  4000
+
+static char *corpus[] = {
+	"INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds\r\n"
+	"Max-Forwards: 70\r\n"
+	"To: Bob <sip:bob@biloxi.example.com>\r\n"
+	"From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+	"Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+	"CSeq: 314159 INVITE\r\n"
+	"Contact: <sip:alice@pc33.atlanta.example.com>\r\n"
+	"Content-Type: application/sdp\r\n"
+	"Content-Length: 4\r\n"
+	"\r\n"
+	"v=0\n",
+
+	"SIP/2.0 200 OK\r\n"
+	"v: SIP/2.0/UDP server10.biloxi.example.com;branch=z9hG4bKnashds8\r\n"
+	"v: SIP/2.0/UDP bigbox3.site3.atlanta.example.com\r\n"
+	" ;branch=z9hG4bK77ef4c2312983.1\r\n"
+	"t: Bob <sip:bob@biloxi.example.com>;tag=a6c85cf\r\n"
+	"f: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+	"i: a84b4c76e66710\r\n"
+	"CSeq: 314159 INVITE\r\n"
+	"X-Very-Long-Header-Name-Crossing-The-Block-Boundary-Of-The-Scanner"
+	"  \t : folded\r\n\tvalue\r\n \tand more\r\n"
+	"Record-Route: <sip:p1.example.com;lr>,\r\n <sip:p2.example.com;lr>\r\n"
+	"l: 0\r\n"
+	"\r\n",
+
+	"REGISTER sip:registrar.example.com SIP/2.0\n"
+	"Via: SIP/2.0/TCP 10.0.0.1:5060;branch=z9hG4bKnashds7\n"
+	"To:<sip:bob@example.com>\n"
+	"From:<sip:bob@example.com>;tag=456248\n"
+	"Call-ID:843817637684230@998sdasdh09\n"
+	"CSeq:1826 REGISTER\n"
+	"Contact:<sip:bob@192.0.2.4>;expires=7200\n"
+	"P-Custom\t:x\n"
+	"Expires:7200\n"
+	"User-Agent:  UA \t/1.0\n"
+	"Content-Length:0\n"
+	"\n",
+};
+
+static unsigned int hs_rand_state;
+
+static unsigned int hs_rand(void)
+{
+	hs_rand_state = hs_rand_state * 1103515245 + 12345;
+	return (hs_rand_state >> 16) & 0x7fff;
+}
+
+/* inserts, drops or overwrites a few bytes, favouring the ones the
+ * header parser cares about */
+static int mutate(char *dst, const char *src, int len, int max)
+{
+	static const char pool[] = ":: \t\t\r\n\n\r\nab:X";
+	int i, n, pos, op, j = 0;
+
+	n = 1 + hs_rand() % 4;
+	for (i = 0; i < len && j < max; i++) {
+		pos = hs_rand() % (len / n + 1);
+		op = pos < 1 ? hs_rand() % 3 : 3;
+		if (op == 0) {
+			/* drop */
+			continue;
+		} else if (op == 1) {
+			/* insert */
+			dst[j++] = pool[hs_rand() % (sizeof pool - 1)];
+			if (j < max)
+				dst[j++] = src[i];
+		} else if (op == 2) {
+			/* overwrite */
+			dst[j++] = pool[hs_rand() % (sizeof pool - 1)];
+		} else {
+			dst[j++] = src[i];
+		}
+	}
+
+	return j;
+}
+
+static int parse(char *buf, int len, struct sip_msg *msg)
+{
+	memset(msg, 0, sizeof *msg);
+	msg->buf = buf;
+	msg->len = len;
+
+	if (parse_msg(buf, len, msg) != 0)
+		return -1;
+
+	/* incremental parsing, as done during the script */
+	if (parse_headers(msg, HDR_CALLID_F, 0) < 0)
+		return -2;
+	if (parse_headers(msg, HDR_EOH_F, 0) < 0)
+		return -3;
+
+	return 0;
+}
+
+#define same_str(_a, _b) \
+	((_a).len == (_b).len && \
+	 ((_a).s ? (_b).s && (_a).s - a->buf == (_b).s - b->buf : !(_b).s))
+
+/* the two messages are parsed from identical buffers */
+static int same_parsing(struct sip_msg *a, struct sip_msg *b)
+{
+	struct hdr_field *ha, *hb;
+
+	if (a->parsed_flag != b->parsed_flag ||
+	a->unparsed - a->buf != b->unparsed - b->buf ||
+	(a->eoh ? a->eoh - a->buf : -1) != (b->eoh ? b->eoh - b->buf : -1))
+		return 0;
+
+	for (ha = a->headers, hb = b->headers; ha && hb;
+	ha = ha->next, hb = hb->next)
+		if (ha->type != hb->type || ha->len != hb->len ||
+		!same_str(ha->name, hb->name) || !same_str(ha->body, hb->body))
+			return 0;
+
+	return !ha && !hb;
+}
+
+static int cmp_parsing(char *buf, int len, int *failed)
+{
+	struct sip_msg ma, mb;
+	char *ba, *bb;
+	int ra, rb, same;
+
+	ba = pkg_malloc(len + 1);
+	bb = pkg_malloc(len + 1);
+	if (!ba || !bb) {
+		LM_ERR("oom\n");
+		return 0;
+	}
+	memcpy(ba, buf, len);
+	ba[len] = '\0';
+	memcpy(bb, buf, len);
+	bb[len] = '\0';
+
+	hdr_scan_enabled = 0;
+	ra = parse(ba, len, &ma);
+	hdr_scan_enabled = 1;
+	rb = parse(bb, len, &mb);
+
+	same = ra == rb && same_parsing(&ma, &mb);
+	if (rb < 0)
+		(*failed)++;
+
+	free_sip_msg(&ma);
+	free_sip_msg(&mb);
+	pkg_free(ba);
+	pkg_free(bb);
+
+	return same;
+}
+
+static void test_hdr_scan_index(void)
+{
+	char *buf = corpus[0];
+	struct hdr_scan *hs;
+	struct hdr_line *hl;
+	char *via;
+
+	via = strstr(buf, "Via:");
+	hs = hdr_scan_build(buf, strlen(buf), via);
+	if (!ok(hs != NULL, "index built"))
+		return;
+
+	ok(hs->lines_no == 9, "all the header lines indexed");
+	hl = hdr_scan_line(hs, via);
+	ok(hl && buf + hl->end == strstr(buf, "Max-Forwards") &&
+	   hl->delim == 3, "first line boundaries");
+	hl = hdr_scan_line(hs, strstr(buf, "Content-Length"));
+	ok(hl && buf + hl->end == strstr(buf, "\r\n\r\n") + 2 &&
+	   hl->delim == 14, "last line boundaries");
+	ok(hdr_scan_line(hs, via + 1) == NULL, "no line inside a line");
+
+	pkg_free(hs);
+
+	buf = corpus[1];
+	hs = hdr_scan_build(buf, strlen(buf), strstr(buf, "v:"));
+	if (!ok(hs != NULL, "index built"))
+		return;
+
+	hl = hdr_scan_line(hs, strstr(buf, "X-Very"));
+	ok(hl && buf + hl->end == strstr(buf, "Record-Route") &&
+	   buf[(hl - hs->lines ? hl[-1].end : hs->start) + hl->delim] == ' ',
+	   "folded line kept within the header");
+	hl = hdr_scan_line(hs, strstr(buf, "Record-Route"));
+	ok(hl && buf + hl->end == strstr(buf, "l: 0"), "folded list");
+
+	pkg_free(hs);
+}
+
+static void test_hdr_scan_fuzz(void)
+{
+	char buf[2048];
+	int i, k, len, diff = 0, failed = 0, total = 0;
+
+	for (k = 0; k < sizeof corpus / sizeof *corpus; k++) {
+		total++;
+		diff += !cmp_parsing(corpus[k], strlen(corpus[k]), &failed);
+
+		hs_rand_state = k + 1;
+		for (i = 0; i < HSF_MUTATIONS; i++) {
+			len = mutate(buf, corpus[k], strlen(corpus[k]), sizeof buf);
+			total++;
+			diff += !cmp_parsing(buf, len, &failed);
+		}
+	}
+
+	LM_INFO("%d messages parsed, %d rejected, %d differences\n",
+	        total, failed, diff);
+	ok(diff == 0, "same parsing with and without the header index");
+	ok(failed > 0 && failed < total, "corpus mixes good and bad messages");
+}
+
+/* the way tm and b2b parse a block of headers, without free_sip_msg() */
+static void test_hdr_scan_free(void)
+{
+	struct sip_msg msg;
+	char *hdrs = strstr(corpus[0], "Via:");
+
+	memset(&msg, 0, sizeof msg);
+	msg.buf = msg.unparsed = hdrs;
+	msg.len = strlen(hdrs);
+
+	ok(parse_headers(&msg, HDR_EOH_F, 0) == 0 && msg.hdr_scan != NULL,
+	   "headers block indexed");
+
+	if (msg.headers)
+		free_hdr_field_lst(msg.headers);
+	free_hdr_scan(&msg);
+	ok(msg.hdr_scan == NULL, "index released");
+	free_hdr_scan(&msg);
+}
+
+void test_parser_hdr_scan(void)
+{
+	test_hdr_scan_index();
+	test_hdr_scan_fuzz();
+	test_hdr_scan_free();
+}
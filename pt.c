@@ -69,8 +69,9 @@ int count_child_processes(void)
 
 #ifdef UNIT_TESTS
 #include "mem/test/test_hp_malloc.h"
+#include "mem/test/test_hp_cache.h"
 	if (testing_framework)
-		proc_no += TEST_MALLOC_PROCS - 1;
+		proc_no += TEST_MALLOC_PROCS - 1 + 2 * (TEST_CACHE_PROCS - 1);
 #endif
 
 	return proc_no;
@@ -235,6 +236,8 @@ pid_t internal_fork(char *proc_desc, unsigned int flags)
 		/* set uid and pid */
 		process_no = process_counter;
 		pt[process_no].pid = getpid();
+		/* the parent never caches shm fragments, so start clean */
+		shm_cache_enable();
 		pt[process_no].flags = flags;
 		process_counter = CHILD_COUNTER_STOP;
 		/* each children need a unique seed */
@@ -56,6 +56,7 @@
 #include "parser/parse_from.h"
 #include "parser/parse_uri.h"
 #include "parser/parse_hname2.h"
+#include "parser/hdr_index.h"
 #include "parser/parse_content.h"
 #include "parser/parse_refer_to.h"
 #include "parser/parse_rpid.h"
@@ -2203,27 +2204,18 @@ static int pv_get_hdr_prolog(struct sip_msg *msg,  pv_param_t *param, pv_value_t
 static int pv_get_hdrcnt(struct sip_msg *msg,  pv_param_t *param, pv_value_t *res)
 {
 	pv_value_t tv;
-	struct hdr_field *hf;
 	unsigned int n;
 	int ret;
 
 	if ( (ret=pv_get_hdr_prolog(msg,  param, res, &tv)) <= 0 )
 	    	return ret;
 
-	n = 0;
 	if (tv.flags==0) {
 		/* it is a known header -> use type to find it */
-		for (hf=msg->headers; hf; hf=hf->next) {
-			if (tv.ri==hf->type)
-			        ++n;
-		}
+		n = hdr_index_count(msg, tv.ri, NULL);
 	} else {
 		/* it is an un-known header -> use name to find it */
-		for (hf=msg->headers; hf; hf=hf->next) {
-			if (hf->type==HDR_OTHER_T && hf->name.len==tv.rs.len
-			&& strncasecmp(hf->name.s, tv.rs.s, hf->name.len)==0)
-				++n;
-		}
+		n = hdr_index_count(msg, HDR_OTHER_T, &tv.rs);
 	}
 	return pv_get_uintval(msg, param, res, n);
 }
@@ -2234,29 +2226,20 @@ static int pv_get_hdr(struct sip_msg *msg,  pv_param_t *param, pv_value_t *res)
 	int idxf;
 	pv_value_t tv;
 	struct hdr_field *hf;
-	struct hdr_field *hf0;
+	struct hdr_iter it;
 	char *p;
-	int n;
 	int ret;
 
 	if ( (ret=pv_get_hdr_prolog(msg,  param, res, &tv)) <= 0 )
 	    	return ret;
 
-	if (tv.flags==0) {
-		/* it is a known header -> use type to find it */
-		for (hf=msg->headers; hf; hf=hf->next) {
-			if (tv.ri==hf->type)
-				break;
-		}
-	} else {
-		/* it is an un-known header -> use name to find it */
-		for (hf=msg->headers; hf; hf=hf->next) {
-			if (hf->type==HDR_OTHER_T && hf->name.len==tv.rs.len
-			&& strncasecmp(hf->name.s, tv.rs.s, hf->name.len)==0)
-				break;
-		}
-	}
+	/* known headers are looked up by type, the others by name */
+	if (tv.flags==0)
+		tv.rs.s = NULL;
+	else
+		tv.ri = HDR_OTHER_T;
 
+	hf = hdr_index_first(msg, tv.ri, &tv.rs, &it);
 	if(hf==NULL)
 		return pv_get_null(msg, param, res);
 	/* get the index */
@@ -2296,20 +2279,7 @@ static int pv_get_hdr(struct sip_msg *msg,  pv_param_t *param, pv_value_t *res)
 			memcpy(p, hf->body.s, hf->body.len);
 			p += hf->body.len;
 			/* next hf */
-			if (tv.flags==0) {
-				/* it is a known header -> use type to find it */
-				for (hf=hf->next ; hf; hf=hf->next) {
-					if (tv.ri==hf->type)
-						break;
-				}
-			} else {
-				/* it is an un-known header -> use name to find it */
-				for (hf=hf->next ; hf; hf=hf->next) {
-					if (hf->type==HDR_OTHER_T && hf->name.len==tv.rs.len
-					&& strncasecmp(hf->name.s, tv.rs.s, hf->name.len)==0)
-						break;
-				}
-			}
+			hf = hdr_index_next(&it);
 		} while (hf);
 		*p = 0;
 		res->rs.s = pv_local_buf;
@@ -2318,67 +2288,10 @@ static int pv_get_hdr(struct sip_msg *msg,  pv_param_t *param, pv_value_t *res)
 	}
 
 	/* we have a numeric index */
-	hf0 = 0;
-	if(idx<0)
-	{
-		n = 1;
-		/* count headers */
-		if (tv.flags==0 ) {
-			/* it is a known header -> use type to find it */
-			for (hf0=hf->next; hf0; hf0=hf0->next) {
-				if (tv.ri==hf0->type)
-					n++;
-			}
-		} else {
-			/* it is an un-known header -> use name to find it */
-			for (hf0=hf->next; hf0; hf0=hf0->next) {
-				if (hf0->type==HDR_OTHER_T && hf0->name.len==tv.rs.len
-				&& strncasecmp(hf0->name.s, tv.rs.s, hf0->name.len)==0)
-					n++;
-			}
-		}
-
-		idx = -idx;
-		if(idx>n)
-		{
-			LM_DBG("index out of range\n");
-			return pv_get_null(msg, param, res);
-		}
-		idx = n - idx;
-		if(idx==0)
-		{
-			res->rs  = hf->body;
-			return 0;
-		}
-	}
-	n=0;
-	while(n<idx)
-	{
-		if (tv.flags==0) {
-			/* it is a known header -> use type to find it */
-			for (hf0=hf->next; hf0; hf0=hf0->next) {
-				if (tv.ri==hf0->type) {
-					n++;
-					if(n==idx) break;
-				}
-			}
-		} else {
-			/* it is an un-known header -> use name to find it */
-			for (hf0=hf->next; hf0; hf0=hf0->next) {
-				if (hf0->type==HDR_OTHER_T && hf0->name.len==tv.rs.len
-				&& strncasecmp(hf0->name.s, tv.rs.s, hf0->name.len)==0) {
-					n++;
-					if(n==idx) break;
-				}
-			}
-		}
-		if(hf0==NULL)
-			break;
-	}
-
-	if(hf0!=0)
+	hf = hdr_index_get(msg, tv.ri, &tv.rs, idx);
+	if(hf!=0)
 	{
-		res->rs  = hf0->body;
+		res->rs  = hf->body;
 		return 0;
 	}
 
@@ -53,6 +53,7 @@
 #include "forward.h"
 #include "action.h"
 #include "mem/mem.h"
+#include "mem/msg_arena.h"
 #include "ip_addr.h"
 #include "script_cb.h"
 #include "dset.h"
@@ -102,7 +103,7 @@ int receive_msg(char* buf, unsigned int len, struct receive_info* rcv_info,
 	static context_p ctx = NULL;
 	struct sip_msg* msg;
 	struct timeval start;
-	int rc;
+	int rc, arena;
 	char *tmp;
 	str in_buff;
 
@@ -142,6 +143,9 @@ int receive_msg(char* buf, unsigned int len, struct receive_info* rcv_info,
 	msg->msg_flags=msg_flags;
 	msg->ruri_q = Q_UNSPECIFIED;
 
+	/* everything parsed or built for this message only goes to the arena */
+	arena = msg_arena_open(msg);
+
 	if (parse_msg(in_buff.s,len, msg)!=0){
 		tmp=ip_addr2a(&(rcv_info->src_ip));
 		LM_ERR("Unable to parse msg received from [%s:%d]\n",
@@ -285,8 +289,12 @@ end:
 	/* free possible loaded avps -bogdan */
 	reset_avps();
 	LM_DBG("cleaning up\n");
+	rc = msg->first_line.type==SIP_REQUEST ?
+		MSG_ARENA_REQUEST : MSG_ARENA_REPLY;
 	free_sip_msg(msg);
 	pkg_free(msg);
+	if (arena)
+		msg_arena_close(rc);
 	if (in_buff.s != buf)
 		pkg_free(in_buff.s);
 	return 0;
@@ -294,6 +302,8 @@ parse_error:
 	exec_parse_err_cb(msg);
 	free_sip_msg(msg);
 	pkg_free(msg);
+	if (arena)
+		msg_arena_close(MSG_ARENA_ERROR);
 error:
 	if (in_buff.s != buf)
 		pkg_free(in_buff.s);
@@ -158,4 +158,79 @@ inline static void lock_destroy_rw(rw_lock_t *_lock)
 		lock_release((_lock)->lock); \
 	} while (0)
 
+/*
+ * a set of reader/writer locks, e.g. one per hash bucket (or group of
+ * buckets). A writer holds the lock of the set for its whole section, so
+ * with no readers around writing costs just the plain lock (and writers
+ * queue on it, not on a sleep loop); it only sleeps while the readers
+ * already in drain out. Readers hold the lock just to register themselves.
+ */
+struct rw_lock_state {
+	volatile int r_count;
+};
+
+typedef struct rw_lock_set_t {
+	gen_lock_set_t *locks;
+	struct rw_lock_state *states;
+	int size;
+} rw_lock_set_t;
+
+inline static rw_lock_set_t * lock_init_rw_set(int size)
+{
+	rw_lock_set_t *new_set;
+
+	new_set = (rw_lock_set_t*)shm_malloc(sizeof(rw_lock_set_t) +
+		size * sizeof(struct rw_lock_state));
+	if (!new_set)
+		return NULL;
+	memset(new_set, 0, sizeof(rw_lock_set_t) +
+		size * sizeof(struct rw_lock_state));
+	new_set->states = (struct rw_lock_state *)(new_set + 1);
+	new_set->size = size;
+
+	new_set->locks = lock_set_alloc(size);
+	if (!new_set->locks)
+		goto error;
+	if (!lock_set_init(new_set->locks)) {
+		lock_set_dealloc(new_set->locks);
+		goto error;
+	}
+
+	return new_set;
+error:
+	shm_free(new_set);
+	return NULL;
+}
+
+inline static void lock_destroy_rw_set(rw_lock_set_t *_set)
+{
+	if (!_set)
+		return;
+
+	lock_set_destroy(_set->locks);
+	lock_set_dealloc(_set->locks);
+	shm_free(_set);
+}
+
+#define lock_set_start_write(_set, _i) \
+	do { \
+		lock_set_get((_set)->locks, _i); \
+		/* no new readers may get in, wait for the current ones */ \
+		while ((_set)->states[_i].r_count) \
+			usleep(LOCK_WAIT); \
+	} while (0)
+
+#define lock_set_stop_write(_set, _i) \
+	lock_set_release((_set)->locks, _i)
+
+#define lock_set_start_read(_set, _i) \
+	do { \
+		lock_set_get((_set)->locks, _i); \
+		__sync_add_and_fetch(&(_set)->states[_i].r_count, 1); \
+		lock_set_release((_set)->locks, _i); \
+	} while (0)
+
+#define lock_set_stop_read(_set, _i) \
+	__sync_sub_and_fetch(&(_set)->states[_i].r_count, 1)
+
 #endif
@@ -265,6 +265,11 @@ int run_post_raw_processing_cb(int type, str* data, struct sip_msg* msg)
 	return run_raw_processing_cb(type, data, msg, post_processing_cb_list);
 }
 
+int has_post_raw_processing_cb(void)
+{
+	return post_processing_cb_list!=NULL;
+}
+
 int run_raw_processing_cb(int type, str *data, struct sip_msg* msg, struct raw_processing_cb_list* list)
 {
 
@@ -96,6 +96,7 @@ int register_post_raw_processing_cb(raw_processing_func f, int type, char freeab
 
 int run_pre_raw_processing_cb(int type, str* data, struct sip_msg* msg);
 int run_post_raw_processing_cb(int type, str* data, struct sip_msg* msg);
+int has_post_raw_processing_cb(void);
 
 int run_raw_processing_cb(int type,str *data, struct sip_msg* msg, struct raw_processing_cb_list* list);
 
@@ -74,6 +74,12 @@ int register_slcb(enum sl_cb_type type, unsigned int fmask, sl_cb_t f)
 }
 
 
+int slcb_registered(enum sl_cb_type type)
+{
+	return slcb_hl[type]!=NULL;
+}
+
+
 void slcb_run_reply_out(struct sip_msg *req, str *buffer,
 									union sockaddr_union *dst, int rpl_code)
 {
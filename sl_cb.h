@@ -56,6 +56,9 @@ void slcb_run_ack_in(struct sip_msg *req);
 void slcb_run_req_out(struct sip_msg *req, str *buffer,
 		union sockaddr_union *dst, struct socket_info *sock, int proto);
 
+/* any callback registered for the given type? */
+int slcb_registered(enum sl_cb_type type);
+
 #endif
 
 
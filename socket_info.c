@@ -177,6 +177,7 @@ static void free_sock_info(struct socket_info* si)
 		if(si->adv_name_str.s) pkg_free(si->adv_name_str.s);
 		if(si->adv_port_str.s) pkg_free(si->adv_port_str.s);
 		if(si->adv_sock_str.s) pkg_free(si->adv_sock_str.s);
+		if(si->workers_sockets) pkg_free(si->workers_sockets);
 	}
 }
 
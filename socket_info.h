@@ -44,7 +44,8 @@ struct socket_info {
 	str address_str;        /*!< ip address converted to string -- optimization*/
 	unsigned short port_no;  /*!< port number */
 	str port_no_str; /*!< port number converted to string -- optimization*/
-	enum si_flags flags; /*!< SI_IS_IP | SI_IS_LO | SI_IS_MCAST | SI_IS_ANYCAST */
+	enum si_flags flags; /*!< SI_IS_IP | SI_IS_LO | SI_IS_MCAST | SI_IS_ANYCAST |
+	                          SI_REUSEPORT */
 	union sockaddr_union su;
 	int proto; /*!< tcp or udp*/
 	str sock_str;
@@ -63,6 +64,10 @@ struct socket_info {
 	 * otherwise you may read old data here */
 	unsigned short last_local_real_port;
 	unsigned short last_remote_real_port;
+	/* SO_REUSEPORT mode (SI_REUSEPORT) - one socket per worker ("children"
+	 * of the listener), the first one being also the default one, used by
+	 * all the other processes */
+	int *workers_sockets;
 
 	struct socket_info* next;
 	struct socket_info* prev;
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+#include <tap.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../dprint.h"
+#include "../ut.h"
+#include "../bin_persist.h"
+
+#include "test_bin_persist.h"
+
+#define BPT_MAX 16
+
+static str bpt_cap = str_init("bin-persist-test");
+
+struct bpt_loaded {
+	int n;
+	int vals[BPT_MAX];
+};
+
+static int bpt_packet(bin_packet_t *packet, int val)
+{
+	if (bin_init(packet, &bpt_cap, 1, 1, 0) != 0)
+		return -1;
+
+	bin_push_int(packet, val);
+	bin_push_str(packet, &bpt_cap);
+	return 0;
+}
+
+static int bpt_journal(bin_persist_t *bp, int val)
+{
+	bin_packet_t packet;
+	int rc;
+
+	if (bpt_packet(&packet, val) != 0)
+		return -1;
+
+	rc = bin_persist_journal(bp, &packet);
+	bin_free_packet(&packet);
+	return rc;
+}
+
+static int bpt_load_cb(bin_packet_t *packet, void *param)
+{
+	struct bpt_loaded *l = (struct bpt_loaded *)param;
+	str s;
+	int val;
+
+	if (bin_pop_int(packet, &val) != 0 || bin_pop_str(packet, &s) != 0 ||
+	    str_strcmp(&s, &bpt_cap) != 0 || l->n == BPT_MAX)
+		val = -1;
+
+	l->vals[l->n++] = val;
+	return 0;
+}
+
+static int bpt_load(bin_persist_t *bp, const char *expected)
+{
+	struct bpt_loaded l;
+	char buf[BPT_MAX * 4], *p = buf;
+	int i;
+
+	memset(&l, 0, sizeof l);
+	if (bin_persist_load(bp, bpt_load_cb, &l) != l.n)
+		return 0;
+
+	*p = 0;
+	for (i = 0; i < l.n; i++)
+		p += sprintf(p, "%s%d", i ? "," : "", l.vals[i]);
+
+	if (strcmp(buf, expected) != 0) {
+		diag("loaded '%s', expected '%s'", buf, expected);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* dumps 10 and 11, while 4 is changed meanwhile */
+static int bpt_dump(bin_persist_t *bp, void *param)
+{
+	bin_packet_t packet;
+	int val, rc = 0;
+
+	for (val = 10; val <= 11; val++) {
+		if (bpt_packet(&packet, val) != 0)
+			return -1;
+
+		rc |= bin_persist_write(bp, &packet);
+		bin_free_packet(&packet);
+	}
+
+	rc |= bpt_journal(bp, *(int *)param);
+	return rc;
+}
+
+static int bpt_dump_fail(bin_persist_t *bp, void *param)
+{
+	bpt_journal(bp, *(int *)param);
+	return -1;
+}
+
+/* the files as a crash right after the dump would leave them */
+static int bpt_crash_image(bin_persist_t *bp, int save)
+{
+	char *files[3] = {bp->snapshot, bp->journal, bp->journal_old};
+	char crash[128];
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		sprintf(crash, "%s.crash", files[i]);
+		if (save) {
+			unlink(crash);
+			if (access(files[i], F_OK) == 0 && link(files[i], crash) < 0)
+				return -1;
+		} else {
+			unlink(files[i]);
+			if (access(crash, F_OK) == 0 && rename(crash, files[i]) < 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* changes @param meanwhile, then "crashes" before the snapshot is in place */
+static int bpt_dump_crash(bin_persist_t *bp, void *param)
+{
+	if (bpt_journal(bp, *(int *)param) < 0)
+		return -1;
+
+	return bpt_crash_image(bp, 1);
+}
+
+static void bpt_unlink(bin_persist_t *bp)
+{
+	unlink(bp->snapshot);
+	unlink(bp->journal);
+	unlink(bp->journal_old);
+	unlink(bp->tmp);
+}
+
+void test_bin_persist(void)
+{
+	bin_persist_t *bp;
+	char path[64];
+	FILE *f;
+	int val;
+
+	sprintf(path, "/tmp/opensips_bin_persist_%d", getpid());
+	bp = bin_persist_init(path);
+	if (!ok(bp != NULL, "bin_persist_init"))
+		return;
+	bpt_unlink(bp);
+
+	ok(bin_persist_snapshot(bp, bpt_dump, &val) == 0 &&
+	   access(bp->snapshot, F_OK) != 0, "no snapshot before loading");
+	ok(bpt_load(bp, ""), "nothing to load");
+
+	ok(bpt_journal(bp, 1) == 0 && bpt_journal(bp, 2) == 0 &&
+	   bpt_journal(bp, 3) == 0, "journaled");
+	ok(bpt_load(bp, "1,2,3"), "journal loaded");
+
+	val = 4;
+	ok(bin_persist_snapshot(bp, bpt_dump, &val) == 0 &&
+	   access(bp->journal_old, F_OK) != 0, "snapshot written");
+	ok(bpt_journal(bp, 5) == 0, "journaled after the snapshot");
+	ok(bpt_load(bp, "10,11,4,5"), "snapshot and new journal loaded");
+
+	val = 6;
+	ok(bin_persist_snapshot(bp, bpt_dump_fail, &val) < 0 &&
+	   access(bp->journal_old, F_OK) != 0, "failed snapshot");
+	ok(bpt_load(bp, "10,11,4,5,6"), "journal kept on failure");
+
+	/* an append interrupted half-way */
+	f = fopen(bp->journal, "a");
+	if (f) {
+		fwrite(BIN_PACKET_MARKER "\xff\x00", 6, 1, f);
+		fclose(f);
+	}
+	ok(bpt_load(bp, "10,11,4,5,6"), "truncated packet ignored");
+
+	/* two snapshots in a row crash before being renamed in place */
+	bpt_unlink(bp);
+	ok(bpt_journal(bp, 1) == 0 && bpt_journal(bp, 2) == 0, "journaled");
+
+	val = 3;
+	ok(bin_persist_snapshot(bp, bpt_dump_crash, &val) == 0 &&
+	   bpt_crash_image(bp, 0) == 0 && access(bp->journal_old, F_OK) == 0,
+	   "first crashed snapshot");
+	ok(bpt_load(bp, "1,2,3"), "recovered from the old journal");
+
+	val = 4;
+	ok(bin_persist_snapshot(bp, bpt_dump_crash, &val) == 0 &&
+	   bpt_crash_image(bp, 0) == 0, "second crashed snapshot");
+	ok(bpt_load(bp, "1,2,3,4"), "nothing lost after the second crash");
+
+	val = 5;
+	ok(bin_persist_snapshot(bp, bpt_dump, &val) == 0 &&
+	   access(bp->journal_old, F_OK) != 0, "snapshot after the crashes");
+	ok(bpt_load(bp, "10,11,5"), "snapshot and new journal loaded");
+
+	bpt_unlink(bp);
+	bin_persist_destroy(bp);
+}
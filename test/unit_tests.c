@@ -24,7 +24,13 @@
 
 #include "../cachedb/test/test_cachedb.h"
 #include "../lib/test/test_csv.h"
+#include "../lib/test/test_timer_wheel.h"
+#include "../parser/test/test_hdr_scan.h"
+#include "../parser/test/test_hdr_index.h"
 #include "../mem/test/test_hp_malloc.h"
+#include "../mem/test/test_hp_cache.h"
+#include "../mem/test/test_msg_arena.h"
+#include "test_bin_persist.h"
 
 #include "../lib/list.h"
 #include "../dprint.h"
@@ -34,11 +40,18 @@ void init_unit_tests(void) {
 	set_mpath("modules/");
 	init_cachedb_tests();
 	//init_hp_malloc_tests();
+	//init_hp_cache_tests();
 }
 
 int run_unit_tests(void) {
 	test_cachedb();
 	test_lib_csv();
+	test_lib_timer_wheel();
+	test_parser_hdr_scan();
+	test_parser_hdr_index();
+	test_msg_arena();
+	test_bin_persist();
 	//test_hp_malloc();
+	//test_hp_cache();
 	done_testing();
 }
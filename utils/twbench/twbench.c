@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020 OpenSIPS Solutions
+ *
+ * This file is part of opensips, a free SIP server.
+ *
+ * opensips is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * opensips is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301,USA
+ */
+
+/*
+ * Timer wheel benchmark - measures the average cost of an insert and of
+ * an expiry, for an increasing number of live timers (the cost should stay
+ * flat, up to the cache misses of a larger working set)
+ *
+ * usage: twbench [live_timers ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "../../lib/timer_wheel.h"
+
+/* the timers fire within this many units */
+#define TWB_SPAN     30000
+/* units the benchmark runs for, once the wheel is populated */
+#define TWB_STEPS    3000
+
+static long usec_since(struct timeval *start)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	return (end.tv_sec - start->tv_sec) * 1000000L +
+	       (end.tv_usec - start->tv_usec);
+}
+
+/* populates a wheel with "live" timers, then keeps re-arming each fired
+ * timer (as transactions come and go) */
+static int bench_timer_wheel(int live)
+{
+	struct timer_wheel *tw;
+	struct tw_link *tl;
+	struct list_head expired, *it, *next;
+	struct timeval start;
+	long usec_add = 0, usec_exp = 0, adds = 0, exps = 0;
+	utime_t now = 0;
+	int i;
+
+	tw = malloc(sizeof *tw);
+	tl = malloc(live * sizeof *tl);
+	if (!tw || !tl) {
+		fprintf(stderr, "oom\n");
+		free(tw);
+		free(tl);
+		return -1;
+	}
+
+	srand(live);
+	tw_init(tw, 1, now);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < live; i++)
+		tw_add(tw, &tl[i], now + 1 + rand() % TWB_SPAN, now);
+	usec_add += usec_since(&start);
+	adds += live;
+
+	for (i = 0; i < TWB_STEPS; i++) {
+		now++;
+		INIT_LIST_HEAD(&expired);
+
+		gettimeofday(&start, NULL);
+		tw_expire(tw, now, &expired);
+		usec_exp += usec_since(&start);
+
+		gettimeofday(&start, NULL);
+		list_for_each_safe(it, next, &expired) {
+			exps++;
+			tw_add(tw, list_entry(it, struct tw_link, list),
+			       now + 1 + rand() % TWB_SPAN, now);
+		}
+		usec_add += usec_since(&start);
+		adds += live - tw->count;
+	}
+
+	printf("%8d live timers: %.1f ns/insert, %.1f ns/expire (%ld fired)\n",
+	       live, usec_add * 1000.0 / adds,
+	       exps ? usec_exp * 1000.0 / exps : 0, exps);
+
+	free(tl);
+	free(tw);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int live[] = { 10000, 100000, 1000000 };
+	int i;
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++)
+			if (bench_timer_wheel(atoi(argv[i])) < 0)
+				return 1;
+		return 0;
+	}
+
+	for (i = 0; i < sizeof live / sizeof *live; i++)
+		if (bench_timer_wheel(live[i]) < 0)
+			return 1;
+
+	return 0;
+}